@@ -0,0 +1,620 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <glm/glm/glm.hpp>
+
+#include "ConcurrentRegistry.h"
+#include "DrawData.h"
+#include "GridMesh.h"
+#include "Resources.h"
+#include "ThreadPool.h"
+#include "api/DrawDataBuilder.h"
+#include "api/StaticBatch.h"
+#include "api/Transform.h"
+#include "api/TransformHierarchy.h"
+
+/*
+ * CPU microbenchmarks for the code that runs every frame while building and uploading draw data.
+ * No window or Vulkan device is created, so this can run on machines without a GPU.
+ *
+ * Usage: EggBenchmark [output file] [max scene size] [repetitions]
+ */
+
+using Clock = std::chrono::steady_clock;
+
+/*
+ * The measured timings of a single benchmark at a single scene size.
+ */
+struct BenchmarkResult
+{
+    std::string m_Name;
+    uint32_t m_Size = 0;                                        //The amount of items processed per repetition.
+    uint32_t m_Repetitions = 0;
+    double m_MinMilliseconds = 0.0;
+    double m_MedianMilliseconds = 0.0;
+    std::vector<std::pair<std::string, double>> m_Extra;       //Benchmark specific values, written as extra JSON fields.
+};
+
+/*
+ * Written to at the end of every benchmark so that the compiler can not remove the measured work.
+ */
+volatile uint64_t g_Sink = 0;
+
+/*
+ * Measure a function multiple times.
+ * a_Setup is called before every repetition and is not measured. a_Run is the measured part.
+ */
+BenchmarkResult Measure(const std::string& a_Name, uint32_t a_Size, uint32_t a_Repetitions, const std::function<void()>& a_Setup, const std::function<void()>& a_Run)
+{
+    std::vector<double> timings;
+    timings.reserve(a_Repetitions);
+
+    for (uint32_t i = 0; i < a_Repetitions; ++i)
+    {
+        a_Setup();
+        const auto start = Clock::now();
+        a_Run();
+        const auto end = Clock::now();
+        timings.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+    }
+
+    std::sort(timings.begin(), timings.end());
+
+    BenchmarkResult result;
+    result.m_Name = a_Name;
+    result.m_Size = a_Size;
+    result.m_Repetitions = a_Repetitions;
+    result.m_MinMilliseconds = timings.front();
+    result.m_MedianMilliseconds = timings[timings.size() / 2];
+    return result;
+}
+
+/*
+ * Create a material with some variation so that packing is not constant.
+ */
+std::shared_ptr<egg::Material> CreateMaterial(uint32_t a_Index)
+{
+    egg::MaterialCreateInfo info;
+    const float factor = static_cast<float>(a_Index % 256) / 255.f;
+    info.m_AlbedoFactor = glm::vec3(factor, 1.f - factor, 0.5f);
+    info.m_EmissiveFactor = glm::vec3(0.f, factor, 0.f);
+    info.m_MetallicFactor = factor;
+    info.m_RoughnessFactor = 1.f - factor;
+    return std::make_shared<egg::Material>(info);
+}
+
+glm::mat4 CreateTransform(uint32_t a_Index)
+{
+    glm::mat4 transform(1.f);
+    transform[3] = glm::vec4(static_cast<float>(a_Index % 100), static_cast<float>(a_Index / 100 % 100), static_cast<float>(a_Index / 10000), 1.f);
+    return transform;
+}
+
+/*
+ * Add instances with a single shared material to an empty draw data.
+ */
+BenchmarkResult BenchmarkAddInstance(uint32_t a_Size, uint32_t a_Repetitions)
+{
+    const auto material = CreateMaterial(0);
+    std::unique_ptr<egg::DrawData> drawData;
+    egg::MaterialHandle materialHandle{};
+
+    return Measure("DrawData::AddInstance", a_Size, a_Repetitions,
+        [&]()
+        {
+            drawData = std::make_unique<egg::DrawData>();
+            materialHandle = drawData->AddMaterial(material);
+        },
+        [&]()
+        {
+            for (uint32_t i = 0; i < a_Size; ++i)
+            {
+                drawData->AddInstance(CreateTransform(i), materialHandle, i);
+            }
+            g_Sink = drawData->GetInstanceCount();
+        });
+}
+
+/*
+ * Add a draw call for every instance. Instances are added up front and not measured.
+ */
+BenchmarkResult BenchmarkAddDrawCall(uint32_t a_Size, uint32_t a_Repetitions)
+{
+    const auto material = CreateMaterial(0);
+    std::unique_ptr<egg::DrawData> drawData;
+    std::vector<egg::InstanceDataHandle> instances;
+    egg::MeshHandle meshHandle{};
+
+    return Measure("DrawData::AddDrawCall", a_Size, a_Repetitions,
+        [&]()
+        {
+            drawData = std::make_unique<egg::DrawData>();
+            meshHandle = drawData->AddMesh(nullptr);
+            const auto materialHandle = drawData->AddMaterial(material);
+            instances.clear();
+            for (uint32_t i = 0; i < a_Size; ++i)
+            {
+                instances.push_back(drawData->AddInstance(CreateTransform(i), materialHandle, i));
+            }
+        },
+        [&]()
+        {
+            for (uint32_t i = 0; i < a_Size; ++i)
+            {
+                drawData->AddDrawCall(meshHandle, &instances[i], 1);
+            }
+            g_Sink = drawData->GetDrawCallCount();
+        });
+}
+
+/*
+ * Add an equal amount of sphere and directional lights without shadows.
+ */
+BenchmarkResult BenchmarkAddLight(uint32_t a_Size, uint32_t a_Repetitions)
+{
+    std::unique_ptr<egg::DrawData> drawData;
+
+    return Measure("DrawData::AddLight", a_Size, a_Repetitions,
+        [&]()
+        {
+            drawData = std::make_unique<egg::DrawData>();
+        },
+        [&]()
+        {
+            for (uint32_t i = 0; i < a_Size; ++i)
+            {
+                if (i % 2 == 0)
+                {
+                    egg::SphereLight light;
+                    light.SetPosition(static_cast<float>(i), 0.f, 0.f);
+                    drawData->AddLight(light);
+                }
+                else
+                {
+                    egg::DirectionalLight light;
+                    light.SetRadiance(static_cast<float>(i), 1.f, 1.f);
+                    drawData->AddLight(light);
+                }
+            }
+            g_Sink = drawData->GetLightCount();
+        });
+}
+
+/*
+ * Pack materials into their GPU representation. A limited set of unique materials is cycled through, like in a real scene.
+ */
+BenchmarkResult BenchmarkPackMaterialData(uint32_t a_Size, uint32_t a_Repetitions)
+{
+    constexpr uint32_t NUM_UNIQUE_MATERIALS = 1024;
+    std::vector<std::shared_ptr<egg::Material>> materials;
+    for (uint32_t i = 0; i < NUM_UNIQUE_MATERIALS; ++i)
+    {
+        materials.push_back(CreateMaterial(i));
+    }
+
+    return Measure("Material::PackMaterialData", a_Size, a_Repetitions,
+        []() {},
+        [&]()
+        {
+            uint64_t checksum = 0;
+            for (uint32_t i = 0; i < a_Size; ++i)
+            {
+                const auto packed = materials[i % NUM_UNIQUE_MATERIALS]->PackMaterialData();
+                checksum += packed.m_Data.x ^ packed.m_Data.z;
+            }
+            g_Sink = checksum;
+        });
+}
+
+/*
+ * Rebuild the matrices of transforms that were all modified since the last rebuild.
+ */
+BenchmarkResult BenchmarkTransformRebuild(uint32_t a_Size, uint32_t a_Repetitions)
+{
+    std::vector<egg::Transform> transforms(a_Size);
+
+    return Measure("Transform::GetTransformation", a_Size, a_Repetitions,
+        [&]()
+        {
+            //Modify every transform so that the dirty flag is set.
+            for (uint32_t i = 0; i < a_Size; ++i)
+            {
+                transforms[i].Translate(glm::vec3(0.01f, 0.f, 0.f));
+                transforms[i].Rotate(glm::vec3(0.f, 1.f, 0.f), 0.01f);
+            }
+        },
+        [&]()
+        {
+            float checksum = 0.f;
+            for (uint32_t i = 0; i < a_Size; ++i)
+            {
+                checksum += transforms[i].GetTransformation()[3][0];
+            }
+            g_Sink = static_cast<uint64_t>(checksum);
+        });
+}
+
+/*
+ * Update the world matrices of many skeleton-like hierarchies after moving every root, so that all transforms are recalculated.
+ * Every skeleton has a spine of 8 bones with 7 bones hanging from each spine bone.
+ */
+BenchmarkResult BenchmarkTransformHierarchy(uint32_t a_Size, uint32_t a_Repetitions)
+{
+    constexpr uint32_t SPINE_LENGTH = 8;
+    constexpr uint32_t BONES_PER_SKELETON = SPINE_LENGTH * 8;
+
+    const uint32_t numThreads = std::max(2u, std::thread::hardware_concurrency()) - 1;
+    egg::TransformHierarchy hierarchy(numThreads);
+    std::vector<egg::TransformHandle> roots;
+    for (uint32_t skeleton = 0; skeleton < std::max(1u, a_Size / BONES_PER_SKELETON); ++skeleton)
+    {
+        auto parent = hierarchy.Create();
+        roots.push_back(parent);
+        for (uint32_t spine = 0; spine < SPINE_LENGTH; ++spine)
+        {
+            for (uint32_t limb = 0; limb < 7; ++limb)
+            {
+                hierarchy.SetLocalTranslation(hierarchy.Create(parent), glm::vec3(0.1f * limb, 0.f, 0.f));
+            }
+
+            if (spine + 1 < SPINE_LENGTH)
+            {
+                parent = hierarchy.Create(parent);
+                hierarchy.SetLocalTranslation(parent, glm::vec3(0.f, 0.2f, 0.f));
+            }
+        }
+    }
+    hierarchy.Update();
+
+    uint32_t numUpdated = 0;
+    auto result = Measure("TransformHierarchy::Update", hierarchy.GetCount(), a_Repetitions,
+        [&]()
+        {
+            for (const auto root : roots)
+            {
+                hierarchy.SetLocalTranslation(root, hierarchy.GetLocalTranslation(root) + glm::vec3(0.01f, 0.f, 0.f));
+            }
+        },
+        [&]()
+        {
+            numUpdated = hierarchy.Update();
+            g_Sink = numUpdated;
+        });
+
+    result.m_Extra.emplace_back("threads", static_cast<double>(numThreads));
+    result.m_Extra.emplace_back("levels", static_cast<double>(hierarchy.GetLevelCount()));
+    result.m_Extra.emplace_back("updated", static_cast<double>(numUpdated));
+    return result;
+}
+
+/*
+ * Build draw data from objects that were added in a random mesh and material order, like a scene graph would submit them.
+ * The builder persists between repetitions, so this measures the cost per frame of a scene that did not change.
+ */
+BenchmarkResult BenchmarkDrawDataBuilder(uint32_t a_Size, uint32_t a_Repetitions)
+{
+    constexpr uint32_t NUM_MESHES = 64;
+    constexpr uint32_t NUM_MATERIALS = 16;
+
+    std::vector<std::shared_ptr<egg::EggStaticMesh>> meshes;
+    for (uint32_t i = 0; i < NUM_MESHES; ++i)
+    {
+        meshes.push_back(std::make_shared<egg::EggStaticMesh>());
+    }
+    std::vector<std::shared_ptr<egg::EggMaterial>> materials;
+    for (uint32_t i = 0; i < NUM_MATERIALS; ++i)
+    {
+        materials.push_back(CreateMaterial(i));
+    }
+
+    //A cheap hash scatters the objects over the meshes and materials.
+    egg::DrawDataBuilder builder;
+    for (uint32_t i = 0; i < a_Size; ++i)
+    {
+        const uint32_t hash = i * 2654435761u;
+        builder.Add(meshes[(hash >> 8) % NUM_MESHES], materials[(hash >> 20) % NUM_MATERIALS], CreateTransform(i), i);
+    }
+
+    std::unique_ptr<egg::DrawData> drawData;
+    std::vector<egg::DrawCallHandle> drawCalls;
+    auto result = Measure("DrawDataBuilder::Build", a_Size, a_Repetitions,
+        [&]()
+        {
+            drawData = std::make_unique<egg::DrawData>();
+        },
+        [&]()
+        {
+            builder.Build(*drawData, drawCalls);
+            g_Sink = drawData->GetDrawCallCount();
+        });
+
+    result.m_Extra.emplace_back("draw_calls", static_cast<double>(drawCalls.size()));
+    return result;
+}
+
+/*
+ * Concatenate the area and directional lights into the upload buffer, like the renderer does every frame.
+ */
+BenchmarkResult BenchmarkPackLights(uint32_t a_Size, uint32_t a_Repetitions)
+{
+    egg::DrawData drawData;
+    for (uint32_t i = 0; i < a_Size; ++i)
+    {
+        if (i % 2 == 0)
+        {
+            drawData.AddLight(egg::SphereLight());
+        }
+        else
+        {
+            drawData.AddLight(egg::DirectionalLight());
+        }
+    }
+
+    return Measure("DrawData::PackLights", a_Size, a_Repetitions,
+        []() {},
+        [&]()
+        {
+            //A new vector every frame, the same as in Renderer::DrawFrame.
+            std::vector<egg::PackedLightData> allLightData;
+            drawData.PackLights(allLightData);
+            g_Sink = allLightData.size();
+        });
+}
+
+/*
+ * Remove the entries of a registry that are no longer referenced from the outside.
+ * One in every sixteen entries is unreferenced, which is similar to a frame in which some meshes are released.
+ */
+BenchmarkResult BenchmarkRemoveUnused(uint32_t a_Size, uint32_t a_Repetitions)
+{
+    constexpr uint32_t REMOVE_INTERVAL = 16;
+    std::unique_ptr<egg::ConcurrentRegistry<uint32_t>> registry;
+    std::vector<std::shared_ptr<uint32_t>> references;
+
+    return Measure("ConcurrentRegistry::RemoveUnused", a_Size, a_Repetitions,
+        [&]()
+        {
+            registry = std::make_unique<egg::ConcurrentRegistry<uint32_t>>();
+            references.clear();
+            for (uint32_t i = 0; i < a_Size; ++i)
+            {
+                auto entry = std::make_shared<uint32_t>(i);
+                registry->Add(entry);
+                if (i % REMOVE_INTERVAL != 0)
+                {
+                    references.push_back(std::move(entry));
+                }
+            }
+        },
+        [&]()
+        {
+            uint64_t numRemoved = 0;
+            registry->RemoveUnused([&numRemoved](uint32_t&)
+            {
+                ++numRemoved;
+                return true;
+            });
+            g_Sink = numRemoved;
+        });
+}
+
+/*
+ * Enqueue tasks on the thread pool and measure the time until each task starts executing.
+ * All tasks are enqueued at once, so later tasks also measure the time spent waiting in the queue.
+ * The measured time includes executing all tasks, so that every repetition starts with an idle pool.
+ */
+BenchmarkResult BenchmarkThreadPoolEnqueue(uint32_t a_Size, uint32_t a_Repetitions)
+{
+    const uint32_t numThreads = std::max(2u, std::thread::hardware_concurrency()) - 1;
+    egg::ThreadPool threadPool(numThreads);
+
+    std::vector<double> latencies(a_Size);
+    std::vector<double> allLatencies;
+    std::atomic<uint32_t> numCompleted{ 0 };
+    double enqueueMilliseconds = 0.0;
+
+    auto result = Measure("ThreadPool::enqueue", a_Size, a_Repetitions,
+        [&]()
+        {
+            numCompleted = 0;
+        },
+        [&]()
+        {
+            const auto enqueueStart = Clock::now();
+            for (uint32_t i = 0; i < a_Size; ++i)
+            {
+                const auto enqueueTime = Clock::now();
+                threadPool.enqueue([&latencies, &numCompleted, enqueueTime, i]()
+                {
+                    latencies[i] = std::chrono::duration<double, std::micro>(Clock::now() - enqueueTime).count();
+                    ++numCompleted;
+                });
+            }
+            enqueueMilliseconds += std::chrono::duration<double, std::milli>(Clock::now() - enqueueStart).count();
+
+            while (numCompleted.load() < a_Size)
+            {
+                std::this_thread::yield();
+            }
+            allLatencies.insert(allLatencies.end(), latencies.begin(), latencies.end());
+        });
+
+    std::sort(allLatencies.begin(), allLatencies.end());
+    const auto percentile = [&allLatencies](double a_Percentage)
+    {
+        const auto index = static_cast<size_t>(a_Percentage / 100.0 * static_cast<double>(allLatencies.size() - 1));
+        return allLatencies[index];
+    };
+
+    result.m_Extra.emplace_back("threads", static_cast<double>(numThreads));
+    result.m_Extra.emplace_back("enqueue_ns_per_task", enqueueMilliseconds * 1000000.0 / (static_cast<double>(a_Size) * a_Repetitions));
+    result.m_Extra.emplace_back("p50_start_latency_us", percentile(50.0));
+    result.m_Extra.emplace_back("p95_start_latency_us", percentile(95.0));
+    result.m_Extra.emplace_back("p99_start_latency_us", percentile(99.0));
+    result.m_Extra.emplace_back("max_start_latency_us", allLatencies.back());
+    return result;
+}
+
+/*
+ * Group small static props into clusters and build their merged LOD hierarchy.
+ * Every prop is a grid of 32 triangles, so that the LODs have geometry to simplify.
+ */
+BenchmarkResult BenchmarkStaticBatchBuild(uint32_t a_Size, uint32_t a_Repetitions)
+{
+    std::vector<egg::Vertex> vertices;
+    std::vector<uint32_t> indices;
+    CreateGridMesh(4, vertices, indices);
+
+    egg::StaticMeshCreateInfo meshInfo;
+    meshInfo.m_VertexBuffer = vertices.data();
+    meshInfo.m_IndexBuffer = indices.data();
+    meshInfo.m_NumVertices = static_cast<uint32_t>(vertices.size());
+    meshInfo.m_NumIndices = static_cast<uint32_t>(indices.size());
+
+    const uint32_t numMaterials = 4;
+    std::vector<std::shared_ptr<egg::Material>> materials;
+    for (uint32_t i = 0; i < numMaterials; ++i)
+    {
+        materials.push_back(CreateMaterial(i));
+    }
+
+    egg::StaticBatch batch;
+    const uint32_t sourceMesh = batch.AddSourceMesh(meshInfo);
+    for (uint32_t i = 0; i < a_Size; ++i)
+    {
+        batch.AddInstance(sourceMesh, materials[i % numMaterials], CreateTransform(i));
+    }
+
+    const egg::StaticBatchSettings settings;
+    auto result = Measure("StaticBatch::Build", a_Size, a_Repetitions,
+        []() {},
+        [&]()
+        {
+            batch.Build(settings);
+            g_Sink = batch.GetNodeCount();
+        });
+
+    result.m_Extra.emplace_back("clusters", static_cast<double>(batch.GetClusterCount()));
+    result.m_Extra.emplace_back("nodes", static_cast<double>(batch.GetNodeCount()));
+    result.m_Extra.emplace_back("meshes", static_cast<double>(batch.GetMeshCount()));
+    for (uint32_t level = 0; level <= settings.m_NumLodLevels; ++level)
+    {
+        result.m_Extra.emplace_back("triangles_level_" + std::to_string(level), static_cast<double>(batch.GetTriangleCount(level)));
+    }
+    return result;
+}
+
+/*
+ * Write all results as a single JSON document.
+ */
+bool WriteJson(const std::string& a_FilePath, const std::vector<BenchmarkResult>& a_Results)
+{
+    std::ofstream file(a_FilePath, std::ios::out | std::ios::trunc);
+    if (!file.is_open())
+    {
+        printf("Could not open benchmark output file: %s\n", a_FilePath.c_str());
+        return false;
+    }
+
+#ifdef NDEBUG
+    file << "{\n  \"build\": \"release\",\n  \"benchmarks\": [\n";
+#else
+    file << "{\n  \"build\": \"debug\",\n  \"benchmarks\": [\n";
+#endif
+
+    for (size_t i = 0; i < a_Results.size(); ++i)
+    {
+        const auto& result = a_Results[i];
+        const double nanosPerItem = result.m_MedianMilliseconds * 1000000.0 / static_cast<double>(result.m_Size);
+
+        file << "    {\"name\": \"" << result.m_Name << "\""
+            << ", \"size\": " << result.m_Size
+            << ", \"repetitions\": " << result.m_Repetitions
+            << ", \"min_ms\": " << result.m_MinMilliseconds
+            << ", \"median_ms\": " << result.m_MedianMilliseconds
+            << ", \"ns_per_item\": " << nanosPerItem
+            << ", \"items_per_second\": " << (result.m_MedianMilliseconds > 0.0 ? 1000.0 * result.m_Size / result.m_MedianMilliseconds : 0.0);
+
+        for (const auto& extra : result.m_Extra)
+        {
+            file << ", \"" << extra.first << "\": " << extra.second;
+        }
+
+        file << (i + 1 < a_Results.size() ? "},\n" : "}\n");
+    }
+
+    file << "  ]\n}\n";
+    return true;
+}
+
+/*
+ * Program entry point.
+ */
+int main(int a_Argc, char** a_Argv)
+{
+    const std::string outputPath = a_Argc > 1 ? a_Argv[1] : "benchmark_results.json";
+    const uint32_t maxSize = a_Argc > 2 ? static_cast<uint32_t>(std::strtoul(a_Argv[2], nullptr, 10)) : 1000000;
+    const uint32_t repetitions = a_Argc > 3 ? std::max(1u, static_cast<uint32_t>(std::strtoul(a_Argv[3], nullptr, 10))) : 7;
+
+#ifndef NDEBUG
+    printf("Warning: benchmarking a debug build. Timings include assertions and are not representative.\n");
+#endif
+
+    struct Benchmark
+    {
+        std::function<BenchmarkResult(uint32_t, uint32_t)> m_Function;
+        uint32_t m_MaxSize;         //Some benchmarks scale badly, so they stop at a smaller scene size.
+    };
+
+    const std::vector<Benchmark> benchmarks
+    {
+        { BenchmarkAddInstance, 1000000 },
+        { BenchmarkAddDrawCall, 1000000 },
+        { BenchmarkAddLight, 1000000 },
+        { BenchmarkPackMaterialData, 1000000 },
+        { BenchmarkTransformRebuild, 1000000 },
+        { BenchmarkTransformHierarchy, 1000000 },
+        { BenchmarkDrawDataBuilder, 1000000 },
+        { BenchmarkPackLights, 1000000 },
+        { BenchmarkRemoveUnused, 100000 },          //Erasing from the middle of the vector makes this quadratic.
+        { BenchmarkThreadPoolEnqueue, 1000000 },
+        { BenchmarkStaticBatchBuild, 100000 },      //Every instance copies its geometry, so memory grows quickly.
+    };
+
+    const uint32_t sizes[] = { 1000, 10000, 100000, 1000000 };
+
+    std::vector<BenchmarkResult> results;
+    for (const auto& benchmark : benchmarks)
+    {
+        for (const auto size : sizes)
+        {
+            if (size > maxSize || size > benchmark.m_MaxSize)
+            {
+                continue;
+            }
+
+            results.push_back(benchmark.m_Function(size, repetitions));
+            const auto& result = results.back();
+            printf("%-36s %8u items  median %10.3f ms  min %10.3f ms  %8.2f ns/item\n",
+                result.m_Name.c_str(), result.m_Size, result.m_MedianMilliseconds, result.m_MinMilliseconds,
+                result.m_MedianMilliseconds * 1000000.0 / static_cast<double>(result.m_Size));
+        }
+    }
+
+    if (!WriteJson(outputPath, results))
+    {
+        return 1;
+    }
+
+    printf("Benchmark results written to %s\n", outputPath.c_str());
+    return 0;
+}
@@ -6,9 +6,20 @@ echo "Deleting existing Spir-V files..."
 
 echo "Compiling glsl to Spir-V in output folder..."
 mkdir "%cd%/shaders/output"
-for %%i in (shaders/*.vert shaders/*.frag) do (
+for %%i in (shaders/*.vert shaders/*.frag shaders/*.comp) do (
 "%VULKAN_SDK%\Bin\glslangValidator.exe" -V "shaders/%%~i" -o "shaders/output/%%~i.spv"
 )
 
+echo "Compiling debug view variants..."
+for %%i in (deferred.vert deferred.frag deferred_processing.frag) do (
+"%VULKAN_SDK%\Bin\glslangValidator.exe" -V -DDEBUG_VIEW "shaders/%%~i" -o "shaders/output/%%~ni_debug%%~xi.spv"
+)
+
+echo "Compiling buffer device address variants..."
+for %%i in (deferred.vert deferred_processing.frag) do (
+"%VULKAN_SDK%\Bin\glslangValidator.exe" -V --target-env vulkan1.2 -DBUFFER_DEVICE_ADDRESS "shaders/%%~i" -o "shaders/output/%%~ni_bda%%~xi.spv"
+"%VULKAN_SDK%\Bin\glslangValidator.exe" -V --target-env vulkan1.2 -DBUFFER_DEVICE_ADDRESS -DDEBUG_VIEW "shaders/%%~i" -o "shaders/output/%%~ni_debug_bda%%~xi.spv"
+)
+
 pause
 exit 0
\ No newline at end of file
@@ -4,53 +4,112 @@
 namespace egg
 {
 	struct PackedLightData;
-	union PackedInstanceData;
+	struct PackedInstanceData;
 	union PackedMaterialData;
+	struct PackedDebugVertex;
+	struct PackedAnimationState;
+	struct PackedScatterData;
+	class Terrain;
 
 	class DrawData : public EggDrawData
 	{
 		friend class Renderer;
 		friend class RenderStage_Deferred;
+		friend class RenderStage_Terrain;
+		friend class DrawDataCaptureWriter;
+		friend class DrawDataCaptureReader;
 	public:
 		DrawData();
 
 		void SetCamera(const Camera& a_Camera) override;
+		void SetInputTimestamp(uint64_t a_Timestamp) override;
+		void SetInterpolationFactor(float a_Factor) override;
 		LightHandle AddLight(const DirectionalLight& a_Light) override;
 		LightHandle AddLight(const SphereLight& a_Light) override;
 		MaterialHandle AddMaterial(const std::shared_ptr<EggMaterial>& a_Material) override;
 		MeshHandle AddMesh(const std::shared_ptr<EggStaticMesh>& a_Mesh) override;
+		VertexAnimationHandle AddVertexAnimation(const std::shared_ptr<EggVertexAnimation>& a_Animation) override;
 		InstanceDataHandle AddInstance(const glm::mat4& a_Transform, const MaterialHandle a_MaterialHandle,
 			const uint32_t a_CustomId) override;
+		InstanceDataHandle AddInterpolatedInstance(const glm::mat4& a_PreviousTransform, const glm::mat4& a_Transform,
+			const MaterialHandle a_MaterialHandle, const uint32_t a_CustomId) override;
+		InstanceDataHandle AddAnimatedInstance(const glm::mat4& a_Transform, const MaterialHandle a_MaterialHandle, const MeshHandle a_MeshHandle,
+			const VertexAnimationHandle a_AnimationHandle, float a_Time, const uint32_t a_CustomId) override;
+		InstanceDataHandle AddInstances(const TransformHierarchy& a_Hierarchy, const TransformHandle* a_Transforms, uint32_t a_NumInstances,
+			const MaterialHandle a_MaterialHandle, const uint32_t a_CustomId) override;
 		DrawCallHandle AddDrawCall(MeshHandle a_MeshHandle, const InstanceDataHandle* a_Instances,
 			uint32_t a_InstanceCount) override;
+		DrawCallHandle AddScatteredDrawCall(MeshHandle a_MeshHandle, const MaterialHandle a_MaterialHandle,
+			const ScatterDistribution& a_Distribution, const uint32_t a_CustomId) override;
 		DrawPassHandle AddDeferredShadingDrawPass(const DrawCallHandle* a_DrawCalls, uint32_t a_NumDrawCalls) override;
+		void SetTerrain(const std::shared_ptr<EggTerrain>& a_Terrain, const MaterialHandle a_MaterialHandle, const uint32_t a_CustomId) override;
 		uint32_t GetInstanceCount() const override;
 		uint32_t GetDrawPassCount() const override;
 		uint32_t GetDrawCallCount() const override;
 		uint32_t GetMaterialCount() const override;
 		uint32_t GetMeshCount() const override;
 		uint32_t GetLightCount() const override;
+		uint32_t GetDebugLineCount() const override;
+		uint32_t GetDebugTriangleCount() const override;
+
+		void AddDebugLine(const glm::vec3& a_From, const glm::vec3& a_To, const glm::vec4& a_Color) override;
+		void AddDebugLines(const glm::vec3* a_Points, uint32_t a_NumLines, const glm::vec4& a_Color) override;
+		void AddDebugTriangle(const glm::vec3& a_A, const glm::vec3& a_B, const glm::vec3& a_C, const glm::vec4& a_Color) override;
+		void AddDebugBox(const glm::mat4& a_Transform, const glm::vec4& a_Color) override;
+		void AddDebugAabb(const glm::vec3& a_Min, const glm::vec3& a_Max, const glm::vec4& a_Color) override;
+		void AddDebugSphere(const glm::vec3& a_Center, float a_Radius, const glm::vec4& a_Color) override;
+		void AddDebugFrustum(const glm::mat4& a_InverseViewProjection, const glm::vec4& a_Color) override;
 
         LightHandle AddLightWithShadow(const DirectionalLight& a_Light, const DrawCallHandle* a_ShadowDrawCalls,
             uint32_t a_NumDrawCalls) override;
         LightHandle AddLightWithShadow(const SphereLight& a_Light, const DrawCallHandle* a_ShadowDrawCalls,
             uint32_t a_NumDrawCalls) override;
+
+		/*
+		 * Concatenate all lights into a single continuous buffer, ready for uploading.
+		 * Area lights are placed before directional lights. The output is cleared first.
+		 */
+		void PackLights(std::vector<PackedLightData>& a_Output) const;
+	private:
+		/*
+		 * Add the twelve edges between eight box corners.
+		 * Corners are indexed by their x, y and z bits (0 for the minimum side, 1 for the maximum side).
+		 */
+		void AddDebugBoxEdges(const glm::vec3* a_Corners, uint32_t a_Color);
+
 	private:
 		Camera m_Camera;											//Camera for this frame.
+		uint64_t m_InputTimestamp;									//The input this frame reacts to, 0 if none.
+		float m_InterpolationFactor;								//Blend factor between the previous and current transforms of interpolated instances.
+		uint64_t m_SubmissionId;									//Set by the renderer when submitted, so that uploads can be reused when the draw data is drawn again.
 		std::vector<std::shared_ptr<EggMaterial>> m_Materials;		//Material handles used during this frame.
 		std::vector<PackedMaterialData> m_PackedMaterialData;		//All materials used during this frame.
 		std::vector<PackedLightData> m_PackedAreaLightData;			//Lights used during this frame. (area lights).
 		std::vector<PackedLightData> m_PackedDirectionalLightData;	//Lights used during this frame. (directional lights).
 		std::vector<std::shared_ptr<EggStaticMesh>> m_Meshes;				//All meshes used during this frame.
 		std::vector<PackedInstanceData> m_PackedInstanceData;		//Buffer of instance data, ready for upload.
+		std::vector<glm::mat4> m_PreviousTransforms;				//Previous transforms of interpolated instances, ready for upload.
+		std::vector<std::shared_ptr<EggVertexAnimation>> m_VertexAnimations;	//Vertex animations used during this frame.
+		std::vector<PackedAnimationState> m_AnimationStates;		//Frames of animated instances, ready for upload.
 		std::vector<uint32_t> m_IndirectionBuffer;					//Indirection buffer, contains indices into instance data.
 		std::vector<DrawCall> m_DrawCalls;							//Draw calls for this frame.
+		std::vector<PackedScatterData> m_Scatters;					//Scattered draw calls, generated on the GPU.
+		uint32_t m_NumScatterCandidates;							//Instances reserved in the scatter output buffers for all scatters.
 		std::vector<DrawPass> m_DrawPasses;							//Draw passes referring to the draw calls.
 
+		//The terrain drawn this frame, if any.
+		std::shared_ptr<Terrain> m_Terrain;
+		uint32_t m_TerrainMaterial;
+		uint32_t m_TerrainCustomId;
+
 		//Specific to shadow map generation.
 		std::vector<DrawPass> m_DirectionalShadowPasses;
 		std::vector<DrawPass> m_AreaShadowPasses;
 		uint32_t m_NumDirectionalShadows;
 		uint32_t m_NumAreaShadows;
+
+		//Immediate-mode debug primitives, two vertices per line and three per triangle.
+		std::vector<PackedDebugVertex> m_DebugLineVertices;
+		std::vector<PackedDebugVertex> m_DebugTriangleVertices;
 	};
 }
@@ -0,0 +1,192 @@
+#pragma once
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <glm/glm/glm.hpp>
+
+#include "api/EggStaticMesh.h"
+
+namespace egg
+{
+	class Camera;
+	class DrawData;
+	class StaticMesh;
+
+	/*
+	 * Capture files start with a header, followed by chunks.
+	 * Every chunk starts with a CaptureChunkHeader and its payload is padded to 16 bytes.
+	 * Mesh chunks always come before the first frame that uses them.
+	 */
+	constexpr char CAPTURE_MAGIC[8] = { 'E', 'G', 'G', 'C', 'A', 'P', 'T', '\0' };
+	constexpr uint32_t CAPTURE_VERSION = 3;
+
+	enum class CaptureChunkType : uint32_t
+	{
+		MESH = 0,		//Vertices and indices of a single mesh.
+		FRAME			//All draw data of a single frame.
+	};
+
+	struct CaptureFileHeader
+	{
+		char m_Magic[8];
+		uint32_t m_Version;
+
+		//Sizes of the packed structs. Captures can only be replayed by builds with the same layout.
+		uint32_t m_VertexSize;
+		uint32_t m_InstanceSize;
+		uint32_t m_MaterialSize;
+		uint32_t m_LightSize;
+		uint32_t m_Padding;
+	};
+
+	struct CaptureChunkHeader
+	{
+		CaptureChunkType m_Type;
+		uint32_t m_Padding;
+		uint64_t m_Size;		//Size of the payload in bytes, including padding.
+	};
+
+	/*
+	 * Mesh chunks start with this, followed by the vertices and then the indices.
+	 */
+	struct CaptureMeshHeader
+	{
+		uint32_t m_MeshIndex;	//Index of the mesh within the capture, referred to by frames.
+		uint32_t m_NumVertices;
+		uint32_t m_NumIndices;
+		uint32_t m_Padding;
+	};
+
+	/*
+	 * Frame chunks start with this, followed by the arrays in the order of the counts.
+	 * Draw passes are stored as a type, light type, light index and draw call count, followed by the draw call indices.
+	 * The previous transforms of interpolated instances come last.
+	 */
+	struct CaptureFrameHeader
+	{
+		uint32_t m_FrameIndex;
+		uint32_t m_ResolutionX;
+		uint32_t m_ResolutionY;
+
+		//Camera.
+		float m_Fov;
+		float m_NearPlane;
+		float m_FarPlane;
+		float m_AspectRatio;
+		float m_Translation[3];
+		float m_Rotation[4];		//Quaternion as x, y, z, w.
+		float m_Scale[3];
+
+		uint32_t m_NumMeshes;
+		uint32_t m_NumMaterials;
+		uint32_t m_NumInstances;
+		uint32_t m_NumIndirections;
+		uint32_t m_NumDrawCalls;
+		uint32_t m_NumAreaLights;
+		uint32_t m_NumDirectionalLights;
+		uint32_t m_NumDrawPasses;
+		uint32_t m_NumDirectionalShadowPasses;
+		uint32_t m_NumAreaShadowPasses;
+		uint32_t m_NumDirectionalShadows;
+		uint32_t m_NumAreaShadows;
+		uint32_t m_NumPreviousTransforms;
+		float m_InterpolationFactor;
+	};
+
+	/*
+	 * Writes the draw data of every frame to a capture file.
+	 * Meshes are written the first time a frame uses them.
+	 */
+	class DrawDataCaptureWriter
+	{
+	public:
+		//Reads the vertices and indices of a mesh back from the GPU.
+		using MeshReadFunction = std::function<bool(StaticMesh& a_Mesh, std::vector<Vertex>& a_Vertices, std::vector<uint32_t>& a_Indices)>;
+
+		/*
+		 * Start a new capture. The file is overwritten.
+		 * Any capture that was already open is closed first.
+		 */
+		bool Open(const std::string& a_FilePath);
+
+		/*
+		 * Finish the capture and close the file.
+		 */
+		void Close();
+
+		bool IsOpen() const;
+
+		/*
+		 * Write a single frame, and all meshes it uses that were not written yet.
+		 * The camera and interpolation factor are the ones the frame is drawn with, which differ from the draw data when it is redrawn.
+		 */
+		bool WriteFrame(const DrawData& a_DrawData, const Camera& a_Camera, float a_InterpolationFactor, uint32_t a_FrameIndex, const glm::uvec2& a_Resolution, const MeshReadFunction& a_ReadMesh);
+
+	private:
+		void WriteChunk(CaptureChunkType a_Type, const std::vector<uint8_t>& a_Payload);
+
+	private:
+		mutable std::mutex m_Mutex;
+		std::ofstream m_File;
+		std::unordered_map<uint32_t, uint32_t> m_MeshIndices;	//StaticMesh unique ID to the index in the capture.
+		std::vector<uint8_t> m_Payload;							//Reused between frames.
+	};
+
+	/*
+	 * Memory-maps a capture file, and turns its frames back into draw data.
+	 */
+	class DrawDataCaptureReader
+	{
+	public:
+		DrawDataCaptureReader();
+		~DrawDataCaptureReader();
+
+		DrawDataCaptureReader(const DrawDataCaptureReader&) = delete;
+		DrawDataCaptureReader& operator =(const DrawDataCaptureReader&) = delete;
+
+		/*
+		 * Map a capture file and find all its chunks.
+		 * Returns false if the file can not be read, or was written by a build with a different data layout.
+		 */
+		bool Open(const std::string& a_FilePath);
+
+		/*
+		 * Unmap the file. Mesh create infos that were returned before point into the mapping and become invalid.
+		 */
+		void Close();
+
+		uint32_t GetMeshCount() const;
+		uint32_t GetFrameCount() const;
+
+		/*
+		 * Get the create info for a mesh in the capture. The buffers point straight into the mapped file.
+		 */
+		StaticMeshCreateInfo GetMesh(uint32_t a_MeshIndex) const;
+
+		/*
+		 * Get the resolution that the given frame was rendered at.
+		 */
+		glm::uvec2 GetResolution(uint32_t a_FrameIndex) const;
+
+		/*
+		 * Fill an empty draw data object with a captured frame.
+		 * a_Meshes contains the meshes created from GetMesh(), in the same order.
+		 * Materials are replayed from their packed data, so the draw data does not keep any material objects.
+		 */
+		bool ReadFrame(uint32_t a_FrameIndex, DrawData& a_DrawData, const std::vector<std::shared_ptr<EggStaticMesh>>& a_Meshes) const;
+
+	private:
+		const uint8_t* m_Data;
+		size_t m_Size;
+		void* m_FileHandle;			//Platform specific handles of the mapping.
+		void* m_MappingHandle;
+
+		std::vector<size_t> m_MeshOffsets;		//Offsets of the mesh chunk payloads, by capture mesh index.
+		std::vector<size_t> m_FrameOffsets;		//Offsets of the frame chunk payloads.
+	};
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "api/FrameStatistics.h"
+
+namespace egg
+{
+	/*
+	 * Keeps a rolling history of frame statistics, and optionally streams every frame to a file.
+	 * Frames are added from the render thread. All other functions can be called from any thread.
+	 */
+	class FrameStatisticsTracker
+	{
+	public:
+		FrameStatisticsTracker();
+
+		/*
+		 * Set the amount of frames kept in the history. Older frames are discarded.
+		 */
+		void Init(uint32_t a_HistorySize);
+
+		/*
+		 * Clear the history and close the stream.
+		 */
+		void CleanUp();
+
+		/*
+		 * Add the statistics of a finished frame.
+		 */
+		void AddFrame(const FrameStatistics& a_Statistics);
+
+		/*
+		 * Get a copy of the history, oldest first.
+		 */
+		std::vector<FrameStatistics> GetHistory() const;
+
+		/*
+		 * Copy the most recent frames into a_Output, oldest first. The vector is cleared first, so its memory can be reused.
+		 */
+		void GetRecentHistory(size_t a_MaxFrames, std::vector<FrameStatistics>& a_Output) const;
+
+		/*
+		 * Calculate the distributions of the statistics in the history.
+		 */
+		FrameStatisticsSummary GetSummary() const;
+
+		/*
+		 * Start writing every added frame to the given file. The file is overwritten.
+		 * Any stream that was already open is closed first.
+		 * Returns false if the file could not be opened.
+		 */
+		bool StartStream(const std::string& a_FilePath, StatisticsStreamFormat a_Format);
+
+		/*
+		 * Stop streaming and close the file.
+		 */
+		void StopStream();
+
+	private:
+		/*
+		 * Write a single frame to the stream. The mutex has to be locked.
+		 */
+		void WriteToStream(const FrameStatistics& a_Statistics);
+
+	private:
+		mutable std::mutex m_Mutex;
+		std::deque<FrameStatistics> m_History;
+		uint32_t m_HistorySize;
+
+		std::ofstream m_Stream;
+		StatisticsStreamFormat m_StreamFormat;
+	};
+}
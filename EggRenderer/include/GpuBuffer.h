@@ -1,6 +1,8 @@
 #pragma once
 #include <vk_mem_alloc.h>
 
+#include "api/MemoryReport.h"
+
 namespace egg
 {
 	/*
@@ -12,6 +14,7 @@ namespace egg
 		size_t m_AlignmentBytes = 0;			//The buffers minimum alignment in bytes.
 		VmaMemoryUsage m_MemoryUsage = VMA_MEMORY_USAGE_UNKNOWN;
 		VkBufferUsageFlags m_BufferUsageFlags = 0;
+		MemoryCategory m_MemoryCategory = MemoryCategory::OTHER;	//Used to report memory usage.
 	};
 
 	struct CPUWrite
@@ -46,12 +49,26 @@ namespace egg
 		 */
 		bool Write(const CPUWrite* a_Writes, size_t a_NumWrites, bool a_Resize = false);
 
+		/*
+		 * Read a_Size bytes starting at a_Offset from this GPU buffer into a_Destination.
+		 * The buffer has to be CPU readable, and any GPU writes have to be finished.
+		 *
+		 * Returns false if the data could not be read.
+		 */
+		bool Read(void* a_Destination, size_t a_Offset, size_t a_Size) const;
+
 		/*
 		 * Resize the buffer with the given settings.
 		 * The old buffer data will be lost.
 		 */
 		bool Resize(const GpuBufferSettings& a_Settings);
 
+		/*
+		 * Grow the buffer to at least a_SizeInBytes, keeping its other settings.
+		 * The old buffer data will be lost when it grows.
+		 */
+		bool Reserve(size_t a_SizeInBytes);
+
 		/*
 		 * Free all allocated resources for this buffer.
 		 */
@@ -66,6 +83,18 @@ namespace egg
 		VmaAllocation GetAllocation() const;
 		VmaAllocationInfo GetAllocationInfo() const;
 
+		/*
+		 * Get the address of the buffer for use in shaders.
+		 * Returns 0 when the buffer is empty, or was not created with VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT.
+		 */
+		VkDeviceAddress GetDeviceAddress() const;
+
+		/*
+		 * Get a number that changes every time the buffer is recreated, for example when it grows during a write.
+		 * Descriptors referring to the buffer have to be written again when it changes.
+		 */
+		uint32_t GetVersion() const;
+
 	private:
 		//The buffer has to have access to the device and allocator.
 		VkDevice m_Device;
@@ -77,5 +106,7 @@ namespace egg
 		VmaAllocation m_Allocation;
 		VmaAllocationInfo m_AllocationInfo;
 		VkBuffer m_Buffer;
+		VkDeviceAddress m_DeviceAddress;
+		uint32_t m_Version;
 	};
 }
\ No newline at end of file
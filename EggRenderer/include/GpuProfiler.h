@@ -0,0 +1,127 @@
+#pragma once
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+#include "api/EggRenderer.h"
+
+namespace egg
+{
+	/*
+	 * Measures GPU time and pipeline statistics for zones within the frame command buffers.
+	 * Every frame in the swap chain has its own query pools.
+	 * Results are read back when a frame's fence has been waited on, so reading them never stalls.
+	 */
+	class GpuProfiler
+	{
+	public:
+		//Returned by BeginZone when the zone is not recorded.
+		static constexpr uint32_t INVALID_ZONE = std::numeric_limits<uint32_t>::max();
+
+		//The maximum amount of zones that can be recorded in a single frame.
+		static constexpr uint32_t MAX_ZONES_PER_FRAME = 256;
+
+		GpuProfiler();
+
+		/*
+		 * Create the query pools for each frame.
+		 * When the queue family does not support timestamps, the profiler stays disabled and all calls are ignored.
+		 * Pipeline statistics are only gathered when a_PipelineStatistics is true (the device feature has to be enabled).
+		 */
+		bool Init(VkDevice a_Device, VkPhysicalDevice a_PhysicalDevice, uint32_t a_QueueFamilyIndex, uint32_t a_NumFrames, bool a_PipelineStatistics, const RendererSettings& a_Settings);
+
+		/*
+		 * Destroy the query pools.
+		 */
+		void CleanUp();
+
+		/*
+		 * Read back the results of the previous use of this frame, and reset the queries.
+		 * Has to be called after the frame's fence was waited on, and before any zone is recorded.
+		 * The command buffer has to be recording, and can't be inside of a render pass.
+		 */
+		void BeginFrame(VkCommandBuffer a_CommandBuffer, uint32_t a_FrameIndex, uint32_t a_FrameCounter);
+
+		/*
+		 * Start a new zone. Zones can be nested.
+		 * Pipeline statistics are only gathered for zones that are not nested, and that do not start within a render pass.
+		 * Returns the zone index to pass to EndZone().
+		 */
+		uint32_t BeginZone(VkCommandBuffer a_CommandBuffer, uint32_t a_FrameIndex, const std::string& a_Name, bool a_InsideRenderPass = false);
+
+		/*
+		 * End a zone previously started with BeginZone().
+		 */
+		void EndZone(VkCommandBuffer a_CommandBuffer, uint32_t a_FrameIndex, uint32_t a_Zone);
+
+		/*
+		 * Returns true if individual draw passes should be profiled.
+		 */
+		bool ProfileDrawPasses() const;
+
+		/*
+		 * Get a copy of the resolved results, oldest first.
+		 */
+		std::vector<GpuFrameTimings> GetHistory() const;
+
+		/*
+		 * Copy the most recently resolved frame into a_Timings.
+		 * Returns false if no frame has been resolved yet.
+		 */
+		bool GetLatestFrame(GpuFrameTimings& a_Timings) const;
+
+		/*
+		 * Get the total GPU time of a frame that is still in the history.
+		 * Returns false if the frame was not measured or already discarded.
+		 */
+		bool GetFrameMilliseconds(uint32_t a_FrameCounter, double& a_Milliseconds) const;
+
+	private:
+		/*
+		 * A zone recorded in a frame.
+		 */
+		struct Zone
+		{
+			std::string m_Name;
+			uint32_t m_Depth;				//How many zones this zone is nested in.
+			uint32_t m_StatisticsQuery;		//Index into the pipeline statistics pool, or INVALID_ZONE.
+		};
+
+		/*
+		 * The queries for a single frame in the swap chain.
+		 */
+		struct FrameQueries
+		{
+			VkQueryPool m_TimestampPool = VK_NULL_HANDLE;	//Two timestamps per zone.
+			VkQueryPool m_StatisticsPool = VK_NULL_HANDLE;	//Up to one statistics query per zone.
+			std::vector<Zone> m_Zones;
+			uint32_t m_NumStatisticsQueries = 0;
+			uint32_t m_FrameCounter = 0;					//The renderer frame that recorded these queries.
+			uint32_t m_OpenZones = 0;						//Zones that were started but not ended yet.
+			bool m_StatisticsActive = false;				//True while a statistics query is being recorded.
+			bool m_Recorded = false;						//True when BeginFrame() was called, so the queries were reset.
+		};
+
+		/*
+		 * Read the queries for a frame into the history.
+		 */
+		void Resolve(FrameQueries& a_Frame);
+
+	private:
+		VkDevice m_Device;
+		bool m_Enabled;
+		bool m_PipelineStatistics;
+		bool m_ProfileDrawPasses;
+		float m_TimestampPeriod;			//Nanoseconds per timestamp tick.
+		uint64_t m_TimestampMask;			//Only the valid bits of the timestamps are used.
+		uint32_t m_HistorySize;
+
+		std::vector<FrameQueries> m_Frames;
+
+		mutable std::mutex m_HistoryMutex;
+		std::deque<GpuFrameTimings> m_History;
+	};
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm/glm/glm.hpp>
+
+#include "Resources.h"
+
+namespace egg
+{
+	/*
+	 * A bounding volume hierarchy over the sphere lights of a frame, used to shade distant groups of lights as a single light.
+	 *
+	 * Every node stores a representative light that emits as much as all lights below it: the radii are combined so that the areas add up,
+	 * the radiance is scaled to keep the total emitted power, and the light is placed at the power weighted center.
+	 * Seen from far enough away, the representative light lights a surface the same as the lights it replaces.
+	 *
+	 * A cut through the tree is selected for a camera. Nodes that cover less than a number of pixels on screen are shaded as their
+	 * representative light, so the amount of shaded lights depends on how many groups of lights can be told apart, not on how many lights there are.
+	 * Lights with a shadow are never merged.
+	 */
+	class LightTree
+	{
+	public:
+		/*
+		 * Build the tree over the given sphere lights, replacing the previous tree.
+		 */
+		void Build(const std::vector<PackedLightData>& a_Lights);
+
+		/*
+		 * Append the lights of the cut for a camera to a_Output.
+		 * a_PixelsPerUnit is the size in pixels of a world unit one unit in front of the camera.
+		 * Groups of lights that are smaller than a_ErrorPixels on screen, and that the camera is outside of, are merged.
+		 */
+		void SelectCut(const glm::vec3& a_CameraPosition, float a_PixelsPerUnit, float a_ErrorPixels, std::vector<PackedLightData>& a_Output);
+
+	private:
+		struct LightTreeNode
+		{
+			glm::vec3 m_Min;							//Bounds of the light spheres below this node.
+			glm::vec3 m_Max;
+			uint32_t m_FirstChild;						//Index of the first of two children. 0 for a leaf, as the root is never a child.
+			PackedLightData m_Representative;			//The light itself for a leaf.
+		};
+
+		/*
+		 * Fill in an added node for a range of m_Indices, adding the nodes below it.
+		 */
+		void BuildNode(const std::vector<PackedLightData>& a_Lights, uint32_t a_NodeIndex, uint32_t a_Begin, uint32_t a_End);
+
+		/*
+		 * Create a light that emits as much as both given lights together.
+		 */
+		static PackedLightData MergeLights(const PackedLightData& a_First, const PackedLightData& a_Second);
+
+	private:
+		std::vector<LightTreeNode> m_Nodes;				//Root first, when there are any lights to merge.
+		std::vector<uint32_t> m_Indices;				//Lights without a shadow, reordered while building.
+		std::vector<PackedLightData> m_ShadowedLights;	//Always shaded on their own.
+		std::vector<uint32_t> m_Stack;					//Used while selecting a cut, kept to reuse the memory.
+	};
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "api/MemoryReport.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define EGG_RETURN_ADDRESS() _ReturnAddress()
+#else
+#define EGG_RETURN_ADDRESS() __builtin_return_address(0)
+#endif
+
+namespace egg
+{
+	/*
+	 * Keeps track of live meshes, textures and materials in debug builds, together with where they were created.
+	 * All functions do nothing in release builds.
+	 */
+	class LiveResourceTracker
+	{
+	public:
+		/*
+		 * Marks a public renderer function as the creation site for all resources created within its scope on the calling thread.
+		 * When scopes are nested, the outermost scope is used.
+		 */
+		class CreationSiteScope
+		{
+		public:
+			CreationSiteScope(const char* a_Function, const void* a_ReturnAddress);
+			~CreationSiteScope();
+
+			CreationSiteScope(const CreationSiteScope&) = delete;
+			CreationSiteScope& operator =(const CreationSiteScope&) = delete;
+
+		private:
+			bool m_Outermost;
+		};
+
+		/*
+		 * Start tracking a resource. a_Type has to be a string literal.
+		 */
+		static void Register(const void* a_Resource, const char* a_Type, uint32_t a_CreationFrame);
+
+		/*
+		 * Stop tracking a resource. Called when the resource is destroyed.
+		 */
+		static void Unregister(const void* a_Resource);
+
+		/*
+		 * Get all resources that are still alive.
+		 */
+		static std::vector<LiveResourceInfo> GetLiveResources();
+	};
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <vector>
+
+#include "vk_mem_alloc.h"
+#include "LiveResourceTracker.h"
+#include "api/MemoryReport.h"
+
+namespace egg
+{
+	/*
+	 * Keeps track of the live GPU memory per category.
+	 * The category is stored in the allocation's user data, so allocations can be untracked without knowing their category.
+	 * Counters are shared by all allocators in the process.
+	 */
+	class MemoryTracker
+	{
+	public:
+		/*
+		 * Start tracking a new allocation.
+		 */
+		static void Track(VmaAllocator a_Allocator, VmaAllocation a_Allocation, MemoryCategory a_Category);
+
+		/*
+		 * Stop tracking an allocation. Has to be called before the allocation is freed.
+		 * Allocations that were never tracked are ignored.
+		 */
+		static void Untrack(VmaAllocator a_Allocator, VmaAllocation a_Allocation);
+
+		/*
+		 * Write the live memory per category into the report.
+		 */
+		static void GetCategoryUsage(MemoryReport& a_Report);
+	};
+}
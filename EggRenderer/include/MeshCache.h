@@ -0,0 +1,88 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <glm/glm/glm.hpp>
+
+#include "api/EggRenderer.h"
+
+namespace egg
+{
+	/*
+	 * Finds meshes that were created before from the same geometry or shape, so that they are shared instead of uploaded again.
+	 *
+	 * Uploaded geometry is keyed by a hash of its vertices and indices, procedural shapes are keyed by their parameters.
+	 * Different geometry can have the same hash, so a copy of the vertices and indices is kept with every uploaded mesh.
+	 * A mesh is only shared when those bytes are equal to the new geometry.
+	 *
+	 * Entries only hold weak references. A mesh is freed as usual when the application drops it, and its entry is removed later on.
+	 * All functions can be called from any thread.
+	 */
+	class MeshCache
+	{
+	public:
+		MeshCache();
+
+		/*
+		 * Build the key for uploaded geometry. The geometry has to be valid.
+		 */
+		static std::string CreateKey(const StaticMeshCreateInfo& a_CreateInfo);
+
+		/*
+		 * Build the key for a procedural shape. Only the parameters that affect the shape's type are used.
+		 */
+		static std::string CreateKey(const ShapeCreateInfo& a_CreateInfo);
+
+		/*
+		 * Get the mesh for a shape key. Returns nullptr when there is none, or when it has been freed.
+		 */
+		std::shared_ptr<EggStaticMesh> Find(const std::string& a_Key);
+
+		/*
+		 * Get the mesh for a geometry key, when it was created from exactly the same vertices and indices as a_Geometry.
+		 * Returns nullptr when there is none, when it has been freed, or when only the hashes match.
+		 */
+		std::shared_ptr<EggStaticMesh> Find(const std::string& a_Key, const StaticMeshCreateInfo& a_Geometry);
+
+		/*
+		 * Remember a shape mesh under a key, replacing the previous mesh for the key.
+		 */
+		void Insert(const std::string& a_Key, const std::shared_ptr<EggStaticMesh>& a_Mesh);
+
+		/*
+		 * Remember a mesh under a geometry key, together with a copy of its vertices and indices.
+		 * Replaces the previous mesh for the key.
+		 */
+		void Insert(const std::string& a_Key, const StaticMeshCreateInfo& a_Geometry, const std::shared_ptr<EggStaticMesh>& a_Mesh);
+
+		/*
+		 * Forget all meshes. The meshes themselves are not affected.
+		 */
+		void Clear();
+
+	private:
+		/*
+		 * Hash a range of bytes. Reads eight bytes at a time, which is a lot faster than hashing every byte separately.
+		 * a_Data may be nullptr when a_Size is 0.
+		 */
+		static uint64_t Hash(const void* a_Data, size_t a_Size, uint64_t a_Seed);
+
+		struct Entry
+		{
+			std::weak_ptr<EggStaticMesh> m_Mesh;
+			std::string m_Contents;		//The vertex bytes followed by the index bytes. Empty for shapes.
+		};
+
+		/*
+		 * Remember a mesh, and remove the entries of freed meshes once in a while. Called while holding the lock.
+		 */
+		void InsertEntry(const std::string& a_Key, Entry&& a_Entry);
+
+	private:
+		std::mutex m_Mutex;
+		std::unordered_map<std::string, Entry> m_Entries;
+		size_t m_NumInsertsSinceSweep;		//Freed entries are removed once this reaches the amount of entries.
+	};
+}
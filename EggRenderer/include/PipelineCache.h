@@ -0,0 +1,186 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+#include "RenderUtility.h"
+
+namespace egg
+{
+	class ThreadPool;
+
+	/*
+	 * The state of a pipeline in the cache, as returned by PipelineCache::Poll().
+	 */
+	enum class PipelineState
+	{
+		COMPILING,
+		READY,
+		FAILED
+	};
+
+	/*
+	 * A pipeline that is compiled on a worker thread. See PipelineCache::AcquireAsync().
+	 */
+	struct AsyncPipeline
+	{
+		PipelineData m_Data;	//Only valid when m_Ready is true.
+		std::string m_Key;		//The key of the pipeline in the cache. Empty when nothing was requested.
+		bool m_Ready = false;	//Set by PipelineCache::Poll() once the pipeline was compiled.
+	};
+
+	/*
+	 * Shares pipelines and shader modules between all render stages.
+	 * Pipelines are keyed by everything in their PipelineCreateInfo, so stages that ask for identical pipelines get the same objects.
+	 * Render passes and descriptor set layouts are keyed by their description instead of their handle, and viewport and scissor are dynamic.
+	 * Shader modules are keyed by file, so pipelines that use the same Spir-V share the modules.
+	 * Compute pipelines are created from a PipelineCreateInfo with a single compute shader, of which only the push constants and descriptors are used.
+	 *
+	 * Both are reference counted. A pipeline does not refer to the render pass and layouts it was created with once it exists.
+	 * Unused pipelines and shader modules are therefore kept until DestroyUnused(), so that stages that are created again (for example after a resize)
+	 * get the same pipelines back for their compatible render passes and identically defined layouts.
+	 * New pipelines are created through a Vulkan pipeline cache, which makes creating a pipeline that only differs in a few states cheap.
+	 *
+	 * Pipelines can also be compiled on the thread pool, so that a stage can draw with a fallback pipeline until its specialized pipeline is ready.
+	 * Only optional pipelines that have such a fallback (the debug views) are compiled this way. The pipelines every frame needs are acquired
+	 * with the blocking Acquire() when a stage is created. After a resize they are found in the cache, so acquiring them again does not compile.
+	 * Pipelines are compiled with a render pass and descriptor set layouts owned by the cache, so releasing a request never has to wait for its compile.
+	 * All functions can be called from any thread.
+	 */
+	class PipelineCache
+	{
+	public:
+		PipelineCache();
+
+		/*
+		 * Create the Vulkan pipeline cache. Shader files are loaded relative to a_ShadersPath.
+		 * Asynchronous pipelines are compiled on a_ThreadPool.
+		 */
+		bool Init(VkDevice a_Device, const std::string& a_ShadersPath, ThreadPool& a_ThreadPool);
+
+		/*
+		 * Destroy all pipelines, render passes, shader modules and the Vulkan pipeline cache.
+		 * All stages have to have released their pipelines before this is called. Waits for pipelines that are still compiling in the background.
+		 */
+		void CleanUp();
+
+		/*
+		 * Get the pipeline for a_CreateInfo, creating it on this thread when no identical pipeline exists.
+		 * Waits when the same pipeline is being compiled in the background, so this is only meant for stage creation.
+		 * The returned objects are owned by the cache, and have to be returned with Release() instead of being destroyed.
+		 */
+		bool Acquire(const PipelineCreateInfo& a_CreateInfo, PipelineData& a_Result);
+
+		/*
+		 * Request the pipeline for a_CreateInfo without waiting for it to be compiled.
+		 * When no identical pipeline exists, it is compiled on the thread pool. Poll() tells when it can be used.
+		 * The compile does not use the render pass and descriptor set layouts in a_CreateInfo, so the stage may destroy them at any time.
+		 */
+		void AcquireAsync(const PipelineCreateInfo& a_CreateInfo, AsyncPipeline& a_Result);
+
+		/*
+		 * See if an asynchronous pipeline has been compiled, and fill in its pipeline data when it has. Never waits.
+		 * Returns FAILED when compiling failed, in which case the request will never become ready and should be released.
+		 * Requests that were never made are reported as FAILED as well.
+		 */
+		PipelineState Poll(AsyncPipeline& a_Pipeline);
+
+		/*
+		 * Stop using a pipeline returned by Acquire(), and reset a_Pipeline. The pipeline is kept until DestroyUnused() when it has no users left.
+		 * Passing pipeline data that was not acquired (for example after a failed Acquire()) is ignored.
+		 */
+		void Release(PipelineData& a_Pipeline);
+
+		/*
+		 * Stop using a pipeline requested with AcquireAsync(), and reset a_Pipeline. Never waits.
+		 * A pipeline that is still compiling is detached: it is kept until DestroyUnused() once compiled, or forgotten when compiling fails.
+		 */
+		void Release(AsyncPipeline& a_Pipeline);
+
+		/*
+		 * Destroy the pipelines that no stage uses, and then the shader modules that are no longer used by any pipeline.
+		 * Pipelines that are still compiling are left alone.
+		 */
+		void DestroyUnused();
+
+		/*
+		 * Get the compatibility key of a render pass, for PipelineCreateInfo::renderPass. Pipelines are compiled with a compatible render pass
+		 * that the cache creates from a_CreateInfo the first time the key is seen, and keeps until CleanUp().
+		 * Returns false when that render pass could not be created.
+		 */
+		bool RegisterRenderPass(const VkRenderPassCreateInfo& a_CreateInfo, std::string& a_Key);
+
+		/*
+		 * The amount of unique pipelines and shader modules that currently exist.
+		 * Pipelines that are still compiling or not used are included.
+		 */
+		uint32_t GetPipelineCount() const;
+		uint32_t GetShaderModuleCount() const;
+
+	private:
+		struct ShaderModuleEntry
+		{
+			VkShaderModule m_Module = VK_NULL_HANDLE;
+			uint32_t m_NumUsers = 0;		//Pipelines using the module. Unused modules stay until DestroyUnused().
+		};
+
+		struct PipelineEntry
+		{
+			PipelineData m_Data;							//Only valid in the READY state.
+			std::vector<std::string> m_ShaderModuleKeys;	//Keys of the modules in m_Data, to release them.
+			PipelineState m_State = PipelineState::COMPILING;
+			uint32_t m_NumUsers = 0;						//Unused pipelines stay until DestroyUnused().
+		};
+
+		/*
+		 * Build the key of a pipeline. Every field that ends up in the pipeline is appended as bytes.
+		 */
+		static std::string CreateKey(const PipelineCreateInfo& a_CreateInfo);
+
+		/*
+		 * Describe a render pass by everything that decides whether it is compatible with another render pass.
+		 * Layouts and load and store operations are left out, as they do not affect compatibility.
+		 */
+		static std::string CreateRenderPassKey(const VkRenderPassCreateInfo& a_CreateInfo);
+
+		/*
+		 * Load the shader modules and create the pipeline of an entry that was added in the COMPILING state.
+		 * The registered render pass and new copies of the descriptor set layouts are used instead of the objects in a_CreateInfo.
+		 * Called without holding the lock. Wakes up everyone waiting for the entry when done, and erases it when it failed without users.
+		 */
+		void Compile(const std::string& a_Key, const PipelineCreateInfo& a_CreateInfo);
+
+		/*
+		 * Get the shader module for a file and count the new user, loading it when it does not exist yet.
+		 * Called without holding the lock, the file is read while other threads keep using the cache.
+		 */
+		bool AcquireShaderModule(const std::string& a_FileName, VkShaderModule& a_Module);
+
+		//Called while holding the lock.
+		void ReleaseShaderModule(const std::string& a_FileName);
+
+		/*
+		 * Stop using the entry with the given key. Erases it when it has no users left and failed to compile.
+		 * Called while holding the lock.
+		 */
+		void ReleaseEntry(const std::string& a_Key);
+
+	private:
+		VkDevice m_Device;
+		VkPipelineCache m_VulkanCache;
+		std::string m_ShadersPath;
+		ThreadPool* m_ThreadPool;
+
+		mutable std::mutex m_Mutex;							//Guards all containers below.
+		std::condition_variable m_CompiledCondition;		//Notified whenever an entry leaves the COMPILING state.
+
+		std::unordered_map<std::string, ShaderModuleEntry> m_ShaderModules;	//Keyed by file name.
+		std::unordered_map<std::string, PipelineEntry> m_Pipelines;			//Keyed by CreateKey().
+		std::unordered_map<std::string, VkRenderPass> m_RenderPasses;		//Keyed by CreateRenderPassKey().
+		std::unordered_map<VkPipeline, std::string> m_PipelineKeys;			//Key of every compiled pipeline, for Release().
+	};
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vulkan/vulkan.h>
+
+namespace egg
+{
+	/*
+	 * Measures when presented frames reach the screen, using VK_KHR_present_id and VK_KHR_present_wait.
+	 * Presents are tagged with an increasing ID. A background thread waits for the IDs in order, and records the time each one completed.
+	 * When the extensions are not supported, the waiter stays disabled and all calls are ignored.
+	 */
+	class PresentWaiter
+	{
+	public:
+		//The amount of completed presents that are remembered.
+		static constexpr size_t HISTORY_SIZE = 64;
+
+		//How long a single wait blocks, so that the thread notices when it has to stop.
+		static constexpr uint64_t WAIT_TIMEOUT_NANOSECONDS = 50000000;
+
+		PresentWaiter();
+		~PresentWaiter();
+
+		PresentWaiter(const PresentWaiter&) = delete;
+		PresentWaiter& operator =(const PresentWaiter&) = delete;
+
+		/*
+		 * Load the present wait function. a_Supported is true when both extensions and their features were enabled on the device.
+		 */
+		void Init(VkDevice a_Device, bool a_Supported);
+
+		bool IsEnabled() const;
+
+		/*
+		 * Start waiting for presents to the given swapchain.
+		 */
+		void Start(VkSwapchainKHR a_SwapChain);
+
+		/*
+		 * Stop the thread. Presents that have not completed yet are never measured.
+		 * Has to be called before the swapchain is destroyed.
+		 */
+		void Stop();
+
+		/*
+		 * Get the ID to chain into the next vkQueuePresentKHR call.
+		 */
+		uint64_t GetNextPresentId();
+
+		/*
+		 * Start waiting for a present that was queued with the given ID.
+		 */
+		void AddPresent(uint64_t a_PresentId);
+
+		/*
+		 * Get the time at which the given present completed, from GetTimestampMicroseconds().
+		 * Returns false if it has not completed yet, could not be measured, or is older than the history.
+		 */
+		bool GetPresentTimestamp(uint64_t a_PresentId, uint64_t& a_Timestamp) const;
+
+	private:
+		/*
+		 * The background thread. Waits for the pending presents in order until stopped.
+		 */
+		void WaitForPresents();
+
+	private:
+		VkDevice m_Device;
+		PFN_vkWaitForPresentKHR m_WaitForPresent;	//Extension function, null when disabled.
+		VkSwapchainKHR m_SwapChain;
+		uint64_t m_NextPresentId;					//IDs have to increase for every present to a swapchain. Never reset, so they stay valid for recreated swapchains.
+
+		std::thread m_Thread;
+		mutable std::mutex m_Mutex;					//Guards everything below.
+		std::condition_variable m_Condition;
+		bool m_Running;
+		std::deque<uint64_t> m_PendingPresents;
+		std::deque<std::pair<uint64_t, uint64_t>> m_CompletedPresents;	//Present ID and the time it completed, oldest first.
+	};
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <map>
+
+namespace egg
+{
+	/*
+	 * Hands out ranges of a fixed size space, such as a buffer that never grows.
+	 * Ranges are handed out first fit from a list of free ranges, and merged with their neighbours when freed.
+	 * Only offsets are tracked, so ranges that are in use never move.
+	 * This is not thread safe.
+	 */
+	class RangeAllocator
+	{
+	public:
+		RangeAllocator();
+
+		/*
+		 * Make the whole space of a_Size bytes free, forgetting all ranges that were handed out.
+		 * Ranges start at multiples of a_Alignment, which has to be a power of two.
+		 */
+		void Reset(size_t a_Size, size_t a_Alignment);
+
+		/*
+		 * Reserve a range. The size is rounded up to the alignment. Returns false when no free range is large enough.
+		 */
+		bool Allocate(size_t a_Size, size_t& a_Offset);
+
+		/*
+		 * Return a range that was reserved with Allocate(), with the same size that was requested.
+		 */
+		void Free(size_t a_Offset, size_t a_Size);
+
+		/*
+		 * The amount of bytes that are not handed out.
+		 */
+		size_t GetFreeSize() const;
+
+		/*
+		 * The size of the largest range that can still be allocated.
+		 */
+		size_t GetLargestFreeRange() const;
+
+		/*
+		 * The amount of separate free ranges. A space without any ranges in use has one.
+		 */
+		uint32_t GetFreeRangeCount() const;
+
+	private:
+		size_t AlignSize(size_t a_Size) const;
+
+	private:
+		size_t m_Alignment;
+		std::map<size_t, size_t> m_FreeRanges;		//Size of every free range, keyed by offset.
+	};
+}
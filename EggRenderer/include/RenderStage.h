@@ -2,17 +2,24 @@
 #include <glm/glm/glm.hpp>
 #include <vulkan/vulkan.h>
 #include <array>
+#include <atomic>
+#include <string>
+#include <vector>
 
 #include "Resources.h"
 #include "RenderUtility.h"
 #include "vk_mem_alloc.h"
 #include "DrawData.h"
+#include "GpuBuffer.h"
+#include "PipelineCache.h"
 
 namespace egg
 {
     //Forward declare the settings used for rendering.
 	struct RenderData;
 	struct QueueInfo;
+	struct HudData;
+	class RenderStage_Terrain;
 
 	/*
 	 * 128 byte struct to send data to the shader quickly.
@@ -21,18 +28,41 @@ namespace egg
 	{
 		glm::mat4 m_VPMatrix;	//Camera view projection matrix.
 		glm::vec4 m_Data1;		//Anything can be stored in these.
+
+		//Addresses of the per-frame buffers, when they are read through buffer device addresses instead of descriptors.
+		VkDeviceAddress m_IndirectionAddress = 0;
+		VkDeviceAddress m_InstanceAddress = 0;
+		VkDeviceAddress m_PreviousTransformAddress = 0;
+		VkDeviceAddress m_AnimationStateAddress = 0;
+
 		glm::vec4 m_Data2;
-		glm::vec4 m_Data3;
-		glm::vec4 m_Data4;
 	};
 
 	/*
-	 * Push data used during shading.
+	 * Push data used during shading. Exactly 128 bytes, the push constant size that every device supports.
 	 */
 	struct DeferredProcessingPushConstants
 	{
 		glm::vec4 m_CameraPosition;
-		glm::uvec4 m_LightCounts;
+		glm::uvec4 m_LightCounts;	//x: area lights, y: directional lights, z: contact shadow steps.
+		glm::uvec4 m_DebugData;		//x: debug view mode, y: heatmap maximum. Only read by the debug view shader.
+
+		//Addresses of the shading buffers, when they are read through buffer device addresses instead of descriptors.
+		VkDeviceAddress m_MaterialAddress = 0;
+		VkDeviceAddress m_AreaLightAddress = 0;
+		VkDeviceAddress m_DirectionalLightAddress = 0;
+
+		//Used to march contact shadows through the depth buffer.
+		glm::vec2 m_DepthToDistance;			//Turns a depth value d into the distance along the view direction: y / (d + x).
+		glm::vec4 m_ScreenProjection[3];		//The rows of the view projection matrix that give clip space x, y and w. Y is negated for the flipped viewport.
+	};
+
+	/*
+	 * Push data used when scattering the instances of a single scatter.
+	 */
+	struct ScatterPushConstants
+	{
+		uint32_t m_ScatterIndex;
 	};
 
 	/*
@@ -74,6 +104,11 @@ namespace egg
 		 */
 		virtual bool RecordCommandBuffer(const RenderData& a_RenderData, VkCommandBuffer& a_CommandBuffer, const uint32_t currentFrameIndex, std::vector<VkSemaphore>& a_WaitSemaphores, std::vector<VkSemaphore>& a_SignalSemaphores, std::vector<VkPipelineStageFlags>& a_WaitStageFlags) = 0;
 
+		/*
+		 * Get the name of this render stage, used when profiling.
+		 */
+		virtual const char* GetName() const = 0;
+
 		/*
 		 * Enable or disable this render stage.
 		 */
@@ -103,6 +138,7 @@ namespace egg
 			const uint32_t a_CurrentFrameIndex, std::vector<VkSemaphore>& a_WaitSemaphores,
 			std::vector<VkSemaphore>& a_SignalSemaphores, std::vector<VkPipelineStageFlags>& a_WaitStageFlags) override;
 		void WaitForIdle(const RenderData& a_RenderData) override;
+		const char* GetName() const override { return "HelloTriangle"; }
 	private:
 		VkPipeline m_Pipeline;
 		VkShaderModule m_VertexShader;
@@ -132,13 +168,102 @@ namespace egg
 			std::vector<VkSemaphore>& a_SignalSemaphores, std::vector<VkPipelineStageFlags>& a_WaitStageFlags) override;
 
 		void WaitForIdle(const RenderData& a_RenderData) override;
+
+		const char* GetName() const override { return "Deferred"; }
+
+		/*
+		 * Debug views need the fragmentStoresAndAtomics device feature, and their pipelines have to compile.
+		 */
+		bool SupportsDebugViews() const { return m_DebugViewsSupported && !m_DebugViewsFailed; }
+
+		/*
+		 * Swap in the debug view pipelines once they have been compiled. Never waits for them.
+		 * Returns READY when debug views can be drawn, and FAILED when they never will be. Once failed, the pipelines are not polled again until the stage is created again.
+		 * Called by the renderer before a frame is recorded, so pipelines only change between frames.
+		 */
+		PipelineState PollDebugViews(const RenderData& a_RenderData);
+
+		/*
+		 * Set the stage that draws terrain into the G-buffer, or nullptr when terrain is disabled.
+		 * Has to be set before this stage is initialized, as the terrain pipeline is created for this stage's render pass.
+		 */
+		void SetTerrainStage(RenderStage_Terrain* a_TerrainStage) { m_TerrainStage = a_TerrainStage; }
 	private:
+		/*
+		 * Copy the custom ID and depth texels requested by this frame's picking queries into the readback buffer.
+		 * Has to be recorded after the render pass has ended.
+		 */
+		void RecordPickingCopies(const RenderData& a_RenderData, VkCommandBuffer& a_CommandBuffer, const uint32_t a_CurrentFrameIndex);
+
+		/*
+		 * Create the overdraw images and descriptors used for debug views, and start compiling their pipelines.
+		 */
+		bool InitDebugViews(const RenderData& a_RenderData);
+
+		/*
+		 * Clear the overdraw image and debug counters of this frame.
+		 * Has to be recorded before the render pass begins.
+		 */
+		void RecordDebugViewClears(const RenderData& a_RenderData, VkCommandBuffer& a_CommandBuffer, const uint32_t a_CurrentFrameIndex);
+
+		/*
+		 * Generate the instances of every scattered draw call in the frame, and reset their indirect draw commands.
+		 * Has to be recorded before the render pass begins.
+		 * Returns false when the scatter output buffers could not be grown, in which case nothing is recorded and scattered draw calls are skipped.
+		 */
+		bool RecordScatters(const RenderData& a_RenderData, VkCommandBuffer& a_CommandBuffer, const uint32_t a_CurrentFrameIndex);
+
 		/*
 		 * Pipeline objects for the deferred rendering stage.
 		 */
 		PipelineData m_DeferredPipelineData;			//Used to write to the array images (pos, normal, tangent, uv) and to the depth buffer.
 		PipelineData m_DeferredProcessingPipelineData;	//Reads the array images and depth buffer, then outputs to the swapchain.
 		VkRenderPass m_DeferredRenderPass;				//Multiple sub-passes that use the above pipelines.
+		std::string m_DeferredRenderPassKey;			//Compatibility key of the render pass, see PipelineCache::RegisterRenderPass().
+		VkSampler m_DepthSampler;						//Reads the depth at other pixels than the shaded one, for contact shadows.
+
+		/*
+		 * Variants of the pipelines above that count overdraw and lights, and output a debug view.
+		 * Only used while a debug view is enabled, so that normal rendering keeps early depth testing.
+		 * They are compiled in the background. Frames are drawn with the pipelines above until both are ready.
+		 */
+		bool m_DebugViewsSupported = false;
+		std::atomic<bool> m_DebugViewsFailed{ false };	//Set by the render thread when a debug pipeline could not be compiled.
+		AsyncPipeline m_DebugPipeline;
+		AsyncPipeline m_DebugProcessingPipeline;
+
+		/*
+		 * Immediate-mode debug lines and triangles, drawn over the shaded image in the third sub-pass.
+		 * Depth tested against the G-buffer depth without writing to it.
+		 */
+		PipelineData m_DebugLinePipelineData;
+		PipelineData m_DebugTrianglePipelineData;
+
+		/*
+		 * Compute pipeline that places and culls scattered instances, and appends them to the scatter output buffers.
+		 */
+		PipelineData m_ScatterPipelineData;
+
+		//Draws terrain at the end of the geometry sub-pass. Owned by the renderer.
+		RenderStage_Terrain* m_TerrainStage = nullptr;
+
+		/*
+		 * When supported, the geometry and shading pipelines read the per-frame buffers through addresses in the push constants.
+		 * Otherwise the instance and shading descriptor sets are used, and only rewritten when a buffer or light range changed.
+		 */
+		bool m_BufferDeviceAddress = false;
+
+		/*
+		 * When supported, the indirect draw command of a scatter starts at the scatter's first indirection.
+		 * Otherwise it starts at instance 0, and the first indirection is pushed as the w component of DeferredPushConstants::m_Data1 instead.
+		 */
+		bool m_DrawIndirectFirstInstance = false;
+
+		/*
+		 * GPU profiler zone names for the draw passes, indexed by draw pass.
+		 * Only grows when a frame has more draw passes than before, so profiling draw passes does not format names every frame.
+		 */
+		std::vector<std::string> m_DrawPassZoneNames;
 
 		/*
 		 * The indices at which each attachment is bound.
@@ -169,18 +294,247 @@ namespace egg
 
 			//The framebuffer used to render to the deferred 2d image array.
 			VkFramebuffer m_DeferredBuffer;
+
+			//Amount of fragments rasterized per pixel. Only created when debug views are supported.
+			ImageData m_OverdrawImage;
+			VkImageView m_OverdrawImageView = VK_NULL_HANDLE;
+
+			//The buffers last written to the instance and shading descriptor sets of this frame, as GpuBuffer versions.
+			//Only used without buffer device addresses. 0 means that nothing was written yet.
+			uint32_t m_WrittenIndirectionVersion = 0;
+			uint32_t m_WrittenInstanceVersion = 0;
+			uint32_t m_WrittenPreviousTransformVersion = 0;
+			uint32_t m_WrittenAnimationStateVersion = 0;
+			uint32_t m_WrittenMaterialVersion = 0;
+			uint32_t m_WrittenLightsVersion = 0;
+			VkDeviceSize m_WrittenAreaLightSize = 0;
+			VkDeviceSize m_WrittenDirectionalLightSize = 0;
+
+			//The vertex animation storage is read through the instance set in both modes, as it is not a per-frame buffer.
+			uint32_t m_WrittenAnimationStorageVersion = 0;
+
+			//The scatters of the frame and an indirect draw command for each. Both are written inline when the frame is recorded.
+			GpuBuffer m_ScatterBuffer;
+			GpuBuffer m_ScatterCommandBuffer;
+
+			//Instances generated by scattering and their indirections. Only accessed by the GPU, and grown to the candidates of the frame when recording.
+			GpuBuffer m_ScatterInstanceBuffer;
+			GpuBuffer m_ScatterIndirectionBuffer;
+
+			//The scatter output buffers last written to the scatter set, and to the scattered instance set without buffer device addresses.
+			uint32_t m_WrittenScatterInstanceVersion = 0;
+			uint32_t m_WrittenScatterIndirectionVersion = 0;
 		};
 
 		//Descriptor pool and set for the deferred processing.
 		DescriptorSetContainer m_ProcessingDescriptors;
 
 		//Descriptor pool and set layout for the instance data.
+		//The first set of every frame points to the uploaded instances, the set at m_Frames.size() + frame index to the scatter output buffers.
 		DescriptorSetContainer m_InstanceDescriptors;
 
 		//Descriptor sets that are used for shading (per frame data buffers).
 		DescriptorSetContainer m_ShadingDescriptors;
 
+		//Descriptor sets with the overdraw image and debug counters, used by both debug pipelines.
+		DescriptorSetContainer m_DebugDescriptors;
+
+		//Descriptor sets with the scatter buffers of each frame, and with the surface mesh of every scatter of every frame.
+		DescriptorSetContainer m_ScatterDescriptors;
+		DescriptorSetContainer m_ScatterSurfaceDescriptors;
+
 		//Separate buffers for each frame.
 		std::vector<DeferredFrame> m_Frames;
 	};
+
+	/*
+	 * Push data used when drawing terrain.
+	 */
+	struct TerrainPushConstants
+	{
+		glm::mat4 m_VPMatrix;	//Camera view projection matrix.
+	};
+
+	/*
+	 * Draws a terrain heightfield as nested clipmap levels around the camera, each twice the size and half the detail of the previous one.
+	 * Every level is a grid of the same size that is displaced in the vertex shader, so there is no vertex buffer.
+	 * The finest level is a full grid. The others are rings around the level inside them, drawn with one of nine index ranges depending on where the hole is.
+	 * Vertices near the outside of a level morph towards the next level, which hides the seams between them.
+	 *
+	 * Every level has a layer in a heightmap that wraps around, so only the samples that come into view are streamed in when the camera moves.
+	 * The heightmap is updated before the deferred stage, which draws the levels into its G-buffer by calling RecordDraw().
+	 */
+	class RenderStage_Terrain : public RenderStage
+	{
+	public:
+		static constexpr uint32_t NUM_RING_VARIANTS = 9;				//One for every offset of the hole by -1, 0 or 1 cell on both axes.
+		static constexpr uint32_t FULL_GRID_VARIANT = NUM_RING_VARIANTS;	//The finest level has no hole.
+		static constexpr uint32_t NUM_MESH_VARIANTS = NUM_RING_VARIANTS + 1;
+
+		bool Init(const RenderData& a_RenderData) override;
+
+		bool CleanUp(const RenderData& a_RenderData) override;
+
+		/*
+		 * Stream the heightmap samples that came into view, and write the level positions of this frame.
+		 * Recorded before the deferred render pass begins.
+		 */
+		bool RecordCommandBuffer(const RenderData& a_RenderData, VkCommandBuffer& a_CommandBuffer,
+			const uint32_t a_CurrentFrameIndex, std::vector<VkSemaphore>& a_WaitSemaphores,
+			std::vector<VkSemaphore>& a_SignalSemaphores, std::vector<VkPipelineStageFlags>& a_WaitStageFlags) override;
+
+		void WaitForIdle(const RenderData& a_RenderData) override;
+
+		const char* GetName() const override { return "Terrain"; }
+
+		/*
+		 * Create the pipeline for a sub-pass that writes the deferred G-buffer.
+		 * Called by the deferred stage when it initializes, after this stage is initialized.
+		 */
+		bool InitPipeline(const RenderData& a_RenderData, VkRenderPass a_RenderPass, const std::string& a_RenderPassKey, uint32_t a_SubpassIndex, uint32_t a_NumAttachments);
+
+		/*
+		 * Draw the terrain of this frame, if there is any. Recorded by the deferred stage inside its geometry sub-pass.
+		 */
+		void RecordDraw(const RenderData& a_RenderData, VkCommandBuffer& a_CommandBuffer, const uint32_t a_CurrentFrameIndex);
+
+	private:
+		/*
+		 * Copy the grid indices from the staging buffer into the index buffer.
+		 * Recorded once, before the first time the terrain is drawn.
+		 */
+		void RecordIndexUpload(VkCommandBuffer& a_CommandBuffer);
+
+		/*
+		 * Request the heights of a rectangle of level samples, and stage them for the texels they wrap around to.
+		 * Rectangles that cross the edge of the heightmap are split into up to four copies.
+		 */
+		void StageRect(const Terrain& a_Terrain, uint32_t a_Level, const glm::ivec2& a_Min, const glm::ivec2& a_Max);
+
+	private:
+		uint32_t m_GridSize = 0;			//Cells along the side of every level.
+		uint32_t m_HeightmapSize = 0;		//Texels along the side of every heightmap layer. A little larger than a level, for normals and morphing.
+		uint32_t m_NumLevels = 0;
+		uint32_t m_RingIndexCount = 0;		//Indices of every ring variant.
+
+		PipelineData m_PipelineData;
+
+		//Grid indices of every mesh variant, rings first.
+		GpuBuffer m_IndexBuffer;
+		GpuBuffer m_IndexStagingBuffer;
+		bool m_IndicesUploaded = false;
+
+		//The heightmap, with a layer for every level. Read with texel fetches.
+		ImageData m_HeightmapImage;
+		VkImageView m_HeightmapImageView;
+		VkSampler m_HeightmapSampler;
+		bool m_HeightmapInitialized = false;		//False until the first copy, when the contents are still undefined.
+		DescriptorSetContainer m_Descriptors;
+
+		//The terrain in the heightmap, and the first sample of every level that is in it.
+		std::shared_ptr<Terrain> m_StreamedTerrain;
+		std::array<glm::ivec2, PackedTerrainData::MAX_LEVELS> m_StreamedOrigins;
+
+		//Filled while streaming, kept to reuse the memory.
+		std::vector<float> m_StagedHeights;
+		std::vector<VkBufferImageCopy> m_Copies;
+
+		struct TerrainFrame
+		{
+			GpuBuffer m_StagingBuffer;				//Heights streamed in this frame.
+			GpuBuffer m_TerrainBuffer;				//Written inline when the frame is recorded.
+			bool m_Draw = false;					//Whether the frame has a terrain to draw.
+
+			//The amount of levels drawn with every mesh variant. Levels are ordered by variant in the terrain buffer.
+			uint32_t m_VariantInstances[NUM_MESH_VARIANTS] = {};
+		};
+		std::vector<TerrainFrame> m_Frames;
+	};
+
+	/*
+	 * A single quad drawn by the HUD, either a glyph from the font atlas or a solid block.
+	 */
+	struct HudGlyph
+	{
+		glm::vec4 m_Rect;		//Top left corner and size in pixels.
+		uint32_t m_Glyph;		//ASCII code of the glyph.
+		uint32_t m_Color;		//RGBA8, red in the lowest byte.
+	};
+
+	/*
+	 * Push data used when drawing the HUD.
+	 */
+	struct HudPushConstants
+	{
+		glm::vec2 m_InverseResolution;	//One over the output resolution in pixels.
+		glm::uvec2 m_AtlasGlyphs;		//x: first glyph in the atlas, y: glyphs per atlas row.
+	};
+
+	/*
+	 * Draws frame time graphs, CPU and GPU phase timings, draw statistics and memory usage over the swap chain output.
+	 * Everything is a glyph quad, drawn with a single instanced draw call.
+	 */
+	class RenderStage_Hud : public RenderStage
+	{
+	public:
+		static constexpr uint32_t GRAPH_FRAMES = 120;		//The amount of frames shown in the frame time graph.
+
+		bool Init(const RenderData& a_RenderData) override;
+
+		bool CleanUp(const RenderData& a_RenderData) override;
+
+		bool RecordCommandBuffer(const RenderData& a_RenderData, VkCommandBuffer& a_CommandBuffer,
+			const uint32_t a_CurrentFrameIndex, std::vector<VkSemaphore>& a_WaitSemaphores,
+			std::vector<VkSemaphore>& a_SignalSemaphores, std::vector<VkPipelineStageFlags>& a_WaitStageFlags) override;
+
+		void WaitForIdle(const RenderData& a_RenderData) override;
+
+		const char* GetName() const override { return "HUD"; }
+
+	private:
+		/*
+		 * Lay out all HUD elements as glyph quads.
+		 */
+		void BuildGlyphs(const HudData& a_Data);
+
+		/*
+		 * Add a line of text and move the cursor to the next line.
+		 */
+		void AddLine(uint32_t a_Color, const char* a_Format, ...);
+
+		/*
+		 * Add a solid rectangle in pixels.
+		 */
+		void AddQuad(float a_X, float a_Y, float a_Width, float a_Height, uint32_t a_Color);
+
+		/*
+		 * Copy the font atlas from the staging buffer into the atlas image.
+		 * Recorded once, before the first time the HUD is drawn.
+		 */
+		void RecordAtlasUpload(VkCommandBuffer& a_CommandBuffer);
+
+	private:
+		PipelineData m_PipelineData;
+		VkRenderPass m_RenderPass;					//Loads the swap chain image and draws on top of it.
+		std::string m_RenderPassKey;				//Compatibility key of the render pass, see PipelineCache::RegisterRenderPass().
+
+		//The font atlas, sampled with texel fetches.
+		ImageData m_AtlasImage;
+		VkImageView m_AtlasImageView;
+		VkSampler m_AtlasSampler;
+		GpuBuffer m_AtlasStagingBuffer;
+		bool m_AtlasUploaded = false;
+		DescriptorSetContainer m_AtlasDescriptors;
+
+		float m_Scale = 1.f;						//Size of a font pixel in screen pixels.
+		glm::vec2 m_Cursor;							//Where the next line of text is added.
+		std::vector<HudGlyph> m_Glyphs;				//Rebuilt every frame, kept to reuse the memory.
+
+		struct HudFrame
+		{
+			GpuBuffer m_GlyphBuffer;				//Per instance vertex data, written once per frame.
+			VkFramebuffer m_Framebuffer;
+		};
+		std::vector<HudFrame> m_Frames;
+	};
 }
\ No newline at end of file
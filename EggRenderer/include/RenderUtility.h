@@ -8,6 +8,7 @@
 #include <map>
 
 #include "vk_mem_alloc.h"
+#include "MemoryTracker.h"
 
 namespace egg
 {
@@ -31,6 +32,9 @@ namespace egg
 
         //How this image will be used.
         VkImageUsageFlags m_Usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+
+        //What the image memory is used for, used to report memory usage.
+        MemoryCategory m_MemoryCategory = MemoryCategory::OTHER;
     };
 
     /*
@@ -98,6 +102,21 @@ namespace egg
         VkFormat m_AttachmentFormat = VkFormat::VK_FORMAT_R32G32B32A32_SFLOAT;
     };
 
+    /*
+     * Contains descriptor sets and a layout + pool.
+     */
+    struct DescriptorSetContainer
+    {
+        //All descriptor currently residing in the pool with given layout.
+        std::vector<VkDescriptorSet> m_Sets;
+        VkDescriptorSetLayout m_Layout;
+        VkDescriptorPool m_Pool;
+
+        //The bindings used for the set layout, and their flags.
+        std::vector<VkDescriptorSetLayoutBinding> m_Bindings;
+        std::vector<VkDescriptorBindingFlags> m_BindingFlags;
+    };
+
     /*
      * Struct containing all the relevant information to create an entire pipeline.
      * This should hopefully take away a lot of boilerplate code.
@@ -122,8 +141,23 @@ namespace egg
              */
             VkFormat m_DepthFormat = VK_FORMAT_D32_SFLOAT;
 
+            /*
+             * The comparison used for the depth test.
+             */
+            VkCompareOp m_CompareOp = VK_COMPARE_OP_LESS;
+
         } depth;
 
+        /*
+         * Primitive assembly.
+         */
+        struct
+        {
+            //The type of primitives drawn with this pipeline.
+            VkPrimitiveTopology m_Topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+        } inputAssembly;
+
         /*
          * Vertex layout.
          */
@@ -155,6 +189,24 @@ namespace egg
              */
             std::vector<VkDescriptorSetLayout> m_Layouts;
 
+            /*
+             * The bindings and binding flags of every layout, in the same order.
+             * The pipeline cache shares pipelines between identically defined layouts, so it compares these instead of the layout handles.
+             * It also creates its own copies of the layouts from these, so that it never uses the layouts of a stage that may be destroyed.
+             */
+            std::vector<std::vector<VkDescriptorSetLayoutBinding>> m_Bindings;
+            std::vector<std::vector<VkDescriptorBindingFlags>> m_BindingFlags;
+
+            /*
+             * Add the layout of a descriptor set container, together with its bindings.
+             */
+            void Add(const DescriptorSetContainer& a_Container)
+            {
+                m_Layouts.push_back(a_Container.m_Layout);
+                m_Bindings.push_back(a_Container.m_Bindings);
+                m_BindingFlags.push_back(a_Container.m_BindingFlags);
+            }
+
         } descriptors;
 
         struct
@@ -165,17 +217,12 @@ namespace egg
              */
             uint32_t m_NumAttachments = 1;
 
-        } attachments;
-
-        /*
-         * Viewport resolution.
-         */
-        struct
-        {
-            uint32_t m_ResolutionX = 0;
-            uint32_t m_ResolutionY = 0;
+            /*
+             * When true, the output is blended over the attachments using its alpha.
+             */
+            bool m_AlphaBlending = false;
 
-        } resolution;
+        } attachments;
 
         //The shader stages to load.
         std::vector<ShaderInfo> m_Shaders;
@@ -188,6 +235,11 @@ namespace egg
             //The render pass that will be used with this pipeline.
             VkRenderPass m_RenderPass = nullptr;
 
+            //Describes what makes the render pass compatible with others, as returned by PipelineCache::RegisterRenderPass().
+            //The pipeline cache shares pipelines between compatible render passes, so that they survive the render pass being recreated.
+            //It compiles them with its own compatible render pass instead of m_RenderPass.
+            std::string m_CompatibilityKey;
+
             //The index of the subpass within the render pass to use for this pipeline.
             uint32_t m_SubpassIndex = 0;
 
@@ -219,20 +271,6 @@ namespace egg
         VkPipeline m_Pipeline = nullptr;
     };
 
-    /*
-     * Contains descriptor sets and a layout + pool.
-     */
-    struct DescriptorSetContainer
-    {
-        //All descriptor currently residing in the pool with given layout.
-        std::vector<VkDescriptorSet> m_Sets;
-        VkDescriptorSetLayout m_Layout;
-        VkDescriptorPool m_Pool;
-
-        //The bindings used for the set layout.
-        std::vector<VkDescriptorSetLayoutBinding> m_Bindings;
-    };
-
     /*
      * Information to create some descriptor sets.
      */
@@ -317,16 +355,20 @@ namespace egg
 
         /*
          * Update the descriptors in this builder with all the accumulated data.
+         * Returns the amount of descriptors that were written.
          */
-        void Upload()
+        uint32_t Upload()
         {
+            const auto numWrites = static_cast<uint32_t>(m_Writes.size());
+
             //Only upload when writes were actually done.
             if(!m_Writes.empty())
             {
-                vkUpdateDescriptorSets(m_Device, static_cast<uint32_t>(m_Writes.size()), m_Writes.data(), 0, nullptr);
+                vkUpdateDescriptorSets(m_Device, numWrites, m_Writes.data(), 0, nullptr);
                 m_Writes.clear();
                 m_BufferInfo.clear();
             }
+            return numWrites;
         }
     private:
         const VkDevice& m_Device;
@@ -361,6 +403,46 @@ namespace egg
             vkDestroyDescriptorSetLayout(a_Device, a_Container.m_Layout, nullptr);
         }
 
+        /*
+         * Create a descriptor set layout from its bindings and their flags.
+         * The update after bind pool flag is set when any of the bindings can be updated after binding.
+         */
+        static bool CreateDescriptorSetLayout(
+            const VkDevice& a_Device,
+            const std::vector<VkDescriptorSetLayoutBinding>& a_Bindings,
+            const std::vector<VkDescriptorBindingFlags>& a_BindingFlags,
+            VkDescriptorSetLayout& a_Layout)
+        {
+            VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo{};
+            descriptorSetLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+            descriptorSetLayoutCreateInfo.bindingCount = static_cast<uint32_t>(a_Bindings.size());
+            descriptorSetLayoutCreateInfo.pBindings = a_Bindings.data();
+
+            for (auto& binding : a_BindingFlags)
+            {
+                if ((binding & VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT) != 0)
+                {
+                    descriptorSetLayoutCreateInfo.flags = VkDescriptorSetLayoutCreateFlagBits::VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+                    break;
+                }
+            }
+
+            //Explicitly specify binding flags for each binding.
+            VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlags{};
+            bindingFlags.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+            bindingFlags.bindingCount = static_cast<uint32_t>(a_BindingFlags.size());
+            bindingFlags.pBindingFlags = a_BindingFlags.data();
+
+            descriptorSetLayoutCreateInfo.pNext = &bindingFlags;
+
+            if (vkCreateDescriptorSetLayout(a_Device, &descriptorSetLayoutCreateInfo, nullptr, &a_Layout) != VK_SUCCESS)
+            {
+                printf("Could not create descriptor set layout!\n");
+                return false;
+            }
+            return true;
+        }
+
         /*
          * Create a descriptor set layout, pool and the given amount of sets.
          * This is not very dynamic but it's easy to quickly set up a few sets.
@@ -375,39 +457,24 @@ namespace egg
             assert(!a_Info.m_Bindings.empty() && "At least one binding is required to create descriptor sets!");
             assert(a_Info.m_NumSets > 0 && "At least one set needs to be created!");
 
-            VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo{};
-            descriptorSetLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-            descriptorSetLayoutCreateInfo.bindingCount = static_cast<uint32_t>(a_Info.m_Bindings.size());
-            descriptorSetLayoutCreateInfo.pBindings = a_Info.m_Bindings.data();
+            if (!CreateDescriptorSetLayout(a_Device, a_Info.m_Bindings, a_Info.m_BindingFlags, a_Output.m_Layout))
+            {
+                return false;
+            }
 
             //Pool data here so that I can set flags if needed.
             VkDescriptorPoolCreateInfo descriptorPoolInfo{};
 
-            //Set the update after bind bit if any of the bindings have it set.
+            //Set the update after bind bit if any of the bindings have it set, to match the layout.
             for(auto& binding : a_Info.m_BindingFlags)
             {
                 if((binding & VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT) != 0)
                 {
                     descriptorPoolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
-                    descriptorSetLayoutCreateInfo.flags = VkDescriptorSetLayoutCreateFlagBits::VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
                     break;
                 }
             }
 
-            //Explicitly specify binding flags for each binding.
-            VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlags{};
-            bindingFlags.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
-            bindingFlags.bindingCount = static_cast<uint32_t>(a_Info.m_BindingFlags.size());
-            bindingFlags.pBindingFlags = a_Info.m_BindingFlags.data();
-
-            descriptorSetLayoutCreateInfo.pNext = &bindingFlags;
-
-            if (vkCreateDescriptorSetLayout(a_Device, &descriptorSetLayoutCreateInfo, nullptr, &a_Output.m_Layout) != VK_SUCCESS)
-            {
-                printf("Could not create descriptor set layout!\n");
-                return false;
-            }
-
             std::map<VkDescriptorType, uint32_t> descriptorCounts;
 
             for(auto& binding : a_Info.m_Bindings)
@@ -465,6 +532,7 @@ namespace egg
 
             //Copy the bindings over for later runtime reflection of sets.
             a_Output.m_Bindings = a_Info.m_Bindings;
+            a_Output.m_BindingFlags = a_Info.m_BindingFlags;
 
             return true;
         }
@@ -519,6 +587,7 @@ namespace egg
                 printf("Could not create image.\n");
                 return false;
             }
+            MemoryTracker::Track(a_Allocator, result.m_Allocation, a_CreateInfo.m_MemoryCategory);
 
             a_Result = result;
             return true;
@@ -617,12 +686,44 @@ namespace egg
 
         /*
          * Create a vulkan pipeline state object.
+         * The shader modules are loaded from disk, and owned by the returned pipeline data.
          */
         static bool CreatePipeline(const PipelineCreateInfo& a_CreateInfo, const VkDevice& a_Device, const std::string& a_ShadersPath, PipelineData& a_Result)
+        {
+            //Load the shaders.
+            std::vector<VkShaderModule> shaderModules;
+            shaderModules.reserve(a_CreateInfo.m_Shaders.size());
+            for (auto& shader : a_CreateInfo.m_Shaders)
+            {
+                const std::string path = a_ShadersPath + shader.m_ShaderFileName;
+                VkShaderModule module;
+                //Failed to load
+                if (!RenderUtility::CreateShaderModuleFromSpirV(path, module, a_Device))
+                {
+                    printf("Could not create shader from file: %s of type: %u.\n", path.c_str(), shader.m_ShaderStage);
+                    return false;
+                }
+                shaderModules.push_back(module);
+            }
+
+            return CreatePipeline(a_CreateInfo, a_Device, shaderModules, VK_NULL_HANDLE, a_Result);
+        }
+
+        /*
+         * Create a vulkan pipeline state object from shader modules that were already loaded, in the order of the shaders in a_CreateInfo.
+         * The modules are copied into the returned pipeline data. An optional pipeline cache speeds up creating similar pipelines.
+         */
+        static bool CreatePipeline(const PipelineCreateInfo& a_CreateInfo, const VkDevice& a_Device, const std::vector<VkShaderModule>& a_ShaderModules,
+            VkPipelineCache a_PipelineCache, PipelineData& a_Result)
         {
             /*
              * Verify the passed parameters.
              */
+            if (a_ShaderModules.size() != a_CreateInfo.m_Shaders.size())
+            {
+                printf("Trying to create pipeline with %u shader modules for %u shaders!\n", static_cast<uint32_t>(a_ShaderModules.size()), static_cast<uint32_t>(a_CreateInfo.m_Shaders.size()));
+                return false;
+            }
 
              //Ensure that a vertex shader is provided.
             bool vertexShaderFound = false;
@@ -641,12 +742,6 @@ namespace egg
                 return false;
             }
 
-            if (a_CreateInfo.resolution.m_ResolutionX <= 0 || a_CreateInfo.resolution.m_ResolutionY <= 0)
-            {
-                printf("Invalid resolution specified for pipeline creation! X: %u Y: %u\n", a_CreateInfo.resolution.m_ResolutionX, a_CreateInfo.resolution.m_ResolutionY);
-                return false;
-            }
-
             //Ensure that the bindings referred to by the vertex attributes are actually valid.
             for (auto& vertexAttrib : a_CreateInfo.vertexData.m_VertexAttributes)
             {
@@ -678,28 +773,14 @@ namespace egg
              */
             PipelineData result;
 
-            //Load the shaders.
+            //The shader stages.
             std::vector<VkPipelineShaderStageCreateInfo> shaderStages;
             shaderStages.reserve(a_CreateInfo.m_Shaders.size());
-            result.m_ShaderModules.reserve(a_CreateInfo.m_Shaders.size());
-            int index = 0;
-            for (auto& shader : a_CreateInfo.m_Shaders)
+            result.m_ShaderModules = a_ShaderModules;
+            for (size_t index = 0; index < a_CreateInfo.m_Shaders.size(); ++index)
             {
-                const std::string path = a_ShadersPath + shader.m_ShaderFileName;
-                VkShaderModule module;
-                //Failed to load
-                if (!RenderUtility::CreateShaderModuleFromSpirV(path, module, a_Device))
-                {
-                    printf("Could not create shader from file: %s of type: %u.\n", path.c_str(), shader.m_ShaderStage);
-                    return false;
-                }
-                //Load succeeded.
-                else
-                {
-                    result.m_ShaderModules.push_back(module);
-                    shaderStages.push_back({ VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO, nullptr, 0, shader.m_ShaderStage, result.m_ShaderModules[index], shader.m_ShaderEntryPoint.c_str(), nullptr });
-                }
-                ++index;
+                const auto& shader = a_CreateInfo.m_Shaders[index];
+                shaderStages.push_back({ VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO, nullptr, 0, shader.m_ShaderStage, result.m_ShaderModules[index], shader.m_ShaderEntryPoint.c_str(), nullptr });
             }
 
 
@@ -714,26 +795,22 @@ namespace egg
             //Input assembly state
             VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
             inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-            inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+            inputAssembly.topology = a_CreateInfo.inputAssembly.m_Topology;
             inputAssembly.primitiveRestartEnable = false;
 
-            //Viewport
-            VkViewport viewport{};
-            viewport.x = 0.0f;
-            viewport.y = static_cast<float>(a_CreateInfo.resolution.m_ResolutionY); //Note: Nomally 0, but since Y is flipped..
-            viewport.width = static_cast<float>(a_CreateInfo.resolution.m_ResolutionX);
-            viewport.height = -static_cast<float>(a_CreateInfo.resolution.m_ResolutionY); //NOTE: Vulkan has Y inverted, so negative here flips it back!
-            viewport.minDepth = 0.0f;
-            viewport.maxDepth = 1.0f;
-            VkRect2D scissor{};
-            scissor.offset = { 0, 0 };
-            scissor.extent = VkExtent2D{ a_CreateInfo.resolution.m_ResolutionX, a_CreateInfo.resolution.m_ResolutionY };
+            //Viewport and scissor are dynamic, so that the pipeline does not depend on the resolution. See SetViewport().
             VkPipelineViewportStateCreateInfo viewportState{};
             viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
             viewportState.viewportCount = 1;
-            viewportState.pViewports = &viewport;
+            viewportState.pViewports = nullptr;
             viewportState.scissorCount = 1;
-            viewportState.pScissors = &scissor;
+            viewportState.pScissors = nullptr;
+
+            const VkDynamicState dynamicStates[2]{ VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+            VkPipelineDynamicStateCreateInfo dynamicState{};
+            dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+            dynamicState.dynamicStateCount = 2;
+            dynamicState.pDynamicStates = &dynamicStates[0];
 
             //Rasterizer state
             VkPipelineRasterizationStateCreateInfo rasterizationState{};
@@ -762,7 +839,7 @@ namespace egg
             //The depth state. Stencil is not used for now.
             VkPipelineDepthStencilStateCreateInfo depthStencilState{};
             depthStencilState.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-            depthStencilState.depthCompareOp = VK_COMPARE_OP_LESS;
+            depthStencilState.depthCompareOp = a_CreateInfo.depth.m_CompareOp;
             depthStencilState.depthTestEnable = a_CreateInfo.depth.m_UseDepth;
             depthStencilState.depthWriteEnable = a_CreateInfo.depth.m_WriteDepth;
             depthStencilState.stencilTestEnable = false;
@@ -771,12 +848,12 @@ namespace egg
             //Color blending.
             VkPipelineColorBlendAttachmentState colorBlendAttachment{};
             colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-            colorBlendAttachment.blendEnable = VK_FALSE;
-            colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
-            colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+            colorBlendAttachment.blendEnable = a_CreateInfo.attachments.m_AlphaBlending ? VK_TRUE : VK_FALSE;
+            colorBlendAttachment.srcColorBlendFactor = a_CreateInfo.attachments.m_AlphaBlending ? VK_BLEND_FACTOR_SRC_ALPHA : VK_BLEND_FACTOR_ONE;
+            colorBlendAttachment.dstColorBlendFactor = a_CreateInfo.attachments.m_AlphaBlending ? VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA : VK_BLEND_FACTOR_ZERO;
             colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
             colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-            colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+            colorBlendAttachment.dstAlphaBlendFactor = a_CreateInfo.attachments.m_AlphaBlending ? VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA : VK_BLEND_FACTOR_ZERO;
             colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
 
             std::vector< VkPipelineColorBlendAttachmentState> blending;
@@ -826,13 +903,86 @@ namespace egg
             psoInfo.renderPass = a_CreateInfo.renderPass.m_RenderPass;
             psoInfo.subpass = a_CreateInfo.renderPass.m_SubpassIndex;
 
-            psoInfo.pDynamicState = nullptr;
+            psoInfo.pDynamicState = &dynamicState;
             psoInfo.basePipelineHandle = nullptr;
             psoInfo.basePipelineIndex = -1;
 
-            if (vkCreateGraphicsPipelines(a_Device, VK_NULL_HANDLE, 1, &psoInfo, nullptr, &result.m_Pipeline) != VK_SUCCESS)
+            if (vkCreateGraphicsPipelines(a_Device, a_PipelineCache, 1, &psoInfo, nullptr, &result.m_Pipeline) != VK_SUCCESS)
             {
                 printf("Could not create graphics pipeline!\n");
+                vkDestroyPipelineLayout(a_Device, result.m_PipelineLayout, nullptr);
+                return false;
+            }
+
+            a_Result = result;
+            return true;
+        }
+
+        /*
+         * Set the viewport and scissor used by pipelines created with CreatePipeline() to cover a_ResolutionX by a_ResolutionY pixels.
+         * Call this after beginning a render pass, before drawing with those pipelines.
+         */
+        static void SetViewport(VkCommandBuffer a_CommandBuffer, uint32_t a_ResolutionX, uint32_t a_ResolutionY)
+        {
+            VkViewport viewport{};
+            viewport.x = 0.0f;
+            viewport.y = static_cast<float>(a_ResolutionY); //Note: Nomally 0, but since Y is flipped..
+            viewport.width = static_cast<float>(a_ResolutionX);
+            viewport.height = -static_cast<float>(a_ResolutionY); //NOTE: Vulkan has Y inverted, so negative here flips it back!
+            viewport.minDepth = 0.0f;
+            viewport.maxDepth = 1.0f;
+            vkCmdSetViewport(a_CommandBuffer, 0, 1, &viewport);
+
+            VkRect2D scissor{};
+            scissor.offset = { 0, 0 };
+            scissor.extent = VkExtent2D{ a_ResolutionX, a_ResolutionY };
+            vkCmdSetScissor(a_CommandBuffer, 0, 1, &scissor);
+        }
+
+        /*
+         * Create a compute pipeline from a shader module that was already loaded.
+         * a_CreateInfo has a single compute shader, and only its push constants and descriptor set layouts are used.
+         * The module is copied into the returned pipeline data. An optional pipeline cache speeds up creating the pipeline.
+         */
+        static bool CreateComputePipeline(const PipelineCreateInfo& a_CreateInfo, const VkDevice& a_Device, VkShaderModule a_ShaderModule,
+            VkPipelineCache a_PipelineCache, PipelineData& a_Result)
+        {
+            if (a_CreateInfo.m_Shaders.size() != 1 || a_CreateInfo.m_Shaders[0].m_ShaderStage != VK_SHADER_STAGE_COMPUTE_BIT)
+            {
+                printf("Trying to create compute pipeline without exactly one compute shader!\n");
+                return false;
+            }
+
+            PipelineData result;
+            result.m_ShaderModules.push_back(a_ShaderModule);
+
+            const auto& layouts = a_CreateInfo.descriptors.m_Layouts;
+            const auto& pushConstantRanges = a_CreateInfo.pushConstants.m_PushConstantRanges;
+            VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+            pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+            pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(layouts.size());
+            pipelineLayoutInfo.pSetLayouts = layouts.empty() ? nullptr : layouts.data();
+            pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size());
+            pipelineLayoutInfo.pPushConstantRanges = pushConstantRanges.empty() ? nullptr : pushConstantRanges.data();
+
+            if (vkCreatePipelineLayout(a_Device, &pipelineLayoutInfo, nullptr, &result.m_PipelineLayout) != VK_SUCCESS)
+            {
+                printf("Could not create pipeline layout for compute pipeline!\n");
+                return false;
+            }
+
+            const auto& shader = a_CreateInfo.m_Shaders[0];
+            VkComputePipelineCreateInfo psoInfo{};
+            psoInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+            psoInfo.stage = { VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO, nullptr, 0, VK_SHADER_STAGE_COMPUTE_BIT, a_ShaderModule, shader.m_ShaderEntryPoint.c_str(), nullptr };
+            psoInfo.layout = result.m_PipelineLayout;
+            psoInfo.basePipelineHandle = nullptr;
+            psoInfo.basePipelineIndex = -1;
+
+            if (vkCreateComputePipelines(a_Device, a_PipelineCache, 1, &psoInfo, nullptr, &result.m_Pipeline) != VK_SUCCESS)
+            {
+                printf("Could not create compute pipeline!\n");
+                vkDestroyPipelineLayout(a_Device, result.m_PipelineLayout, nullptr);
                 return false;
             }
 
@@ -1,18 +1,29 @@
 #pragma once
+#include <atomic>
 #include <filesystem>
+#include <future>
+#include <mutex>
 #include <vector>
 #include <GLFW/glfw3.h>
 #include <glm/glm/glm.hpp>
 
 #include "Bindless.h"
 #include "ConcurrentRegistry.h"
+#include "DrawDataCapture.h"
+#include "FrameStatisticsTracker.h"
 #include "GpuBuffer.h"
+#include "GpuProfiler.h"
+#include "LightTree.h"
+#include "MeshCache.h"
+#include "PipelineCache.h"
+#include "PresentWaiter.h"
 #include "vk_mem_alloc.h"
 #include "RenderStage.h"
 #include "Resources.h"
 #include "api/EggRenderer.h"
 #include "api/InputQueue.h"
 #include "ThreadPool.h"
+#include "VertexAnimationStorage.h"
 
 namespace egg
 {
@@ -44,6 +55,72 @@ namespace egg
 		GpuBuffer m_IndirectionBuffer;	//Indices into the instance data buffer.
 		GpuBuffer m_MaterialBuffer;		//Buffer containing the materials used for this frame.
 		GpuBuffer m_LightsBuffer;		//Buffer containing all the lights for this frame.
+		GpuBuffer m_DebugVertexBuffer;	//Debug line vertices, followed by the debug triangle vertices.
+		GpuBuffer m_PreviousTransformBuffer;	//Previous transforms of interpolated instances.
+		GpuBuffer m_AnimationStateBuffer;		//Frames of instances with a vertex animation.
+		uint32_t m_NumDebugLineVertices = 0;
+		uint32_t m_NumDebugTriangleVertices = 0;
+		uint32_t m_NumAreaLights = 0;			//Sphere lights in the lights buffer, after distant groups were merged. Directional lights follow them.
+		uint64_t m_UploadedDrawDataId = 0;		//Submission ID of the draw data in the buffers, so that redraws don't upload it again.
+	};
+
+	/*
+	 * A single custom ID query for a rectangle on the screen.
+	 */
+	struct PickingQuery
+	{
+		glm::uvec2 m_Offset;									//The top left pixel of the queried rectangle.
+		glm::uvec2 m_Size;										//The size of the queried rectangle in pixels.
+		size_t m_BufferOffset = 0;								//The offset into the readback buffer that the texels are copied to.
+		std::promise<std::vector<uint32_t>> m_Promise;			//Fulfilled once the frame containing the copy has finished.
+	};
+
+	/*
+	 * Picking queries that were recorded into a frame, and the buffer their texels are copied into.
+	 * For every query, the custom ID texels (8 bytes each) are stored first, followed by the depth texels (4 bytes each).
+	 */
+	struct PickingData
+	{
+		static constexpr size_t ID_TEXEL_SIZE = 8;		//R16G16B16A16 texel, with the custom ID in the last two components.
+		static constexpr size_t DEPTH_TEXEL_SIZE = 4;	//D32 texel.
+
+		std::vector<PickingQuery> m_Queries;	//The queries recorded into this frame.
+		GpuBuffer m_ReadbackBuffer;				//GPU to CPU buffer containing the copied texels.
+	};
+
+	/*
+	 * The debug view that a frame was recorded with, and the buffer its counters are written to.
+	 */
+	struct DebugViewData
+	{
+		static constexpr size_t COUNTER_BUFFER_SIZE = 8 * sizeof(uint32_t);	//Matches the DebugCounters block in deferred_processing.frag.
+
+		DebugViewSettings m_Settings;			//The debug view this frame was recorded with.
+		GpuBuffer m_CounterBuffer;				//GPU to CPU buffer that the shaders accumulate the counters in.
+		bool m_CountersPending = false;			//True when the counters have been recorded, but not read back yet.
+		uint32_t m_FrameIndex = 0;				//The frame that the counters are gathered for.
+	};
+
+	/*
+	 * Snapshot of the statistics shown by the HUD, taken right before the frame is recorded.
+	 */
+	struct HudData
+	{
+		std::vector<FrameStatistics> m_RecentFrames;	//The most recently published frames, oldest first.
+		GpuFrameTimings m_GpuTimings;					//Zones of the most recent frame measured on the GPU.
+		bool m_HasGpuTimings = false;
+		MemoryReport m_Memory;							//Only the categories are filled in.
+	};
+
+	/*
+	 * Timestamps used to measure the input latency of a frame, from GetTimestampMicroseconds().
+	 */
+	struct LatencyData
+	{
+		uint64_t m_InputTimestamp = 0;			//The input the draw data was tagged with. Nothing is measured when 0.
+		uint64_t m_SubmitTimestamp = 0;
+		uint64_t m_GpuCompleteTimestamp = 0;	//0 until the frame's fence has been seen signaled.
+		uint64_t m_PresentId = 0;				//0 when the present is not waited for.
 	};
 
 	/*
@@ -58,8 +135,17 @@ namespace egg
 		VkCommandPool m_CommandPool;			//The command pool used to allocate commands for this frame.
 		VkImageView m_SwapchainView;			//The ImageView into the swapchain for this frame.
 
-		std::unique_ptr<DrawData> m_DrawData;	//The draw data uploaded for this frame.
+		std::shared_ptr<DrawData> m_DrawData;	//The draw data uploaded for this frame. Shared with other frames when it is redrawn.
+		Camera m_Camera;						//The camera this frame is drawn with.
+		float m_InterpolationFactor = 1.f;		//Blend factor between the previous and current transforms of interpolated instances.
 		UploadData m_UploadData;				//Contains information about the uploaded draw data for this frame.
+		PickingData m_PickingData;				//Custom ID queries that are resolved once this frame has finished.
+		DebugViewData m_DebugView;				//Debug view counters that are read back once this frame has finished.
+		HudData m_HudData;						//Only filled in while the HUD is enabled.
+		LatencyData m_Latency;					//Input latency timestamps of the last frame recorded here.
+
+		FrameStatistics m_Statistics;			//Statistics of the last frame recorded here, published once its GPU time is known.
+		bool m_StatisticsPending = false;		//True when m_Statistics has not been published yet.
 	};
 
 	/*
@@ -73,8 +159,13 @@ namespace egg
 		               m_Device(nullptr),
 		               m_Surface(nullptr),
 		               m_Allocator(nullptr),
+		               m_EnabledFeatures(),
+		               m_MemoryBudgetSupported(false),
+		               m_PresentWaitSupported(false),
+		               m_BufferDeviceAddressSupported(false),
 		               m_Settings(),
 		               m_ThreadPool(std::thread::hardware_concurrency()),
+		               m_VertexAnimationStorage(std::make_shared<VertexAnimationStorage>()),
 					   m_FrameCounter(0)
 		{
 		}
@@ -82,8 +173,12 @@ namespace egg
 		VkInstance m_VulkanInstance;			//The global vulkan context.
 		VkPhysicalDevice m_PhysicalDevice;		//Physical GPU device.
 		VkDevice m_Device;						//Logical device wrapping around physical GPU.
-		VkSurfaceKHR m_Surface;					//The output surface. In this case provided by GLFW.
+		VkSurfaceKHR m_Surface;					//The output surface. Provided by GLFW, or a headless surface.
 		VmaAllocator m_Allocator;				//External library handling memory management to keep this project a bit cleaner.
+		VkPhysicalDeviceFeatures m_EnabledFeatures;	//The optional core device features that were enabled.
+		bool m_MemoryBudgetSupported;			//True when VK_EXT_memory_budget is enabled.
+		bool m_PresentWaitSupported;			//True when VK_KHR_present_id and VK_KHR_present_wait are enabled.
+		bool m_BufferDeviceAddressSupported;	//True when shaders can access the per-frame buffers through addresses instead of descriptors.
 		
 		std::vector<Frame> m_FrameData;			//Resources for each frame.
 
@@ -106,6 +201,19 @@ namespace egg
 		//Pool of threads for async tasks. Mutable because functions are not const.
 		mutable ThreadPool m_ThreadPool;
 
+		//GPU timestamp and statistics queries. Mutable so that stages can record zones.
+		mutable GpuProfiler m_GpuProfiler;
+
+		//Statistics of the frame that is being recorded. Mutable so that stages can count their draws and descriptor updates.
+		mutable FrameStatistics m_RecordingStatistics;
+
+		//Pipelines and shader modules shared by all stages. Mutable so that stages can acquire and release pipelines.
+		mutable PipelineCache m_PipelineCache;
+
+		//The frames of all vertex animations. Read by the deferred stage.
+		//Shared with every animation, so that animations can outlive the renderer.
+		std::shared_ptr<VertexAnimationStorage> m_VertexAnimationStorage;
+
 		//The index of the current frame. Used to track resource usage.
 		//Incremented by one after each frame.
 		uint32_t m_FrameCounter;					
@@ -123,6 +231,7 @@ namespace egg
 	public:
 		bool Init(const RendererSettings& a_Settings) override;
 		bool DrawFrame(std::unique_ptr<EggDrawData>& a_DrawData) override;
+		bool RedrawFrame(const Camera& a_Camera, float a_InterpolationFactor) override;
 		bool Resize(bool a_FullScreen, std::uint32_t a_Width, std::uint32_t a_Height) override;
 		bool IsFullScreen() const override;
 		bool CleanUp() override;
@@ -132,9 +241,26 @@ namespace egg
 		std::vector<std::shared_ptr<EggStaticMesh>>
 			CreateMeshes(const std::vector<StaticMeshCreateInfo>& a_MeshCreateInfos) override;
 		std::shared_ptr<EggStaticMesh> CreateMesh(const ShapeCreateInfo& a_ShapeCreateInfo) override;
+		std::shared_ptr<EggVertexAnimation> CreateVertexAnimation(const VertexAnimationCreateInfo& a_CreateInfo) override;
+		std::shared_ptr<EggTerrain> CreateTerrain(const TerrainCreateInfo& a_CreateInfo) override;
 	    InputData QueryInput() override;
 		std::shared_ptr<EggMaterial> CreateMaterial(const MaterialCreateInfo& a_Info) override;
 		std::unique_ptr<EggDrawData> CreateDrawData() override;
+		std::future<std::vector<uint32_t>> QueryCustomIds(std::uint32_t a_X, std::uint32_t a_Y, std::uint32_t a_Width, std::uint32_t a_Height) override;
+		std::vector<GpuFrameTimings> GetGpuTimingHistory() const override;
+		std::vector<FrameStatistics> GetFrameStatisticsHistory() const override;
+		FrameStatisticsSummary GetFrameStatisticsSummary() const override;
+		bool StartStatisticsStream(const std::string& a_FilePath, StatisticsStreamFormat a_Format) override;
+		void StopStatisticsStream() override;
+		bool StartDrawDataCapture(const std::string& a_FilePath) override;
+		void StopDrawDataCapture() override;
+		MemoryReport GetMemoryReport() const override;
+		bool WriteMemoryStatistics(const std::string& a_FilePath, bool a_Detailed) const override;
+		bool SetDebugView(const DebugViewSettings& a_Settings) override;
+		DebugViewSettings GetDebugView() const override;
+		DebugCounters GetDebugCounters() const override;
+		void SetHudEnabled(bool a_Enabled) override;
+		bool IsHudEnabled() const override;
 	
 	private:
 		template<typename T>
@@ -154,6 +280,35 @@ namespace egg
 			return ptr;
 		}
 
+		/*
+		 * Close the window when requested, and resize when the window was resized outside of the renderer.
+		 * Returns false when the window was closed.
+		 */
+		bool PollWindow();
+
+		/*
+		 * Upload and draw the given draw data into the next swapchain image, with the given camera and interpolation factor.
+		 */
+		bool SubmitFrame(const std::shared_ptr<DrawData>& a_DrawData, const Camera& a_Camera, float a_InterpolationFactor);
+
+		/*
+		 * Upload the instances, materials and debug primitives of the draw data into the upload buffers of a frame.
+		 * The frame's fence has to be signaled before calling this.
+		 */
+		bool UploadDrawData(const DrawData& a_DrawData, UploadData& a_UploadData, FrameStatistics& a_Statistics);
+
+		/*
+		 * Returns true when distant sphere lights of the draw data are merged with the light tree.
+		 */
+		bool UsesLightTree(const DrawData& a_DrawData) const;
+
+		/*
+		 * Upload the lights of the draw data into the lights buffer of a frame.
+		 * When the light tree is used, the lights are merged for a_Camera, so this has to be done again when the same draw data is redrawn.
+		 * The frame's fence has to be signaled before calling this.
+		 */
+		bool UploadLights(const DrawData& a_DrawData, const Camera& a_Camera, UploadData& a_UploadData, FrameStatistics& a_Statistics);
+
 		/*
 		 * Initialize Vulkan context and enable debug layers if specified.
 		 */
@@ -204,6 +359,46 @@ namespace egg
 		 */
 		bool InitPipeline();
 
+		/*
+		 * Move all pending picking queries into the given frame, and calculate where their texels are copied to.
+		 * Queries are clamped to the current resolution.
+		 */
+		bool PreparePickingQueries(Frame& a_Frame);
+
+		/*
+		 * Read back the picking results for the given frame and fulfill the promises.
+		 * The frame's fence has to be signaled before calling this.
+		 */
+		void ResolvePickingQueries(Frame& a_Frame);
+
+		/*
+		 * Read back the debug counters of the given frame, if it was drawn with a debug view.
+		 * The frame's fence has to be signaled before calling this.
+		 */
+		void ResolveDebugCounters(Frame& a_Frame);
+
+		/*
+		 * Publish the statistics of the last frame recorded into the given frame, together with its GPU time.
+		 * Has to be called after the GPU profiler resolved the frame.
+		 */
+		void PublishFrameStatistics(Frame& a_Frame);
+
+		/*
+		 * Record the current time as GPU completion for every frame with input latency whose fence is now signaled.
+		 * Completion is only observed when this is called, so the measured time is an upper bound.
+		 */
+		void ObserveGpuCompletion();
+
+		/*
+		 * Copy the vertices and indices of a mesh back to the CPU. Blocks until the copy has finished.
+		 */
+		bool ReadMeshGeometry(StaticMesh& a_Mesh, std::vector<Vertex>& a_Vertices, std::vector<uint32_t>& a_Indices);
+
+		/*
+		 * Measure the radius and triangle areas of geometry that is about to be uploaded.
+		 */
+		static MeshBounds CalculateMeshBounds(const StaticMeshCreateInfo& a_CreateInfo);
+
 		//Vulkan debug layer callback function.
 		static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
 			VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
@@ -216,6 +411,9 @@ namespace egg
 		 */
 		bool m_Initialized;
 		uint32_t m_MeshCounter;						//The mesh ID incrementing counter.
+		MeshCache m_MeshCache;						//Meshes by content, to share identical meshes.
+		LightTree m_LightTree;						//Merges distant sphere lights before they are uploaded.
+		uint64_t m_LightTreeDrawDataId;				//Submission ID of the draw data that m_LightTree was built for.
 
 		/*
 		 * Input object.
@@ -242,6 +440,23 @@ namespace egg
 		VkFence m_CopyFence;
 		std::mutex m_CopyMutex;
 
+		std::mutex m_PickingMutex;							//Guards the pending picking queries.
+		std::vector<PickingQuery> m_PendingPickingQueries;	//Picking queries that have not been recorded into a frame yet.
+
+		FrameStatisticsTracker m_FrameStatistics;			//History of published frame statistics.
+		DrawDataCaptureWriter m_DrawDataCapture;			//Writes every drawn frame to a file while a capture is running.
+
+		mutable std::mutex m_DebugViewMutex;				//Guards the debug view settings and counters.
+		DebugViewSettings m_DebugViewSettings;				//Applied to the next frame that is drawn.
+		DebugCounters m_DebugCounters;						//Counters of the last finished frame that was drawn with a debug view.
+
+		std::atomic<bool> m_HudEnabled;						//Toggled from the input thread, applied to the HUD stage when drawing.
+
+		PresentWaiter m_PresentWaiter;						//Measures when frames with input latency reach the screen.
+
+		std::shared_ptr<DrawData> m_LastDrawData;			//The last draw data passed to DrawFrame(), drawn again by RedrawFrame().
+		uint64_t m_SubmissionCounter;						//Identifies every draw data passed to DrawFrame().
+
 		std::uint32_t m_SwapChainIndex;			//The current frame index in the swapchain.
 		VkSemaphore m_FrameReadySemaphore;		//This semaphore is signaled by the swapchain when it's ready for the next frame. 
 
@@ -254,6 +469,8 @@ namespace egg
 		 * References to render stages for individual specific use.
 		 */
 		RenderStage_HelloTriangle* m_HelloTriangleStage;	//The hello world triangle for testing.
+		RenderStage_Terrain* m_TerrainStage;				//Streams the terrain heightmap, and draws the terrain into the deferred G-buffer.
 		RenderStage_Deferred* m_DeferredStage;				//The deferred render pass.
+		RenderStage_Hud* m_HudStage;						//Draws the performance HUD over the output.
 	};
 }
@@ -4,9 +4,13 @@
 
 #include "Bindless.h"
 #include "vk_mem_alloc.h"
+#include "MemoryTracker.h"
+#include "VertexAnimationStorage.h"
 #include "api/EggStaticMesh.h"
 #include "api/EggMaterial.h"
+#include "api/EggTerrain.h"
 #include "api/EggTexture.h"
+#include "api/EggVertexAnimation.h"
 
 namespace egg
 {
@@ -32,6 +36,8 @@ namespace egg
 
 		~Texture() override
 		{
+			LiveResourceTracker::Unregister(this);
+			MemoryTracker::Untrack(m_Allocator, m_Allocation);
 			vmaDestroyImage(m_Allocator, m_Image, m_Allocation);
 		}
 
@@ -70,13 +76,23 @@ namespace egg
 		VkAccessFlags m_AccessFlags;
 	};
 
+	/*
+	 * The size of a mesh, calculated once when it is created.
+	 */
+	struct MeshBounds
+	{
+		float m_Radius = 0.f;				//Distance from the origin to the furthest vertex.
+		float m_SurfaceArea = 0.f;			//Total area of all triangles.
+		float m_MaxTriangleArea = 0.f;		//Area of the largest triangle.
+	};
+
 	/*
 	 * Mesh class containing a vertex and index buffer.
 	 */
 	class StaticMesh : public EggStaticMesh, public Resource
 	{
 	public:
-		StaticMesh(uint32_t a_UniqueId, VmaAllocator a_Allocator, VmaAllocation a_Allocation, VkBuffer a_Buffer, std::uint64_t a_NumIndices, std::uint64_t a_NumVertices, size_t a_IndexBufferOffset, size_t a_VertexBufferOffset) :
+		StaticMesh(uint32_t a_UniqueId, VmaAllocator a_Allocator, VmaAllocation a_Allocation, VkBuffer a_Buffer, std::uint64_t a_NumIndices, std::uint64_t a_NumVertices, size_t a_IndexBufferOffset, size_t a_VertexBufferOffset, const MeshBounds& a_Bounds) :
 			m_UniqueId(a_UniqueId),
 			m_Allocator(a_Allocator),
 			m_Allocation(a_Allocation),
@@ -84,7 +100,8 @@ namespace egg
 			m_IndexOffset(a_IndexBufferOffset),
 			m_VertexOffset(a_VertexBufferOffset),
 			m_NumIndices(a_NumIndices),
-			m_NumVertices(a_NumVertices)
+			m_NumVertices(a_NumVertices),
+			m_Bounds(a_Bounds)
 		{
 		}
 
@@ -92,6 +109,8 @@ namespace egg
 		//This means all buffers are OWNED by mesh. This only works because meshes are kept in a shared_ptr always.
 		~StaticMesh() override
 		{
+			LiveResourceTracker::Unregister(this);
+			MemoryTracker::Untrack(m_Allocator, m_Allocation);
 			vmaDestroyBuffer(m_Allocator, m_Buffer, m_Allocation);
 		}
 
@@ -106,6 +125,7 @@ namespace egg
 
 		uint32_t GetUniqueId() const { return m_UniqueId; }
 
+		const MeshBounds& GetBounds() const { return m_Bounds; }
 
 	private:
 		uint32_t m_UniqueId;			//The unique ID for this mesh that can be used for sorting and comparing.
@@ -118,6 +138,82 @@ namespace egg
 		size_t m_VertexOffset;			//The offset into m_Buffer for the vertex buffer 
 		size_t m_NumIndices;			//The amount of indices in the index buffer.
 		size_t m_NumVertices;			//The amount of vertices in the vertex buffer.
+		MeshBounds m_Bounds;			//Used to scatter instances over the mesh, and to cull scattered instances of it.
+	};
+
+	/*
+	 * A vertex of a baked animation frame as it is stored on the GPU.
+	 */
+	struct PackedAnimatedVertex
+	{
+		glm::vec3 m_Position;
+		uint32_t m_Normal;				//Packed as four signed normalized bytes.
+	};
+
+	/*
+	 * A baked vertex animation, stored in a range of the renderer's vertex animation storage.
+	 * The range is returned to the storage when the animation is destroyed.
+	 * The storage is shared, so an animation that outlives the renderer frees into a storage that was cleaned up, which ignores it.
+	 */
+	class VertexAnimation : public EggVertexAnimation, public Resource
+	{
+	public:
+		VertexAnimation(const std::shared_ptr<VertexAnimationStorage>& a_Storage, size_t a_Offset, uint32_t a_NumVertices, uint32_t a_NumFrames, float a_FramesPerSecond, bool a_Loop) :
+			m_Storage(a_Storage),
+			m_Offset(a_Offset),
+			m_NumVertices(a_NumVertices),
+			m_NumFrames(a_NumFrames),
+			m_FramesPerSecond(a_FramesPerSecond),
+			m_Loop(a_Loop)
+		{
+		}
+
+		~VertexAnimation() override
+		{
+			LiveResourceTracker::Unregister(this);
+			m_Storage->Free(m_Offset, GetSizeInBytes());
+		}
+
+		//The index of the first vertex of the first frame in the storage, in vertices.
+		uint32_t GetFirstVertex() const { return static_cast<uint32_t>(m_Offset / sizeof(PackedAnimatedVertex)); }
+
+		uint32_t GetNumVertices() const { return m_NumVertices; }
+		uint32_t GetNumFrames() const { return m_NumFrames; }
+		float GetFramesPerSecond() const { return m_FramesPerSecond; }
+		bool IsLooping() const { return m_Loop; }
+
+		size_t GetSizeInBytes() const { return sizeof(PackedAnimatedVertex) * m_NumVertices * m_NumFrames; }
+
+	private:
+		std::shared_ptr<VertexAnimationStorage> m_Storage;	//The storage that the frames are in.
+		size_t m_Offset;					//Offset of the first frame in the storage, in bytes.
+		uint32_t m_NumVertices;				//The amount of vertices in every frame.
+		uint32_t m_NumFrames;
+		float m_FramesPerSecond;
+		bool m_Loop;
+	};
+
+	/*
+	 * A terrain heightfield. It owns no GPU memory, as the terrain stage streams the heights around the camera with the callback.
+	 */
+	class Terrain : public EggTerrain, public Resource
+	{
+	public:
+		Terrain(const TerrainCreateInfo& a_Info) : m_Info(a_Info)
+		{
+		}
+
+		~Terrain() override
+		{
+			LiveResourceTracker::Unregister(this);
+		}
+
+		float GetHeight(int32_t a_X, int32_t a_Z) const { return m_Info.m_HeightCallback(a_X, a_Z); }
+		float GetSampleSpacing() const { return m_Info.m_SampleSpacing; }
+		float GetUvScale() const { return m_Info.m_UvScale; }
+
+	private:
+		TerrainCreateInfo m_Info;
 	};
 
 	union UI32UI8Alias
@@ -155,29 +251,71 @@ namespace egg
      * Instance data that is packed and aligned correctly.
      * Custom data can be stored in the last row of the matrix.
      */
-	union PackedInstanceData
+	struct PackedInstanceData
 	{
 		//TODO try to pack everything in a mat4 in the future (last row is unused anyways).
-		struct
-		{
-			//Mat4x4 (4x3 would add padding)
-			glm::mat4 m_Transform;
+		//Mat4x4 (4x3 would add padding)
+		glm::mat4 m_Transform;
 
-			//Last column as individual components.
-			union
+		//Last column as individual components.
+		union
+		{
+			glm::uvec4 m_CustomData;
+			struct
 			{
-				glm::uvec4 m_CustomData;
-				struct
-				{
-					uint32_t m_MaterialId;
-					uint32_t m_CustomId;
-					uint32_t m_CustomData3;
-					uint32_t m_CustomData4;
-				};
+				uint32_t m_MaterialId;
+				uint32_t m_CustomId;
+				uint32_t m_PreviousTransformIndex;	//One more than the index into the previous transforms, 0 when not interpolated.
+				uint32_t m_AnimationStateIndex;		//One more than the index into the animation states, 0 when not animated.
 			};
 		};
 	};
 
+	/*
+	 * The frames that an animated instance blends between, ready to be uploaded to the GPU.
+	 */
+	struct PackedAnimationState
+	{
+		uint32_t m_FirstFrameVertex;	//Index of vertex 0 of the earlier frame in the vertex animation storage.
+		uint32_t m_SecondFrameVertex;	//Index of vertex 0 of the later frame.
+		float m_Blend;					//How far the animation is between both frames.
+		uint32_t m_Padding;
+	};
+
+	/*
+	 * Everything the scatter compute shader needs to generate the instances of a scattered draw call.
+	 * Instances and indirections are written to the scatter output buffers of the frame, which only the GPU accesses.
+	 */
+	struct PackedScatterData
+	{
+		static constexpr uint32_t GROUP_SIZE = 64;							//Candidates per compute work group.
+		static constexpr uint32_t MAX_CANDIDATES = 65535 * GROUP_SIZE;		//Keeps dispatches within the work group count every device supports.
+
+		glm::mat4 m_Transform;			//Places the surface in the world.
+		glm::vec4 m_Area;				//xy: size of the area, z: largest triangle area of the surface mesh, w: bounding radius of the drawn mesh.
+		glm::vec4 m_Ranges;				//Minimum and maximum scale, followed by the minimum and maximum rotation.
+		glm::uvec4 m_Counts;			//x: candidates, y: seed, z: triangles of the surface mesh (0 for an area), w: 1 to align to the surface.
+		glm::uvec4 m_Output;			//x: first instance, y: first indirection, both in the scatter output buffers. z: material ID, w: custom ID.
+		glm::uvec4 m_Surface;			//x: first index and y: first vertex of the surface mesh in 32 bit words. z: surface mesh index, w: drawn mesh index. Only x and y are read on the GPU.
+	};
+
+	/*
+	 * Everything the terrain vertex shader needs to place the clipmap levels, updated every frame.
+	 * Level L has a sample spacing of 2^L times the finest spacing, and its heights are stored in layer L of the heightmap.
+	 * The heightmap wraps around, so sample s of a level is always stored in texel s modulo the heightmap size.
+	 * The window of samples around the center of a level can therefore start at any texel.
+	 */
+	struct PackedTerrainData
+	{
+		static constexpr uint32_t MAX_LEVELS = 16;
+
+		glm::vec4 m_Scale;							//x: finest sample spacing, y: UVs per world unit, z: width of the morph region in cells.
+		glm::uvec4 m_Settings;						//x: cells per level, y: heightmap size in texels, z: amount of levels, w: material ID.
+		glm::uvec4 m_Ids;							//x: custom ID.
+		glm::ivec4 m_Levels[MAX_LEVELS];			//xy: center of every level in its own samples, zw: the texel that stores the first sample of its window.
+		glm::uvec4 m_LevelOrder[MAX_LEVELS / 4];	//The level of every instance, four per element. Instances are grouped by the ring they are drawn with.
+	};
+
 	/*
 	 * Light data ready to be uploaded to the GPU.
 	 * This struct can contain position, direction, radiance, angle, radius etc.
@@ -202,6 +340,15 @@ namespace egg
 		};
 	};
 
+	/*
+	 * A single vertex of an immediate-mode debug line or triangle.
+	 */
+	struct PackedDebugVertex
+	{
+		glm::vec3 m_Position;	//World space.
+		uint32_t m_Color;		//RGBA8, red in the lowest byte.
+	};
+
 	/*
 	 * A material instance with GPU backing memory.
 	 */
@@ -209,6 +356,7 @@ namespace egg
 	{
     public:
 		Material(const MaterialCreateInfo& a_Info);
+		~Material() override;
         glm::vec3 GetAlbedoFactor() const override;
         void SetAlbedoFactor(const glm::vec3& a_Factor) override;
         glm::vec3 GetEmissiveFactor() const override;
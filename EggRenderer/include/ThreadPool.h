@@ -7,6 +7,9 @@
 #include <future>
 #include <functional>
 #include <stdexcept>
+#include <string>
+
+#include "api/TraceProfiler.h"
 
 namespace egg
 {
@@ -65,8 +68,10 @@ namespace egg
 	{
 		for (size_t i = 0; i < threads; ++i)
 			workers.emplace_back(
-				[this]
+				[this, i]
 				{
+					TraceProfiler::SetThreadName("Worker " + std::to_string(i));
+
 					for (;;)
 					{
 						std::function<void()> task;
@@ -89,7 +94,10 @@ namespace egg
 							--idleThreads;
 						}
 
-						task();
+						{
+							EGG_TRACE_ZONE("Worker Task");
+							task();
+						}
 						++idleThreads;
 					}
 				}
@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+
+#include "GpuBuffer.h"
+#include "RangeAllocator.h"
+
+namespace egg
+{
+	/*
+	 * A single GPU-only buffer that holds the frames of all baked vertex animations.
+	 * Shaders read every animation from the same descriptor, so drawing does not depend on which animations exist.
+	 * A buffer is used rather than an image array, because frames are fetched per vertex by gl_VertexIndex and never filtered.
+	 * Animations of any vertex count then pack tightly, without padding to a texture row or being limited by the maximum image dimensions.
+	 *
+	 * The buffer never grows, and its ranges are handed out by a RangeAllocator, so ranges that are in use never move.
+	 * Allocating and freeing can be done from any thread.
+	 */
+	class VertexAnimationStorage
+	{
+	public:
+		//Ranges start at multiples of this, so that offsets can be passed to shaders in whole elements.
+		static constexpr size_t ALIGNMENT = 16;
+
+		VertexAnimationStorage();
+
+		/*
+		 * Create the buffer. A size of 0 creates no buffer, and every allocation fails.
+		 */
+		bool Init(size_t a_SizeInBytes, VkDevice& a_Device, VmaAllocator& a_Allocator);
+
+		/*
+		 * Destroy the buffer. Every allocation fails afterwards, and ranges that are freed afterwards are ignored.
+		 */
+		void CleanUp();
+
+		/*
+		 * Reserve a range of the buffer. Returns false when no free range is large enough.
+		 */
+		bool Allocate(size_t a_Size, size_t& a_Offset);
+
+		/*
+		 * Return a range that was reserved with Allocate(). The GPU must no longer read from it.
+		 */
+		void Free(size_t a_Offset, size_t a_Size);
+
+		const GpuBuffer& GetBuffer() const;
+
+	private:
+		GpuBuffer m_Buffer;
+		std::mutex m_Mutex;
+		RangeAllocator m_Ranges;
+		bool m_Initialized;							//False before Init() and after CleanUp(), when there is nothing to free into.
+	};
+}
@@ -70,6 +70,29 @@ namespace egg
 			return m_ProjectionMatrix;
 		}
 
+		/*
+		 * Get the field of view in degrees.
+		 */
+		float GetFov() const
+		{
+			return m_Fov;
+		}
+
+		float GetNearPlane() const
+		{
+			return m_NearPlane;
+		}
+
+		float GetFarPlane() const
+		{
+			return m_FarPlane;
+		}
+
+		float GetAspectRatio() const
+		{
+			return m_AspectRatio;
+		}
+
 	private:
 		float m_Fov;
 		float m_NearPlane;
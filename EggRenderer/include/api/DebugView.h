@@ -0,0 +1,97 @@
+#pragma once
+#include <cstdint>
+
+namespace egg
+{
+	/*
+	 * What the deferred stage outputs instead of the shaded image.
+	 */
+	enum class DebugViewMode : uint32_t
+	{
+		NONE = 0,			//Normal shading.
+		LIGHT_COUNT,		//Heatmap of the amount of lights evaluated per pixel.
+		OVERDRAW,			//Heatmap of the amount of fragments rasterized per pixel during the geometry pass.
+		DEPTH,				//Raw G-buffer attachments.
+		POSITION,
+		NORMAL,
+		TANGENT,
+		UV,
+		MATERIAL_ID,		//Every ID is shown as a unique color.
+		CUSTOM_ID,
+		INSTANCE_ID,		//Index of the instance in the draw data.
+		DRAW_CALL_ID,		//Index of the draw call in the draw data.
+
+		MAX_ENUM
+	};
+
+	/*
+	 * Settings for the debug view.
+	 */
+	struct DebugViewSettings
+	{
+		DebugViewMode m_Mode = DebugViewMode::NONE;
+		uint32_t m_HeatmapMaximum = 16;		//The light count or overdraw that is shown as the hottest color.
+	};
+
+	/*
+	 * Counters aggregated over all pixels of a frame that was drawn with a debug view enabled.
+	 * Counters are gathered in every debug view mode.
+	 */
+	struct DebugCounters
+	{
+		uint32_t m_FrameIndex = 0;					//The frame that the counters were gathered for.
+		DebugViewMode m_Mode = DebugViewMode::NONE;	//NONE when no frame has been drawn with a debug view yet.
+
+		uint32_t m_NumShadedPixels = 0;				//Pixels covered by geometry.
+		uint64_t m_NumLightsEvaluated = 0;			//Light evaluations over all shaded pixels.
+		uint32_t m_MaxLightsPerPixel = 0;
+		uint64_t m_NumFragments = 0;				//Fragments rasterized during the geometry pass, including ones that fail the depth test.
+		uint32_t m_MaxOverdraw = 0;					//The most fragments rasterized for a single pixel.
+
+		double GetAverageLightsPerPixel() const
+		{
+			return m_NumShadedPixels == 0 ? 0.0 : static_cast<double>(m_NumLightsEvaluated) / m_NumShadedPixels;
+		}
+
+		double GetAverageOverdraw() const
+		{
+			return m_NumShadedPixels == 0 ? 0.0 : static_cast<double>(m_NumFragments) / m_NumShadedPixels;
+		}
+	};
+
+	/*
+	 * Get a readable name for a debug view mode.
+	 */
+	inline const char* GetDebugViewModeName(DebugViewMode a_Mode)
+	{
+		switch (a_Mode)
+		{
+		case DebugViewMode::NONE:
+			return "None";
+		case DebugViewMode::LIGHT_COUNT:
+			return "Light Count";
+		case DebugViewMode::OVERDRAW:
+			return "Overdraw";
+		case DebugViewMode::DEPTH:
+			return "Depth";
+		case DebugViewMode::POSITION:
+			return "Position";
+		case DebugViewMode::NORMAL:
+			return "Normal";
+		case DebugViewMode::TANGENT:
+			return "Tangent";
+		case DebugViewMode::UV:
+			return "UV";
+		case DebugViewMode::MATERIAL_ID:
+			return "Material ID";
+		case DebugViewMode::CUSTOM_ID:
+			return "Custom ID";
+		case DebugViewMode::INSTANCE_ID:
+			return "Instance ID";
+		case DebugViewMode::DRAW_CALL_ID:
+			return "Draw Call ID";
+		default:
+			return "Unknown";
+		}
+	}
+}
@@ -1,17 +1,133 @@
 #pragma once
+#include <cstdint>
 #include <memory>
-#include <set>
+#include <unordered_map>
+#include <vector>
 #include <glm/glm/glm.hpp>
 
+#include "EggDrawData.h"
+
 namespace egg
 {
-	/**
-	 * TODO:
-	 * Builder for draw call objects.
-	 * Hold their own state.
-	 * One mesh, multiple draw calls.
-	 * Material switch inside draw call.
-	 * Set to keep track of duplicate materials.
-	 * 
+	enum class RenderObjectHandle : uint32_t {};
+
+	/*
+	 * Builds instanced draw calls from objects that are added in any order.
+	 * An object is a mesh, material, transform and custom ID. Objects stay in the builder until they are removed, so that
+	 * a scene only has to be changed where it changes, and the same builder can fill the draw data of every frame.
+	 *
+	 * Objects are bucketed per mesh. Build() emits one draw call per mesh, with all of its instances in a contiguous indirection range.
+	 * Materials are stored per instance, so objects with different materials still share the draw call of their mesh.
+	 * Meshes and materials are de-duplicated with hash maps, and added to the draw data once.
 	 */
-}
\ No newline at end of file
+	class DrawDataBuilder
+	{
+	public:
+		DrawDataBuilder();
+
+		/*
+		 * Add an object. It is drawn by every following Build() until it is removed.
+		 * The custom ID can be queried for a location on the screen, see EggDrawData::AddInstance().
+		 */
+		RenderObjectHandle Add(const std::shared_ptr<EggStaticMesh>& a_Mesh, const std::shared_ptr<EggMaterial>& a_Material,
+			const glm::mat4& a_Transform, uint32_t a_CustomId);
+
+		/*
+		 * Remove an object. The handle may be returned by a later Add().
+		 */
+		void Remove(RenderObjectHandle a_Handle);
+
+		/*
+		 * Remove all objects. Allocated memory is kept for the objects added next.
+		 */
+		void Clear();
+
+		void SetTransform(RenderObjectHandle a_Handle, const glm::mat4& a_Transform);
+		void SetMaterial(RenderObjectHandle a_Handle, const std::shared_ptr<EggMaterial>& a_Material);
+		void SetCustomId(RenderObjectHandle a_Handle, uint32_t a_CustomId);
+
+		const glm::mat4& GetTransform(RenderObjectHandle a_Handle) const;
+
+		/*
+		 * Add the meshes, materials, instances and draw calls of all objects to the draw data.
+		 * a_DrawCalls is overwritten with the added draw calls, to be passed to draw passes and lights with shadows.
+		 */
+		void Build(EggDrawData& a_DrawData, std::vector<DrawCallHandle>& a_DrawCalls);
+
+		uint32_t GetObjectCount() const;
+
+		/*
+		 * The amount of different meshes used by the objects. This is the amount of draw calls that Build() adds.
+		 */
+		uint32_t GetMeshCount() const;
+
+		/*
+		 * The amount of different materials used by the objects.
+		 */
+		uint32_t GetMaterialCount() const;
+
+	private:
+		//Marks unused handles, buckets and materials.
+		static constexpr uint32_t INVALID_INDEX = ~0u;
+
+		/*
+		 * All objects that use the same mesh, stored as separate arrays.
+		 * Removing an object moves the last object of the bucket into its place.
+		 */
+		struct MeshBucket
+		{
+			std::shared_ptr<EggStaticMesh> m_Mesh;		//Null when the bucket is unused.
+			std::vector<glm::mat4> m_Transforms;
+			std::vector<uint32_t> m_Materials;			//Index into the material entries.
+			std::vector<uint32_t> m_CustomIds;
+			std::vector<uint32_t> m_Handles;			//Handle of every object, to update its location when it is moved.
+		};
+
+		struct MaterialEntry
+		{
+			std::shared_ptr<EggMaterial> m_Material;	//Null when the entry is unused.
+			uint32_t m_NumUsers = 0;
+		};
+
+		struct ObjectLocation
+		{
+			uint32_t m_Bucket = INVALID_INDEX;			//INVALID_INDEX when the handle is unused.
+			uint32_t m_Index = INVALID_INDEX;
+		};
+
+		/*
+		 * Get the bucket for a mesh, creating it when no object used the mesh yet.
+		 */
+		uint32_t AcquireBucket(const std::shared_ptr<EggStaticMesh>& a_Mesh);
+
+		/*
+		 * Get the entry for a material and count the new user, creating it when no object used the material yet.
+		 */
+		uint32_t AcquireMaterial(const std::shared_ptr<EggMaterial>& a_Material);
+
+		/*
+		 * Stop counting a user of a material entry, and free the entry when it has no users left.
+		 */
+		void ReleaseMaterial(uint32_t a_Entry);
+
+		const ObjectLocation& GetLocation(RenderObjectHandle a_Handle) const;
+
+	private:
+		std::vector<MeshBucket> m_Buckets;
+		std::unordered_map<const EggStaticMesh*, uint32_t> m_BucketLookup;
+		std::vector<uint32_t> m_FreeBuckets;
+		uint32_t m_NumBuckets;							//Buckets in use.
+
+		std::vector<MaterialEntry> m_Materials;
+		std::unordered_map<const EggMaterial*, uint32_t> m_MaterialLookup;
+		std::vector<uint32_t> m_FreeMaterials;
+
+		std::vector<ObjectLocation> m_Objects;			//Indexed by handle.
+		std::vector<uint32_t> m_FreeHandles;
+		uint32_t m_NumObjects;
+
+		//Reused by every Build(), so that building does not allocate once the scene stops growing.
+		std::vector<MaterialHandle> m_MaterialHandles;	//Indexed by material entry.
+		std::vector<InstanceDataHandle> m_InstanceHandles;
+	};
+}
@@ -1,4 +1,5 @@
 #pragma once
+#include <limits>
 #include <memory>
 #include <vector>
 #include <glm/glm/glm.hpp>
@@ -7,12 +8,16 @@
 #include "EggMaterial.h"
 #include "EggLight.h"
 #include "EggStaticMesh.h"
+#include "EggTerrain.h"
+#include "EggVertexAnimation.h"
+#include "TransformHierarchy.h"
 
 namespace egg
 {
 	//Opaque handle types.
 	enum class MaterialHandle : uint32_t {};
 	enum class MeshHandle : uint32_t {};
+	enum class VertexAnimationHandle : uint32_t {};
 	enum class InstanceDataHandle : uint32_t {};
 	struct LightHandle { LightType m_Type; uint32_t m_Index; };
 	enum class DrawCallHandle : uint32_t {};
@@ -39,6 +44,37 @@ namespace egg
 		uint32_t m_MeshIndex;					//Index into the mesh array in the draw data.
 		uint32_t m_IndirectionBufferOffset;		//Where in the indirection buffer the indices for this draw call start.
 		uint32_t m_NumInstances;				//How many instances to draw.
+		uint32_t m_ScatterIndex;				//One more than the index of the scatter that generates the instances on the GPU, or 0.
+	};
+
+	/*
+	 * The surface that instances are scattered over.
+	 */
+	enum class ScatterSurface
+	{
+		AREA,		//A rectangle on the XZ plane, centered on the origin.
+		MESH		//The triangles of a mesh.
+	};
+
+	/*
+	 * Describes how instances are scattered over a surface. The instances are generated on the GPU every time a frame is drawn.
+	 * Sizes and densities are measured on the surface itself, before m_Transform is applied.
+	 *
+	 * The amount of candidates follows from the density and the size of the surface, up to 4194240 (65535 work groups of 64) per scatter.
+	 * GPU-only memory for every candidate is reserved every frame, 84 bytes each.
+	 */
+	struct ScatterDistribution
+	{
+		ScatterSurface m_Surface = ScatterSurface::AREA;
+		glm::mat4 m_Transform = glm::mat4(1.f);				//Places the surface in the world.
+		glm::vec2 m_AreaSize = glm::vec2(1.f);				//Width and depth of the area. Only used for AREA.
+		MeshHandle m_SurfaceMesh = MeshHandle{};			//A mesh added to the same draw data. Only used for MESH.
+		float m_Density = 1.f;								//Average amount of instances per square unit.
+		uint32_t m_Seed = 0;								//The same seed places the same instances every frame.
+		glm::vec2 m_ScaleRange = glm::vec2(1.f);			//Uniform scale, picked between x and y.
+		glm::vec2 m_RotationRange = glm::vec2(0.f, 6.28318531f);	//Rotation around the up axis in radians, picked between x and y.
+		bool m_AlignToSurface = true;						//Point the up axis along the triangle normal. Only used for MESH, areas always use Y.
+		uint32_t m_MaxInstances = std::numeric_limits<uint32_t>::max();	//Limits the amount of candidates below the amount that follows from the density.
 	};
 
 	/*
@@ -69,12 +105,28 @@ namespace egg
 	class EggDrawData
 	{
 	public:
+		static constexpr uint32_t MAX_SCATTERS = 64;		//Scattered draw calls per frame.
+
 		virtual ~EggDrawData() = default;
 		
 		/*
 		 * Set the camera used for this frame.
 		 */
 		virtual void SetCamera(const Camera& a_Camera) = 0;
+
+		/*
+		 * Tag this frame with the input it reacts to, usually InputData::GetOldestEventTimestamp().
+		 * The renderer then measures the latency from the input until the frame is submitted, finished and presented.
+		 * A timestamp of 0 means that the frame does not reflect any input.
+		 */
+		virtual void SetInputTimestamp(uint64_t a_Timestamp) = 0;
+
+		/*
+		 * Set how far this frame is between the previous and current transforms of interpolated instances.
+		 * 0 draws them at their previous transform, 1 (the default) at their current transform.
+		 * Frames drawn again with EggRenderer::RedrawFrame() provide their own factor.
+		 */
+		virtual void SetInterpolationFactor(float a_Factor) = 0;
 		
 		/*
 		 * Add a directional light to the scene in this frame.
@@ -114,17 +166,54 @@ namespace egg
 		 */
 		virtual MeshHandle AddMesh(const std::shared_ptr<EggStaticMesh>& a_Mesh) = 0;
 
+		/*
+		 * Add a vertex animation to be used during this frame.
+		 * Returns a handle to the animation that can be specified when adding animated instances.
+		 */
+		virtual VertexAnimationHandle AddVertexAnimation(const std::shared_ptr<EggVertexAnimation>& a_Animation) = 0;
+
 		/*
 		 * Add an instance's data to this frame.
 		 *
 		 * a_Transform represents a mat4x4 consisting of 16 32-bit floats in column-major order.
 		 * a_MaterialHandle is the handle to a material previously added to this DrawData using AddMaterial().
-		 * a_CustomId is an identifier that can be queried for a location on the screen after drawing.
+		 * a_CustomId is an identifier that can be queried for a location on the screen after drawing (see EggRenderer::QueryCustomIds()).
+		 * The identifier should not be the same as INVALID_CUSTOM_ID.
 		 *
 		 * Returns a handle that can be provided to the AddDrawCall() function.
 		 */
 		virtual InstanceDataHandle AddInstance(const glm::mat4& a_Transform, const MaterialHandle a_MaterialHandle, const uint32_t a_CustomId) = 0;
 
+		/*
+		 * Add an instance that moves from a_PreviousTransform to a_Transform, for simulations that update less often than frames are drawn.
+		 * The GPU blends both matrices with the interpolation factor of every frame that draws the instance.
+		 * The blend is linear per matrix element, which is accurate for the small changes between simulation ticks.
+		 *
+		 * Returns a handle that can be provided to the AddDrawCall() function.
+		 */
+		virtual InstanceDataHandle AddInterpolatedInstance(const glm::mat4& a_PreviousTransform, const glm::mat4& a_Transform,
+			const MaterialHandle a_MaterialHandle, const uint32_t a_CustomId) = 0;
+
+		/*
+		 * Add an instance that plays a vertex animation, a_Time seconds after its start.
+		 * The animation has to have been created for a_MeshHandle, the mesh that the instance is drawn with, and is blended between its two nearest frames.
+		 * When the animation has a different amount of vertices than the mesh, the instance is added without the animation.
+		 * Tangents are not animated.
+		 *
+		 * Returns a handle that can be provided to the AddDrawCall() function.
+		 */
+		virtual InstanceDataHandle AddAnimatedInstance(const glm::mat4& a_Transform, const MaterialHandle a_MaterialHandle, const MeshHandle a_MeshHandle,
+			const VertexAnimationHandle a_AnimationHandle, float a_Time, const uint32_t a_CustomId) = 0;
+
+		/*
+		 * Add an instance for every given transform in a hierarchy, using the world matrices from its last Update().
+		 * The world matrices are written directly into the instance data.
+		 *
+		 * Returns the handle of the first instance. The other instances have consecutive handles.
+		 */
+		virtual InstanceDataHandle AddInstances(const TransformHierarchy& a_Hierarchy, const TransformHandle* a_Transforms, uint32_t a_NumInstances,
+			const MaterialHandle a_MaterialHandle, const uint32_t a_CustomId) = 0;
+
 		/*
 		 * Add a draw call to this frame.
 		 * A draw call represents a drawing operation involving geometry and instance data.
@@ -138,6 +227,20 @@ namespace egg
 		 */
 		virtual DrawCallHandle AddDrawCall(MeshHandle a_MeshHandle, const InstanceDataHandle* a_Instances, uint32_t a_InstanceCount) = 0;
 
+		/*
+		 * Add a draw call whose instances are scattered over a surface by the GPU, instead of being added one by one.
+		 * Candidates are placed and culled against the camera in a compute shader, and only the visible ones are drawn.
+		 * The instances never exist on the CPU. They are not counted by GetInstanceCount(), and are not part of draw data captures.
+		 * At most MAX_SCATTERS scattered draw calls can be added per frame, later ones draw nothing.
+		 *
+		 * a_MeshHandle is the handle of the mesh that is drawn for every instance.
+		 * a_MaterialHandle and a_CustomId are used for every instance.
+		 *
+		 * Returns a handle to the newly created draw call, which can be passed to the functions that add draw passes.
+		 */
+		virtual DrawCallHandle AddScatteredDrawCall(MeshHandle a_MeshHandle, const MaterialHandle a_MaterialHandle,
+			const ScatterDistribution& a_Distribution, const uint32_t a_CustomId) = 0;
+
 		/*
 		 * Add a deferred shading draw pass.
 		 * All draw calls in this pass will be shaded and output to the window.
@@ -150,6 +253,56 @@ namespace egg
 		 */
 		virtual DrawPassHandle AddDeferredShadingDrawPass(const DrawCallHandle* a_DrawCalls, uint32_t a_NumDrawCalls) = 0;
 
+		/*
+		 * Draw a terrain into the G-buffer this frame, centered around the camera. Only one terrain is drawn per frame, later calls replace it.
+		 * The terrain is not part of draw data captures.
+		 *
+		 * a_MaterialHandle and a_CustomId are used for the entire terrain. UVs follow the world XZ position.
+		 */
+		virtual void SetTerrain(const std::shared_ptr<EggTerrain>& a_Terrain, const MaterialHandle a_MaterialHandle, const uint32_t a_CustomId) = 0;
+
+		/*
+		 * Immediate-mode debug drawing.
+		 * Debug primitives are drawn after lighting, depth tested against the scene without writing depth.
+		 * All lines and all triangles of a frame are each drawn with a single draw call. Colors are blended using their alpha.
+		 */
+
+		/*
+		 * Add a single debug line between two points in world space.
+		 */
+		virtual void AddDebugLine(const glm::vec3& a_From, const glm::vec3& a_To, const glm::vec4& a_Color) = 0;
+
+		/*
+		 * Add many debug lines of the same color. a_Points contains two points for every line.
+		 */
+		virtual void AddDebugLines(const glm::vec3* a_Points, uint32_t a_NumLines, const glm::vec4& a_Color) = 0;
+
+		/*
+		 * Add a single filled debug triangle. Both sides are drawn.
+		 */
+		virtual void AddDebugTriangle(const glm::vec3& a_A, const glm::vec3& a_B, const glm::vec3& a_C, const glm::vec4& a_Color) = 0;
+
+		/*
+		 * Add the edges of a box. The transform maps the cube from -0.5 to 0.5 onto the box.
+		 */
+		virtual void AddDebugBox(const glm::mat4& a_Transform, const glm::vec4& a_Color) = 0;
+
+		/*
+		 * Add the edges of an axis aligned box.
+		 */
+		virtual void AddDebugAabb(const glm::vec3& a_Min, const glm::vec3& a_Max, const glm::vec4& a_Color) = 0;
+
+		/*
+		 * Add a wire sphere, drawn as a circle around each axis.
+		 */
+		virtual void AddDebugSphere(const glm::vec3& a_Center, float a_Radius, const glm::vec4& a_Color) = 0;
+
+		/*
+		 * Add the edges of a frustum, for example to show the culling volume of a camera.
+		 * Takes the inverse of the view projection matrix, as calculated by Camera::CalculateVPMatrix().
+		 */
+		virtual void AddDebugFrustum(const glm::mat4& a_InverseViewProjection, const glm::vec4& a_Color) = 0;
+
 		/*
 		 * Get the amount of instances that have been added for this frame.
 		 */
@@ -179,6 +332,16 @@ namespace egg
 		 * Get the amount of lights used by this frame.
 		 */
 		virtual uint32_t GetLightCount() const = 0;
+
+		/*
+		 * Get the amount of debug lines added for this frame.
+		 */
+		virtual uint32_t GetDebugLineCount() const = 0;
+
+		/*
+		 * Get the amount of debug triangles added for this frame.
+		 */
+		virtual uint32_t GetDebugTriangleCount() const = 0;
 	};
 
 
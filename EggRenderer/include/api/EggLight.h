@@ -1,7 +1,7 @@
 #pragma once
 #include <cstdint>
 
-#include "Math.h"
+#include <cmath>
 
 namespace egg
 {
@@ -45,13 +45,22 @@ namespace egg
         void SetRadiance(float a_R, float a_G, float a_B);
         void SetRadius(float a_Radius);
 
+        /*
+         * Set how far from a surface toward this light the depth buffer is searched for occluders, in world units.
+         * This gives short range shadows at a fraction of the cost of a shadow map, but only for occluders that are visible on screen.
+         * Lights with a shadow map don't use it. Set to 0 (the default) to disable contact shadows for this light.
+         */
+        void SetContactShadowLength(float a_Length);
+
         void GetPosition(float& a_X, float& a_Y, float& a_Z) const;
         void GetRadiance(float& a_R, float& a_G, float& a_B) const;
         void GetRadius(float& a_Radius) const;
+        void GetContactShadowLength(float& a_Length) const;
 
     private:
         float m_Position[3];
         float m_Radiance[3];
         float m_Radius;
+        float m_ContactShadowLength;
     };
 }
\ No newline at end of file
@@ -1,14 +1,22 @@
 #pragma once
 #include <cstdint>
+#include <future>
+#include <limits>
+#include <vector>
 #include <glm/glm/glm.hpp>
 #include <glm/glm/ext/matrix_transform.hpp>
 #include <string>
 
 #include "EggDrawData.h"
 #include "Camera.h"
+#include "DebugView.h"
 #include "EggMaterial.h"
 #include "EggStaticMesh.h"
+#include "EggTerrain.h"
 #include "EggTexture.h"
+#include "EggVertexAnimation.h"
+#include "FrameStatistics.h"
+#include "MemoryReport.h"
 #include "InputQueue.h"
 
 namespace egg
@@ -16,6 +24,9 @@ namespace egg
     class EggRenderer;
 	class EggDrawData;
 
+	//Returned by custom ID queries for pixels that were not covered by any geometry.
+	constexpr uint32_t INVALID_CUSTOM_ID = std::numeric_limits<uint32_t>::max();
+
 	/*
      * Shape type for basic mesh creation.
      */
@@ -63,6 +74,10 @@ namespace egg
 		//Lock the cursor to the window or not.
 		bool lockCursor = false;
 
+		//Render without a window, through a VK_EXT_headless_surface. Presenting does nothing and no input is received.
+		//Supported by software devices such as SwiftShader and lavapipe. Full-screen is ignored.
+		bool headless = false;
+
 		//Use vsync or not.
 		bool vSync = true;
 
@@ -86,6 +101,81 @@ namespace egg
 
 		//The amount of allocated buffer descriptors.
 		uint32_t maximumBindlessBuffers = 300000;
+
+		//Measure GPU time and pipeline statistics for every render stage and subpass.
+		bool enableGpuProfiling = false;
+
+		//Also measure GPU time for every individual draw pass. Only used when GPU profiling is enabled.
+		bool profileDrawPasses = false;
+
+		//The amount of frames kept in the GPU profiling history.
+		uint32_t gpuProfilingHistorySize = 120;
+
+		//Record CPU zones for the TraceProfiler. Can be toggled later with TraceProfiler::SetEnabled().
+		bool enableCpuTracing = false;
+
+		//The amount of frames kept in the frame statistics history, used for percentiles.
+		uint32_t statisticsHistorySize = 600;
+
+		//Draw the performance HUD over the output from the start. Can be toggled later with the HUD key or SetHudEnabled().
+		bool enableHud = false;
+
+		//Pressing this key toggles the HUD. Presses and releases of this key are not passed on to the input queue.
+		std::int16_t hudToggleKey = EGG_KEY_F3;
+
+		//The size of a HUD font pixel in screen pixels.
+		uint32_t hudScale = 2;
+
+		//The GPU memory reserved for baked vertex animations, in bytes. All animations that exist at the same time have to fit.
+		//Vertex animations are disabled while this is 0.
+		uint64_t vertexAnimationMemory = 0;
+
+		//Share meshes that are created from identical geometry or shape parameters while the first one is still alive, instead of uploading them again.
+		//A CPU copy of the vertices and indices of every uploaded mesh is kept to compare new geometry against, so this costs memory.
+		bool deduplicateMeshes = false;
+
+		//The amount of nested clipmap levels that terrain is drawn with. Every level covers twice the distance of the previous one.
+		//Terrain is disabled while this is 0, and the terrain stage is not created. At most 16 levels are used.
+		uint32_t terrainLevels = 0;
+
+		//The amount of cells along the side of every terrain level. Rounded down to a multiple of 4, and at least 16.
+		uint32_t terrainGridSize = 64;
+
+		//Groups of sphere lights that are smaller than this many pixels on screen are shaded as a single light.
+		//Shadowed lights are never grouped. 0 shades every light on its own.
+		float lightTreeErrorPixels = 0.f;
+
+		//The amount of depth buffer samples taken toward every sphere light that has a contact shadow length.
+		//Set to 0 to disable contact shadows for all lights.
+		uint32_t contactShadowSteps = 12;
+	};
+
+	/*
+	 * GPU time and pipeline statistics measured for a single zone in a frame.
+	 * Pipeline statistics are only gathered for zones that are not nested (m_HasStatistics is true).
+	 */
+	struct GpuZoneTiming
+	{
+		std::string m_Name;							//The render stage, subpass or draw pass that was measured.
+		uint32_t m_Depth = 0;						//How deep this zone is nested. Render stages are at depth 0.
+		double m_Milliseconds = 0.0;				//GPU time between the start and end of the zone.
+
+		bool m_HasStatistics = false;
+		uint64_t m_InputPrimitives = 0;
+		uint64_t m_VertexShaderInvocations = 0;
+		uint64_t m_ClippingPrimitives = 0;
+		uint64_t m_FragmentShaderInvocations = 0;
+		uint64_t m_ComputeShaderInvocations = 0;
+	};
+
+	/*
+	 * All GPU zones measured for a single frame.
+	 */
+	struct GpuFrameTimings
+	{
+		uint32_t m_FrameIndex = 0;					//The index of the frame since the renderer was initialized.
+		double m_TotalMilliseconds = 0.0;			//Sum of all zones at depth 0.
+		std::vector<GpuZoneTiming> m_Zones;			//Zones in the order they were started.
 	};
 
 	/*
@@ -140,6 +230,15 @@ namespace egg
 		 */
 		virtual bool DrawFrame(std::unique_ptr<EggDrawData>& a_DrawData) = 0;
 
+		/*
+		 * Draw the draw data from the last DrawFrame() call again, with a different camera and interpolation factor.
+		 * This allows drawing more often than the simulation updates, without building new draw data for every frame.
+		 * Data that was already uploaded for a swapchain image is reused, so only the first redraw per image uploads.
+		 *
+		 * Returns true when nothing went wrong, also when there is no draw data to redraw yet.
+		 */
+		virtual bool RedrawFrame(const Camera& a_Camera, float a_InterpolationFactor) = 0;
+
 		/*
 		 * Create a new material with the given properties.
 		 */
@@ -178,6 +277,7 @@ namespace egg
 
 		/*
 		 * Create a mesh from the provided data.
+		 * When deduplicateMeshes is enabled, a mesh with identical vertices and indices that is still alive is returned instead of uploading a copy.
 		 */
 		virtual std::shared_ptr<EggStaticMesh> CreateMesh(const StaticMeshCreateInfo& a_MeshCreateInfo) = 0;
 
@@ -186,12 +286,33 @@ namespace egg
 		 */
 		virtual std::vector<std::shared_ptr<EggStaticMesh>> CreateMeshes(const std::vector<StaticMeshCreateInfo>& a_MeshCreateInfos) = 0;
 
+		/*
+		 * Upload a baked vertex animation, for example a skeletal animation that was sampled at a fixed rate at load time.
+		 * Instances added with EggDrawData::AddAnimatedInstance() replace the positions and normals of their mesh with the animation,
+		 * which costs two buffer reads per vertex instead of skinning on the CPU or in compute.
+		 *
+		 * Returns nullptr when the data is invalid, or does not fit in the vertexAnimationMemory that is left.
+		 */
+		virtual std::shared_ptr<EggVertexAnimation> CreateVertexAnimation(const VertexAnimationCreateInfo& a_CreateInfo) = 0;
+
+		/*
+		 * Create a terrain that can be drawn with EggDrawData::SetTerrain().
+		 * Terrain is drawn as nested rings around the camera that are displaced from a heightmap, which is streamed in from the callback as the camera moves.
+		 * The cost of drawing it only depends on the terrainLevels and terrainGridSize settings, not on the size of the world.
+		 * Terrain is only drawn when terrainLevels is larger than 0.
+		 *
+		 * Returns nullptr when the callback is empty or the sample spacing is not positive.
+		 */
+		virtual std::shared_ptr<EggTerrain> CreateTerrain(const TerrainCreateInfo& a_CreateInfo) = 0;
+
 		/*
 		 * Create a mesh of a certain type.
 		 * The transform provided is applied to the vertices themselves.
 		 *
 		 * Note: Unevenly scaling a mesh (x, y, z scale are not equal) will warp normals.
 		 * To e.g. turn a cube into a rectangle, the initial transform can be used to not affect the normals this way.
+		 *
+		 * When deduplicateMeshes is enabled, requesting a shape with the same parameters as a mesh that is still alive returns that mesh.
 		 */
 		virtual std::shared_ptr<EggStaticMesh> CreateMesh(const ShapeCreateInfo& a_ShapeCreateInfo) = 0;
 
@@ -204,6 +325,100 @@ namespace egg
 		 */
 		virtual std::unique_ptr<EggDrawData> CreateDrawData() = 0;
 
+		/*
+		 * Query the custom IDs (see EggDrawData::AddInstance()) visible in a rectangle of pixels on the screen.
+		 * The query is copied from the G-buffer in the next drawn frame, and resolved once that frame has finished on the GPU.
+		 * This never stalls, but the future usually takes one or two frames to become ready.
+		 *
+		 * The result contains the IDs row by row, starting at the top left pixel.
+		 * Pixels that are not covered by any geometry contain INVALID_CUSTOM_ID.
+		 * The rectangle is clamped to the resolution at the time the query is recorded. The result is empty when nothing remains.
+		 */
+		virtual std::future<std::vector<uint32_t>> QueryCustomIds(std::uint32_t a_X, std::uint32_t a_Y, std::uint32_t a_Width = 1, std::uint32_t a_Height = 1) = 0;
+
+		/*
+		 * Get the GPU timings of the most recently finished frames, oldest first.
+		 * Frames are measured when they are drawn, and appear here once the GPU has finished them (usually a few frames later).
+		 * Returns an empty vector when GPU profiling is disabled or not supported by the device.
+		 */
+		virtual std::vector<GpuFrameTimings> GetGpuTimingHistory() const = 0;
+
+		/*
+		 * Get the statistics of the most recently finished frames, oldest first.
+		 * Frames appear here once the GPU has finished them, so that their GPU time is known.
+		 */
+		virtual std::vector<FrameStatistics> GetFrameStatisticsHistory() const = 0;
+
+		/*
+		 * Get the min, max, average and p50/p95/p99 of the most important statistics over the frames in the history.
+		 */
+		virtual FrameStatisticsSummary GetFrameStatisticsSummary() const = 0;
+
+		/*
+		 * Write the statistics of every finished frame to a file, until StopStatisticsStream() is called.
+		 * The file is overwritten. Returns false if it could not be opened.
+		 */
+		virtual bool StartStatisticsStream(const std::string& a_FilePath, StatisticsStreamFormat a_Format) = 0;
+
+		/*
+		 * Stop writing frame statistics to a file, and close it.
+		 */
+		virtual void StopStatisticsStream() = 0;
+
+		/*
+		 * Write the draw data of every drawn frame to a binary capture file, until StopDrawDataCapture() is called.
+		 * The geometry of every mesh is read back from the GPU the first time it is captured, which stalls that frame.
+		 * Captures can be replayed with the EggReplay tool. Returns false if the file could not be opened.
+		 */
+		virtual bool StartDrawDataCapture(const std::string& a_FilePath) = 0;
+
+		/*
+		 * Stop capturing draw data, and close the capture file.
+		 */
+		virtual void StopDrawDataCapture() = 0;
+
+		/*
+		 * Get the live GPU memory per category, the budget and fragmentation of every memory heap,
+		 * and (in debug builds) all meshes, textures and materials that have not been destroyed yet.
+		 * Walks all allocations, so this should not be called every frame.
+		 */
+		virtual MemoryReport GetMemoryReport() const = 0;
+
+		/*
+		 * Write the statistics of the memory allocator to a JSON file.
+		 * When a_Detailed is true, every allocation and free range in every memory block is included.
+		 * Returns false if the file could not be written.
+		 */
+		virtual bool WriteMemoryStatistics(const std::string& a_FilePath, bool a_Detailed) const = 0;
+
+		/*
+		 * Replace the shaded output with a debug view, starting with the next frame. Pass DebugViewMode::NONE to go back to normal shading.
+		 * The debug view pipelines are compiled in the background, so the first frames after startup or a resize may still be shaded normally.
+		 * Returns false if the device does not support debug views, or their pipelines could not be compiled.
+		 * When compiling fails after this returned true, the debug view is turned off again and GetDebugView() returns DebugViewMode::NONE.
+		 */
+		virtual bool SetDebugView(const DebugViewSettings& a_Settings) = 0;
+
+		/*
+		 * Get the debug view that is applied to new frames.
+		 */
+		virtual DebugViewSettings GetDebugView() const = 0;
+
+		/*
+		 * Get the counters of the last finished frame that was drawn with a debug view.
+		 * The counters lag behind by the amount of frames in flight.
+		 */
+		virtual DebugCounters GetDebugCounters() const = 0;
+
+		/*
+		 * Show or hide the performance HUD, starting with the next frame.
+		 */
+		virtual void SetHudEnabled(bool a_Enabled) = 0;
+
+		/*
+		 * Returns true when the performance HUD is drawn.
+		 */
+		virtual bool IsHudEnabled() const = 0;
 	};
 
 }
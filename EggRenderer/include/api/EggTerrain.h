@@ -0,0 +1,29 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+
+namespace egg
+{
+    /*
+     * Struct containing all the information needed to create a terrain.
+     * The terrain is a heightfield on the XZ plane that is streamed around the camera, so it is never stored as a whole.
+     */
+    struct TerrainCreateInfo
+    {
+        //Returns the height of the sample at (a_X, a_Z), in samples of the finest level. Sample (0, 0) is at the world origin.
+        //Called on the render thread for every sample that comes into view, so it has to be cheap and may not call into the renderer.
+        std::function<float(int32_t a_X, int32_t a_Z)> m_HeightCallback;
+
+        float m_SampleSpacing = 1.f;        //World distance between the samples of the finest level.
+        float m_UvScale = 0.1f;             //UVs per world unit, used to tile the material textures.
+    };
+
+    /*
+     * API handle for a terrain.
+     */
+    class EggTerrain
+    {
+    public:
+        virtual ~EggTerrain() = default;
+    };
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+namespace egg
+{
+    /*
+     * Struct containing all the information needed to create a baked vertex animation.
+     * Every frame contains the position and normal of every vertex of the mesh that it animates, in the order of the mesh's vertex buffer.
+     */
+    struct VertexAnimationCreateInfo
+    {
+        const glm::vec3* m_Positions = nullptr;    //m_NumFrames * m_NumVertices positions, one frame after another.
+        const glm::vec3* m_Normals = nullptr;      //Same layout as the positions.
+        uint32_t m_NumVertices = 0;
+        uint32_t m_NumFrames = 0;
+        float m_FramesPerSecond = 30.f;
+        bool m_Loop = true;                        //Wrap around after the last frame, instead of holding it.
+    };
+
+    /*
+     * API handle for a baked vertex animation on the GPU.
+     */
+    class EggVertexAnimation
+    {
+    public:
+        virtual ~EggVertexAnimation() = default;
+    };
+}
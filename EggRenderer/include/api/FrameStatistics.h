@@ -0,0 +1,110 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace egg
+{
+	/*
+	 * Everything the renderer did for a single frame.
+	 * Statistics are published once the GPU has finished the frame, so that the GPU time is known.
+	 */
+	struct FrameStatistics
+	{
+		uint32_t m_FrameIndex = 0;					//The index of the frame since the renderer was initialized.
+
+		//Workload.
+		uint32_t m_NumInstances = 0;				//Instances uploaded for the frame.
+		uint32_t m_NumDrawPasses = 0;				//Draw passes in the draw data.
+		uint32_t m_NumDrawCalls = 0;				//Draw commands recorded into the command buffer, including full-screen passes.
+		uint64_t m_NumTriangles = 0;				//Triangles submitted by all draw commands, counting every instance.
+		uint32_t m_NumLights = 0;					//Area and directional lights.
+		uint32_t m_NumDescriptorUpdates = 0;		//Descriptors written while recording the frame.
+
+		//Bytes uploaded per per-frame buffer.
+		uint64_t m_InstanceBytesUploaded = 0;
+		uint64_t m_MaterialBytesUploaded = 0;
+		uint64_t m_LightBytesUploaded = 0;
+		uint64_t m_IndirectionBytesUploaded = 0;
+		uint64_t m_DebugDrawBytesUploaded = 0;		//Immediate-mode debug lines and triangles.
+		uint64_t m_PreviousTransformBytesUploaded = 0;	//Previous transforms of interpolated instances.
+		uint64_t m_AnimationStateBytesUploaded = 0;		//Frames of instances with a vertex animation.
+
+		//CPU phases of DrawFrame in milliseconds.
+		double m_FenceWaitMilliseconds = 0.0;		//Waiting for the GPU to release the frame's resources.
+		double m_UploadMilliseconds = 0.0;			//Uploading the per-frame buffers.
+		double m_RecordMilliseconds = 0.0;			//Recording the command buffer for all render stages.
+		double m_SubmitMilliseconds = 0.0;			//Submitting, presenting and acquiring the next swap chain image.
+		double m_CpuFrameMilliseconds = 0.0;		//The entire DrawFrame call.
+
+		//GPU time measured with timestamps. Only available when GPU profiling is enabled and supported.
+		bool m_HasGpuTime = false;
+		double m_GpuMilliseconds = 0.0;
+
+		//Time since the input that the frame reflects, in milliseconds. Only available when the draw data was tagged with an input timestamp.
+		bool m_HasInputLatency = false;
+		double m_InputToSubmitMilliseconds = 0.0;		//Until the command buffer was submitted.
+		double m_InputToGpuCompleteMilliseconds = 0.0;	//Until the renderer saw that the GPU finished the frame. This is an upper bound.
+		bool m_HasPresentLatency = false;				//Only when VK_KHR_present_wait is supported.
+		double m_InputToPresentMilliseconds = 0.0;		//Until the frame was presented on screen.
+
+		/*
+		 * The total amount of bytes uploaded for the frame.
+		 */
+		uint64_t GetBytesUploaded() const
+		{
+			return m_InstanceBytesUploaded + m_MaterialBytesUploaded + m_LightBytesUploaded + m_IndirectionBytesUploaded + m_DebugDrawBytesUploaded + m_PreviousTransformBytesUploaded
+				+ m_AnimationStateBytesUploaded;
+		}
+	};
+
+	/*
+	 * The distribution of a single statistic over the frames in the history.
+	 * Percentiles use the nearest rank.
+	 */
+	struct StatisticPercentiles
+	{
+		uint32_t m_NumSamples = 0;
+		double m_Min = 0.0;
+		double m_Max = 0.0;
+		double m_Average = 0.0;
+		double m_P50 = 0.0;
+		double m_P95 = 0.0;
+		double m_P99 = 0.0;
+	};
+
+	/*
+	 * Sort the values and calculate their distribution.
+	 * Used for the frame statistics history, and available to applications that measure their own timings.
+	 */
+	StatisticPercentiles CalculatePercentiles(std::vector<double>& a_Values);
+
+	/*
+	 * Distributions of the most important statistics over the frames in the history.
+	 */
+	struct FrameStatisticsSummary
+	{
+		uint32_t m_NumFrames = 0;
+		StatisticPercentiles m_CpuFrameMilliseconds;
+		StatisticPercentiles m_FenceWaitMilliseconds;
+		StatisticPercentiles m_UploadMilliseconds;
+		StatisticPercentiles m_RecordMilliseconds;
+		StatisticPercentiles m_SubmitMilliseconds;
+		StatisticPercentiles m_GpuMilliseconds;		//Only frames with GPU time are sampled.
+		StatisticPercentiles m_InputToSubmitMilliseconds;		//Only frames with input latency are sampled.
+		StatisticPercentiles m_InputToGpuCompleteMilliseconds;
+		StatisticPercentiles m_InputToPresentMilliseconds;	//Only frames with present latency are sampled.
+		StatisticPercentiles m_DrawCalls;
+		StatisticPercentiles m_Triangles;
+		StatisticPercentiles m_BytesUploaded;
+		StatisticPercentiles m_DescriptorUpdates;
+	};
+
+	/*
+	 * File formats that frame statistics can be streamed to.
+	 */
+	enum class StatisticsStreamFormat
+	{
+		CSV,		//A header row, followed by one row per frame.
+		JSON_LINES	//One JSON object per frame, each on its own line.
+	};
+}
@@ -1,4 +1,5 @@
 #pragma once
+#include <cstdint>
 #include <queue>
 #include <mutex>
 #include <cmath>
@@ -61,6 +62,7 @@ namespace egg
 
 	/*
 	 * A keyboard event contains a key code and information about the type of press.
+	 * The timestamp is the time at which the event was received, from GetTimestampMicroseconds().
 	 */
 	struct KeyboardEvent
 	{
@@ -69,16 +71,19 @@ namespace egg
 		{
 			keyCode = 0;
 			action = KeyboardAction::NONE;
+			timestamp = 0;
 		}
 
-		KeyboardEvent(KeyboardAction action, std::uint16_t keyCode)
+		KeyboardEvent(KeyboardAction action, std::uint16_t keyCode, std::uint64_t timestamp = 0)
 		{
 			this->action = action;
 			this->keyCode = keyCode;
+			this->timestamp = timestamp;
 		}
 
 		std::int16_t keyCode;
 		KeyboardAction action;
+		std::uint64_t timestamp;
 	};
 
 	/*
@@ -86,6 +91,7 @@ namespace egg
 	 * This could be movement or button up/down.
 	 *
 	 * Value contains a value associated with a movement or scroll optionally.
+	 * The timestamp is the time at which the event was received, from GetTimestampMicroseconds().
 	 */
 	struct MouseEvent
 	{
@@ -95,18 +101,21 @@ namespace egg
 			action = MouseAction::NONE;
 			button = MouseButton::NONE;
 			value = 0;
+			timestamp = 0;
 		}
 
-		MouseEvent(MouseAction action, std::float_t value, MouseButton button)
+		MouseEvent(MouseAction action, std::float_t value, MouseButton button, std::uint64_t timestamp = 0)
 		{
 			this->action = action;
 			this->value = value;
 			this->button = button;
+			this->timestamp = timestamp;
 		}
 
 		MouseAction action;
 		MouseButton button;
 		std::float_t value;
+		std::uint64_t timestamp;
 	};
 
 	class InputData
@@ -163,10 +172,31 @@ namespace egg
 		 */
 		ButtonState GetMouseButtonState(MouseButton a_Button) const;
 
+		/*
+		 * Get the timestamp of the oldest event that was taken into this object, or 0 if there were no timestamped events.
+		 * Pass this to EggDrawData::SetInputTimestamp() for the frame that reacts to this input, to measure its latency.
+		 */
+		std::uint64_t GetOldestEventTimestamp() const;
+
+		/*
+		 * Get the timestamp of the most recent event that was taken into this object, or 0 if there were no timestamped events.
+		 */
+		std::uint64_t GetNewestEventTimestamp() const;
+
+	private:
+		/*
+		 * Widen the timestamp range to include the given event timestamp.
+		 */
+		void AddEventTimestamp(std::uint64_t a_Timestamp);
+
 	private:
 		std::queue<KeyboardEvent> m_KeyboardEvents;
 		std::queue<MouseEvent> m_MouseEvents;
 
+		//Range of the event timestamps. Kept separately because events are popped by the application.
+		std::uint64_t m_OldestEventTimestamp;
+		std::uint64_t m_NewestEventTimestamp;
+
 		/*
 		 * Keys may be held down, which means there won't always be an event.
 		 * This enum keeps track of whether a key was pressed briefly or held down.
@@ -0,0 +1,105 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace egg
+{
+	/*
+	 * What a GPU memory allocation is used for.
+	 */
+	enum class MemoryCategory : uint32_t
+	{
+		MESH_GEOMETRY = 0,		//Vertex and index buffers of meshes.
+		FRAME_UPLOAD,			//Per-frame instance, material, light and indirection buffers.
+		G_BUFFER,				//Render targets of the deferred stage.
+		BINDLESS_TEXTURE,		//Textures that are accessed through bindless descriptors.
+		STAGING,				//Temporary CPU visible buffers used to copy resources to the GPU.
+		READBACK,				//GPU to CPU buffers, like picking results.
+		OTHER,
+
+		MAX_ENUM
+	};
+
+	/*
+	 * Live GPU memory allocated for a single category.
+	 */
+	struct MemoryCategoryUsage
+	{
+		uint32_t m_NumAllocations = 0;
+		uint64_t m_Bytes = 0;
+	};
+
+	/*
+	 * Budget and usage of a single memory heap on the GPU.
+	 */
+	struct MemoryHeapReport
+	{
+		uint32_t m_HeapIndex = 0;
+		bool m_DeviceLocal = false;				//True for video memory.
+		uint64_t m_Size = 0;					//The total size of the heap.
+		uint64_t m_Budget = 0;					//Estimated amount of memory available to the application.
+		uint64_t m_Usage = 0;					//Estimated memory used by the application, including memory not allocated by the renderer.
+
+		uint32_t m_NumBlocks = 0;				//Device memory blocks allocated by the renderer.
+		uint32_t m_NumAllocations = 0;			//Allocations placed in those blocks.
+		uint64_t m_BlockBytes = 0;				//Bytes allocated in blocks.
+		uint64_t m_AllocationBytes = 0;			//Bytes used by allocations.
+		uint32_t m_NumUnusedRanges = 0;			//Free ranges between allocations in the blocks.
+		uint64_t m_UnusedBytes = 0;				//Bytes in the blocks that are not used by allocations.
+		uint64_t m_LargestUnusedRange = 0;		//Size of the largest free range.
+
+		//0 when all unused memory is a single range, approaching 1 when it is split into many small ranges.
+		float m_Fragmentation = 0.f;
+	};
+
+	/*
+	 * A mesh, texture or material that has not been destroyed yet.
+	 * Only tracked in debug builds.
+	 */
+	struct LiveResourceInfo
+	{
+		std::string m_Type;						//"StaticMesh", "Texture" or "Material".
+		std::string m_CreationSite;				//The renderer function that created the resource, and the address it was called from.
+		uint32_t m_CreationFrame = 0;			//The renderer frame that was being built when the resource was created.
+	};
+
+	/*
+	 * An overview of all GPU memory used by the renderer.
+	 */
+	struct MemoryReport
+	{
+		MemoryCategoryUsage m_Categories[static_cast<uint32_t>(MemoryCategory::MAX_ENUM)];
+		std::vector<MemoryHeapReport> m_Heaps;
+		std::vector<LiveResourceInfo> m_LiveResources;		//Empty in release builds.
+
+		const MemoryCategoryUsage& GetUsage(MemoryCategory a_Category) const
+		{
+			return m_Categories[static_cast<uint32_t>(a_Category)];
+		}
+	};
+
+	/*
+	 * Get a readable name for a memory category.
+	 */
+	inline const char* GetMemoryCategoryName(MemoryCategory a_Category)
+	{
+		switch (a_Category)
+		{
+		case MemoryCategory::MESH_GEOMETRY:
+			return "Mesh Geometry";
+		case MemoryCategory::FRAME_UPLOAD:
+			return "Frame Upload";
+		case MemoryCategory::G_BUFFER:
+			return "G-Buffer";
+		case MemoryCategory::BINDLESS_TEXTURE:
+			return "Bindless Texture";
+		case MemoryCategory::STAGING:
+			return "Staging";
+		case MemoryCategory::READBACK:
+			return "Readback";
+		default:
+			return "Other";
+		}
+	}
+}
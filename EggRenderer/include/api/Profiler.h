@@ -21,7 +21,7 @@ namespace egg
     * This will print the profiling information.
     */
 #define PROFILING_END(name, timeUnit, info)													\
-float name##_measured_time = name##_timer.Measure(TimeUnit::##timeUnit);					\
+float name##_measured_time = name##_timer.Measure(TimeUnit::timeUnit);					\
 printf("Timings for %s. %s: %f %s.\n", #name, info, name##_measured_time, #timeUnit);		\
 
 //Profiling disabled.
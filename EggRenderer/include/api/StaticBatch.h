@@ -0,0 +1,181 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <glm/glm/glm.hpp>
+
+#include "EggDrawData.h"
+
+namespace egg
+{
+	class EggRenderer;
+
+	struct StaticBatchSettings
+	{
+		//Edge length of the grid cells that instances are grouped in, in world units. Every cell becomes a cluster.
+		float m_ClusterSize = 32.f;
+
+		//The amount of coarser levels above the clusters. Every level merges the nodes of 2x2x2 cells of the level below.
+		uint32_t m_NumLodLevels = 3;
+
+		//A node is drawn with its merged LOD when the camera is further away from it than this many times its cell size.
+		float m_LodDistance = 4.f;
+
+		//Vertices of a LOD are snapped to a grid with this many cells along the edge of its node. Lower values give coarser LODs.
+		uint32_t m_LodResolution = 32;
+	};
+
+	/*
+	 * Merges many small static instances into a few large meshes, so that they are drawn with far fewer draw calls.
+	 *
+	 * Instances are grouped in a grid of clusters by the center of their bounds. The geometry of every cluster is transformed to world space
+	 * and merged into one mesh per material, so materials are still read from the material buffer per draw.
+	 * Clusters are the leaves of a hierarchy: every level above merges 2x2x2 nodes of the level below into a simplified LOD mesh.
+	 * Each frame, distant nodes are drawn with their LOD meshes and near nodes with the meshes of their children.
+	 *
+	 * Building only uses the CPU and can be done offline or at load. Upload() then creates the meshes.
+	 */
+	class StaticBatch
+	{
+	public:
+		StaticBatch();
+
+		/*
+		 * Add geometry that instances can refer to. The vertices and indices are copied.
+		 * Returns the index to pass to AddInstance().
+		 */
+		uint32_t AddSourceMesh(const StaticMeshCreateInfo& a_Mesh);
+
+		/*
+		 * Add a static instance of a source mesh. Instances can't be moved or removed after building.
+		 */
+		void AddInstance(uint32_t a_SourceMesh, const std::shared_ptr<EggMaterial>& a_Material, const glm::mat4& a_Transform);
+
+		/*
+		 * Group the instances into clusters, and merge and simplify the geometry of every node.
+		 * Replaces the result of any previous Build().
+		 */
+		void Build(const StaticBatchSettings& a_Settings);
+
+		/*
+		 * Create the meshes of all nodes. The merged geometry on the CPU is released afterwards.
+		 * Returns false if the meshes could not be created.
+		 */
+		bool Upload(EggRenderer& a_Renderer);
+
+		/*
+		 * Add the meshes for a camera at a_CameraPosition to the draw data, with one instance and draw call per mesh.
+		 * All instances use a_CustomId, as the merged geometry no longer knows which instance it came from.
+		 * a_DrawCalls is overwritten with the added draw calls, to be passed to draw passes and lights with shadows.
+		 */
+		void AddToDrawData(EggDrawData& a_DrawData, const glm::vec3& a_CameraPosition, uint32_t a_CustomId, std::vector<DrawCallHandle>& a_DrawCalls);
+
+		uint32_t GetInstanceCount() const;
+
+		/*
+		 * The amount of clusters, which are the nodes at the lowest level.
+		 */
+		uint32_t GetClusterCount() const;
+
+		/*
+		 * The amount of nodes at all levels, and the amount of meshes they use together.
+		 */
+		uint32_t GetNodeCount() const;
+		uint32_t GetMeshCount() const;
+
+		/*
+		 * The amount of triangles in all meshes of a level, where 0 is the clusters.
+		 */
+		uint64_t GetTriangleCount(uint32_t a_Level) const;
+
+		/*
+		 * The amount of nodes at a level, where 0 is the clusters.
+		 */
+		uint32_t GetNodeCount(uint32_t a_Level) const;
+
+		/*
+		 * Merge all vertices that fall in the same cell of a grid starting at a_Origin, and remove the triangles that collapse.
+		 * This is how the LOD meshes are simplified. Merged vertices are the average of the vertices in their cell.
+		 */
+		static void Simplify(std::vector<Vertex>& a_Vertices, std::vector<uint32_t>& a_Indices, const glm::vec3& a_Origin, float a_CellSize);
+
+	private:
+		struct Geometry
+		{
+			std::vector<Vertex> m_Vertices;
+			std::vector<uint32_t> m_Indices;
+		};
+
+		struct SourceMesh
+		{
+			Geometry m_Geometry;
+			glm::vec3 m_Center;		//Center of the bounds in object space.
+		};
+
+		struct Instance
+		{
+			glm::mat4 m_Transform;
+			uint32_t m_SourceMesh;
+			uint32_t m_Material;
+		};
+
+		/*
+		 * The merged geometry of a node that uses a single material.
+		 */
+		struct Part
+		{
+			uint32_t m_Material;
+			Geometry m_Geometry;					//Released by Upload().
+			uint32_t m_NumTriangles = 0;
+			std::shared_ptr<EggStaticMesh> m_Mesh;	//Null when all triangles were simplified away.
+		};
+
+		struct Node
+		{
+			uint32_t m_Level = 0;
+			glm::ivec3 m_Cell = glm::ivec3(0);		//Grid cell at the node's level.
+			glm::vec3 m_Min = glm::vec3(0.f);		//World space bounds of the geometry.
+			glm::vec3 m_Max = glm::vec3(0.f);
+			std::vector<Part> m_Parts;
+			std::vector<uint32_t> m_Children;
+		};
+
+		/*
+		 * Pack a grid cell into a key for the cell lookups. Every coordinate is stored in 21 bits.
+		 */
+		static uint64_t CellKey(const glm::ivec3& a_Cell);
+
+		/*
+		 * The cell at the level above that contains a_Cell. Rounds towards negative infinity.
+		 */
+		static glm::ivec3 ParentCell(const glm::ivec3& a_Cell);
+
+		/*
+		 * Get the part of a node for a material, adding it when the node does not use the material yet.
+		 */
+		static Part& GetPart(Node& a_Node, uint32_t a_Material);
+
+		/*
+		 * Append the vertices and indices of a_Source to a_Destination.
+		 */
+		static void Append(const Geometry& a_Source, Geometry& a_Destination);
+
+		void AddNode(EggDrawData& a_DrawData, const glm::vec3& a_CameraPosition, uint32_t a_Node, uint32_t a_CustomId, std::vector<DrawCallHandle>& a_DrawCalls);
+
+	private:
+		std::vector<SourceMesh> m_SourceMeshes;
+		std::vector<Instance> m_Instances;
+		std::vector<std::shared_ptr<EggMaterial>> m_Materials;
+		std::unordered_map<const EggMaterial*, uint32_t> m_MaterialLookup;
+
+		StaticBatchSettings m_Settings;
+		std::vector<Node> m_Nodes;				//Sorted by level, clusters first.
+		std::vector<uint32_t> m_Roots;			//Nodes at the highest level.
+		uint32_t m_NumClusters;
+
+		//Reused by every AddToDrawData(), so that adding does not allocate.
+		std::vector<MaterialHandle> m_MaterialHandles;
+		std::vector<uint8_t> m_MaterialAdded;
+	};
+}
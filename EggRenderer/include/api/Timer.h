@@ -1,6 +1,7 @@
 #pragma once
 #include <chrono>
 #include <cmath>
+#include <cstdint>
 
 namespace egg
 {
@@ -41,4 +42,10 @@ namespace egg
 	private:
 		std::chrono::high_resolution_clock::time_point m_Begin;
 	};
+
+	/*
+	 * Get the current time in microseconds, measured with a steady clock from an unspecified starting point.
+	 * Input events and frame latency measurements use this clock, so their timestamps can be compared.
+	 */
+	std::uint64_t GetTimestampMicroseconds();
 }
\ No newline at end of file
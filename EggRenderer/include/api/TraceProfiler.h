@@ -0,0 +1,132 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace egg
+{
+	/*
+	 * Hierarchical CPU trace profiler.
+	 *
+	 * Zones are recorded into a fixed size ring buffer owned by the thread that records them.
+	 * Recording never takes a lock (only the first zone on a new thread registers its buffer), so it can be left enabled.
+	 * When a ring buffer is full, the oldest zones of that thread are overwritten.
+	 *
+	 * The recorded zones can be exported in the Chrome trace event format, which can be opened in chrome://tracing or Perfetto.
+	 */
+	class TraceProfiler
+	{
+	public:
+		//The amount of zones kept per thread.
+		static constexpr uint32_t EVENTS_PER_THREAD = 16384;
+
+		/*
+		 * Enable or disable recording. Zones that were started while disabled are never recorded.
+		 */
+		static void SetEnabled(bool a_Enabled);
+
+		/*
+		 * Returns true if zones are being recorded.
+		 */
+		static bool IsEnabled()
+		{
+			return s_Enabled.load(std::memory_order_relaxed);
+		}
+
+		/*
+		 * Name the calling thread in exported traces.
+		 */
+		static void SetThreadName(const std::string& a_Name);
+
+		/*
+		 * Get the current time in nanoseconds from a steady clock.
+		 */
+		static uint64_t Now();
+
+		/*
+		 * Increment the zone depth of the calling thread, and return the depth before incrementing.
+		 */
+		static uint32_t PushDepth();
+
+		/*
+		 * Decrement the zone depth of the calling thread.
+		 */
+		static void PopDepth();
+
+		/*
+		 * Record a finished zone for the calling thread.
+		 * a_Name has to stay valid until the trace is exported (string literals are ideal).
+		 */
+		static void Record(const char* a_Name, uint64_t a_Start, uint64_t a_End, uint32_t a_Depth);
+
+		/*
+		 * Write all recorded zones of all threads to a Chrome trace JSON file.
+		 * Recording may continue on other threads while exporting.
+		 *
+		 * Returns false if the file could not be written.
+		 */
+		static bool ExportChromeTrace(const std::string& a_FilePath);
+
+		/*
+		 * Forget all zones that have been recorded so far.
+		 */
+		static void Clear();
+
+	private:
+		static inline std::atomic<bool> s_Enabled{ false };
+	};
+
+	/*
+	 * Records a zone from construction until End() is called or it goes out of scope.
+	 * a_Name has to stay valid until the trace is exported (string literals are ideal).
+	 */
+	class TraceZone
+	{
+	public:
+		explicit TraceZone(const char* a_Name) : m_Name(a_Name), m_Start(0), m_Depth(0), m_Active(TraceProfiler::IsEnabled())
+		{
+			if (m_Active)
+			{
+				m_Depth = TraceProfiler::PushDepth();
+				m_Start = TraceProfiler::Now();
+			}
+		}
+
+		~TraceZone()
+		{
+			End();
+		}
+
+		TraceZone(const TraceZone&) = delete;
+		TraceZone& operator =(const TraceZone&) = delete;
+
+		/*
+		 * End this zone before it goes out of scope. Calling this more than once has no effect.
+		 */
+		void End()
+		{
+			if (m_Active)
+			{
+				const auto end = TraceProfiler::Now();
+				TraceProfiler::PopDepth();
+				TraceProfiler::Record(m_Name, m_Start, end, m_Depth);
+				m_Active = false;
+			}
+		}
+
+	private:
+		const char* m_Name;
+		uint64_t m_Start;
+		uint32_t m_Depth;
+		bool m_Active;
+	};
+}
+
+/*
+ * Usage:
+ *
+ * Trace the rest of the current scope: EGG_TRACE_ZONE("My Zone");
+ */
+#define EGG_TRACE_CONCAT_INNER(a, b) a##b
+#define EGG_TRACE_CONCAT(a, b) EGG_TRACE_CONCAT_INNER(a, b)
+#define EGG_TRACE_ZONE(name) egg::TraceZone EGG_TRACE_CONCAT(egg_trace_zone_, __LINE__)(name)
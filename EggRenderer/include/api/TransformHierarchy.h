@@ -0,0 +1,126 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <glm/glm/glm.hpp>
+#include <glm/glm/gtc/quaternion.hpp>
+
+namespace egg
+{
+	class ThreadPool;
+
+	enum class TransformHandle : uint32_t {};
+
+	//Parent of transforms that are at the root of the hierarchy.
+	constexpr TransformHandle NO_PARENT_TRANSFORM = static_cast<TransformHandle>(~0u);
+
+	/*
+	 * A hierarchy of transforms, for example the bones of a skeleton or the parts of a vehicle.
+	 * Every transform has a local translation, rotation and scale relative to its parent. Update() calculates the world matrices.
+	 *
+	 * Data is stored as separate arrays sorted by depth in the hierarchy, so that every level is a contiguous range.
+	 * Only transforms that changed, or whose parent changed, are recalculated. Levels are processed in order, and large levels are split over worker threads.
+	 */
+	class TransformHierarchy
+	{
+	public:
+		//Levels smaller than this are updated on the calling thread.
+		static constexpr uint32_t MIN_NODES_PER_TASK = 1024;
+
+		/*
+		 * Create an empty hierarchy. When a_NumThreads is 0, every update runs on the calling thread.
+		 */
+		TransformHierarchy(uint32_t a_NumThreads = 0);
+		~TransformHierarchy();
+
+		TransformHierarchy(const TransformHierarchy&) = delete;
+		TransformHierarchy& operator =(const TransformHierarchy&) = delete;
+
+		/*
+		 * Add a transform with an identity local transform.
+		 */
+		TransformHandle Create(TransformHandle a_Parent = NO_PARENT_TRANSFORM);
+
+		/*
+		 * Remove a transform. Its children are attached to its parent, keeping their local transforms.
+		 * This searches all transforms for children.
+		 */
+		void Remove(TransformHandle a_Handle);
+
+		/*
+		 * Attach a transform to a new parent, keeping its local transform.
+		 * Returns false if the parent is the transform itself or one of its descendants.
+		 */
+		bool SetParent(TransformHandle a_Handle, TransformHandle a_Parent);
+
+		TransformHandle GetParent(TransformHandle a_Handle) const;
+
+		/*
+		 * Set the local transform relative to the parent.
+		 */
+		void SetLocal(TransformHandle a_Handle, const glm::vec3& a_Translation, const glm::quat& a_Rotation, const glm::vec3& a_Scale);
+		void SetLocalTranslation(TransformHandle a_Handle, const glm::vec3& a_Translation);
+		void SetLocalRotation(TransformHandle a_Handle, const glm::quat& a_Rotation);
+		void SetLocalScale(TransformHandle a_Handle, const glm::vec3& a_Scale);
+
+		glm::vec3 GetLocalTranslation(TransformHandle a_Handle) const;
+		glm::quat GetLocalRotation(TransformHandle a_Handle) const;
+		glm::vec3 GetLocalScale(TransformHandle a_Handle) const;
+
+		/*
+		 * Get the world matrix calculated by the last Update().
+		 */
+		const glm::mat4& GetWorldTransform(TransformHandle a_Handle) const;
+
+		/*
+		 * Recalculate the world matrices of all changed transforms and their descendants.
+		 * Returns the amount of world matrices that were recalculated.
+		 */
+		uint32_t Update();
+
+		uint32_t GetCount() const;
+
+		/*
+		 * The amount of depth levels, as of the last Update().
+		 */
+		uint32_t GetLevelCount() const;
+
+	private:
+		//Marks unused handles, parents of root transforms and removed transforms.
+		static constexpr uint32_t INVALID_INDEX = ~0u;
+
+		/*
+		 * Sort the transforms by depth after transforms were added, removed or attached to a different parent.
+		 */
+		void RebuildLevels();
+
+		/*
+		 * Recalculate the world matrices of the changed transforms in the range [a_Begin, a_End) of a single level.
+		 * Returns the amount of world matrices that were recalculated.
+		 */
+		uint32_t UpdateRange(uint32_t a_Begin, uint32_t a_End);
+
+		uint32_t GetIndex(TransformHandle a_Handle) const;
+
+	private:
+		std::unique_ptr<ThreadPool> m_ThreadPool;	//Null when updating on the calling thread only.
+
+		//Indexed by handle.
+		std::vector<uint32_t> m_HandleIndices;		//Index of the transform in the arrays below, INVALID_INDEX when the handle is unused.
+		std::vector<uint32_t> m_ParentHandles;		//Parent handle, so that the structure survives reordering.
+		std::vector<uint32_t> m_FreeHandles;
+
+		//Indexed by position in the hierarchy. Sorted by depth after every rebuild; new transforms are appended until then.
+		std::vector<uint32_t> m_Handles;			//INVALID_INDEX for transforms removed since the last rebuild.
+		std::vector<uint32_t> m_Parents;			//Index of the parent, INVALID_INDEX for root transforms.
+		std::vector<glm::vec3> m_Translations;
+		std::vector<glm::quat> m_Rotations;
+		std::vector<glm::vec3> m_Scales;
+		std::vector<glm::mat4> m_WorldTransforms;
+		std::vector<uint8_t> m_Dirty;				//Set when the local transform changed. During an update, also set when the world matrix was recalculated.
+
+		std::vector<uint32_t> m_LevelOffsets;		//Start index of every level, followed by the total count.
+		bool m_LevelsChanged;
+		uint32_t m_NumTransforms;
+	};
+}
@@ -0,0 +1,17 @@
+#version 460
+#extension GL_KHR_vulkan_glsl: enable
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec4 inColor;  //Unpacked from RGBA8 by the vertex input.
+
+layout(location = 0) out vec4 outColor;
+
+layout( push_constant ) uniform PushData {
+  mat4 viewProjectionMatrix;    //The same matrix as the geometry pass, so that depth testing against the G-buffer depth lines up.
+} pushData;
+
+void main() 
+{
+    outColor = inColor;
+    gl_Position = pushData.viewProjectionMatrix * vec4(inPosition, 1.0);
+}
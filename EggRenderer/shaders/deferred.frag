@@ -12,6 +12,24 @@ layout(location = 1) out vec4 outNormal;
 layout(location = 2) out vec4 outTangent;
 layout(location = 3) out vec4 outUvsCustomId;
 
+#ifdef DEBUG_VIEW
+#define DEBUG_VIEW_INSTANCE_ID 10u
+#define DEBUG_VIEW_DRAW_CALL_ID 11u
+
+layout(location = 6) in flat uint inInstanceIndex;
+layout(location = 7) in flat uint inDrawCallIndex;
+
+layout( push_constant ) uniform PushData {
+  mat4 viewProjectionMatrix;
+  vec4 data1;                   //x: draw call index, y: debug view mode. Both stored as uint bits.
+  vec4 data2;
+  vec4 data3;
+  vec4 data4;
+} pushData;
+
+layout (set = 1, binding = 0, r32ui) uniform uimage2D overdrawImage;
+#endif
+
 void main() 
 {
     //Pack the material ID into position and normal W components. Both need to be read when shading anyways, so it doesn't matter that it's two reads.
@@ -24,4 +42,16 @@ void main()
     vec2 customIdAsVector = unpackHalf2x16(inCustomId);
     outUvsCustomId.xy = inUvs;   //UVs and mesh ID are combined.
     outUvsCustomId.zw = customIdAsVector; //Interpret the uint as two floats. Use packHalf2x16 to get the uint back.
+
+#ifdef DEBUG_VIEW
+    //Count every rasterized fragment. Writing to an image disables early depth testing, so hidden fragments are counted as well.
+    imageAtomicAdd(overdrawImage, ivec2(gl_FragCoord.xy), 1u);
+
+    //The ID views do not need the tangent, so the IDs are stored in its place.
+    const uint debugViewMode = floatBitsToUint(pushData.data1.y);
+    if(debugViewMode == DEBUG_VIEW_INSTANCE_ID || debugViewMode == DEBUG_VIEW_DRAW_CALL_ID)
+    {
+        outTangent = vec4(unpackHalf2x16(inInstanceIndex), unpackHalf2x16(inDrawCallIndex));
+    }
+#endif
 }
\ No newline at end of file
@@ -1,6 +1,9 @@
 #version 460 core
 #extension GL_KHR_vulkan_glsl: enable
 #extension GL_EXT_nonuniform_qualifier: enable
+#ifdef BUFFER_DEVICE_ADDRESS
+#extension GL_EXT_buffer_reference : require
+#endif
 
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inNormal;
@@ -14,20 +17,74 @@ layout(location = 3) out vec2 outUvs;
 layout(location = 4) out flat uint outMaterialId;
 layout(location = 5) out flat uint outCustomId;
 
-layout( push_constant ) uniform PushData {
-  mat4 viewProjectionMatrix;    //The view projection matrix.
-  vec4 data1;                   //Some data that can be set to whatever.
-  vec4 data2;
-  vec4 data3;
-  vec4 data4;
-} pushData;
+#ifdef DEBUG_VIEW
+layout(location = 6) out flat uint outInstanceIndex;
+layout(location = 7) out flat uint outDrawCallIndex;
+#endif
 
 struct InstanceData
 {
     mat4 transform;
-    uvec4 customData;
+    uvec4 customData;   //Material ID, custom ID, previous transform index + 1 (0 when not interpolated), animation state index + 1 (0 when not animated).
+};
+
+struct AnimationState
+{
+    uint firstFrameVertex;  //Index of vertex 0 of both frames in the vertex animation storage.
+    uint secondFrameVertex;
+    float blend;
+    uint padding;
+};
+
+//Baked frames of all vertex animations. Not a per-frame buffer, so it is read through a descriptor in both variants.
+//Every vertex is a position, followed by a normal packed as four signed normalized bytes.
+layout (std430, binding = 4) readonly buffer VertexAnimationStorage
+{
+    vec4 vertices[];
+
+} vertexAnimationStorage;
+
+#ifdef BUFFER_DEVICE_ADDRESS
+//The per-frame buffers are read through addresses in the push constants, so no descriptors are written every frame.
+layout (std430, buffer_reference, buffer_reference_align = 4) readonly buffer IndirectionBuffer
+{
+    uint indices[];
+};
+
+layout (std430, buffer_reference, buffer_reference_align = 16) readonly buffer InstanceDataBuffer
+{
+    InstanceData instances[];
+};
+
+layout (std430, buffer_reference, buffer_reference_align = 16) readonly buffer PreviousTransformBuffer
+{
+    mat4 transforms[];
 };
 
+layout (std430, buffer_reference, buffer_reference_align = 16) readonly buffer AnimationStateBuffer
+{
+    AnimationState states[];
+};
+
+layout( push_constant ) uniform PushData {
+  mat4 viewProjectionMatrix;    //The view projection matrix.
+  vec4 data1;                   //x: draw call index, y: debug view mode, z: interpolation factor, w: instance offset. x, y and w are stored as uint bits.
+  IndirectionBuffer indirectionBuffer;
+  InstanceDataBuffer instanceBuffer;
+  PreviousTransformBuffer previousTransformBuffer;
+  AnimationStateBuffer animationStateBuffer;
+} pushData;
+
+#define indirectionBuffer pushData.indirectionBuffer
+#define instanceBuffer pushData.instanceBuffer
+#define previousTransformBuffer pushData.previousTransformBuffer
+#define animationStateBuffer pushData.animationStateBuffer
+#else
+layout( push_constant ) uniform PushData {
+  mat4 viewProjectionMatrix;    //The view projection matrix.
+  vec4 data1;                   //x: draw call index, y: debug view mode, z: interpolation factor, w: instance offset. x, y and w are stored as uint bits.
+} pushData;
+
 layout (std430, binding = 0) buffer IndirectionBuffer
 {
     uint indices[];
@@ -40,19 +97,61 @@ layout (std430, binding = 1) buffer InstanceDataBuffer
 
 } instanceBuffer;
 
+layout (std430, binding = 2) buffer PreviousTransformBuffer
+{
+    mat4 transforms[];
+
+} previousTransformBuffer;
+
+layout (std430, binding = 3) buffer AnimationStateBuffer
+{
+    AnimationState states[];
+
+} animationStateBuffer;
+#endif
+
 void main() 
 {
     //gl_InstanceIndex is equal to the index of the instance data indirection buffer thanks to the instance offset in the draw command.
-    InstanceData instance = instanceBuffer.instances[indirectionBuffer.indices[gl_InstanceIndex]];
+    //Scattered draws on devices without drawIndirectFirstInstance start at instance 0, and push their offset in data1.w instead.
+    uint indirection = uint(gl_InstanceIndex) + floatBitsToUint(pushData.data1.w);
+    InstanceData instance = instanceBuffer.instances[indirectionBuffer.indices[indirection]];
 
     //The material and mesh ID are stored in the matrix to save uploading bandwidth.
     outMaterialId = instance.customData[0];   
     outCustomId = instance.customData[1]; 
 
-    outNormal = vec3(instance.transform * vec4(inNormal, 0.0));
-    vec4 pos = instance.transform * vec4(inPosition, 1.0);
+#ifdef DEBUG_VIEW
+    //The debug view pipeline pushes the index of the draw call before every draw.
+    outInstanceIndex = indirectionBuffer.indices[indirection];
+    outDrawCallIndex = floatBitsToUint(pushData.data1.x);
+#endif
+
+    //Interpolated instances blend from their previous transform, using the factor of the frame being drawn.
+    //A linear blend of the matrices is close enough to a decomposed blend for the small changes between simulation ticks.
+    mat4 transform = instance.transform;
+    if(instance.customData[2] != 0)
+    {
+        mat4 previous = previousTransformBuffer.transforms[instance.customData[2] - 1];
+        transform = previous + (transform - previous) * pushData.data1.z;
+    }
+
+    //Animated instances replace the position and normal with a blend of two baked frames.
+    vec3 position = inPosition;
+    vec3 normal = inNormal;
+    if(instance.customData[3] != 0)
+    {
+        AnimationState state = animationStateBuffer.states[instance.customData[3] - 1];
+        vec4 first = vertexAnimationStorage.vertices[state.firstFrameVertex + gl_VertexIndex];
+        vec4 second = vertexAnimationStorage.vertices[state.secondFrameVertex + gl_VertexIndex];
+        position = mix(first.xyz, second.xyz, state.blend);
+        normal = normalize(mix(unpackSnorm4x8(floatBitsToUint(first.w)).xyz, unpackSnorm4x8(floatBitsToUint(second.w)).xyz, state.blend));
+    }
+
+    outNormal = vec3(transform * vec4(normal, 0.0));
+    vec4 pos = transform * vec4(position, 1.0);
     outPosition = vec3(pos);
-    outTangent = vec4(((instance.transform * vec4(inTangent.xyz, 0.f)).xyz), inTangent.w);
+    outTangent = vec4(((transform * vec4(inTangent.xyz, 0.f)).xyz), inTangent.w);
 
     gl_Position = pushData.viewProjectionMatrix * pos;
 }
\ No newline at end of file
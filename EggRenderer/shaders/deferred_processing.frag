@@ -1,5 +1,8 @@
 #version 460
 #extension GL_KHR_vulkan_glsl: enable
+#ifdef BUFFER_DEVICE_ADDRESS
+#extension GL_EXT_buffer_reference : require
+#endif
 
 layout (input_attachment_index = 0, set = 0, binding = 0) uniform subpassInput inDepth;
 layout (input_attachment_index = 1, set = 0, binding = 1) uniform subpassInput inPosition;
@@ -7,11 +10,8 @@ layout (input_attachment_index = 2, set = 0, binding = 2) uniform subpassInput i
 layout (input_attachment_index = 3, set = 0, binding = 3) uniform subpassInput inTangent;
 layout (input_attachment_index = 4, set = 0, binding = 4) uniform subpassInput inUvCustomId;
 
-layout (std430, binding = 0, set = 1) buffer MaterialData
-{
-    uvec4 data[];
-
-} materialBuffer;
+//The same depth as inDepth, sampled at other pixels to march contact shadows.
+layout (set = 0, binding = 5) uniform sampler2D depthSampler;
 
 struct PackedLightData
 {
@@ -20,6 +20,24 @@ struct PackedLightData
     ivec4 data2;
 };
 
+#ifdef BUFFER_DEVICE_ADDRESS
+//The shading buffers are read through addresses in the push constants, so no descriptors are written every frame.
+layout (std430, buffer_reference, buffer_reference_align = 16) readonly buffer MaterialData
+{
+    uvec4 data[];
+};
+
+layout (std430, buffer_reference, buffer_reference_align = 16) readonly buffer LightData
+{
+    PackedLightData data[];
+};
+#else
+layout (std430, binding = 0, set = 1) buffer MaterialData
+{
+    uvec4 data[];
+
+} materialBuffer;
+
 layout (std430, binding = 1, set = 1) buffer AreaLights
 {
     PackedLightData data[];
@@ -31,13 +49,64 @@ layout (std430, binding = 2, set = 1) buffer DirectionalLights
     PackedLightData data[];
 
 } directionalLightBuffer;
+#endif
 
 //Push data
 layout( push_constant ) uniform PushData {
   vec4 cameraPosition;
-  uvec4 lightCounts;
+  uvec4 lightCounts;    //x: area lights, y: directional lights, z: contact shadow steps.
+#ifdef DEBUG_VIEW
+  uvec4 debugData;      //x: debug view mode, y: heatmap maximum.
+#endif
+#ifdef BUFFER_DEVICE_ADDRESS
+  layout(offset = 48) MaterialData materialBuffer;
+  LightData areaLightBuffer;
+  LightData directionalLightBuffer;
+#endif
+  layout(offset = 72) vec2 depthToDistance;     //Turns a depth value d into the distance along the view direction: y / (d + x).
+  vec4 screenProjection[3];                     //The rows of the view projection matrix that give clip space x, y and w. Y is negated, so that y / w maps to texture coordinates of the flipped viewport.
 } pushData;
 
+#ifdef BUFFER_DEVICE_ADDRESS
+#define materialBuffer pushData.materialBuffer
+#define areaLightBuffer pushData.areaLightBuffer
+#define directionalLightBuffer pushData.directionalLightBuffer
+#endif
+
+#ifdef DEBUG_VIEW
+//Must match egg::DebugViewMode.
+#define DEBUG_VIEW_LIGHT_COUNT 1u
+#define DEBUG_VIEW_OVERDRAW 2u
+#define DEBUG_VIEW_DEPTH 3u
+#define DEBUG_VIEW_POSITION 4u
+#define DEBUG_VIEW_NORMAL 5u
+#define DEBUG_VIEW_TANGENT 6u
+#define DEBUG_VIEW_UV 7u
+#define DEBUG_VIEW_MATERIAL_ID 8u
+#define DEBUG_VIEW_CUSTOM_ID 9u
+#define DEBUG_VIEW_INSTANCE_ID 10u
+#define DEBUG_VIEW_DRAW_CALL_ID 11u
+
+layout (set = 2, binding = 0, r32ui) uniform readonly uimage2D overdrawImage;
+
+//Counters for the whole frame, read back by the CPU. 64-bit totals are split into a low and a high part.
+layout (std430, set = 2, binding = 1) buffer DebugCounters
+{
+    uint shadedPixels;
+    uint lightsEvaluatedLow;
+    uint lightsEvaluatedHigh;
+    uint maxLightsPerPixel;
+    uint fragmentsLow;
+    uint fragmentsHigh;
+    uint maxOverdraw;
+    uint padding;
+
+} debugCounters;
+
+vec3 heatmap(uint value, uint maximum);
+vec3 idColor(uint id);
+#endif
+
 layout(location = 5) out vec4 outColor;         //In the framebuffer, the output is the 5th bound buffer.
 
 //Calculate the BRDF.
@@ -47,6 +116,9 @@ float GeometrySchlickGGX(float sNormalToCamDot, float roughness);
 float GeometrySmith(vec3 surfaceNormal, vec3 toCameraDir, vec3 toLightDir, float roughness);
 vec3 FresnelSchlick(float cosTheta, vec3 f0);
 
+//March the depth buffer toward a light.
+bool isContactShadowed(vec3 position, vec3 toLightDir, float rayLength);
+
 void main() 
 {
     //Temporary light and material values;
@@ -86,6 +158,10 @@ void main()
 
     PackedLightData currentLight;
 
+#ifdef DEBUG_VIEW
+    uint numLightsEvaluated = 0;
+#endif
+
     //Loop over the area lights.
     for(uint i = 0; i < pushData.lightCounts.x; ++i)
     {
@@ -94,6 +170,7 @@ void main()
         #define lightPosition (currentLight.data0.xyz)
         #define lightRadius (currentLight.data0.w)
         #define lightRadiance (currentLight.data1.xyz)
+        #define contactShadowLength (currentLight.data1.w)
         #define shadowIndex (currentLight.data2.x)
         const float lightRadiusSquared = lightRadius * lightRadius;
         const float lightArea = 3.1415926536 * lightRadiusSquared;     //Area is equal to the disk projected onto the pixel hemisphere (surface of the circle with the radius of the light).
@@ -117,6 +194,11 @@ void main()
             //Do not append light if occluded.
             shadowed = false;
         }
+        //Lights without a shadow map can search the depth buffer for nearby occluders instead. The ray never goes past the light.
+        else if(cosI > 0.f && contactShadowLength > 0.0 && pushData.lightCounts.z != 0u)
+        {
+            shadowed = isContactShadowed(position.xyz, pixelToLightDir, min(contactShadowLength, lDistance));
+        }
 
         //Only shade when the light is visible.
         if (cosI > 0.f && !shadowed)
@@ -132,6 +214,9 @@ void main()
             //brdf is the light transport based on the microfacet normal.
             //SolidAngle is the surface of the light projected onto the hemisphere of the shaded pixel (scale according to distance and such).
             finalLightColor += brdf * solidAngle * cosI * lightRadiance;
+#ifdef DEBUG_VIEW
+            ++numLightsEvaluated;
+#endif
         }
     }
 
@@ -168,12 +253,127 @@ void main()
             //brdf is the light transport based on the microfacet normal.
             //SolidAngle is the surface of the light projected onto the hemisphere of the shaded pixel (scale according to distance and such).
             finalLightColor += brdf * cosI * lightRadiance;
+#ifdef DEBUG_VIEW
+            ++numLightsEvaluated;
+#endif
         }
     }
 
     //Finally write to the output buffer.
     outColor = vec4(finalLightColor, 1.0);
+
+#ifdef DEBUG_VIEW
+    const uint overdraw = imageLoad(overdrawImage, ivec2(gl_FragCoord.xy)).r;
+
+    //Add this pixel to the frame counters. The high part of a total is incremented when the low part wraps around.
+    atomicAdd(debugCounters.shadedPixels, 1u);
+    atomicMax(debugCounters.maxLightsPerPixel, numLightsEvaluated);
+    atomicMax(debugCounters.maxOverdraw, overdraw);
+    const uint previousLights = atomicAdd(debugCounters.lightsEvaluatedLow, numLightsEvaluated);
+    if(previousLights + numLightsEvaluated < previousLights)
+    {
+        atomicAdd(debugCounters.lightsEvaluatedHigh, 1u);
+    }
+    const uint previousFragments = atomicAdd(debugCounters.fragmentsLow, overdraw);
+    if(previousFragments + overdraw < previousFragments)
+    {
+        atomicAdd(debugCounters.fragmentsHigh, 1u);
+    }
+
+    switch(pushData.debugData.x)
+    {
+    case DEBUG_VIEW_LIGHT_COUNT:
+        outColor = vec4(heatmap(numLightsEvaluated, pushData.debugData.y), 1.0);
+        break;
+    case DEBUG_VIEW_OVERDRAW:
+        outColor = vec4(heatmap(overdraw, pushData.debugData.y), 1.0);
+        break;
+    case DEBUG_VIEW_DEPTH:
+        outColor = vec4(vec3(depth), 1.0);
+        break;
+    case DEBUG_VIEW_POSITION:
+        outColor = vec4(fract(position.xyz), 1.0);     //Repeats every unit, so that world positions stay visible far from the origin.
+        break;
+    case DEBUG_VIEW_NORMAL:
+        outColor = vec4(normal * 0.5 + 0.5, 1.0);
+        break;
+    case DEBUG_VIEW_TANGENT:
+        outColor = vec4(tangent * 0.5 + 0.5, 1.0);
+        break;
+    case DEBUG_VIEW_UV:
+        outColor = vec4(uvCustomId.xy, 0.0, 1.0);
+        break;
+    case DEBUG_VIEW_MATERIAL_ID:
+        outColor = vec4(idColor(materialId), 1.0);
+        break;
+    case DEBUG_VIEW_CUSTOM_ID:
+        outColor = vec4(idColor(customId), 1.0);
+        break;
+    case DEBUG_VIEW_INSTANCE_ID:
+        outColor = vec4(idColor(packHalf2x16(tangentRaw.xy)), 1.0);  //The geometry pass stores the IDs in place of the tangent.
+        break;
+    case DEBUG_VIEW_DRAW_CALL_ID:
+        outColor = vec4(idColor(packHalf2x16(tangentRaw.zw)), 1.0);
+        break;
+    }
+#endif
+}
+
+bool isContactShadowed(vec3 position, vec3 toLightDir, float rayLength)
+{
+    const uint steps = pushData.lightCounts.z;
+    const float stepLength = rayLength / float(steps);
+
+    //Offset the samples by a different amount for every pixel, which turns banding into noise.
+    const float jitter = fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715))));
+
+    for(uint i = 0; i < steps; ++i)
+    {
+        const vec4 rayPosition = vec4(position + toLightDir * (stepLength * (float(i) + jitter)), 1.0);
+        const float rayDistance = dot(pushData.screenProjection[2], rayPosition);
+
+        //Nothing is known about the depth behind the camera or outside the screen.
+        if(rayDistance <= 0.0) break;
+        const vec2 uv = vec2(dot(pushData.screenProjection[0], rayPosition), dot(pushData.screenProjection[1], rayPosition)) / rayDistance * 0.5 + 0.5;
+        if(any(lessThan(uv, vec2(0.0))) || any(greaterThan(uv, vec2(1.0)))) break;
+
+        const float depth = textureLod(depthSampler, uv, 0.0).r;
+        const float sceneDistance = pushData.depthToDistance.y / (depth + pushData.depthToDistance.x);
+
+        //The ray is occluded when it passes behind a surface. Occluders are assumed to be as thick as the ray is long, so that rays passing far behind an object are not occluded.
+        //The minimum difference leaves room for the half precision positions in the G-buffer.
+        const float difference = rayDistance - sceneDistance;
+        if(difference > 0.005 * rayDistance && difference < rayLength)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+#ifdef DEBUG_VIEW
+//Blue at zero, through cyan, green and yellow, to red at the maximum. Values above the maximum are white.
+vec3 heatmap(uint value, uint maximum)
+{
+    if(value > maximum)
+    {
+        return vec3(1.0);
+    }
+    const float t = float(value) / float(max(maximum, 1u));
+    return clamp(vec3(1.5 - abs(4.0 * t - 3.0), 1.5 - abs(4.0 * t - 2.0), 1.5 - abs(4.0 * t - 1.0)), 0.0, 1.0);
+}
+
+//Hash the ID so that consecutive IDs get very different colors.
+vec3 idColor(uint id)
+{
+    id ^= id >> 16;
+    id *= 0x7feb352du;
+    id ^= id >> 15;
+    id *= 0x846ca68bu;
+    id ^= id >> 16;
+    return unpackUnorm4x8(id).rgb;
 }
+#endif
 
 //BRDF below.
 
@@ -0,0 +1,20 @@
+#version 460
+#extension GL_KHR_vulkan_glsl: enable
+
+layout(location = 0) in vec2 inAtlasTexel;
+layout(location = 1) in vec4 inColor;
+
+layout(location = 0) out vec4 outColor;
+
+//Single channel atlas with a coverage of either 0 or 1.
+layout(set = 0, binding = 0) uniform sampler2D fontAtlas;
+
+void main() 
+{
+    const float coverage = texelFetch(fontAtlas, ivec2(inAtlasTexel), 0).r;
+    if(coverage == 0.0)
+    {
+        discard;
+    }
+    outColor = vec4(inColor.rgb, inColor.a * coverage);
+}
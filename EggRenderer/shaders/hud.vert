@@ -0,0 +1,41 @@
+#version 460
+#extension GL_KHR_vulkan_glsl: enable
+
+//Every instance is a single glyph quad.
+layout(location = 0) in vec4 inRect;        //Top left corner and size in pixels.
+layout(location = 1) in uint inGlyph;       //ASCII code of the glyph in the font atlas.
+layout(location = 2) in vec4 inColor;
+
+layout(location = 0) out vec2 outAtlasTexel;
+layout(location = 1) out vec4 outColor;
+
+layout( push_constant ) uniform PushData {
+  vec2 inverseResolution;                   //One over the output resolution in pixels.
+  uvec2 atlasGlyphs;                        //x: first glyph in the atlas, y: glyphs per atlas row.
+} pushData;
+
+#define GLYPH_SIZE 8.0
+
+//Two triangles forming a quad.
+vec2 corners[6] = vec2[](
+    vec2(0.0, 0.0),
+    vec2(1.0, 0.0),
+    vec2(0.0, 1.0),
+    vec2(1.0, 0.0),
+    vec2(1.0, 1.0),
+    vec2(0.0, 1.0)
+);
+
+void main() 
+{
+    const vec2 corner = corners[gl_VertexIndex];
+
+    //Pixels to normalized device coordinates. Vulkan has Y pointing down, same as the pixel coordinates.
+    const vec2 pixel = inRect.xy + corner * inRect.zw;
+    gl_Position = vec4(pixel * pushData.inverseResolution * 2.0 - 1.0, 0.0, 1.0);
+
+    const uint atlasIndex = inGlyph - pushData.atlasGlyphs.x;
+    const vec2 cell = vec2(atlasIndex % pushData.atlasGlyphs.y, atlasIndex / pushData.atlasGlyphs.y);
+    outAtlasTexel = (cell + corner) * GLYPH_SIZE;
+    outColor = inColor;
+}
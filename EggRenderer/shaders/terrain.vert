@@ -0,0 +1,101 @@
+#version 460 core
+#extension GL_KHR_vulkan_glsl: enable
+
+//Must match PackedTerrainData::MAX_LEVELS.
+#define MAX_LEVELS 16
+
+//The same outputs as deferred.vert, so that the G-buffer is written by deferred.frag.
+layout(location = 0) out vec3 outPosition;
+layout(location = 1) out vec3 outNormal;
+layout(location = 2) out vec4 outTangent;
+layout(location = 3) out vec2 outUvs;
+layout(location = 4) out flat uint outMaterialId;
+layout(location = 5) out flat uint outCustomId;
+
+//A layer of heights for every level. Sample s of a level is stored in texel s modulo the size.
+layout(set = 0, binding = 0) uniform sampler2DArray heightmap;
+
+layout(std430, set = 0, binding = 1) readonly buffer TerrainBuffer
+{
+    vec4 scale;                         //x: finest sample spacing, y: UVs per world unit, z: width of the morph region in cells.
+    uvec4 settings;                     //x: cells per level, y: heightmap size in texels, z: amount of levels, w: material ID.
+    uvec4 ids;                          //x: custom ID.
+    ivec4 levels[MAX_LEVELS];           //xy: center of every level in its own samples, zw: the texel that stores the first sample of its window.
+    uvec4 levelOrder[MAX_LEVELS / 4];   //The level of every instance, four per element.
+} terrain;
+
+layout(push_constant) uniform PushData
+{
+    mat4 viewProjectionMatrix;
+} pushData;
+
+float FetchHeight(ivec2 a_Sample, uint a_Level)
+{
+    //Relative to the start of the window the sample is never negative, which keeps the modulo defined.
+    int size = int(terrain.settings.y);
+    ivec4 level = terrain.levels[a_Level];
+    ivec2 texel = (a_Sample - (level.xy - size / 2) + level.zw) % size;
+    return texelFetch(heightmap, ivec3(texel, int(a_Level)), 0).r;
+}
+
+vec3 CalculateNormal(ivec2 a_Sample, uint a_Level, float a_Spacing)
+{
+    float left = FetchHeight(a_Sample - ivec2(1, 0), a_Level);
+    float right = FetchHeight(a_Sample + ivec2(1, 0), a_Level);
+    float back = FetchHeight(a_Sample - ivec2(0, 1), a_Level);
+    float front = FetchHeight(a_Sample + ivec2(0, 1), a_Level);
+    return normalize(vec3(left - right, 2.0 * a_Spacing, back - front));
+}
+
+void main()
+{
+    uint instance = uint(gl_InstanceIndex);
+    uint level = terrain.levelOrder[instance / 4][instance % 4];
+    uint gridSize = terrain.settings.x;
+
+    //There is no vertex buffer, the grid position follows from the index.
+    uint vertex = uint(gl_VertexIndex);
+    ivec2 grid = ivec2(vertex % (gridSize + 1), vertex / (gridSize + 1));
+    int halfGrid = int(gridSize / 2);
+    ivec2 levelSample = terrain.levels[level].xy - halfGrid + grid;
+
+    float spacing = terrain.scale.x * float(1u << level);
+    float height = FetchHeight(levelSample, level);
+    vec3 normal = CalculateNormal(levelSample, level, spacing);
+
+    //Near the outside, vertices morph to the surface of the next level, so that both meet without cracks.
+    //The next level only has every other sample, and the samples in between lie halfway along the edges of its triangles.
+    if (level + 1 < terrain.settings.z)
+    {
+        float morphWidth = terrain.scale.z;
+        vec2 distance = abs(vec2(grid - halfGrid));
+        float morph = clamp((max(distance.x, distance.y) - (float(halfGrid) - 1.0 - morphWidth)) / morphWidth, 0.0, 1.0);
+        if (morph > 0.0)
+        {
+            uint coarseLevel = level + 1;
+            ivec2 coarseMin = levelSample >> 1;
+            ivec2 coarseMax = (levelSample + 1) >> 1;
+            float coarseHeight = 0.25 * (
+                FetchHeight(ivec2(coarseMin.x, coarseMin.y), coarseLevel) + FetchHeight(ivec2(coarseMax.x, coarseMin.y), coarseLevel) +
+                FetchHeight(ivec2(coarseMin.x, coarseMax.y), coarseLevel) + FetchHeight(ivec2(coarseMax.x, coarseMax.y), coarseLevel));
+            vec3 coarseNormal =
+                CalculateNormal(ivec2(coarseMin.x, coarseMin.y), coarseLevel, 2.0 * spacing) + CalculateNormal(ivec2(coarseMax.x, coarseMin.y), coarseLevel, 2.0 * spacing) +
+                CalculateNormal(ivec2(coarseMin.x, coarseMax.y), coarseLevel, 2.0 * spacing) + CalculateNormal(ivec2(coarseMax.x, coarseMax.y), coarseLevel, 2.0 * spacing);
+
+            height = mix(height, coarseHeight, morph);
+            normal = normalize(mix(normal, normalize(coarseNormal), morph));
+        }
+    }
+
+    vec3 position = vec3(float(levelSample.x) * spacing, height, float(levelSample.y) * spacing);
+
+    //UVs follow the world position, with the tangent along X and the bitangent along Z.
+    outPosition = position;
+    outNormal = normal;
+    outTangent = vec4(normalize(vec3(normal.y, -normal.x, 0.0)), -1.0);
+    outUvs = position.xz * terrain.scale.y;
+    outMaterialId = terrain.settings.w;
+    outCustomId = terrain.ids.x;
+
+    gl_Position = pushData.viewProjectionMatrix * vec4(position, 1.0);
+}
@@ -1,9 +1,15 @@
 #include "DrawData.h"
 #include "Resources.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <glm/glm/gtc/constants.hpp>
+#include <glm/glm/gtc/packing.hpp>
+
 namespace egg
 {
-    DrawData::DrawData() : m_NumDirectionalShadows(0), m_NumAreaShadows(0)
+    DrawData::DrawData() : m_InputTimestamp(0), m_InterpolationFactor(1.f), m_SubmissionId(0), m_NumScatterCandidates(0), m_TerrainMaterial(0), m_TerrainCustomId(0), m_NumDirectionalShadows(0), m_NumAreaShadows(0)
     {
 
     }
@@ -13,6 +19,16 @@ namespace egg
 		m_Camera = a_Camera;
 	}
 
+	void DrawData::SetInputTimestamp(uint64_t a_Timestamp)
+	{
+		m_InputTimestamp = a_Timestamp;
+	}
+
+	void DrawData::SetInterpolationFactor(float a_Factor)
+	{
+		m_InterpolationFactor = a_Factor;
+	}
+
     LightHandle DrawData::AddLight(const DirectionalLight& a_Light)
     {
         return AddLightWithShadow(a_Light, nullptr, 0);
@@ -38,6 +54,12 @@ namespace egg
         return static_cast<MeshHandle>(m_Meshes.size() - 1);
     }
 
+    VertexAnimationHandle DrawData::AddVertexAnimation(const std::shared_ptr<EggVertexAnimation>& a_Animation)
+    {
+        m_VertexAnimations.push_back(a_Animation);
+        return static_cast<VertexAnimationHandle>(m_VertexAnimations.size() - 1);
+    }
+
     InstanceDataHandle DrawData::AddInstance(const glm::mat4& a_Transform, const MaterialHandle a_MaterialHandle,
         const uint32_t a_CustomId)
     {
@@ -49,10 +71,87 @@ namespace egg
         instance.m_Transform = a_Transform;
         instance.m_MaterialId = static_cast<uint32_t>(a_MaterialHandle);
         instance.m_CustomId = a_CustomId;
+        instance.m_PreviousTransformIndex = 0;
+        instance.m_AnimationStateIndex = 0;
         
         return static_cast<InstanceDataHandle>(m_PackedInstanceData.size() - 1);
     }
 
+    InstanceDataHandle DrawData::AddInterpolatedInstance(const glm::mat4& a_PreviousTransform, const glm::mat4& a_Transform,
+        const MaterialHandle a_MaterialHandle, const uint32_t a_CustomId)
+    {
+        const auto handle = AddInstance(a_Transform, a_MaterialHandle, a_CustomId);
+
+        //Instances without a previous transform use 0, so the index is offset by one.
+        m_PreviousTransforms.push_back(a_PreviousTransform);
+        m_PackedInstanceData.back().m_PreviousTransformIndex = static_cast<uint32_t>(m_PreviousTransforms.size());
+        return handle;
+    }
+
+    InstanceDataHandle DrawData::AddAnimatedInstance(const glm::mat4& a_Transform, const MaterialHandle a_MaterialHandle, const MeshHandle a_MeshHandle,
+        const VertexAnimationHandle a_AnimationHandle, float a_Time, const uint32_t a_CustomId)
+    {
+        assert(static_cast<uint32_t>(a_MeshHandle) < m_Meshes.size() && "Invalid mesh provided!");
+        assert(static_cast<uint32_t>(a_AnimationHandle) < m_VertexAnimations.size() && "Animation handle refers to an animation that was not added!");
+        const auto& mesh = static_cast<const StaticMesh&>(*m_Meshes[static_cast<uint32_t>(a_MeshHandle)]);
+        const auto& animation = static_cast<const VertexAnimation&>(*m_VertexAnimations[static_cast<uint32_t>(a_AnimationHandle)]);
+        const auto handle = AddInstance(a_Transform, a_MaterialHandle, a_CustomId);
+
+        //The shader reads the animation at the index of every vertex of the mesh, so other meshes would read past the animation.
+        if (mesh.GetNumVertices() != animation.GetNumVertices())
+        {
+            printf("Vertex animation with %u vertices added for a mesh with %u vertices! The instance is drawn without the animation.\n",
+                animation.GetNumVertices(), static_cast<uint32_t>(mesh.GetNumVertices()));
+            return handle;
+        }
+
+        //Find the frames on both sides of the time. Looping animations blend from the last frame back into the first.
+        const float numFrames = static_cast<float>(animation.GetNumFrames());
+        float frame = a_Time * animation.GetFramesPerSecond();
+        if (animation.IsLooping())
+        {
+            frame = frame - glm::floor(frame / numFrames) * numFrames;
+        }
+        else
+        {
+            frame = glm::clamp(frame, 0.f, numFrames - 1.f);
+        }
+        const uint32_t first = std::min(static_cast<uint32_t>(frame), animation.GetNumFrames() - 1);
+        const uint32_t second = (first + 1) % animation.GetNumFrames();
+
+        PackedAnimationState state;
+        state.m_FirstFrameVertex = animation.GetFirstVertex() + first * animation.GetNumVertices();
+        state.m_SecondFrameVertex = animation.GetFirstVertex() + second * animation.GetNumVertices();
+        state.m_Blend = frame - static_cast<float>(first);
+        state.m_Padding = 0;
+        m_AnimationStates.push_back(state);
+
+        //Instances without an animation use 0, so the index is offset by one.
+        m_PackedInstanceData.back().m_AnimationStateIndex = static_cast<uint32_t>(m_AnimationStates.size());
+        return handle;
+    }
+
+    InstanceDataHandle DrawData::AddInstances(const TransformHierarchy& a_Hierarchy, const TransformHandle* a_Transforms, uint32_t a_NumInstances,
+        const MaterialHandle a_MaterialHandle, const uint32_t a_CustomId)
+    {
+        assert(static_cast<uint32_t>(a_MaterialHandle) < m_PackedMaterialData.size() && "Material handle referes to a material that was not added!");
+
+        //Grow once, then fill the new instances in place.
+        const size_t first = m_PackedInstanceData.size();
+        m_PackedInstanceData.resize(first + a_NumInstances);
+        PackedInstanceData* instances = m_PackedInstanceData.data() + first;
+        for (uint32_t i = 0; i < a_NumInstances; ++i)
+        {
+            instances[i].m_Transform = a_Hierarchy.GetWorldTransform(a_Transforms[i]);
+            instances[i].m_MaterialId = static_cast<uint32_t>(a_MaterialHandle);
+            instances[i].m_CustomId = a_CustomId;
+            instances[i].m_PreviousTransformIndex = 0;
+            instances[i].m_AnimationStateIndex = 0;
+        }
+
+        return static_cast<InstanceDataHandle>(first);
+    }
+
     DrawCallHandle DrawData::AddDrawCall(MeshHandle a_MeshHandle, const InstanceDataHandle* a_Instances,
         uint32_t a_InstanceCount)
     {
@@ -70,7 +169,63 @@ namespace egg
         //Create a draw call after adding the instance data indices to the indirection buffer.
         const uint32_t indirectionBufferOffset = static_cast<uint32_t>(m_IndirectionBuffer.size());
         m_IndirectionBuffer.insert(m_IndirectionBuffer.end(), reinterpret_cast<const uint32_t*>(&a_Instances[0]), reinterpret_cast<const uint32_t*> (&a_Instances[a_InstanceCount]));
-        m_DrawCalls.push_back(DrawCall{static_cast<uint32_t>(a_MeshHandle), indirectionBufferOffset, a_InstanceCount});
+        m_DrawCalls.push_back(DrawCall{static_cast<uint32_t>(a_MeshHandle), indirectionBufferOffset, a_InstanceCount, 0});
+        return static_cast<DrawCallHandle>(m_DrawCalls.size() - 1);
+    }
+
+    DrawCallHandle DrawData::AddScatteredDrawCall(MeshHandle a_MeshHandle, const MaterialHandle a_MaterialHandle,
+        const ScatterDistribution& a_Distribution, const uint32_t a_CustomId)
+    {
+        assert(static_cast<uint32_t>(a_MeshHandle) < m_Meshes.size() && "Invalid mesh provided!");
+        assert(static_cast<uint32_t>(a_MaterialHandle) < m_PackedMaterialData.size() && "Material handle referes to a material that was not added!");
+
+        //Every scatter has its own indirect draw command, and only a fixed amount of those exists.
+        if (m_Scatters.size() >= MAX_SCATTERS)
+        {
+            printf("Too many scattered draw calls in a single frame! The draw call will not draw anything.\n");
+            m_DrawCalls.push_back(DrawCall{ static_cast<uint32_t>(a_MeshHandle), 0, 0, 0 });
+            return static_cast<DrawCallHandle>(m_DrawCalls.size() - 1);
+        }
+
+        const auto& mesh = static_cast<const StaticMesh&>(*m_Meshes[static_cast<uint32_t>(a_MeshHandle)]);
+
+        PackedScatterData scatter{};
+        scatter.m_Transform = a_Distribution.m_Transform;
+        scatter.m_Area = glm::vec4(a_Distribution.m_AreaSize, 0.f, mesh.GetBounds().m_Radius);
+        scatter.m_Ranges = glm::vec4(a_Distribution.m_ScaleRange, a_Distribution.m_RotationRange);
+        scatter.m_Surface.w = static_cast<uint32_t>(a_MeshHandle);
+
+        double numCandidates = 0.0;
+        if (a_Distribution.m_Surface == ScatterSurface::MESH)
+        {
+            assert(static_cast<uint32_t>(a_Distribution.m_SurfaceMesh) < m_Meshes.size() && "Invalid surface mesh provided!");
+            const auto& surface = static_cast<const StaticMesh&>(*m_Meshes[static_cast<uint32_t>(a_Distribution.m_SurfaceMesh)]);
+            const auto numTriangles = static_cast<uint32_t>(surface.GetNumIndices() / 3);
+
+            //Candidates pick a triangle uniformly, and are kept with a chance of its area relative to the largest triangle.
+            //That takes more candidates than instances, but needs no per-triangle data on the GPU.
+            scatter.m_Area.z = surface.GetBounds().m_MaxTriangleArea;
+            scatter.m_Counts.z = numTriangles;
+            scatter.m_Counts.w = a_Distribution.m_AlignToSurface ? 1 : 0;
+            scatter.m_Surface.x = static_cast<uint32_t>(surface.GetIndexBufferOffset() / sizeof(uint32_t));
+            scatter.m_Surface.y = static_cast<uint32_t>(surface.GetVertexBufferOffset() / sizeof(uint32_t));
+            scatter.m_Surface.z = static_cast<uint32_t>(a_Distribution.m_SurfaceMesh);
+            numCandidates = static_cast<double>(a_Distribution.m_Density) * scatter.m_Area.z * numTriangles;
+        }
+        else
+        {
+            numCandidates = static_cast<double>(a_Distribution.m_Density) * a_Distribution.m_AreaSize.x * a_Distribution.m_AreaSize.y;
+        }
+
+        //Space for every candidate is reserved in the scatter output buffers, as any of them may be visible.
+        const double maxCandidates = std::min(a_Distribution.m_MaxInstances, PackedScatterData::MAX_CANDIDATES);
+        scatter.m_Counts.x = static_cast<uint32_t>(std::min(std::max(0.0, std::ceil(numCandidates)), maxCandidates));
+        scatter.m_Counts.y = a_Distribution.m_Seed;
+        scatter.m_Output = glm::uvec4(m_NumScatterCandidates, m_NumScatterCandidates, static_cast<uint32_t>(a_MaterialHandle), a_CustomId);
+        m_NumScatterCandidates += scatter.m_Counts.x;
+        m_Scatters.push_back(scatter);
+
+        m_DrawCalls.push_back(DrawCall{ static_cast<uint32_t>(a_MeshHandle), 0, 0, static_cast<uint32_t>(m_Scatters.size()) });
         return static_cast<DrawCallHandle>(m_DrawCalls.size() - 1);
     }
 
@@ -91,6 +246,16 @@ namespace egg
         return static_cast<DrawPassHandle>(m_DrawPasses.size() - 1);
     }
 
+    void DrawData::SetTerrain(const std::shared_ptr<EggTerrain>& a_Terrain, const MaterialHandle a_MaterialHandle, const uint32_t a_CustomId)
+    {
+        assert(a_Terrain != nullptr && "Invalid terrain provided!");
+        assert(static_cast<uint32_t>(a_MaterialHandle) < m_PackedMaterialData.size() && "Material handle referes to a material that was not added!");
+
+        m_Terrain = std::static_pointer_cast<Terrain>(a_Terrain);
+        m_TerrainMaterial = static_cast<uint32_t>(a_MaterialHandle);
+        m_TerrainCustomId = a_CustomId;
+    }
+
     uint32_t DrawData::GetInstanceCount() const
     {
         return static_cast<uint32_t>(m_PackedInstanceData.size());
@@ -121,6 +286,14 @@ namespace egg
 		return static_cast<uint32_t>(m_PackedDirectionalLightData.size() + m_PackedAreaLightData.size());
     }
 
+    void DrawData::PackLights(std::vector<PackedLightData>& a_Output) const
+    {
+        a_Output.clear();
+        a_Output.reserve(m_PackedAreaLightData.size() + m_PackedDirectionalLightData.size());
+        a_Output.insert(a_Output.end(), m_PackedAreaLightData.begin(), m_PackedAreaLightData.end());
+        a_Output.insert(a_Output.end(), m_PackedDirectionalLightData.begin(), m_PackedDirectionalLightData.end());
+    }
+
     LightHandle DrawData::AddLightWithShadow(const DirectionalLight& a_Light, const DrawCallHandle* a_ShadowDrawCalls,
         uint32_t a_NumDrawCalls)
     {
@@ -163,7 +336,7 @@ namespace egg
     {
         auto data = PackedLightData{
 {a_Light.m_Position[0], a_Light.m_Position[1], a_Light.m_Position[2], a_Light.m_Radius},
-{a_Light.m_Radiance[0], a_Light.m_Radiance[1], a_Light.m_Radiance[2], 0.f } };
+{a_Light.m_Radiance[0], a_Light.m_Radiance[1], a_Light.m_Radiance[2], a_Light.m_ContactShadowLength } };
         data.m_ShadowIndex = -1;
 
         const auto index = static_cast<uint32_t>(m_PackedAreaLightData.size()) - 1;
@@ -193,4 +366,123 @@ namespace egg
         m_PackedAreaLightData.emplace_back(data);
         return handle;
     }
+
+    uint32_t DrawData::GetDebugLineCount() const
+    {
+        return static_cast<uint32_t>(m_DebugLineVertices.size() / 2);
+    }
+
+    uint32_t DrawData::GetDebugTriangleCount() const
+    {
+        return static_cast<uint32_t>(m_DebugTriangleVertices.size() / 3);
+    }
+
+    void DrawData::AddDebugLine(const glm::vec3& a_From, const glm::vec3& a_To, const glm::vec4& a_Color)
+    {
+        const uint32_t color = glm::packUnorm4x8(a_Color);
+        m_DebugLineVertices.push_back(PackedDebugVertex{ a_From, color });
+        m_DebugLineVertices.push_back(PackedDebugVertex{ a_To, color });
+    }
+
+    void DrawData::AddDebugLines(const glm::vec3* a_Points, uint32_t a_NumLines, const glm::vec4& a_Color)
+    {
+        const uint32_t color = glm::packUnorm4x8(a_Color);
+        const size_t numVertices = static_cast<size_t>(a_NumLines) * 2;
+
+        //Resize once and fill in place, so that large batches don't reallocate per line.
+        const size_t start = m_DebugLineVertices.size();
+        m_DebugLineVertices.resize(start + numVertices);
+        PackedDebugVertex* output = &m_DebugLineVertices[start];
+        for (size_t i = 0; i < numVertices; ++i)
+        {
+            output[i].m_Position = a_Points[i];
+            output[i].m_Color = color;
+        }
+    }
+
+    void DrawData::AddDebugTriangle(const glm::vec3& a_A, const glm::vec3& a_B, const glm::vec3& a_C, const glm::vec4& a_Color)
+    {
+        const uint32_t color = glm::packUnorm4x8(a_Color);
+        m_DebugTriangleVertices.push_back(PackedDebugVertex{ a_A, color });
+        m_DebugTriangleVertices.push_back(PackedDebugVertex{ a_B, color });
+        m_DebugTriangleVertices.push_back(PackedDebugVertex{ a_C, color });
+    }
+
+    void DrawData::AddDebugBox(const glm::mat4& a_Transform, const glm::vec4& a_Color)
+    {
+        glm::vec3 corners[8];
+        for (uint32_t i = 0; i < 8; ++i)
+        {
+            const glm::vec4 local((i & 1) ? 0.5f : -0.5f, (i & 2) ? 0.5f : -0.5f, (i & 4) ? 0.5f : -0.5f, 1.f);
+            corners[i] = glm::vec3(a_Transform * local);
+        }
+        AddDebugBoxEdges(corners, glm::packUnorm4x8(a_Color));
+    }
+
+    void DrawData::AddDebugAabb(const glm::vec3& a_Min, const glm::vec3& a_Max, const glm::vec4& a_Color)
+    {
+        glm::vec3 corners[8];
+        for (uint32_t i = 0; i < 8; ++i)
+        {
+            corners[i] = glm::vec3((i & 1) ? a_Max.x : a_Min.x, (i & 2) ? a_Max.y : a_Min.y, (i & 4) ? a_Max.z : a_Min.z);
+        }
+        AddDebugBoxEdges(corners, glm::packUnorm4x8(a_Color));
+    }
+
+    void DrawData::AddDebugSphere(const glm::vec3& a_Center, float a_Radius, const glm::vec4& a_Color)
+    {
+        //The amount of line segments per circle.
+        constexpr uint32_t NUM_SEGMENTS = 32;
+
+        const uint32_t color = glm::packUnorm4x8(a_Color);
+        const size_t start = m_DebugLineVertices.size();
+        m_DebugLineVertices.resize(start + NUM_SEGMENTS * 3 * 2);
+        PackedDebugVertex* output = &m_DebugLineVertices[start];
+
+        for (uint32_t segment = 0; segment < NUM_SEGMENTS; ++segment)
+        {
+            const float angle0 = glm::two_pi<float>() * static_cast<float>(segment) / NUM_SEGMENTS;
+            const float angle1 = glm::two_pi<float>() * static_cast<float>(segment + 1) / NUM_SEGMENTS;
+            const glm::vec2 point0 = glm::vec2(glm::cos(angle0), glm::sin(angle0)) * a_Radius;
+            const glm::vec2 point1 = glm::vec2(glm::cos(angle1), glm::sin(angle1)) * a_Radius;
+
+            //One circle around every axis.
+            *output++ = PackedDebugVertex{ a_Center + glm::vec3(0.f, point0.x, point0.y), color };
+            *output++ = PackedDebugVertex{ a_Center + glm::vec3(0.f, point1.x, point1.y), color };
+            *output++ = PackedDebugVertex{ a_Center + glm::vec3(point0.x, 0.f, point0.y), color };
+            *output++ = PackedDebugVertex{ a_Center + glm::vec3(point1.x, 0.f, point1.y), color };
+            *output++ = PackedDebugVertex{ a_Center + glm::vec3(point0.x, point0.y, 0.f), color };
+            *output++ = PackedDebugVertex{ a_Center + glm::vec3(point1.x, point1.y, 0.f), color };
+        }
+    }
+
+    void DrawData::AddDebugFrustum(const glm::mat4& a_InverseViewProjection, const glm::vec4& a_Color)
+    {
+        //Unproject the corners of the clip space cube. GLM uses a depth range of -1 to 1.
+        glm::vec3 corners[8];
+        for (uint32_t i = 0; i < 8; ++i)
+        {
+            const glm::vec4 clip((i & 1) ? 1.f : -1.f, (i & 2) ? 1.f : -1.f, (i & 4) ? 1.f : -1.f, 1.f);
+            const glm::vec4 world = a_InverseViewProjection * clip;
+            corners[i] = glm::vec3(world) / world.w;
+        }
+        AddDebugBoxEdges(corners, glm::packUnorm4x8(a_Color));
+    }
+
+    void DrawData::AddDebugBoxEdges(const glm::vec3* a_Corners, uint32_t a_Color)
+    {
+        //Every edge connects two corners that differ in a single bit.
+        static constexpr uint32_t EDGES[12][2] =
+        {
+            { 0, 1 }, { 2, 3 }, { 4, 5 }, { 6, 7 },     //Along x.
+            { 0, 2 }, { 1, 3 }, { 4, 6 }, { 5, 7 },     //Along y.
+            { 0, 4 }, { 1, 5 }, { 2, 6 }, { 3, 7 }      //Along z.
+        };
+
+        for (const auto& edge : EDGES)
+        {
+            m_DebugLineVertices.push_back(PackedDebugVertex{ a_Corners[edge[0]], a_Color });
+            m_DebugLineVertices.push_back(PackedDebugVertex{ a_Corners[edge[1]], a_Color });
+        }
+    }
 }
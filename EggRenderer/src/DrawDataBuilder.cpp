@@ -1,9 +1,251 @@
 #include "api/DrawDataBuilder.h"
 
-#include "Resources.h"
-#include "DrawData.h"
+#include <cassert>
 
 namespace egg
 {
+	DrawDataBuilder::DrawDataBuilder() : m_NumBuckets(0), m_NumObjects(0)
+	{
+	}
 
+	RenderObjectHandle DrawDataBuilder::Add(const std::shared_ptr<EggStaticMesh>& a_Mesh, const std::shared_ptr<EggMaterial>& a_Material,
+		const glm::mat4& a_Transform, uint32_t a_CustomId)
+	{
+		assert(a_Mesh != nullptr && a_Material != nullptr && "Objects need a mesh and a material!");
+
+		uint32_t handle;
+		if (!m_FreeHandles.empty())
+		{
+			handle = m_FreeHandles.back();
+			m_FreeHandles.pop_back();
+		}
+		else
+		{
+			handle = static_cast<uint32_t>(m_Objects.size());
+			m_Objects.emplace_back();
+		}
+
+		const uint32_t bucketIndex = AcquireBucket(a_Mesh);
+		auto& bucket = m_Buckets[bucketIndex];
+		m_Objects[handle] = ObjectLocation{ bucketIndex, static_cast<uint32_t>(bucket.m_Handles.size()) };
+		bucket.m_Transforms.push_back(a_Transform);
+		bucket.m_Materials.push_back(AcquireMaterial(a_Material));
+		bucket.m_CustomIds.push_back(a_CustomId);
+		bucket.m_Handles.push_back(handle);
+
+		++m_NumObjects;
+		return static_cast<RenderObjectHandle>(handle);
+	}
+
+	void DrawDataBuilder::Remove(RenderObjectHandle a_Handle)
+	{
+		const uint32_t handle = static_cast<uint32_t>(a_Handle);
+		const ObjectLocation location = GetLocation(a_Handle);
+		auto& bucket = m_Buckets[location.m_Bucket];
+		ReleaseMaterial(bucket.m_Materials[location.m_Index]);
+
+		//Move the last object of the bucket into the gap.
+		const uint32_t last = static_cast<uint32_t>(bucket.m_Handles.size()) - 1;
+		if (location.m_Index != last)
+		{
+			bucket.m_Transforms[location.m_Index] = bucket.m_Transforms[last];
+			bucket.m_Materials[location.m_Index] = bucket.m_Materials[last];
+			bucket.m_CustomIds[location.m_Index] = bucket.m_CustomIds[last];
+			bucket.m_Handles[location.m_Index] = bucket.m_Handles[last];
+			m_Objects[bucket.m_Handles[last]].m_Index = location.m_Index;
+		}
+		bucket.m_Transforms.pop_back();
+		bucket.m_Materials.pop_back();
+		bucket.m_CustomIds.pop_back();
+		bucket.m_Handles.pop_back();
+
+		//Release the mesh once no object uses it. The bucket keeps its memory for the next mesh.
+		if (bucket.m_Handles.empty())
+		{
+			m_BucketLookup.erase(bucket.m_Mesh.get());
+			bucket.m_Mesh = nullptr;
+			m_FreeBuckets.push_back(location.m_Bucket);
+			--m_NumBuckets;
+		}
+
+		m_Objects[handle] = ObjectLocation{};
+		m_FreeHandles.push_back(handle);
+		--m_NumObjects;
+	}
+
+	void DrawDataBuilder::Clear()
+	{
+		m_FreeBuckets.clear();
+		for (uint32_t i = 0; i < m_Buckets.size(); ++i)
+		{
+			auto& bucket = m_Buckets[i];
+			bucket.m_Mesh = nullptr;
+			bucket.m_Transforms.clear();
+			bucket.m_Materials.clear();
+			bucket.m_CustomIds.clear();
+			bucket.m_Handles.clear();
+			m_FreeBuckets.push_back(i);
+		}
+		m_BucketLookup.clear();
+		m_NumBuckets = 0;
+
+		m_Materials.clear();
+		m_MaterialLookup.clear();
+		m_FreeMaterials.clear();
+
+		m_Objects.clear();
+		m_FreeHandles.clear();
+		m_NumObjects = 0;
+	}
+
+	void DrawDataBuilder::SetTransform(RenderObjectHandle a_Handle, const glm::mat4& a_Transform)
+	{
+		const auto& location = GetLocation(a_Handle);
+		m_Buckets[location.m_Bucket].m_Transforms[location.m_Index] = a_Transform;
+	}
+
+	void DrawDataBuilder::SetMaterial(RenderObjectHandle a_Handle, const std::shared_ptr<EggMaterial>& a_Material)
+	{
+		assert(a_Material != nullptr && "Objects need a material!");
+		const auto& location = GetLocation(a_Handle);
+		auto& material = m_Buckets[location.m_Bucket].m_Materials[location.m_Index];
+
+		//Acquire before releasing, so that the entry is not freed when the material does not change.
+		const uint32_t entry = AcquireMaterial(a_Material);
+		ReleaseMaterial(material);
+		material = entry;
+	}
+
+	void DrawDataBuilder::SetCustomId(RenderObjectHandle a_Handle, uint32_t a_CustomId)
+	{
+		const auto& location = GetLocation(a_Handle);
+		m_Buckets[location.m_Bucket].m_CustomIds[location.m_Index] = a_CustomId;
+	}
+
+	const glm::mat4& DrawDataBuilder::GetTransform(RenderObjectHandle a_Handle) const
+	{
+		const auto& location = GetLocation(a_Handle);
+		return m_Buckets[location.m_Bucket].m_Transforms[location.m_Index];
+	}
+
+	void DrawDataBuilder::Build(EggDrawData& a_DrawData, std::vector<DrawCallHandle>& a_DrawCalls)
+	{
+		a_DrawCalls.clear();
+
+		//Every material that is in use is added once.
+		m_MaterialHandles.resize(m_Materials.size());
+		for (size_t i = 0; i < m_Materials.size(); ++i)
+		{
+			if (m_Materials[i].m_Material != nullptr)
+			{
+				m_MaterialHandles[i] = a_DrawData.AddMaterial(m_Materials[i].m_Material);
+			}
+		}
+
+		//Instances of a bucket are added in order, so every draw call refers to a contiguous range of instances.
+		for (const auto& bucket : m_Buckets)
+		{
+			if (bucket.m_Mesh == nullptr)
+			{
+				continue;
+			}
+
+			const auto numInstances = static_cast<uint32_t>(bucket.m_Handles.size());
+			m_InstanceHandles.resize(numInstances);
+			for (uint32_t i = 0; i < numInstances; ++i)
+			{
+				m_InstanceHandles[i] = a_DrawData.AddInstance(bucket.m_Transforms[i], m_MaterialHandles[bucket.m_Materials[i]], bucket.m_CustomIds[i]);
+			}
+
+			const auto meshHandle = a_DrawData.AddMesh(bucket.m_Mesh);
+			a_DrawCalls.push_back(a_DrawData.AddDrawCall(meshHandle, m_InstanceHandles.data(), numInstances));
+		}
+	}
+
+	uint32_t DrawDataBuilder::GetObjectCount() const
+	{
+		return m_NumObjects;
+	}
+
+	uint32_t DrawDataBuilder::GetMeshCount() const
+	{
+		return m_NumBuckets;
+	}
+
+	uint32_t DrawDataBuilder::GetMaterialCount() const
+	{
+		return static_cast<uint32_t>(m_MaterialLookup.size());
+	}
+
+	uint32_t DrawDataBuilder::AcquireBucket(const std::shared_ptr<EggStaticMesh>& a_Mesh)
+	{
+		const auto found = m_BucketLookup.find(a_Mesh.get());
+		if (found != m_BucketLookup.end())
+		{
+			return found->second;
+		}
+
+		uint32_t index;
+		if (!m_FreeBuckets.empty())
+		{
+			index = m_FreeBuckets.back();
+			m_FreeBuckets.pop_back();
+		}
+		else
+		{
+			index = static_cast<uint32_t>(m_Buckets.size());
+			m_Buckets.emplace_back();
+		}
+
+		m_Buckets[index].m_Mesh = a_Mesh;
+		m_BucketLookup.emplace(a_Mesh.get(), index);
+		++m_NumBuckets;
+		return index;
+	}
+
+	uint32_t DrawDataBuilder::AcquireMaterial(const std::shared_ptr<EggMaterial>& a_Material)
+	{
+		const auto found = m_MaterialLookup.find(a_Material.get());
+		if (found != m_MaterialLookup.end())
+		{
+			++m_Materials[found->second].m_NumUsers;
+			return found->second;
+		}
+
+		uint32_t index;
+		if (!m_FreeMaterials.empty())
+		{
+			index = m_FreeMaterials.back();
+			m_FreeMaterials.pop_back();
+		}
+		else
+		{
+			index = static_cast<uint32_t>(m_Materials.size());
+			m_Materials.emplace_back();
+		}
+
+		m_Materials[index].m_Material = a_Material;
+		m_Materials[index].m_NumUsers = 1;
+		m_MaterialLookup.emplace(a_Material.get(), index);
+		return index;
+	}
+
+	void DrawDataBuilder::ReleaseMaterial(uint32_t a_Entry)
+	{
+		auto& entry = m_Materials[a_Entry];
+		assert(entry.m_NumUsers > 0 && "Material released more often than acquired!");
+		if (--entry.m_NumUsers == 0)
+		{
+			m_MaterialLookup.erase(entry.m_Material.get());
+			entry.m_Material = nullptr;
+			m_FreeMaterials.push_back(a_Entry);
+		}
+	}
+
+	const DrawDataBuilder::ObjectLocation& DrawDataBuilder::GetLocation(RenderObjectHandle a_Handle) const
+	{
+		const uint32_t handle = static_cast<uint32_t>(a_Handle);
+		assert(handle < m_Objects.size() && m_Objects[handle].m_Bucket != INVALID_INDEX && "Invalid render object handle!");
+		return m_Objects[handle];
+	}
 }
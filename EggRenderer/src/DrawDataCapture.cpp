@@ -0,0 +1,583 @@
+#include "DrawDataCapture.h"
+
+#include <cstdio>
+#include <cstring>
+
+#include "DrawData.h"
+#include "Resources.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace egg
+{
+	namespace
+	{
+		constexpr size_t CHUNK_ALIGNMENT = 16;
+
+		size_t AlignChunkSize(size_t a_Size)
+		{
+			return (a_Size + CHUNK_ALIGNMENT - 1) & ~(CHUNK_ALIGNMENT - 1);
+		}
+
+		/*
+		 * Fixed size part of a stored draw pass. Followed by m_NumDrawCalls draw call indices.
+		 */
+		struct CapturePass
+		{
+			uint32_t m_Type;
+			uint32_t m_LightType;
+			uint32_t m_LightIndex;
+			uint32_t m_NumDrawCalls;
+		};
+
+		template<typename T>
+		void Append(std::vector<uint8_t>& a_Payload, const T* a_Data, size_t a_Count)
+		{
+			if (a_Count == 0)
+			{
+				return;
+			}
+			const auto offset = a_Payload.size();
+			a_Payload.resize(offset + sizeof(T) * a_Count);
+			memcpy(a_Payload.data() + offset, a_Data, sizeof(T) * a_Count);
+		}
+
+		template<typename T>
+		void Append(std::vector<uint8_t>& a_Payload, const T& a_Value)
+		{
+			Append(a_Payload, &a_Value, 1);
+		}
+
+		void AppendPasses(std::vector<uint8_t>& a_Payload, const std::vector<DrawPass>& a_Passes)
+		{
+			for (const auto& pass : a_Passes)
+			{
+				CapturePass stored{};
+				stored.m_Type = static_cast<uint32_t>(pass.m_Type);
+				stored.m_NumDrawCalls = static_cast<uint32_t>(pass.m_DrawCalls.size());
+				if (pass.m_Type == DrawPassType::SHADOW_GENERATION)
+				{
+					stored.m_LightType = static_cast<uint32_t>(pass.m_LightHandle.m_Type);
+					stored.m_LightIndex = pass.m_LightHandle.m_Index;
+				}
+				Append(a_Payload, stored);
+				Append(a_Payload, pass.m_DrawCalls.data(), pass.m_DrawCalls.size());
+			}
+		}
+
+		/*
+		 * Reads consecutive arrays out of a mapped chunk, failing once the chunk runs out.
+		 */
+		class ChunkReader
+		{
+		public:
+			ChunkReader(const uint8_t* a_Data, size_t a_Size) : m_Data(a_Data), m_Size(a_Size), m_Offset(0) {}
+
+			template<typename T>
+			bool Read(std::vector<T>& a_Output, size_t a_Count)
+			{
+				if (sizeof(T) * a_Count > m_Size - m_Offset)
+				{
+					return false;
+				}
+				a_Output.resize(a_Count);
+				if (a_Count != 0)
+				{
+					memcpy(a_Output.data(), m_Data + m_Offset, sizeof(T) * a_Count);
+				}
+				m_Offset += sizeof(T) * a_Count;
+				return true;
+			}
+
+			template<typename T>
+			bool Read(T& a_Output)
+			{
+				if (sizeof(T) > m_Size - m_Offset)
+				{
+					return false;
+				}
+				memcpy(&a_Output, m_Data + m_Offset, sizeof(T));
+				m_Offset += sizeof(T);
+				return true;
+			}
+
+			bool ReadPasses(std::vector<DrawPass>& a_Output, uint32_t a_Count, uint32_t a_NumDrawCalls)
+			{
+				a_Output.resize(a_Count);
+				for (auto& pass : a_Output)
+				{
+					CapturePass stored;
+					if (!Read(stored) || !Read(pass.m_DrawCalls, stored.m_NumDrawCalls))
+					{
+						return false;
+					}
+					for (const auto drawCall : pass.m_DrawCalls)
+					{
+						if (drawCall >= a_NumDrawCalls)
+						{
+							return false;
+						}
+					}
+					pass.m_Type = static_cast<DrawPassType>(stored.m_Type);
+					if (pass.m_Type == DrawPassType::SHADOW_GENERATION)
+					{
+						pass.m_LightHandle.m_Type = static_cast<LightType>(stored.m_LightType);
+						pass.m_LightHandle.m_Index = stored.m_LightIndex;
+					}
+				}
+				return true;
+			}
+
+		private:
+			const uint8_t* m_Data;
+			size_t m_Size;
+			size_t m_Offset;
+		};
+	}
+
+	bool DrawDataCaptureWriter::Open(const std::string& a_FilePath)
+	{
+		Close();
+
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_File.open(a_FilePath, std::ios::binary | std::ios::trunc);
+		if (!m_File.is_open())
+		{
+			printf("Could not open draw data capture file %s.\n", a_FilePath.c_str());
+			return false;
+		}
+
+		CaptureFileHeader header{};
+		memcpy(header.m_Magic, CAPTURE_MAGIC, sizeof(header.m_Magic));
+		header.m_Version = CAPTURE_VERSION;
+		header.m_VertexSize = sizeof(Vertex);
+		header.m_InstanceSize = sizeof(PackedInstanceData);
+		header.m_MaterialSize = sizeof(PackedMaterialData);
+		header.m_LightSize = sizeof(PackedLightData);
+		m_File.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		return true;
+	}
+
+	void DrawDataCaptureWriter::Close()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		if (m_File.is_open())
+		{
+			m_File.close();
+		}
+		m_MeshIndices.clear();
+	}
+
+	bool DrawDataCaptureWriter::IsOpen() const
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		return m_File.is_open();
+	}
+
+	bool DrawDataCaptureWriter::WriteFrame(const DrawData& a_DrawData, const Camera& a_Camera, float a_InterpolationFactor, uint32_t a_FrameIndex, const glm::uvec2& a_Resolution, const MeshReadFunction& a_ReadMesh)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		if (!m_File.is_open())
+		{
+			return false;
+		}
+
+		//Write every mesh that was not seen before, and look up the capture index of all meshes used in this frame.
+		std::vector<uint32_t> meshIndices;
+		meshIndices.reserve(a_DrawData.m_Meshes.size());
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices;
+		for (const auto& eggMesh : a_DrawData.m_Meshes)
+		{
+			auto& mesh = *std::static_pointer_cast<StaticMesh>(eggMesh);
+			const auto found = m_MeshIndices.find(mesh.GetUniqueId());
+			if (found != m_MeshIndices.end())
+			{
+				meshIndices.push_back(found->second);
+				continue;
+			}
+
+			if (!a_ReadMesh(mesh, vertices, indices))
+			{
+				printf("Could not read mesh geometry for draw data capture. Capture stopped.\n");
+				m_File.close();
+				return false;
+			}
+
+			CaptureMeshHeader meshHeader{};
+			meshHeader.m_MeshIndex = static_cast<uint32_t>(m_MeshIndices.size());
+			meshHeader.m_NumVertices = static_cast<uint32_t>(vertices.size());
+			meshHeader.m_NumIndices = static_cast<uint32_t>(indices.size());
+
+			m_Payload.clear();
+			Append(m_Payload, meshHeader);
+			Append(m_Payload, vertices.data(), vertices.size());
+			Append(m_Payload, indices.data(), indices.size());
+			WriteChunk(CaptureChunkType::MESH, m_Payload);
+
+			m_MeshIndices.emplace(mesh.GetUniqueId(), meshHeader.m_MeshIndex);
+			meshIndices.push_back(meshHeader.m_MeshIndex);
+		}
+
+		const auto& camera = a_Camera;
+		const auto translation = camera.GetTransform().GetTranslation();
+		const auto rotation = camera.GetTransform().GetRotation();
+		const auto scale = camera.GetTransform().GetScale();
+
+		CaptureFrameHeader frameHeader{};
+		frameHeader.m_FrameIndex = a_FrameIndex;
+		frameHeader.m_ResolutionX = a_Resolution.x;
+		frameHeader.m_ResolutionY = a_Resolution.y;
+		frameHeader.m_Fov = camera.GetFov();
+		frameHeader.m_NearPlane = camera.GetNearPlane();
+		frameHeader.m_FarPlane = camera.GetFarPlane();
+		frameHeader.m_AspectRatio = camera.GetAspectRatio();
+		for (int i = 0; i < 3; ++i)
+		{
+			frameHeader.m_Translation[i] = translation[i];
+			frameHeader.m_Scale[i] = scale[i];
+		}
+		frameHeader.m_Rotation[0] = rotation.x;
+		frameHeader.m_Rotation[1] = rotation.y;
+		frameHeader.m_Rotation[2] = rotation.z;
+		frameHeader.m_Rotation[3] = rotation.w;
+		frameHeader.m_NumMeshes = static_cast<uint32_t>(meshIndices.size());
+		frameHeader.m_NumMaterials = static_cast<uint32_t>(a_DrawData.m_PackedMaterialData.size());
+		frameHeader.m_NumInstances = static_cast<uint32_t>(a_DrawData.m_PackedInstanceData.size());
+		frameHeader.m_NumIndirections = static_cast<uint32_t>(a_DrawData.m_IndirectionBuffer.size());
+		frameHeader.m_NumDrawCalls = static_cast<uint32_t>(a_DrawData.m_DrawCalls.size());
+		frameHeader.m_NumAreaLights = static_cast<uint32_t>(a_DrawData.m_PackedAreaLightData.size());
+		frameHeader.m_NumDirectionalLights = static_cast<uint32_t>(a_DrawData.m_PackedDirectionalLightData.size());
+		frameHeader.m_NumDrawPasses = static_cast<uint32_t>(a_DrawData.m_DrawPasses.size());
+		frameHeader.m_NumDirectionalShadowPasses = static_cast<uint32_t>(a_DrawData.m_DirectionalShadowPasses.size());
+		frameHeader.m_NumAreaShadowPasses = static_cast<uint32_t>(a_DrawData.m_AreaShadowPasses.size());
+		frameHeader.m_NumDirectionalShadows = a_DrawData.m_NumDirectionalShadows;
+		frameHeader.m_NumAreaShadows = a_DrawData.m_NumAreaShadows;
+		frameHeader.m_NumPreviousTransforms = static_cast<uint32_t>(a_DrawData.m_PreviousTransforms.size());
+		frameHeader.m_InterpolationFactor = a_InterpolationFactor;
+
+		m_Payload.clear();
+		Append(m_Payload, frameHeader);
+		Append(m_Payload, meshIndices.data(), meshIndices.size());
+		Append(m_Payload, a_DrawData.m_PackedMaterialData.data(), a_DrawData.m_PackedMaterialData.size());
+		Append(m_Payload, a_DrawData.m_PackedInstanceData.data(), a_DrawData.m_PackedInstanceData.size());
+		Append(m_Payload, a_DrawData.m_IndirectionBuffer.data(), a_DrawData.m_IndirectionBuffer.size());
+		Append(m_Payload, a_DrawData.m_DrawCalls.data(), a_DrawData.m_DrawCalls.size());
+		Append(m_Payload, a_DrawData.m_PackedAreaLightData.data(), a_DrawData.m_PackedAreaLightData.size());
+		Append(m_Payload, a_DrawData.m_PackedDirectionalLightData.data(), a_DrawData.m_PackedDirectionalLightData.size());
+		AppendPasses(m_Payload, a_DrawData.m_DrawPasses);
+		AppendPasses(m_Payload, a_DrawData.m_DirectionalShadowPasses);
+		AppendPasses(m_Payload, a_DrawData.m_AreaShadowPasses);
+		Append(m_Payload, a_DrawData.m_PreviousTransforms.data(), a_DrawData.m_PreviousTransforms.size());
+		WriteChunk(CaptureChunkType::FRAME, m_Payload);
+
+		return m_File.good();
+	}
+
+	void DrawDataCaptureWriter::WriteChunk(CaptureChunkType a_Type, const std::vector<uint8_t>& a_Payload)
+	{
+		CaptureChunkHeader header{};
+		header.m_Type = a_Type;
+		header.m_Size = AlignChunkSize(a_Payload.size());
+
+		static const char padding[CHUNK_ALIGNMENT]{};
+		m_File.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		m_File.write(reinterpret_cast<const char*>(a_Payload.data()), static_cast<std::streamsize>(a_Payload.size()));
+		m_File.write(padding, static_cast<std::streamsize>(header.m_Size - a_Payload.size()));
+	}
+
+	DrawDataCaptureReader::DrawDataCaptureReader() : m_Data(nullptr), m_Size(0), m_FileHandle(nullptr), m_MappingHandle(nullptr)
+	{
+	}
+
+	DrawDataCaptureReader::~DrawDataCaptureReader()
+	{
+		Close();
+	}
+
+	bool DrawDataCaptureReader::Open(const std::string& a_FilePath)
+	{
+		Close();
+
+#ifdef _WIN32
+		const HANDLE file = CreateFileA(a_FilePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			printf("Could not open draw data capture %s.\n", a_FilePath.c_str());
+			return false;
+		}
+		m_FileHandle = file;
+
+		LARGE_INTEGER size;
+		GetFileSizeEx(file, &size);
+		m_Size = static_cast<size_t>(size.QuadPart);
+
+		const HANDLE mapping = m_Size != 0 ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+		if (mapping != nullptr)
+		{
+			m_MappingHandle = mapping;
+			m_Data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+		}
+#else
+		const int file = open(a_FilePath.c_str(), O_RDONLY);
+		if (file < 0)
+		{
+			printf("Could not open draw data capture %s.\n", a_FilePath.c_str());
+			return false;
+		}
+
+		struct stat fileInfo;
+		fstat(file, &fileInfo);
+		m_Size = static_cast<size_t>(fileInfo.st_size);
+
+		if (m_Size != 0)
+		{
+			void* data = mmap(nullptr, m_Size, PROT_READ, MAP_PRIVATE, file, 0);
+			m_Data = data != MAP_FAILED ? static_cast<const uint8_t*>(data) : nullptr;
+		}
+
+		//The mapping stays valid after the descriptor is closed.
+		close(file);
+#endif
+
+		if (m_Data == nullptr)
+		{
+			printf("Could not map draw data capture %s.\n", a_FilePath.c_str());
+			Close();
+			return false;
+		}
+
+		CaptureFileHeader header;
+		if (m_Size < sizeof(header))
+		{
+			printf("Draw data capture %s is truncated.\n", a_FilePath.c_str());
+			Close();
+			return false;
+		}
+		memcpy(&header, m_Data, sizeof(header));
+
+		if (memcmp(header.m_Magic, CAPTURE_MAGIC, sizeof(header.m_Magic)) != 0 || header.m_Version != CAPTURE_VERSION)
+		{
+			printf("%s is not a draw data capture, or was written by an unsupported version.\n", a_FilePath.c_str());
+			Close();
+			return false;
+		}
+
+		if (header.m_VertexSize != sizeof(Vertex) || header.m_InstanceSize != sizeof(PackedInstanceData) ||
+			header.m_MaterialSize != sizeof(PackedMaterialData) || header.m_LightSize != sizeof(PackedLightData))
+		{
+			printf("Draw data capture %s was written with a different data layout.\n", a_FilePath.c_str());
+			Close();
+			return false;
+		}
+
+		//Find all chunks. A chunk cut off at the end (capture not closed properly) is ignored.
+		size_t offset = sizeof(header);
+		while (m_Size - offset >= sizeof(CaptureChunkHeader))
+		{
+			CaptureChunkHeader chunk;
+			memcpy(&chunk, m_Data + offset, sizeof(chunk));
+			offset += sizeof(chunk);
+
+			if (chunk.m_Size > m_Size - offset)
+			{
+				break;
+			}
+
+			if (chunk.m_Type == CaptureChunkType::MESH)
+			{
+				m_MeshOffsets.push_back(offset);
+			}
+			else if (chunk.m_Type == CaptureChunkType::FRAME)
+			{
+				m_FrameOffsets.push_back(offset);
+			}
+			offset += static_cast<size_t>(chunk.m_Size);
+		}
+
+		return true;
+	}
+
+	void DrawDataCaptureReader::Close()
+	{
+#ifdef _WIN32
+		if (m_Data != nullptr)
+		{
+			UnmapViewOfFile(m_Data);
+		}
+		if (m_MappingHandle != nullptr)
+		{
+			CloseHandle(m_MappingHandle);
+		}
+		if (m_FileHandle != nullptr)
+		{
+			CloseHandle(m_FileHandle);
+		}
+#else
+		if (m_Data != nullptr)
+		{
+			munmap(const_cast<uint8_t*>(m_Data), m_Size);
+		}
+#endif
+		m_Data = nullptr;
+		m_Size = 0;
+		m_FileHandle = nullptr;
+		m_MappingHandle = nullptr;
+		m_MeshOffsets.clear();
+		m_FrameOffsets.clear();
+	}
+
+	uint32_t DrawDataCaptureReader::GetMeshCount() const
+	{
+		return static_cast<uint32_t>(m_MeshOffsets.size());
+	}
+
+	uint32_t DrawDataCaptureReader::GetFrameCount() const
+	{
+		return static_cast<uint32_t>(m_FrameOffsets.size());
+	}
+
+	StaticMeshCreateInfo DrawDataCaptureReader::GetMesh(uint32_t a_MeshIndex) const
+	{
+		StaticMeshCreateInfo info{};
+		if (a_MeshIndex >= m_MeshOffsets.size())
+		{
+			return info;
+		}
+
+		//The chunk header and mesh header are both 16 bytes, so the vertex data is aligned within the mapping.
+		const uint8_t* data = m_Data + m_MeshOffsets[a_MeshIndex];
+		CaptureMeshHeader header;
+		memcpy(&header, data, sizeof(header));
+		data += sizeof(header);
+
+		info.m_VertexBuffer = reinterpret_cast<const Vertex*>(data);
+		info.m_NumVertices = header.m_NumVertices;
+		info.m_IndexBuffer = reinterpret_cast<const uint32_t*>(data + sizeof(Vertex) * header.m_NumVertices);
+		info.m_NumIndices = header.m_NumIndices;
+		return info;
+	}
+
+	glm::uvec2 DrawDataCaptureReader::GetResolution(uint32_t a_FrameIndex) const
+	{
+		if (a_FrameIndex >= m_FrameOffsets.size())
+		{
+			return glm::uvec2(0);
+		}
+
+		CaptureFrameHeader header;
+		memcpy(&header, m_Data + m_FrameOffsets[a_FrameIndex], sizeof(header));
+		return glm::uvec2(header.m_ResolutionX, header.m_ResolutionY);
+	}
+
+	bool DrawDataCaptureReader::ReadFrame(uint32_t a_FrameIndex, DrawData& a_DrawData, const std::vector<std::shared_ptr<EggStaticMesh>>& a_Meshes) const
+	{
+		if (a_FrameIndex >= m_FrameOffsets.size())
+		{
+			return false;
+		}
+
+		//The chunk size was validated when opening, so the reader can not go past the end of the mapping.
+		const size_t offset = m_FrameOffsets[a_FrameIndex];
+		CaptureChunkHeader chunk;
+		memcpy(&chunk, m_Data + offset - sizeof(chunk), sizeof(chunk));
+		ChunkReader reader(m_Data + offset, static_cast<size_t>(chunk.m_Size));
+
+		CaptureFrameHeader header;
+		std::vector<uint32_t> meshIndices;
+		if (!reader.Read(header) || !reader.Read(meshIndices, header.m_NumMeshes))
+		{
+			printf("Draw data capture frame %u is corrupt.\n", a_FrameIndex);
+			return false;
+		}
+
+		Camera camera;
+		camera.UpdateProjection(header.m_Fov, header.m_NearPlane, header.m_FarPlane, header.m_AspectRatio);
+		camera.GetTransform().SetTranslation(glm::vec3(header.m_Translation[0], header.m_Translation[1], header.m_Translation[2]));
+		camera.GetTransform().SetRotation(glm::quat(header.m_Rotation[3], header.m_Rotation[0], header.m_Rotation[1], header.m_Rotation[2]));
+		camera.GetTransform().SetScale(glm::vec3(header.m_Scale[0], header.m_Scale[1], header.m_Scale[2]));
+		a_DrawData.m_Camera = camera;
+
+		a_DrawData.m_Meshes.clear();
+		a_DrawData.m_Meshes.reserve(meshIndices.size());
+		for (const auto meshIndex : meshIndices)
+		{
+			if (meshIndex >= a_Meshes.size())
+			{
+				printf("Draw data capture frame %u refers to a mesh that was not created.\n", a_FrameIndex);
+				return false;
+			}
+			a_DrawData.m_Meshes.push_back(a_Meshes[meshIndex]);
+		}
+
+		const bool valid =
+			reader.Read(a_DrawData.m_PackedMaterialData, header.m_NumMaterials) &&
+			reader.Read(a_DrawData.m_PackedInstanceData, header.m_NumInstances) &&
+			reader.Read(a_DrawData.m_IndirectionBuffer, header.m_NumIndirections) &&
+			reader.Read(a_DrawData.m_DrawCalls, header.m_NumDrawCalls) &&
+			reader.Read(a_DrawData.m_PackedAreaLightData, header.m_NumAreaLights) &&
+			reader.Read(a_DrawData.m_PackedDirectionalLightData, header.m_NumDirectionalLights) &&
+			reader.ReadPasses(a_DrawData.m_DrawPasses, header.m_NumDrawPasses, header.m_NumDrawCalls) &&
+			reader.ReadPasses(a_DrawData.m_DirectionalShadowPasses, header.m_NumDirectionalShadowPasses, header.m_NumDrawCalls) &&
+			reader.ReadPasses(a_DrawData.m_AreaShadowPasses, header.m_NumAreaShadowPasses, header.m_NumDrawCalls) &&
+			reader.Read(a_DrawData.m_PreviousTransforms, header.m_NumPreviousTransforms);
+
+		if (!valid)
+		{
+			printf("Draw data capture frame %u is corrupt.\n", a_FrameIndex);
+			return false;
+		}
+
+		//The draw calls index into the instance and mesh data directly, so they have to stay within bounds.
+		//Scatters are not captured, so scattered draw calls are replayed without instances.
+		for (auto& drawCall : a_DrawData.m_DrawCalls)
+		{
+			drawCall.m_ScatterIndex = 0;
+
+			if (drawCall.m_MeshIndex >= a_DrawData.m_Meshes.size() ||
+				static_cast<uint64_t>(drawCall.m_IndirectionBufferOffset) + drawCall.m_NumInstances > a_DrawData.m_IndirectionBuffer.size())
+			{
+				printf("Draw data capture frame %u contains an invalid draw call.\n", a_FrameIndex);
+				return false;
+			}
+		}
+
+		//The indirection buffer is read by the shaders to index into the instance data.
+		for (const auto instanceIndex : a_DrawData.m_IndirectionBuffer)
+		{
+			if (instanceIndex >= a_DrawData.m_PackedInstanceData.size())
+			{
+				printf("Draw data capture frame %u contains an invalid instance index.\n", a_FrameIndex);
+				return false;
+			}
+		}
+
+		//Interpolated instances index into the previous transforms, offset by one.
+		//Vertex animations are not captured, so animated instances are replayed in the pose of their mesh.
+		for (auto& instance : a_DrawData.m_PackedInstanceData)
+		{
+			if (instance.m_PreviousTransformIndex > a_DrawData.m_PreviousTransforms.size())
+			{
+				printf("Draw data capture frame %u contains an invalid previous transform index.\n", a_FrameIndex);
+				return false;
+			}
+			instance.m_AnimationStateIndex = 0;
+		}
+
+		//Materials only exist as packed data during replay. The renderer uses the material list for its size only.
+		a_DrawData.m_Materials.assign(header.m_NumMaterials, nullptr);
+		a_DrawData.m_NumDirectionalShadows = header.m_NumDirectionalShadows;
+		a_DrawData.m_NumAreaShadows = header.m_NumAreaShadows;
+		a_DrawData.m_InterpolationFactor = header.m_InterpolationFactor;
+		return true;
+	}
+}
@@ -39,7 +39,7 @@ namespace egg
         a_B = m_Radiance[2];
     }
 
-    SphereLight::SphereLight() : m_Position{ 0.f, 0.f, 0.f }, m_Radiance{ 1.f, 1.f, 1.f }, m_Radius(1.f)
+    SphereLight::SphereLight() : m_Position{ 0.f, 0.f, 0.f }, m_Radiance{ 1.f, 1.f, 1.f }, m_Radius(1.f), m_ContactShadowLength(0.f)
     {
     }
 
@@ -62,6 +62,11 @@ namespace egg
         m_Radius = a_Radius;
     }
 
+    void SphereLight::SetContactShadowLength(float a_Length)
+    {
+        m_ContactShadowLength = a_Length;
+    }
+
     void SphereLight::GetPosition(float& a_X, float& a_Y, float& a_Z) const
     {
         a_X = m_Position[0];
@@ -80,4 +85,9 @@ namespace egg
     {
         a_Radius = m_Radius;
     }
+
+    void SphereLight::GetContactShadowLength(float& a_Length) const
+    {
+        a_Length = m_ContactShadowLength;
+    }
 }
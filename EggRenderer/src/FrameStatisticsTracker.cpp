@@ -0,0 +1,235 @@
+#include "FrameStatisticsTracker.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace egg
+{
+	StatisticPercentiles CalculatePercentiles(std::vector<double>& a_Values)
+	{
+		StatisticPercentiles result;
+		if (a_Values.empty())
+		{
+			return result;
+		}
+
+		std::sort(a_Values.begin(), a_Values.end());
+
+		//Nearest rank: the smallest value that is greater than or equal to the given percentage of values.
+		const auto percentile = [&a_Values](double a_Percentage)
+		{
+			const auto rank = static_cast<size_t>(std::ceil(a_Percentage / 100.0 * static_cast<double>(a_Values.size())));
+			return a_Values[std::max<size_t>(rank, 1) - 1];
+		};
+
+		double sum = 0.0;
+		for (const auto value : a_Values)
+		{
+			sum += value;
+		}
+
+		result.m_NumSamples = static_cast<uint32_t>(a_Values.size());
+		result.m_Min = a_Values.front();
+		result.m_Max = a_Values.back();
+		result.m_Average = sum / static_cast<double>(a_Values.size());
+		result.m_P50 = percentile(50.0);
+		result.m_P95 = percentile(95.0);
+		result.m_P99 = percentile(99.0);
+		return result;
+	}
+
+	FrameStatisticsTracker::FrameStatisticsTracker() : m_HistorySize(0), m_StreamFormat(StatisticsStreamFormat::CSV)
+	{
+	}
+
+	void FrameStatisticsTracker::Init(uint32_t a_HistorySize)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_HistorySize = a_HistorySize;
+		m_History.clear();
+	}
+
+	void FrameStatisticsTracker::CleanUp()
+	{
+		StopStream();
+
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_History.clear();
+	}
+
+	void FrameStatisticsTracker::AddFrame(const FrameStatistics& a_Statistics)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		if (m_Stream.is_open())
+		{
+			WriteToStream(a_Statistics);
+		}
+
+		if (m_HistorySize == 0)
+		{
+			return;
+		}
+
+		m_History.push_back(a_Statistics);
+		while (m_History.size() > m_HistorySize)
+		{
+			m_History.pop_front();
+		}
+	}
+
+	std::vector<FrameStatistics> FrameStatisticsTracker::GetHistory() const
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		return std::vector<FrameStatistics>(m_History.begin(), m_History.end());
+	}
+
+	void FrameStatisticsTracker::GetRecentHistory(size_t a_MaxFrames, std::vector<FrameStatistics>& a_Output) const
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		const size_t numFrames = std::min(a_MaxFrames, m_History.size());
+		a_Output.assign(m_History.end() - static_cast<std::ptrdiff_t>(numFrames), m_History.end());
+	}
+
+	FrameStatisticsSummary FrameStatisticsTracker::GetSummary() const
+	{
+		//Copy the history so that sorting does not block the render thread.
+		const auto history = GetHistory();
+
+		FrameStatisticsSummary summary;
+		summary.m_NumFrames = static_cast<uint32_t>(history.size());
+
+		std::vector<double> values;
+		values.reserve(history.size());
+
+		//Collect a single statistic of every frame, and calculate its distribution.
+		//Statistics that are not always measured only sample the frames for which the given flag is set.
+		const auto calculate = [&](auto a_Getter, bool FrameStatistics::* a_Filter = nullptr)
+		{
+			values.clear();
+			for (const auto& frame : history)
+			{
+				if (a_Filter == nullptr || frame.*a_Filter)
+				{
+					values.push_back(static_cast<double>(a_Getter(frame)));
+				}
+			}
+			return CalculatePercentiles(values);
+		};
+
+		summary.m_CpuFrameMilliseconds = calculate([](const FrameStatistics& a_Frame) { return a_Frame.m_CpuFrameMilliseconds; });
+		summary.m_FenceWaitMilliseconds = calculate([](const FrameStatistics& a_Frame) { return a_Frame.m_FenceWaitMilliseconds; });
+		summary.m_UploadMilliseconds = calculate([](const FrameStatistics& a_Frame) { return a_Frame.m_UploadMilliseconds; });
+		summary.m_RecordMilliseconds = calculate([](const FrameStatistics& a_Frame) { return a_Frame.m_RecordMilliseconds; });
+		summary.m_SubmitMilliseconds = calculate([](const FrameStatistics& a_Frame) { return a_Frame.m_SubmitMilliseconds; });
+		summary.m_GpuMilliseconds = calculate([](const FrameStatistics& a_Frame) { return a_Frame.m_GpuMilliseconds; }, &FrameStatistics::m_HasGpuTime);
+		summary.m_InputToSubmitMilliseconds = calculate([](const FrameStatistics& a_Frame) { return a_Frame.m_InputToSubmitMilliseconds; }, &FrameStatistics::m_HasInputLatency);
+		summary.m_InputToGpuCompleteMilliseconds = calculate([](const FrameStatistics& a_Frame) { return a_Frame.m_InputToGpuCompleteMilliseconds; }, &FrameStatistics::m_HasInputLatency);
+		summary.m_InputToPresentMilliseconds = calculate([](const FrameStatistics& a_Frame) { return a_Frame.m_InputToPresentMilliseconds; }, &FrameStatistics::m_HasPresentLatency);
+		summary.m_DrawCalls = calculate([](const FrameStatistics& a_Frame) { return a_Frame.m_NumDrawCalls; });
+		summary.m_Triangles = calculate([](const FrameStatistics& a_Frame) { return a_Frame.m_NumTriangles; });
+		summary.m_BytesUploaded = calculate([](const FrameStatistics& a_Frame) { return a_Frame.GetBytesUploaded(); });
+		summary.m_DescriptorUpdates = calculate([](const FrameStatistics& a_Frame) { return a_Frame.m_NumDescriptorUpdates; });
+
+		return summary;
+	}
+
+	bool FrameStatisticsTracker::StartStream(const std::string& a_FilePath, StatisticsStreamFormat a_Format)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		if (m_Stream.is_open())
+		{
+			m_Stream.close();
+		}
+
+		m_Stream.open(a_FilePath, std::ios::out | std::ios::trunc);
+		if (!m_Stream.is_open())
+		{
+			printf("Could not open file for streaming frame statistics: %s\n", a_FilePath.c_str());
+			return false;
+		}
+
+		m_StreamFormat = a_Format;
+		if (m_StreamFormat == StatisticsStreamFormat::CSV)
+		{
+			m_Stream << "frame,instances,draw_passes,draw_calls,triangles,lights,descriptor_updates,"
+				<< "instance_bytes,material_bytes,light_bytes,indirection_bytes,debug_draw_bytes,previous_transform_bytes,animation_state_bytes,"
+				<< "fence_wait_ms,upload_ms,record_ms,submit_ms,cpu_frame_ms,gpu_ms,"
+				<< "input_to_submit_ms,input_to_gpu_complete_ms,input_to_present_ms\n";
+		}
+		return true;
+	}
+
+	void FrameStatisticsTracker::StopStream()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		if (m_Stream.is_open())
+		{
+			m_Stream.close();
+		}
+	}
+
+	void FrameStatisticsTracker::WriteToStream(const FrameStatistics& a_Statistics)
+	{
+		//Statistics that were not measured for this frame write -1, so that every row has the same columns.
+		const double gpuMilliseconds = a_Statistics.m_HasGpuTime ? a_Statistics.m_GpuMilliseconds : -1.0;
+		const double inputToSubmitMilliseconds = a_Statistics.m_HasInputLatency ? a_Statistics.m_InputToSubmitMilliseconds : -1.0;
+		const double inputToGpuCompleteMilliseconds = a_Statistics.m_HasInputLatency ? a_Statistics.m_InputToGpuCompleteMilliseconds : -1.0;
+		const double inputToPresentMilliseconds = a_Statistics.m_HasPresentLatency ? a_Statistics.m_InputToPresentMilliseconds : -1.0;
+
+		if (m_StreamFormat == StatisticsStreamFormat::CSV)
+		{
+			m_Stream << a_Statistics.m_FrameIndex << ','
+				<< a_Statistics.m_NumInstances << ','
+				<< a_Statistics.m_NumDrawPasses << ','
+				<< a_Statistics.m_NumDrawCalls << ','
+				<< a_Statistics.m_NumTriangles << ','
+				<< a_Statistics.m_NumLights << ','
+				<< a_Statistics.m_NumDescriptorUpdates << ','
+				<< a_Statistics.m_InstanceBytesUploaded << ','
+				<< a_Statistics.m_MaterialBytesUploaded << ','
+				<< a_Statistics.m_LightBytesUploaded << ','
+				<< a_Statistics.m_IndirectionBytesUploaded << ','
+				<< a_Statistics.m_DebugDrawBytesUploaded << ','
+				<< a_Statistics.m_PreviousTransformBytesUploaded << ','
+				<< a_Statistics.m_AnimationStateBytesUploaded << ','
+				<< a_Statistics.m_FenceWaitMilliseconds << ','
+				<< a_Statistics.m_UploadMilliseconds << ','
+				<< a_Statistics.m_RecordMilliseconds << ','
+				<< a_Statistics.m_SubmitMilliseconds << ','
+				<< a_Statistics.m_CpuFrameMilliseconds << ','
+				<< gpuMilliseconds << ','
+				<< inputToSubmitMilliseconds << ','
+				<< inputToGpuCompleteMilliseconds << ','
+				<< inputToPresentMilliseconds << '\n';
+		}
+		else
+		{
+			m_Stream << "{\"frame\":" << a_Statistics.m_FrameIndex
+				<< ",\"instances\":" << a_Statistics.m_NumInstances
+				<< ",\"draw_passes\":" << a_Statistics.m_NumDrawPasses
+				<< ",\"draw_calls\":" << a_Statistics.m_NumDrawCalls
+				<< ",\"triangles\":" << a_Statistics.m_NumTriangles
+				<< ",\"lights\":" << a_Statistics.m_NumLights
+				<< ",\"descriptor_updates\":" << a_Statistics.m_NumDescriptorUpdates
+				<< ",\"instance_bytes\":" << a_Statistics.m_InstanceBytesUploaded
+				<< ",\"material_bytes\":" << a_Statistics.m_MaterialBytesUploaded
+				<< ",\"light_bytes\":" << a_Statistics.m_LightBytesUploaded
+				<< ",\"indirection_bytes\":" << a_Statistics.m_IndirectionBytesUploaded
+				<< ",\"debug_draw_bytes\":" << a_Statistics.m_DebugDrawBytesUploaded
+				<< ",\"previous_transform_bytes\":" << a_Statistics.m_PreviousTransformBytesUploaded
+				<< ",\"animation_state_bytes\":" << a_Statistics.m_AnimationStateBytesUploaded
+				<< ",\"fence_wait_ms\":" << a_Statistics.m_FenceWaitMilliseconds
+				<< ",\"upload_ms\":" << a_Statistics.m_UploadMilliseconds
+				<< ",\"record_ms\":" << a_Statistics.m_RecordMilliseconds
+				<< ",\"submit_ms\":" << a_Statistics.m_SubmitMilliseconds
+				<< ",\"cpu_frame_ms\":" << a_Statistics.m_CpuFrameMilliseconds
+				<< ",\"gpu_ms\":" << gpuMilliseconds
+				<< ",\"input_to_submit_ms\":" << inputToSubmitMilliseconds
+				<< ",\"input_to_gpu_complete_ms\":" << inputToGpuCompleteMilliseconds
+				<< ",\"input_to_present_ms\":" << inputToPresentMilliseconds << "}\n";
+		}
+	}
+}
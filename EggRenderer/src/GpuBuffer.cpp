@@ -2,13 +2,18 @@
 
 #include <cassert>
 #include <cstdio>
+#include <cstring>
 #include <memory>
 
+#include "MemoryTracker.h"
+
 namespace egg
 {
 	GpuBuffer::GpuBuffer(): m_Device(nullptr), m_Allocator(nullptr), m_Initialized(false), m_Allocation(nullptr),
 	                        m_AllocationInfo(),
-	                        m_Buffer(nullptr)
+	                        m_Buffer(nullptr),
+	                        m_DeviceAddress(0),
+	                        m_Version(0)
 	{
 	}
 
@@ -67,7 +72,7 @@ namespace egg
 		for(int i = 0; i < static_cast<int>(a_NumWrites); ++i)
 		{
 			const auto& write = a_Writes[i];
-			memcpy(data, write.m_Data, write.m_Size);
+			memcpy(static_cast<uint8_t*>(data) + write.m_Offset, write.m_Data, write.m_Size);
 		}
 		
 		vkUnmapMemory(m_Device, m_AllocationInfo.deviceMemory);
@@ -75,6 +80,39 @@ namespace egg
 		return true;
 	}
 	
+	bool GpuBuffer::Read(void* a_Destination, size_t a_Offset, size_t a_Size) const
+	{
+		assert(m_Initialized);
+
+		//Ensure that this buffer allows CPU reading.
+		if (m_Settings.m_MemoryUsage != VMA_MEMORY_USAGE_GPU_TO_CPU && m_Settings.m_MemoryUsage != VMA_MEMORY_USAGE_CPU_ONLY)
+		{
+			printf("Trying to read from a buffer not readable by the CPU!\n");
+			return false;
+		}
+
+		if (a_Offset + a_Size > m_Settings.m_SizeInBytes)
+		{
+			printf("Trying to read outside of buffer bounds!\n");
+			return false;
+		}
+
+		void* data;
+		if (vmaMapMemory(m_Allocator, m_Allocation, &data) != VK_SUCCESS)
+		{
+			printf("Could not map buffer memory for reading!\n");
+			return false;
+		}
+
+		//Memory may not be host coherent, so make the GPU writes visible first.
+		vmaInvalidateAllocation(m_Allocator, m_Allocation, a_Offset, a_Size);
+		memcpy(a_Destination, static_cast<const char*>(data) + a_Offset, a_Size);
+
+		vmaUnmapMemory(m_Allocator, m_Allocation);
+
+		return true;
+	}
+
 	bool GpuBuffer::Resize(const GpuBufferSettings& a_Settings)
 	{
 		assert(m_Initialized);
@@ -84,6 +122,7 @@ namespace egg
 
 		//Overwrite settings object.
 		m_Settings = a_Settings;
+		++m_Version;
 
 		if(m_Settings.m_SizeInBytes > 0)
 		{
@@ -112,14 +151,37 @@ namespace egg
 			}
 
 			vmaGetAllocationInfo(m_Allocator, m_Allocation, &m_AllocationInfo);
+			MemoryTracker::Track(m_Allocator, m_Allocation, m_Settings.m_MemoryCategory);
+
+			if ((m_Settings.m_BufferUsageFlags & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) != 0)
+			{
+				VkBufferDeviceAddressInfo addressInfo{};
+				addressInfo.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+				addressInfo.buffer = m_Buffer;
+				m_DeviceAddress = vkGetBufferDeviceAddress(m_Device, &addressInfo);
+			}
 		}
 		return true;
 	}
 
+	bool GpuBuffer::Reserve(size_t a_SizeInBytes)
+	{
+		assert(m_Initialized);
+		if (m_Settings.m_SizeInBytes >= a_SizeInBytes)
+		{
+			return true;
+		}
+
+		GpuBufferSettings settings = m_Settings;
+		settings.m_SizeInBytes = a_SizeInBytes;
+		return Resize(settings);
+	}
+
 	bool GpuBuffer::CleanUp()
 	{
 		if(m_Settings.m_SizeInBytes != 0)
 		{
+			MemoryTracker::Untrack(m_Allocator, m_Allocation);
 			vmaDestroyBuffer(m_Allocator, m_Buffer, m_Allocation);
 		}
 		//Overwrite with default initial settings.
@@ -127,6 +189,7 @@ namespace egg
 		m_AllocationInfo = VmaAllocationInfo{};
 		m_Buffer = {};
 		m_Allocation = {};
+		m_DeviceAddress = 0;
 		
 		return true;
 	}
@@ -154,4 +217,15 @@ namespace egg
 		assert(m_Initialized);
 		return m_AllocationInfo;
 	}
+
+	VkDeviceAddress GpuBuffer::GetDeviceAddress() const
+	{
+		assert(m_Initialized);
+		return m_DeviceAddress;
+	}
+
+	uint32_t GpuBuffer::GetVersion() const
+	{
+		return m_Version;
+	}
 }
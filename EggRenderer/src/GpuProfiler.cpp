@@ -0,0 +1,286 @@
+#include "GpuProfiler.h"
+
+#include <cassert>
+#include <cstdio>
+
+namespace egg
+{
+	//The pipeline statistics gathered per zone. Results are written in the order of the bits.
+	constexpr VkQueryPipelineStatisticFlags PIPELINE_STATISTICS =
+		VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT
+		| VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT
+		| VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT
+		| VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT
+		| VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+	constexpr uint32_t NUM_PIPELINE_STATISTICS = 5;
+
+	GpuProfiler::GpuProfiler() : m_Device(nullptr), m_Enabled(false), m_PipelineStatistics(false), m_ProfileDrawPasses(false),
+	                             m_TimestampPeriod(1.f), m_TimestampMask(0), m_HistorySize(0)
+	{
+	}
+
+	bool GpuProfiler::Init(VkDevice a_Device, VkPhysicalDevice a_PhysicalDevice, uint32_t a_QueueFamilyIndex, uint32_t a_NumFrames, bool a_PipelineStatistics, const RendererSettings& a_Settings)
+	{
+		m_Device = a_Device;
+		m_HistorySize = a_Settings.gpuProfilingHistorySize;
+		m_ProfileDrawPasses = a_Settings.profileDrawPasses;
+		m_PipelineStatistics = a_PipelineStatistics;
+		m_Enabled = false;
+
+		if (!a_Settings.enableGpuProfiling || m_HistorySize == 0)
+		{
+			return true;
+		}
+
+		//Ensure that the queue can write timestamps.
+		uint32_t queueFamilyCount = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(a_PhysicalDevice, &queueFamilyCount, nullptr);
+		std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+		vkGetPhysicalDeviceQueueFamilyProperties(a_PhysicalDevice, &queueFamilyCount, queueFamilies.data());
+
+		const uint32_t validBits = a_QueueFamilyIndex < queueFamilyCount ? queueFamilies[a_QueueFamilyIndex].timestampValidBits : 0;
+		if (validBits == 0)
+		{
+			printf("GPU profiling disabled: queue does not support timestamps.\n");
+			return true;
+		}
+		m_TimestampMask = validBits >= 64 ? ~0ull : ((1ull << validBits) - 1ull);
+
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(a_PhysicalDevice, &properties);
+		m_TimestampPeriod = properties.limits.timestampPeriod;
+
+		/*
+		 * Create the query pools for every frame.
+		 */
+		m_Frames.resize(a_NumFrames);
+		for (auto& frame : m_Frames)
+		{
+			VkQueryPoolCreateInfo poolInfo{};
+			poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+			poolInfo.queryCount = MAX_ZONES_PER_FRAME * 2;
+
+			if (vkCreateQueryPool(m_Device, &poolInfo, nullptr, &frame.m_TimestampPool) != VK_SUCCESS)
+			{
+				printf("Could not create timestamp query pool!\n");
+				return false;
+			}
+
+			if (m_PipelineStatistics)
+			{
+				poolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+				poolInfo.queryCount = MAX_ZONES_PER_FRAME;
+				poolInfo.pipelineStatistics = PIPELINE_STATISTICS;
+
+				if (vkCreateQueryPool(m_Device, &poolInfo, nullptr, &frame.m_StatisticsPool) != VK_SUCCESS)
+				{
+					printf("Could not create pipeline statistics query pool!\n");
+					return false;
+				}
+			}
+		}
+
+		m_Enabled = true;
+		return true;
+	}
+
+	void GpuProfiler::CleanUp()
+	{
+		for (auto& frame : m_Frames)
+		{
+			vkDestroyQueryPool(m_Device, frame.m_TimestampPool, nullptr);
+			vkDestroyQueryPool(m_Device, frame.m_StatisticsPool, nullptr);
+		}
+		m_Frames.clear();
+		m_Enabled = false;
+
+		std::lock_guard<std::mutex> lock(m_HistoryMutex);
+		m_History.clear();
+	}
+
+	void GpuProfiler::BeginFrame(VkCommandBuffer a_CommandBuffer, uint32_t a_FrameIndex, uint32_t a_FrameCounter)
+	{
+		if (!m_Enabled)
+		{
+			return;
+		}
+
+		auto& frame = m_Frames[a_FrameIndex];
+
+		//The fence for this frame was waited on, so the previous results are available.
+		if (frame.m_Recorded)
+		{
+			Resolve(frame);
+		}
+
+		vkCmdResetQueryPool(a_CommandBuffer, frame.m_TimestampPool, 0, MAX_ZONES_PER_FRAME * 2);
+		if (m_PipelineStatistics)
+		{
+			vkCmdResetQueryPool(a_CommandBuffer, frame.m_StatisticsPool, 0, MAX_ZONES_PER_FRAME);
+		}
+
+		frame.m_Zones.clear();
+		frame.m_NumStatisticsQueries = 0;
+		frame.m_OpenZones = 0;
+		frame.m_StatisticsActive = false;
+		frame.m_FrameCounter = a_FrameCounter;
+		frame.m_Recorded = true;
+	}
+
+	uint32_t GpuProfiler::BeginZone(VkCommandBuffer a_CommandBuffer, uint32_t a_FrameIndex, const std::string& a_Name, bool a_InsideRenderPass)
+	{
+		if (!m_Enabled)
+		{
+			return INVALID_ZONE;
+		}
+
+		auto& frame = m_Frames[a_FrameIndex];
+		if (frame.m_Zones.size() >= MAX_ZONES_PER_FRAME)
+		{
+			return INVALID_ZONE;
+		}
+
+		const auto zoneIndex = static_cast<uint32_t>(frame.m_Zones.size());
+		auto& zone = frame.m_Zones.emplace_back();
+		zone.m_Name = a_Name;
+		zone.m_Depth = frame.m_OpenZones;
+		zone.m_StatisticsQuery = INVALID_ZONE;
+		++frame.m_OpenZones;
+
+		//Statistics queries of the same type can't be nested, and have to start and end in the same subpass.
+		if (m_PipelineStatistics && !frame.m_StatisticsActive && !a_InsideRenderPass)
+		{
+			zone.m_StatisticsQuery = frame.m_NumStatisticsQueries++;
+			frame.m_StatisticsActive = true;
+			vkCmdBeginQuery(a_CommandBuffer, frame.m_StatisticsPool, zone.m_StatisticsQuery, 0);
+		}
+
+		vkCmdWriteTimestamp(a_CommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.m_TimestampPool, zoneIndex * 2);
+		return zoneIndex;
+	}
+
+	void GpuProfiler::EndZone(VkCommandBuffer a_CommandBuffer, uint32_t a_FrameIndex, uint32_t a_Zone)
+	{
+		if (!m_Enabled || a_Zone == INVALID_ZONE)
+		{
+			return;
+		}
+
+		auto& frame = m_Frames[a_FrameIndex];
+		assert(a_Zone < frame.m_Zones.size());
+		assert(frame.m_OpenZones > 0);
+
+		const auto& zone = frame.m_Zones[a_Zone];
+		vkCmdWriteTimestamp(a_CommandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.m_TimestampPool, a_Zone * 2 + 1);
+
+		if (zone.m_StatisticsQuery != INVALID_ZONE)
+		{
+			vkCmdEndQuery(a_CommandBuffer, frame.m_StatisticsPool, zone.m_StatisticsQuery);
+			frame.m_StatisticsActive = false;
+		}
+
+		--frame.m_OpenZones;
+	}
+
+	bool GpuProfiler::ProfileDrawPasses() const
+	{
+		return m_Enabled && m_ProfileDrawPasses;
+	}
+
+	std::vector<GpuFrameTimings> GpuProfiler::GetHistory() const
+	{
+		std::lock_guard<std::mutex> lock(m_HistoryMutex);
+		return std::vector<GpuFrameTimings>(m_History.begin(), m_History.end());
+	}
+
+	bool GpuProfiler::GetLatestFrame(GpuFrameTimings& a_Timings) const
+	{
+		std::lock_guard<std::mutex> lock(m_HistoryMutex);
+		if (m_History.empty())
+		{
+			return false;
+		}
+		a_Timings = m_History.back();
+		return true;
+	}
+
+	bool GpuProfiler::GetFrameMilliseconds(uint32_t a_FrameCounter, double& a_Milliseconds) const
+	{
+		std::lock_guard<std::mutex> lock(m_HistoryMutex);
+
+		//The requested frame is usually the most recently resolved one.
+		for (auto itr = m_History.rbegin(); itr != m_History.rend(); ++itr)
+		{
+			if (itr->m_FrameIndex == a_FrameCounter)
+			{
+				a_Milliseconds = itr->m_TotalMilliseconds;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void GpuProfiler::Resolve(FrameQueries& a_Frame)
+	{
+		a_Frame.m_Recorded = false;
+
+		const auto numZones = static_cast<uint32_t>(a_Frame.m_Zones.size());
+		if (numZones == 0)
+		{
+			return;
+		}
+
+		//Frames that were never submitted are not available, and are skipped. Nothing waits here.
+		std::vector<uint64_t> timestamps(static_cast<size_t>(numZones) * 2);
+		if (vkGetQueryPoolResults(m_Device, a_Frame.m_TimestampPool, 0, numZones * 2, timestamps.size() * sizeof(uint64_t),
+			timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+		{
+			return;
+		}
+
+		std::vector<uint64_t> statistics(static_cast<size_t>(a_Frame.m_NumStatisticsQueries) * NUM_PIPELINE_STATISTICS);
+		const bool hasStatistics = a_Frame.m_NumStatisticsQueries > 0 && vkGetQueryPoolResults(m_Device, a_Frame.m_StatisticsPool, 0,
+			a_Frame.m_NumStatisticsQueries, statistics.size() * sizeof(uint64_t), statistics.data(),
+			NUM_PIPELINE_STATISTICS * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS;
+
+		GpuFrameTimings timings;
+		timings.m_FrameIndex = a_Frame.m_FrameCounter;
+		timings.m_Zones.reserve(numZones);
+
+		for (uint32_t i = 0; i < numZones; ++i)
+		{
+			const auto& zone = a_Frame.m_Zones[i];
+			const uint64_t start = timestamps[i * 2] & m_TimestampMask;
+			const uint64_t end = timestamps[i * 2 + 1] & m_TimestampMask;
+
+			auto& result = timings.m_Zones.emplace_back();
+			result.m_Name = zone.m_Name;
+			result.m_Depth = zone.m_Depth;
+			result.m_Milliseconds = end > start ? static_cast<double>(end - start) * m_TimestampPeriod / 1000000.0 : 0.0;
+
+			if (hasStatistics && zone.m_StatisticsQuery != INVALID_ZONE)
+			{
+				const uint64_t* zoneStatistics = &statistics[static_cast<size_t>(zone.m_StatisticsQuery) * NUM_PIPELINE_STATISTICS];
+				result.m_HasStatistics = true;
+				result.m_InputPrimitives = zoneStatistics[0];
+				result.m_VertexShaderInvocations = zoneStatistics[1];
+				result.m_ClippingPrimitives = zoneStatistics[2];
+				result.m_FragmentShaderInvocations = zoneStatistics[3];
+				result.m_ComputeShaderInvocations = zoneStatistics[4];
+			}
+
+			if (zone.m_Depth == 0)
+			{
+				timings.m_TotalMilliseconds += result.m_Milliseconds;
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(m_HistoryMutex);
+		m_History.emplace_back(std::move(timings));
+		while (m_History.size() > m_HistorySize)
+		{
+			m_History.pop_front();
+		}
+	}
+}
@@ -4,7 +4,7 @@
 
 namespace egg
 {
-	InputData::InputData() : m_KeyStates(), m_MouseStates()
+	InputData::InputData() : m_OldestEventTimestamp(0), m_NewestEventTimestamp(0), m_KeyStates(), m_MouseStates()
 	{
 		//Init keys to not pressed.
 		for (auto& keyState : m_KeyStates)
@@ -27,6 +27,12 @@ namespace egg
 		data.m_MouseEvents.swap(m_MouseEvents);
 		data.m_KeyboardEvents.swap(m_KeyboardEvents);
 
+		//The timestamps belong to the events that were taken.
+		data.m_OldestEventTimestamp = m_OldestEventTimestamp;
+		data.m_NewestEventTimestamp = m_NewestEventTimestamp;
+		m_OldestEventTimestamp = 0;
+		m_NewestEventTimestamp = 0;
+
 		//Copy the key events and reset any that were marked as PRESSED_RELEASED because they are no longer pressed.
 		for (auto i = 0; i < 512; i++)
 		{
@@ -101,6 +107,7 @@ namespace egg
 			m_MouseStates[static_cast<uint16_t>(event.button)] = ButtonState::PRESSED_RELEASED;
 		}
 
+		AddEventTimestamp(event.timestamp);
 		m_MouseEvents.push(event);
 	}
 
@@ -127,9 +134,38 @@ namespace egg
 			m_KeyStates[event.keyCode] = ButtonState::PRESSED_RELEASED;
 		}
 
+		AddEventTimestamp(event.timestamp);
 		m_KeyboardEvents.push(event);
 	}
 
+	std::uint64_t InputData::GetOldestEventTimestamp() const
+	{
+		return m_OldestEventTimestamp;
+	}
+
+	std::uint64_t InputData::GetNewestEventTimestamp() const
+	{
+		return m_NewestEventTimestamp;
+	}
+
+	void InputData::AddEventTimestamp(std::uint64_t a_Timestamp)
+	{
+		//Events that were created without a timestamp do not count.
+		if (a_Timestamp == 0)
+		{
+			return;
+		}
+
+		if (m_OldestEventTimestamp == 0 || a_Timestamp < m_OldestEventTimestamp)
+		{
+			m_OldestEventTimestamp = a_Timestamp;
+		}
+		if (a_Timestamp > m_NewestEventTimestamp)
+		{
+			m_NewestEventTimestamp = a_Timestamp;
+		}
+	}
+
 	ButtonState InputData::GetMouseButtonState(MouseButton button) const
 	{
 		return m_MouseStates[static_cast<std::uint8_t>(button)];
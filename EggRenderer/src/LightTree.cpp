@@ -0,0 +1,146 @@
+#include "LightTree.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace egg
+{
+	void LightTree::Build(const std::vector<PackedLightData>& a_Lights)
+	{
+		m_Nodes.clear();
+		m_Indices.clear();
+		m_ShadowedLights.clear();
+
+		for (uint32_t i = 0; i < static_cast<uint32_t>(a_Lights.size()); ++i)
+		{
+			if (a_Lights[i].m_ShadowIndex > -1)
+			{
+				m_ShadowedLights.push_back(a_Lights[i]);
+			}
+			else
+			{
+				m_Indices.push_back(i);
+			}
+		}
+
+		if (!m_Indices.empty())
+		{
+			//A binary tree has one node less than twice the amount of leaves.
+			m_Nodes.reserve(m_Indices.size() * 2 - 1);
+			m_Nodes.emplace_back();
+			BuildNode(a_Lights, 0, 0, static_cast<uint32_t>(m_Indices.size()));
+		}
+	}
+
+	void LightTree::SelectCut(const glm::vec3& a_CameraPosition, float a_PixelsPerUnit, float a_ErrorPixels, std::vector<PackedLightData>& a_Output)
+	{
+		a_Output.insert(a_Output.end(), m_ShadowedLights.begin(), m_ShadowedLights.end());
+		if (m_Nodes.empty())
+		{
+			return;
+		}
+
+		m_Stack.clear();
+		m_Stack.push_back(0);
+		while (!m_Stack.empty())
+		{
+			const auto& node = m_Nodes[m_Stack.back()];
+			m_Stack.pop_back();
+
+			if (node.m_FirstChild == 0)
+			{
+				a_Output.push_back(node.m_Representative);
+				continue;
+			}
+
+			//Merge the node when its bounding sphere is small on screen. The camera being inside it always splits the node.
+			const glm::vec3 center = (node.m_Min + node.m_Max) * 0.5f;
+			const float radius = glm::length(node.m_Max - node.m_Min) * 0.5f;
+			const float distance = glm::length(center - a_CameraPosition);
+			if (distance > radius && 2.f * radius / distance * a_PixelsPerUnit < a_ErrorPixels)
+			{
+				a_Output.push_back(node.m_Representative);
+				continue;
+			}
+
+			m_Stack.push_back(node.m_FirstChild);
+			m_Stack.push_back(node.m_FirstChild + 1);
+		}
+	}
+
+	void LightTree::BuildNode(const std::vector<PackedLightData>& a_Lights, uint32_t a_NodeIndex, uint32_t a_Begin, uint32_t a_End)
+	{
+		if (a_End - a_Begin == 1)
+		{
+			const auto& light = a_Lights[m_Indices[a_Begin]];
+			const glm::vec3 position(light.m_Data1);
+			const float radius = light.m_Data1.w;
+
+			auto& node = m_Nodes[a_NodeIndex];
+			node.m_Min = position - radius;
+			node.m_Max = position + radius;
+			node.m_FirstChild = 0;
+			node.m_Representative = light;
+			return;
+		}
+
+		//Split at the median of the light centers along the longest axis of their bounds.
+		glm::vec3 centerMin(a_Lights[m_Indices[a_Begin]].m_Data1);
+		glm::vec3 centerMax = centerMin;
+		for (uint32_t i = a_Begin + 1; i < a_End; ++i)
+		{
+			const glm::vec3 position(a_Lights[m_Indices[i]].m_Data1);
+			centerMin = glm::min(centerMin, position);
+			centerMax = glm::max(centerMax, position);
+		}
+
+		const glm::vec3 extent = centerMax - centerMin;
+		const int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+		const uint32_t middle = a_Begin + (a_End - a_Begin) / 2;
+		std::nth_element(m_Indices.begin() + a_Begin, m_Indices.begin() + middle, m_Indices.begin() + a_End,
+			[&a_Lights, axis](uint32_t a_First, uint32_t a_Second)
+			{
+				return a_Lights[a_First].m_Data1[axis] < a_Lights[a_Second].m_Data1[axis];
+			});
+
+		//Both children are added next to each other before either is built.
+		//Building adds more nodes, so nodes are only looked up again once both children are done.
+		const auto firstChild = static_cast<uint32_t>(m_Nodes.size());
+		m_Nodes.emplace_back();
+		m_Nodes.emplace_back();
+		BuildNode(a_Lights, firstChild, a_Begin, middle);
+		BuildNode(a_Lights, firstChild + 1, middle, a_End);
+
+		const auto& first = m_Nodes[firstChild];
+		const auto& second = m_Nodes[firstChild + 1];
+		auto& node = m_Nodes[a_NodeIndex];
+		node.m_Min = glm::min(first.m_Min, second.m_Min);
+		node.m_Max = glm::max(first.m_Max, second.m_Max);
+		node.m_FirstChild = firstChild;
+		node.m_Representative = MergeLights(first.m_Representative, second.m_Representative);
+	}
+
+	PackedLightData LightTree::MergeLights(const PackedLightData& a_First, const PackedLightData& a_Second)
+	{
+		//A sphere light lights a distant surface in proportion to its radiance times its projected area.
+		const float firstArea = a_First.m_Data1.w * a_First.m_Data1.w;
+		const float secondArea = a_Second.m_Data1.w * a_Second.m_Data1.w;
+		const glm::vec3 firstPower = glm::vec3(a_First.m_Data2) * firstArea;
+		const glm::vec3 secondPower = glm::vec3(a_Second.m_Data2) * secondArea;
+
+		//Place the light at the center of the emitted power, weighted by luminance.
+		const glm::vec3 luminance(0.2126f, 0.7152f, 0.0722f);
+		const float firstWeight = glm::dot(firstPower, luminance);
+		const float secondWeight = glm::dot(secondPower, luminance);
+		const float totalWeight = firstWeight + secondWeight;
+		const float blend = totalWeight > 0.f ? secondWeight / totalWeight : 0.5f;
+
+		//Merged lights have no contact shadow, as they stand in for lights that are spread out.
+		const float area = firstArea + secondArea;
+		PackedLightData merged{};
+		merged.m_Data1 = glm::vec4(glm::mix(glm::vec3(a_First.m_Data1), glm::vec3(a_Second.m_Data1), blend), std::sqrt(area));
+		merged.m_Data2 = glm::vec4(area > 0.f ? (firstPower + secondPower) / area : glm::vec3(0.f), 0.f);
+		merged.m_ShadowIndex = -1;
+		return merged;
+	}
+}
@@ -0,0 +1,97 @@
+#include "LiveResourceTracker.h"
+
+#include <cstdio>
+#include <mutex>
+#include <unordered_map>
+
+namespace egg
+{
+#ifndef NDEBUG
+	namespace
+	{
+		struct LiveResource
+		{
+			const char* m_Type;
+			const char* m_Function;
+			const void* m_ReturnAddress;
+			uint32_t m_CreationFrame;
+		};
+
+		std::mutex g_LiveResourceMutex;
+		std::unordered_map<const void*, LiveResource> g_LiveResources;
+
+		thread_local const char* t_CreationFunction = nullptr;
+		thread_local const void* t_CreationReturnAddress = nullptr;
+	}
+#endif
+
+	LiveResourceTracker::CreationSiteScope::CreationSiteScope(const char* a_Function, const void* a_ReturnAddress) : m_Outermost(false)
+	{
+#ifndef NDEBUG
+		if (t_CreationFunction == nullptr)
+		{
+			t_CreationFunction = a_Function;
+			t_CreationReturnAddress = a_ReturnAddress;
+			m_Outermost = true;
+		}
+#else
+		(void)a_Function;
+		(void)a_ReturnAddress;
+#endif
+	}
+
+	LiveResourceTracker::CreationSiteScope::~CreationSiteScope()
+	{
+#ifndef NDEBUG
+		if (m_Outermost)
+		{
+			t_CreationFunction = nullptr;
+			t_CreationReturnAddress = nullptr;
+		}
+#endif
+	}
+
+	void LiveResourceTracker::Register(const void* a_Resource, const char* a_Type, uint32_t a_CreationFrame)
+	{
+#ifndef NDEBUG
+		std::lock_guard<std::mutex> lock(g_LiveResourceMutex);
+		g_LiveResources[a_Resource] = LiveResource{ a_Type, t_CreationFunction, t_CreationReturnAddress, a_CreationFrame };
+#else
+		(void)a_Resource;
+		(void)a_Type;
+		(void)a_CreationFrame;
+#endif
+	}
+
+	void LiveResourceTracker::Unregister(const void* a_Resource)
+	{
+#ifndef NDEBUG
+		std::lock_guard<std::mutex> lock(g_LiveResourceMutex);
+		g_LiveResources.erase(a_Resource);
+#else
+		(void)a_Resource;
+#endif
+	}
+
+	std::vector<LiveResourceInfo> LiveResourceTracker::GetLiveResources()
+	{
+		std::vector<LiveResourceInfo> resources;
+#ifndef NDEBUG
+		std::lock_guard<std::mutex> lock(g_LiveResourceMutex);
+		resources.reserve(g_LiveResources.size());
+		for (const auto& entry : g_LiveResources)
+		{
+			const auto& resource = entry.second;
+			auto& info = resources.emplace_back();
+			info.m_Type = resource.m_Type;
+			info.m_CreationFrame = resource.m_CreationFrame;
+
+			//The return address can be resolved to a line of code in the debugger.
+			char site[256];
+			snprintf(site, sizeof(site), "%s called from %p", resource.m_Function != nullptr ? resource.m_Function : "Unknown", resource.m_ReturnAddress);
+			info.m_CreationSite = site;
+		}
+#endif
+		return resources;
+	}
+}
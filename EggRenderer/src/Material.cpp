@@ -11,6 +11,11 @@ namespace egg
         m_Textures = a_Info.m_MaterialTextures;
     }
 
+    Material::~Material()
+    {
+        LiveResourceTracker::Unregister(this);
+    }
+
     glm::vec3 Material::GetAlbedoFactor() const
     {
         return m_AlbedoFactor;
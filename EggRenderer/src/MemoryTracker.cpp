@@ -0,0 +1,76 @@
+#include "MemoryTracker.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+
+namespace egg
+{
+	namespace
+	{
+		constexpr uint32_t NUM_CATEGORIES = static_cast<uint32_t>(MemoryCategory::MAX_ENUM);
+
+		std::atomic<uint64_t> g_CategoryBytes[NUM_CATEGORIES]{};
+		std::atomic<uint32_t> g_CategoryAllocations[NUM_CATEGORIES]{};
+
+		/*
+		 * The category is stored in the user data with an offset of one, so that untracked allocations (nullptr) can be detected.
+		 */
+		void* CategoryToUserData(MemoryCategory a_Category)
+		{
+			return reinterpret_cast<void*>(static_cast<uintptr_t>(a_Category) + 1);
+		}
+
+		bool UserDataToCategory(void* a_UserData, uint32_t& a_Category)
+		{
+			const auto value = reinterpret_cast<uintptr_t>(a_UserData);
+			if (value == 0 || value > NUM_CATEGORIES)
+			{
+				return false;
+			}
+			a_Category = static_cast<uint32_t>(value - 1);
+			return true;
+		}
+	}
+
+	void MemoryTracker::Track(VmaAllocator a_Allocator, VmaAllocation a_Allocation, MemoryCategory a_Category)
+	{
+		VmaAllocationInfo info;
+		vmaGetAllocationInfo(a_Allocator, a_Allocation, &info);
+		vmaSetAllocationUserData(a_Allocator, a_Allocation, CategoryToUserData(a_Category));
+
+		const auto category = static_cast<uint32_t>(a_Category);
+		g_CategoryBytes[category] += info.size;
+		++g_CategoryAllocations[category];
+	}
+
+	void MemoryTracker::Untrack(VmaAllocator a_Allocator, VmaAllocation a_Allocation)
+	{
+		if (a_Allocation == nullptr)
+		{
+			return;
+		}
+
+		VmaAllocationInfo info;
+		vmaGetAllocationInfo(a_Allocator, a_Allocation, &info);
+
+		uint32_t category;
+		if (!UserDataToCategory(info.pUserData, category))
+		{
+			return;
+		}
+
+		g_CategoryBytes[category] -= info.size;
+		--g_CategoryAllocations[category];
+		vmaSetAllocationUserData(a_Allocator, a_Allocation, nullptr);
+	}
+
+	void MemoryTracker::GetCategoryUsage(MemoryReport& a_Report)
+	{
+		for (uint32_t i = 0; i < NUM_CATEGORIES; ++i)
+		{
+			a_Report.m_Categories[i].m_Bytes = g_CategoryBytes[i].load();
+			a_Report.m_Categories[i].m_NumAllocations = g_CategoryAllocations[i].load();
+		}
+	}
+}
@@ -0,0 +1,164 @@
+#include "MeshCache.h"
+
+#include <cstring>
+
+namespace egg
+{
+	MeshCache::MeshCache() : m_NumInsertsSinceSweep(0)
+	{
+	}
+
+	std::string MeshCache::CreateKey(const StaticMeshCreateInfo& a_CreateInfo)
+	{
+		const size_t vertexSize = sizeof(Vertex) * a_CreateInfo.m_NumVertices;
+		const size_t indexSize = sizeof(uint32_t) * a_CreateInfo.m_NumIndices;
+
+		//Two differently seeded hashes of both buffers. The first byte keeps geometry and shape keys apart.
+		const uint64_t values[] =
+		{
+			Hash(a_CreateInfo.m_VertexBuffer, vertexSize, 0x243F6A8885A308D3ull),
+			Hash(a_CreateInfo.m_VertexBuffer, vertexSize, 0x13198A2E03707344ull),
+			Hash(a_CreateInfo.m_IndexBuffer, indexSize, 0xA4093822299F31D0ull),
+			Hash(a_CreateInfo.m_IndexBuffer, indexSize, 0x082EFA98EC4E6C89ull),
+			(static_cast<uint64_t>(a_CreateInfo.m_NumVertices) << 32) | a_CreateInfo.m_NumIndices
+		};
+
+		std::string key(1, 'G');
+		key.append(reinterpret_cast<const char*>(values), sizeof(values));
+		return key;
+	}
+
+	std::string MeshCache::CreateKey(const ShapeCreateInfo& a_CreateInfo)
+	{
+		std::string key(1, 'S');
+		const auto append = [&key](const void* a_Data, size_t a_Size)
+		{
+			key.append(static_cast<const char*>(a_Data), a_Size);
+		};
+
+		append(&a_CreateInfo.m_ShapeType, sizeof(a_CreateInfo.m_ShapeType));
+		append(&a_CreateInfo.m_Radius, sizeof(a_CreateInfo.m_Radius));
+		if (a_CreateInfo.m_ShapeType == Shape::SPHERE)
+		{
+			append(&a_CreateInfo.m_Sphere.m_StackCount, sizeof(a_CreateInfo.m_Sphere.m_StackCount));
+			append(&a_CreateInfo.m_Sphere.m_SectorCount, sizeof(a_CreateInfo.m_Sphere.m_SectorCount));
+		}
+		append(&a_CreateInfo.m_InitialTransform, sizeof(a_CreateInfo.m_InitialTransform));
+		return key;
+	}
+
+	std::shared_ptr<EggStaticMesh> MeshCache::Find(const std::string& a_Key)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		const auto found = m_Entries.find(a_Key);
+		if (found == m_Entries.end())
+		{
+			return nullptr;
+		}
+		return found->second.m_Mesh.lock();
+	}
+
+	std::shared_ptr<EggStaticMesh> MeshCache::Find(const std::string& a_Key, const StaticMeshCreateInfo& a_Geometry)
+	{
+		const size_t vertexSize = sizeof(Vertex) * a_Geometry.m_NumVertices;
+		const size_t indexSize = sizeof(uint32_t) * a_Geometry.m_NumIndices;
+
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		const auto found = m_Entries.find(a_Key);
+		if (found == m_Entries.end())
+		{
+			return nullptr;
+		}
+
+		//Equal hashes do not guarantee equal geometry.
+		const auto& contents = found->second.m_Contents;
+		if (contents.size() != vertexSize + indexSize
+			|| (vertexSize != 0 && memcmp(contents.data(), a_Geometry.m_VertexBuffer, vertexSize) != 0)
+			|| (indexSize != 0 && memcmp(contents.data() + vertexSize, a_Geometry.m_IndexBuffer, indexSize) != 0))
+		{
+			return nullptr;
+		}
+		return found->second.m_Mesh.lock();
+	}
+
+	void MeshCache::Insert(const std::string& a_Key, const std::shared_ptr<EggStaticMesh>& a_Mesh)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		InsertEntry(a_Key, Entry{ a_Mesh, std::string() });
+	}
+
+	void MeshCache::Insert(const std::string& a_Key, const StaticMeshCreateInfo& a_Geometry, const std::shared_ptr<EggStaticMesh>& a_Mesh)
+	{
+		const size_t vertexSize = sizeof(Vertex) * a_Geometry.m_NumVertices;
+		const size_t indexSize = sizeof(uint32_t) * a_Geometry.m_NumIndices;
+
+		//Copied before locking, as the geometry may be large.
+		Entry entry{ a_Mesh, std::string() };
+		entry.m_Contents.reserve(vertexSize + indexSize);
+		entry.m_Contents.append(reinterpret_cast<const char*>(a_Geometry.m_VertexBuffer), vertexSize);
+		entry.m_Contents.append(reinterpret_cast<const char*>(a_Geometry.m_IndexBuffer), indexSize);
+
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		InsertEntry(a_Key, std::move(entry));
+	}
+
+	void MeshCache::InsertEntry(const std::string& a_Key, Entry&& a_Entry)
+	{
+		m_Entries[a_Key] = std::move(a_Entry);
+
+		//Sweeping when the inserts catch up with the size keeps the cost per insert constant.
+		if (++m_NumInsertsSinceSweep >= m_Entries.size())
+		{
+			for (auto itr = m_Entries.begin(); itr != m_Entries.end();)
+			{
+				itr = itr->second.m_Mesh.expired() ? m_Entries.erase(itr) : std::next(itr);
+			}
+			m_NumInsertsSinceSweep = 0;
+		}
+	}
+
+	void MeshCache::Clear()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Entries.clear();
+		m_NumInsertsSinceSweep = 0;
+	}
+
+	uint64_t MeshCache::Hash(const void* a_Data, size_t a_Size, uint64_t a_Seed)
+	{
+		constexpr uint64_t multiplier = 0x9E3779B97F4A7C15ull;
+		uint64_t hash = a_Seed ^ (a_Size * multiplier);
+
+		//Empty ranges may come without data, so nothing is read from them.
+		if (a_Size == 0)
+		{
+			return hash;
+		}
+
+		const auto* bytes = static_cast<const uint8_t*>(a_Data);
+
+		size_t offset = 0;
+		for (; offset + sizeof(uint64_t) <= a_Size; offset += sizeof(uint64_t))
+		{
+			uint64_t word;
+			memcpy(&word, bytes + offset, sizeof(word));
+			word *= multiplier;
+			word ^= word >> 32;
+			hash = (hash ^ word) * multiplier;
+			hash ^= hash >> 29;
+		}
+
+		//Remaining bytes are padded with zeroes. The size is already part of the seed.
+		uint64_t tail = 0;
+		memcpy(&tail, bytes + offset, a_Size - offset);
+		hash = (hash ^ (tail * multiplier)) * multiplier;
+
+		//Final mix so that every input bit affects every output bit.
+		hash ^= hash >> 33;
+		hash *= 0xFF51AFD7ED558CCDull;
+		hash ^= hash >> 33;
+		hash *= 0xC4CEB9FE1A85EC53ull;
+		hash ^= hash >> 33;
+		return hash;
+	}
+}
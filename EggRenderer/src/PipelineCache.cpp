@@ -0,0 +1,555 @@
+#include "PipelineCache.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <type_traits>
+#include <utility>
+
+#include "ThreadPool.h"
+
+namespace egg
+{
+	namespace
+	{
+		/*
+		 * Append the bytes of a value to a key. Only used for types without padding, so that equal values give equal keys.
+		 */
+		template<typename T>
+		void AppendKey(std::string& a_Key, const T& a_Value)
+		{
+			static_assert(std::is_trivially_copyable<T>::value, "Only plain values can be appended to a key.");
+			a_Key.append(reinterpret_cast<const char*>(&a_Value), sizeof(T));
+		}
+
+		void AppendKey(std::string& a_Key, const std::string& a_Value)
+		{
+			AppendKey(a_Key, static_cast<uint32_t>(a_Value.size()));
+			a_Key.append(a_Value);
+		}
+
+		/*
+		 * Compute pipelines consist of a single compute shader, and have no render pass or fixed function state.
+		 */
+		bool IsComputePipeline(const PipelineCreateInfo& a_CreateInfo)
+		{
+			return a_CreateInfo.m_Shaders.size() == 1 && a_CreateInfo.m_Shaders[0].m_ShaderStage == VK_SHADER_STAGE_COMPUTE_BIT;
+		}
+	}
+
+	PipelineCache::PipelineCache() : m_Device(nullptr), m_VulkanCache(VK_NULL_HANDLE), m_ThreadPool(nullptr)
+	{
+	}
+
+	bool PipelineCache::Init(VkDevice a_Device, const std::string& a_ShadersPath, ThreadPool& a_ThreadPool)
+	{
+		m_Device = a_Device;
+		m_ShadersPath = a_ShadersPath;
+		m_ThreadPool = &a_ThreadPool;
+
+		VkPipelineCacheCreateInfo cacheInfo{};
+		cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		if (vkCreatePipelineCache(m_Device, &cacheInfo, nullptr, &m_VulkanCache) != VK_SUCCESS)
+		{
+			printf("Could not create Vulkan pipeline cache!\n");
+			return false;
+		}
+
+		return true;
+	}
+
+	void PipelineCache::CleanUp()
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+
+		//Released requests may still be compiling on the thread pool.
+		m_CompiledCondition.wait(lock, [this]()
+		{
+			return std::none_of(m_Pipelines.begin(), m_Pipelines.end(), [](const auto& a_Entry) { return a_Entry.second.m_State == PipelineState::COMPILING; });
+		});
+
+		for (auto& pipeline : m_Pipelines)
+		{
+			assert(pipeline.second.m_NumUsers == 0 && "Pipelines are still in use while destroying the pipeline cache!");
+			vkDestroyPipeline(m_Device, pipeline.second.m_Data.m_Pipeline, nullptr);
+			vkDestroyPipelineLayout(m_Device, pipeline.second.m_Data.m_PipelineLayout, nullptr);
+		}
+		m_Pipelines.clear();
+		m_PipelineKeys.clear();
+
+		for (auto& renderPass : m_RenderPasses)
+		{
+			vkDestroyRenderPass(m_Device, renderPass.second, nullptr);
+		}
+		m_RenderPasses.clear();
+
+		for (auto& module : m_ShaderModules)
+		{
+			vkDestroyShaderModule(m_Device, module.second.m_Module, nullptr);
+		}
+		m_ShaderModules.clear();
+
+		vkDestroyPipelineCache(m_Device, m_VulkanCache, nullptr);
+		m_VulkanCache = VK_NULL_HANDLE;
+	}
+
+	bool PipelineCache::Acquire(const PipelineCreateInfo& a_CreateInfo, PipelineData& a_Result)
+	{
+		const std::string key = CreateKey(a_CreateInfo);
+		std::unique_lock<std::mutex> lock(m_Mutex);
+
+		//Add the entry when it does not exist yet, and compile it on this thread.
+		auto found = m_Pipelines.find(key);
+		if (found == m_Pipelines.end())
+		{
+			m_Pipelines[key].m_NumUsers = 1;
+			lock.unlock();
+			Compile(key, a_CreateInfo);
+			lock.lock();
+		}
+		else
+		{
+			++found->second.m_NumUsers;
+		}
+
+		//Elements of the map keep their address, and this entry is not erased while it is counted as used.
+		auto& entry = m_Pipelines.at(key);
+		m_CompiledCondition.wait(lock, [&entry]() { return entry.m_State != PipelineState::COMPILING; });
+		if (entry.m_State == PipelineState::FAILED)
+		{
+			ReleaseEntry(key);
+			return false;
+		}
+
+		a_Result = entry.m_Data;
+		return true;
+	}
+
+	void PipelineCache::AcquireAsync(const PipelineCreateInfo& a_CreateInfo, AsyncPipeline& a_Result)
+	{
+		a_Result = AsyncPipeline{};
+		a_Result.m_Key = CreateKey(a_CreateInfo);
+
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			const auto found = m_Pipelines.find(a_Result.m_Key);
+			if (found != m_Pipelines.end())
+			{
+				++found->second.m_NumUsers;
+				return;
+			}
+			m_Pipelines[a_Result.m_Key].m_NumUsers = 1;
+		}
+
+		//The create info is copied, as the caller's copy goes out of scope before the task runs.
+		m_ThreadPool->enqueue([this, key = a_Result.m_Key, createInfo = a_CreateInfo]()
+		{
+			Compile(key, createInfo);
+		});
+	}
+
+	PipelineState PipelineCache::Poll(AsyncPipeline& a_Pipeline)
+	{
+		if (a_Pipeline.m_Ready)
+		{
+			return PipelineState::READY;
+		}
+		if (a_Pipeline.m_Key.empty())
+		{
+			return PipelineState::FAILED;
+		}
+
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		const auto& entry = m_Pipelines.at(a_Pipeline.m_Key);
+		if (entry.m_State != PipelineState::READY)
+		{
+			return entry.m_State;
+		}
+
+		a_Pipeline.m_Data = entry.m_Data;
+		a_Pipeline.m_Ready = true;
+		return PipelineState::READY;
+	}
+
+	void PipelineCache::Release(PipelineData& a_Pipeline)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		const auto foundKey = m_PipelineKeys.find(a_Pipeline.m_Pipeline);
+		a_Pipeline = PipelineData{};
+		if (foundKey == m_PipelineKeys.end())
+		{
+			return;
+		}
+
+		const std::string key = foundKey->second;
+		ReleaseEntry(key);
+	}
+
+	void PipelineCache::Release(AsyncPipeline& a_Pipeline)
+	{
+		const std::string key = std::move(a_Pipeline.m_Key);
+		a_Pipeline = AsyncPipeline{};
+		if (key.empty())
+		{
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		ReleaseEntry(key);
+	}
+
+	void PipelineCache::DestroyUnused()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		//Failed entries are erased as soon as they have no users. Compiling entries are destroyed by a later call once they are ready.
+		for (auto itr = m_Pipelines.begin(); itr != m_Pipelines.end();)
+		{
+			auto& entry = itr->second;
+			if (entry.m_NumUsers == 0 && entry.m_State == PipelineState::READY)
+			{
+				vkDestroyPipeline(m_Device, entry.m_Data.m_Pipeline, nullptr);
+				vkDestroyPipelineLayout(m_Device, entry.m_Data.m_PipelineLayout, nullptr);
+				m_PipelineKeys.erase(entry.m_Data.m_Pipeline);
+				for (auto& moduleKey : entry.m_ShaderModuleKeys)
+				{
+					ReleaseShaderModule(moduleKey);
+				}
+				itr = m_Pipelines.erase(itr);
+			}
+			else
+			{
+				++itr;
+			}
+		}
+
+		for (auto itr = m_ShaderModules.begin(); itr != m_ShaderModules.end();)
+		{
+			if (itr->second.m_NumUsers == 0)
+			{
+				vkDestroyShaderModule(m_Device, itr->second.m_Module, nullptr);
+				itr = m_ShaderModules.erase(itr);
+			}
+			else
+			{
+				++itr;
+			}
+		}
+	}
+
+	uint32_t PipelineCache::GetPipelineCount() const
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		return static_cast<uint32_t>(m_Pipelines.size());
+	}
+
+	uint32_t PipelineCache::GetShaderModuleCount() const
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		return static_cast<uint32_t>(m_ShaderModules.size());
+	}
+
+	bool PipelineCache::RegisterRenderPass(const VkRenderPassCreateInfo& a_CreateInfo, std::string& a_Key)
+	{
+		a_Key = CreateRenderPassKey(a_CreateInfo);
+
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		if (m_RenderPasses.find(a_Key) != m_RenderPasses.end())
+		{
+			return true;
+		}
+
+		VkRenderPass renderPass;
+		if (vkCreateRenderPass(m_Device, &a_CreateInfo, nullptr, &renderPass) != VK_SUCCESS)
+		{
+			printf("Could not create render pass for the pipeline cache!\n");
+			return false;
+		}
+		m_RenderPasses.emplace(a_Key, renderPass);
+		return true;
+	}
+
+	std::string PipelineCache::CreateRenderPassKey(const VkRenderPassCreateInfo& a_CreateInfo)
+	{
+		std::string key;
+		key.reserve(256);
+
+		//Attachments only differ in their layouts and load and store operations between compatible render passes.
+		AppendKey(key, a_CreateInfo.flags);
+		AppendKey(key, a_CreateInfo.attachmentCount);
+		for (uint32_t index = 0; index < a_CreateInfo.attachmentCount; ++index)
+		{
+			const auto& attachment = a_CreateInfo.pAttachments[index];
+			AppendKey(key, attachment.flags);
+			AppendKey(key, attachment.format);
+			AppendKey(key, attachment.samples);
+		}
+
+		//References are compared by the attachment they refer to. Their layouts do not matter.
+		const auto appendReferences = [&key](uint32_t a_Count, const VkAttachmentReference* a_References)
+		{
+			AppendKey(key, a_References == nullptr ? 0u : a_Count);
+			for (uint32_t index = 0; a_References != nullptr && index < a_Count; ++index)
+			{
+				AppendKey(key, a_References[index].attachment);
+			}
+		};
+
+		AppendKey(key, a_CreateInfo.subpassCount);
+		for (uint32_t index = 0; index < a_CreateInfo.subpassCount; ++index)
+		{
+			const auto& subpass = a_CreateInfo.pSubpasses[index];
+			AppendKey(key, subpass.flags);
+			AppendKey(key, subpass.pipelineBindPoint);
+			appendReferences(subpass.inputAttachmentCount, subpass.pInputAttachments);
+			appendReferences(subpass.colorAttachmentCount, subpass.pColorAttachments);
+			appendReferences(subpass.colorAttachmentCount, subpass.pResolveAttachments);
+			appendReferences(1, subpass.pDepthStencilAttachment);
+			AppendKey(key, subpass.preserveAttachmentCount);
+			for (uint32_t preserveIndex = 0; preserveIndex < subpass.preserveAttachmentCount; ++preserveIndex)
+			{
+				AppendKey(key, subpass.pPreserveAttachments[preserveIndex]);
+			}
+		}
+
+		AppendKey(key, a_CreateInfo.dependencyCount);
+		for (uint32_t index = 0; index < a_CreateInfo.dependencyCount; ++index)
+		{
+			AppendKey(key, a_CreateInfo.pDependencies[index]);
+		}
+
+		return key;
+	}
+
+	std::string PipelineCache::CreateKey(const PipelineCreateInfo& a_CreateInfo)
+	{
+		std::string key;
+		key.reserve(256);
+
+		AppendKey(key, static_cast<uint32_t>(a_CreateInfo.m_Shaders.size()));
+		for (auto& shader : a_CreateInfo.m_Shaders)
+		{
+			AppendKey(key, shader.m_ShaderFileName);
+			AppendKey(key, shader.m_ShaderEntryPoint);
+			AppendKey(key, shader.m_ShaderStage);
+		}
+
+		AppendKey(key, static_cast<uint32_t>(a_CreateInfo.vertexData.m_VertexBindings.size()));
+		for (auto& binding : a_CreateInfo.vertexData.m_VertexBindings)
+		{
+			AppendKey(key, binding.binding);
+			AppendKey(key, binding.stride);
+			AppendKey(key, binding.inputRate);
+		}
+		AppendKey(key, static_cast<uint32_t>(a_CreateInfo.vertexData.m_VertexAttributes.size()));
+		for (auto& attribute : a_CreateInfo.vertexData.m_VertexAttributes)
+		{
+			AppendKey(key, attribute.location);
+			AppendKey(key, attribute.binding);
+			AppendKey(key, attribute.format);
+			AppendKey(key, attribute.offset);
+		}
+		AppendKey(key, a_CreateInfo.inputAssembly.m_Topology);
+
+		AppendKey(key, static_cast<uint32_t>(a_CreateInfo.pushConstants.m_PushConstantRanges.size()));
+		for (auto& range : a_CreateInfo.pushConstants.m_PushConstantRanges)
+		{
+			AppendKey(key, range.stageFlags);
+			AppendKey(key, range.offset);
+			AppendKey(key, range.size);
+		}
+		//Layouts are keyed by their definition, as stages create them again with new handles after a resize.
+		const auto& descriptors = a_CreateInfo.descriptors;
+		assert(descriptors.m_Bindings.size() == descriptors.m_Layouts.size() && descriptors.m_BindingFlags.size() == descriptors.m_Layouts.size()
+			&& "Descriptor set layouts have to be added with their bindings!");
+		AppendKey(key, static_cast<uint32_t>(descriptors.m_Layouts.size()));
+		for (size_t layoutIndex = 0; layoutIndex < descriptors.m_Layouts.size(); ++layoutIndex)
+		{
+			AppendKey(key, static_cast<uint32_t>(descriptors.m_Bindings[layoutIndex].size()));
+			for (auto& binding : descriptors.m_Bindings[layoutIndex])
+			{
+				assert(binding.pImmutableSamplers == nullptr && "Immutable samplers are not part of the pipeline key!");
+				AppendKey(key, binding.binding);
+				AppendKey(key, binding.descriptorType);
+				AppendKey(key, binding.descriptorCount);
+				AppendKey(key, binding.stageFlags);
+			}
+			AppendKey(key, static_cast<uint32_t>(descriptors.m_BindingFlags[layoutIndex].size()));
+			for (auto& flags : descriptors.m_BindingFlags[layoutIndex])
+			{
+				AppendKey(key, flags);
+			}
+		}
+
+		//Everything below is ignored when creating a compute pipeline.
+		if (IsComputePipeline(a_CreateInfo))
+		{
+			return key;
+		}
+
+		//The render pass handle is left out, so that pipelines are shared with compatible render passes.
+		assert(!a_CreateInfo.renderPass.m_CompatibilityKey.empty() && "Pipelines need the compatibility key of their render pass!");
+		AppendKey(key, a_CreateInfo.renderPass.m_CompatibilityKey);
+		AppendKey(key, a_CreateInfo.renderPass.m_SubpassIndex);
+		AppendKey(key, a_CreateInfo.attachments.m_NumAttachments);
+		AppendKey(key, a_CreateInfo.attachments.m_AlphaBlending);
+
+		AppendKey(key, a_CreateInfo.depth.m_UseDepth);
+		AppendKey(key, a_CreateInfo.depth.m_WriteDepth);
+		AppendKey(key, a_CreateInfo.depth.m_DepthFormat);
+		AppendKey(key, a_CreateInfo.depth.m_CompareOp);
+		AppendKey(key, a_CreateInfo.culling.m_FrontFace);
+		AppendKey(key, a_CreateInfo.culling.m_CullMode);
+
+		return key;
+	}
+
+	void PipelineCache::Compile(const std::string& a_Key, const PipelineCreateInfo& a_CreateInfo)
+	{
+		//Compile with objects owned by the cache, as the ones in a_CreateInfo belong to a stage that may be destroyed while compiling.
+		//The pipeline does not refer to the layouts once it is created, so the copies are destroyed right away.
+		PipelineCreateInfo createInfo = a_CreateInfo;
+		const bool isCompute = IsComputePipeline(createInfo);
+		if (!isCompute)
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			const auto found = m_RenderPasses.find(createInfo.renderPass.m_CompatibilityKey);
+			assert(found != m_RenderPasses.end() && "Pipelines need a render pass that was registered with the pipeline cache!");
+			createInfo.renderPass.m_RenderPass = found != m_RenderPasses.end() ? found->second : VK_NULL_HANDLE;
+		}
+
+		auto& descriptors = createInfo.descriptors;
+		bool success = isCompute || createInfo.renderPass.m_RenderPass != VK_NULL_HANDLE;
+		for (size_t layoutIndex = 0; layoutIndex < descriptors.m_Layouts.size(); ++layoutIndex)
+		{
+			descriptors.m_Layouts[layoutIndex] = VK_NULL_HANDLE;
+			if (success)
+			{
+				success = RenderUtility::CreateDescriptorSetLayout(m_Device, descriptors.m_Bindings[layoutIndex], descriptors.m_BindingFlags[layoutIndex], descriptors.m_Layouts[layoutIndex]);
+			}
+		}
+
+		std::vector<VkShaderModule> shaderModules;
+		std::vector<std::string> shaderModuleKeys;
+		shaderModules.reserve(a_CreateInfo.m_Shaders.size());
+		shaderModuleKeys.reserve(a_CreateInfo.m_Shaders.size());
+
+		for (size_t shaderIndex = 0; success && shaderIndex < createInfo.m_Shaders.size(); ++shaderIndex)
+		{
+			const auto& shader = createInfo.m_Shaders[shaderIndex];
+			VkShaderModule module;
+			if (!AcquireShaderModule(shader.m_ShaderFileName, module))
+			{
+				success = false;
+				break;
+			}
+			shaderModules.push_back(module);
+			shaderModuleKeys.push_back(shader.m_ShaderFileName);
+		}
+
+		PipelineData data;
+		if (success)
+		{
+			success = isCompute
+				? RenderUtility::CreateComputePipeline(createInfo, m_Device, shaderModules[0], m_VulkanCache, data)
+				: RenderUtility::CreatePipeline(createInfo, m_Device, shaderModules, m_VulkanCache, data);
+		}
+
+		for (auto layout : descriptors.m_Layouts)
+		{
+			vkDestroyDescriptorSetLayout(m_Device, layout, nullptr);
+		}
+
+		//Notified while holding the lock, so that CleanUp() can not destroy the cache before this thread is done with it.
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		auto& entry = m_Pipelines.at(a_Key);
+		if (success)
+		{
+			entry.m_Data = data;
+			entry.m_ShaderModuleKeys = std::move(shaderModuleKeys);
+			entry.m_State = PipelineState::READY;
+			m_PipelineKeys.emplace(data.m_Pipeline, a_Key);
+		}
+		else
+		{
+			for (auto& moduleKey : shaderModuleKeys)
+			{
+				ReleaseShaderModule(moduleKey);
+			}
+			entry.m_State = PipelineState::FAILED;
+			printf("Could not compile pipeline with shader %s!\n", createInfo.m_Shaders.empty() ? "" : createInfo.m_Shaders[0].m_ShaderFileName.c_str());
+
+			//Nobody is waiting for a request that was released while compiling, so it is forgotten right away.
+			if (entry.m_NumUsers == 0)
+			{
+				m_Pipelines.erase(a_Key);
+			}
+		}
+		m_CompiledCondition.notify_all();
+	}
+
+	bool PipelineCache::AcquireShaderModule(const std::string& a_FileName, VkShaderModule& a_Module)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			const auto found = m_ShaderModules.find(a_FileName);
+			if (found != m_ShaderModules.end())
+			{
+				++found->second.m_NumUsers;
+				a_Module = found->second.m_Module;
+				return true;
+			}
+		}
+
+		const std::string path = m_ShadersPath + a_FileName;
+		VkShaderModule module;
+		if (!RenderUtility::CreateShaderModuleFromSpirV(path, module, m_Device))
+		{
+			printf("Could not create shader from file: %s.\n", path.c_str());
+			return false;
+		}
+
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		//Another thread may have loaded the same file in the meantime, in which case its module is used.
+		const auto found = m_ShaderModules.find(a_FileName);
+		if (found != m_ShaderModules.end())
+		{
+			vkDestroyShaderModule(m_Device, module, nullptr);
+			++found->second.m_NumUsers;
+			a_Module = found->second.m_Module;
+			return true;
+		}
+
+		ShaderModuleEntry entry;
+		entry.m_Module = module;
+		entry.m_NumUsers = 1;
+		m_ShaderModules.emplace(a_FileName, entry);
+		a_Module = module;
+		return true;
+	}
+
+	void PipelineCache::ReleaseShaderModule(const std::string& a_FileName)
+	{
+		const auto found = m_ShaderModules.find(a_FileName);
+		assert(found != m_ShaderModules.end() && found->second.m_NumUsers > 0 && "Shader module released more often than acquired!");
+		--found->second.m_NumUsers;
+	}
+
+	void PipelineCache::ReleaseEntry(const std::string& a_Key)
+	{
+		auto& entry = m_Pipelines.at(a_Key);
+		assert(entry.m_NumUsers > 0 && "Pipeline released more often than acquired!");
+		if (--entry.m_NumUsers > 0)
+		{
+			return;
+		}
+
+		//Compiled pipelines are kept for stages that are created again, failed ones are tried again by the next request.
+		//Pipelines that are still compiling are handled by Compile() once they are done.
+		if (entry.m_State == PipelineState::FAILED)
+		{
+			m_Pipelines.erase(a_Key);
+		}
+	}
+}
@@ -0,0 +1,136 @@
+#include "PresentWaiter.h"
+
+#include <cstdio>
+
+#include "api/Timer.h"
+
+namespace egg
+{
+	PresentWaiter::PresentWaiter() : m_Device(nullptr), m_WaitForPresent(nullptr), m_SwapChain(nullptr), m_NextPresentId(1), m_Running(false)
+	{
+	}
+
+	PresentWaiter::~PresentWaiter()
+	{
+		Stop();
+	}
+
+	void PresentWaiter::Init(VkDevice a_Device, bool a_Supported)
+	{
+		m_Device = a_Device;
+		m_WaitForPresent = nullptr;
+
+		if (a_Supported)
+		{
+			m_WaitForPresent = reinterpret_cast<PFN_vkWaitForPresentKHR>(vkGetDeviceProcAddr(a_Device, "vkWaitForPresentKHR"));
+			if (m_WaitForPresent == nullptr)
+			{
+				printf("Present latency disabled: could not load vkWaitForPresentKHR.\n");
+			}
+		}
+	}
+
+	bool PresentWaiter::IsEnabled() const
+	{
+		return m_WaitForPresent != nullptr;
+	}
+
+	void PresentWaiter::Start(VkSwapchainKHR a_SwapChain)
+	{
+		Stop();
+		if (!IsEnabled())
+		{
+			return;
+		}
+
+		m_SwapChain = a_SwapChain;
+		m_Running = true;
+		m_Thread = std::thread(&PresentWaiter::WaitForPresents, this);
+	}
+
+	void PresentWaiter::Stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Running = false;
+		}
+		m_Condition.notify_all();
+
+		if (m_Thread.joinable())
+		{
+			m_Thread.join();
+		}
+
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_PendingPresents.clear();
+		m_SwapChain = nullptr;
+	}
+
+	uint64_t PresentWaiter::GetNextPresentId()
+	{
+		return m_NextPresentId++;
+	}
+
+	void PresentWaiter::AddPresent(uint64_t a_PresentId)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			if (!m_Running)
+			{
+				return;
+			}
+			m_PendingPresents.push_back(a_PresentId);
+		}
+		m_Condition.notify_one();
+	}
+
+	bool PresentWaiter::GetPresentTimestamp(uint64_t a_PresentId, uint64_t& a_Timestamp) const
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		for (const auto& present : m_CompletedPresents)
+		{
+			if (present.first == a_PresentId)
+			{
+				a_Timestamp = present.second;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void PresentWaiter::WaitForPresents()
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		while (true)
+		{
+			m_Condition.wait(lock, [this]() { return !m_Running || !m_PendingPresents.empty(); });
+			if (!m_Running)
+			{
+				return;
+			}
+
+			//Don't hold the lock while waiting, so that the render thread can keep adding presents.
+			const uint64_t presentId = m_PendingPresents.front();
+			lock.unlock();
+			const VkResult result = m_WaitForPresent(m_Device, m_SwapChain, presentId, WAIT_TIMEOUT_NANOSECONDS);
+			const uint64_t timestamp = GetTimestampMicroseconds();
+			lock.lock();
+
+			if (result == VK_TIMEOUT)
+			{
+				continue;
+			}
+
+			//Presents that failed (for example because the swapchain is out of date) are dropped.
+			m_PendingPresents.pop_front();
+			if (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR)
+			{
+				m_CompletedPresents.emplace_back(presentId, timestamp);
+				while (m_CompletedPresents.size() > HISTORY_SIZE)
+				{
+					m_CompletedPresents.pop_front();
+				}
+			}
+		}
+	}
+}
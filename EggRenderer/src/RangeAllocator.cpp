@@ -0,0 +1,106 @@
+#include "RangeAllocator.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace egg
+{
+	RangeAllocator::RangeAllocator() : m_Alignment(1)
+	{
+	}
+
+	void RangeAllocator::Reset(size_t a_Size, size_t a_Alignment)
+	{
+		assert(a_Alignment > 0 && (a_Alignment & (a_Alignment - 1)) == 0 && "Range alignment has to be a power of two!");
+		m_Alignment = a_Alignment;
+		m_FreeRanges.clear();
+		if (a_Size > 0)
+		{
+			m_FreeRanges.emplace(0, a_Size);
+		}
+	}
+
+	bool RangeAllocator::Allocate(size_t a_Size, size_t& a_Offset)
+	{
+		const size_t size = AlignSize(a_Size);
+
+		for (auto itr = m_FreeRanges.begin(); itr != m_FreeRanges.end(); ++itr)
+		{
+			if (itr->second < size)
+			{
+				continue;
+			}
+
+			//Take the start of the range, and keep the rest free.
+			a_Offset = itr->first;
+			const size_t remaining = itr->second - size;
+			m_FreeRanges.erase(itr);
+			if (remaining > 0)
+			{
+				m_FreeRanges.emplace(a_Offset + size, remaining);
+			}
+			return true;
+		}
+		return false;
+	}
+
+	void RangeAllocator::Free(size_t a_Offset, size_t a_Size)
+	{
+		size_t offset = a_Offset;
+		size_t size = AlignSize(a_Size);
+
+		//Merge with the free range after this one.
+		const auto next = m_FreeRanges.find(offset + size);
+		if (next != m_FreeRanges.end())
+		{
+			size += next->second;
+			m_FreeRanges.erase(next);
+		}
+
+		//Merge with the free range before this one.
+		auto previous = m_FreeRanges.lower_bound(offset);
+		if (previous != m_FreeRanges.begin())
+		{
+			--previous;
+			assert(previous->first + previous->second <= offset && "Range freed twice!");
+			if (previous->first + previous->second == offset)
+			{
+				offset = previous->first;
+				size += previous->second;
+				m_FreeRanges.erase(previous);
+			}
+		}
+
+		m_FreeRanges.emplace(offset, size);
+	}
+
+	size_t RangeAllocator::GetFreeSize() const
+	{
+		size_t size = 0;
+		for (const auto& range : m_FreeRanges)
+		{
+			size += range.second;
+		}
+		return size;
+	}
+
+	size_t RangeAllocator::GetLargestFreeRange() const
+	{
+		size_t size = 0;
+		for (const auto& range : m_FreeRanges)
+		{
+			size = std::max(size, range.second);
+		}
+		return size;
+	}
+
+	uint32_t RangeAllocator::GetFreeRangeCount() const
+	{
+		return static_cast<uint32_t>(m_FreeRanges.size());
+	}
+
+	size_t RangeAllocator::AlignSize(size_t a_Size) const
+	{
+		return (a_Size + m_Alignment - 1) & ~(m_Alignment - 1);
+	}
+}
@@ -1,5 +1,8 @@
+#include <algorithm>
+#include <cstddef>
 #include <filesystem>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "Resources.h"
@@ -21,6 +24,27 @@ namespace egg
     {
         m_Frames.resize(a_RenderData.m_Settings.m_SwapBufferCount);
 
+        //Descriptor sets are created again, so nothing has been written to them yet.
+        for (auto& frame : m_Frames)
+        {
+            frame.m_WrittenIndirectionVersion = 0;
+            frame.m_WrittenInstanceVersion = 0;
+            frame.m_WrittenPreviousTransformVersion = 0;
+            frame.m_WrittenAnimationStateVersion = 0;
+            frame.m_WrittenAnimationStorageVersion = 0;
+            frame.m_WrittenMaterialVersion = 0;
+            frame.m_WrittenLightsVersion = 0;
+            frame.m_WrittenAreaLightSize = 0;
+            frame.m_WrittenDirectionalLightSize = 0;
+            frame.m_WrittenScatterInstanceVersion = 0;
+            frame.m_WrittenScatterIndirectionVersion = 0;
+        }
+
+        //Shaders that read the per-frame buffers through addresses are compiled as separate variants.
+        m_BufferDeviceAddress = a_RenderData.m_BufferDeviceAddressSupported;
+        const std::string addressVariant = m_BufferDeviceAddress ? "_bda" : "";
+        m_DrawIndirectFirstInstance = a_RenderData.m_EnabledFeatures.drawIndirectFirstInstance == VK_TRUE;
+
         constexpr auto DEFERRED_COLOR_FORMAT = VK_FORMAT_R16G16B16A16_SFLOAT;
         constexpr auto DEFERRED_DEPTH_FORMAT = VK_FORMAT_D32_SFLOAT;
 
@@ -41,18 +65,43 @@ namespace egg
 
         /*
          * Create the descriptor pool and set layout for the instance data buffers.
-         * Two bindings are used, one for instance data and one for the indirection buffer.
+         * Bindings are used for the indirection buffer, the instance data, the previous transforms of interpolated instances,
+         * the frames of animated instances and the storage that holds all vertex animations.
+         * Every frame has a second set for scattered draw calls, which only points to the scatter output buffers. Scattered instances are never interpolated or animated.
          */
         if (!RenderUtility::CreateDescriptorSetContainer(a_RenderData.m_Device,
-            DescriptorSetContainerCreateInfo::Create(a_RenderData.m_Settings.m_SwapBufferCount)
+            DescriptorSetContainerCreateInfo::Create(a_RenderData.m_Settings.m_SwapBufferCount * 2)
             .AddBinding(0, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
             .AddBinding(1, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+            .AddBinding(2, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT)  //Previous transforms
+            .AddBinding(3, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT)  //Animation states
+            .AddBinding(4, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT)  //Vertex animation storage
             , m_InstanceDescriptors))
         {
             printf("Could not create descriptor sets!\n");
             return false;
         }
 
+        /*
+         * Scattering reads the scatters of the frame, and appends to the draw commands and the scatter output buffers.
+         * The surface mesh differs per scatter, so it is bound in a separate set for every scatter of every frame.
+         */
+        if (!RenderUtility::CreateDescriptorSetContainer(a_RenderData.m_Device,
+            DescriptorSetContainerCreateInfo::Create(a_RenderData.m_Settings.m_SwapBufferCount)
+            .AddBinding(0, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)   //Scatters
+            .AddBinding(1, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)   //Draw commands
+            .AddBinding(2, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)   //Instance data
+            .AddBinding(3, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)   //Indirection buffer
+            , m_ScatterDescriptors)
+            || !RenderUtility::CreateDescriptorSetContainer(a_RenderData.m_Device,
+            DescriptorSetContainerCreateInfo::Create(a_RenderData.m_Settings.m_SwapBufferCount * EggDrawData::MAX_SCATTERS)
+            .AddBinding(0, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT)  //Surface mesh
+            , m_ScatterSurfaceDescriptors))
+        {
+            printf("Could not create descriptor sets!\n");
+            return false;
+        }
+
         //Ensure that the format is supported as color attachment.
         VkFormatProperties properties;
         vkGetPhysicalDeviceFormatProperties(a_RenderData.m_PhysicalDevice, DEFERRED_COLOR_FORMAT, &properties);
@@ -118,7 +167,11 @@ namespace egg
             secondPassInputs[i].attachment = i;
         }
 
-        VkSubpassDescription subpass[]{ {}, {} };
+        //The depth is only tested against by the debug draw subpass.
+        VkAttachmentReference debugDrawDepthReference{ 0, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL };
+        VkAttachmentReference debugDrawOutputReference{ DEFERRED_ATTACHMENT_MAX_ENUM, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+
+        VkSubpassDescription subpass[]{ {}, {}, {} };
         //First subpass outputs to the deferred images.
         subpass[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
         subpass[0].colorAttachmentCount = DEFERRED_ATTACHMENT_MAX_ENUM - 1;
@@ -135,10 +188,16 @@ namespace egg
         subpass[1].inputAttachmentCount = DEFERRED_ATTACHMENT_MAX_ENUM;
         subpass[1].pInputAttachments = &secondPassInputs[0];
 
+        //Third subpass draws debug primitives over the shaded output.
+        subpass[2].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass[2].colorAttachmentCount = 1;
+        subpass[2].pColorAttachments = &debugDrawOutputReference;
+        subpass[2].pDepthStencilAttachment = &debugDrawDepthReference;
+
         /*
-         * Set up dependencies between the two passes.
+         * Set up dependencies between the passes.
          */
-        VkSubpassDependency subPassDependencies[3]{ {}, {}, {} };
+        VkSubpassDependency subPassDependencies[7]{ {}, {}, {}, {}, {}, {}, {} };
 
         //Dependency between previous commands and starting the deferred rendering.
         subPassDependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
@@ -154,30 +213,67 @@ namespace egg
         //The stage starts with the color attachment outputs, and ends in the fragment shader.
         subPassDependencies[1].srcSubpass = 0;
         subPassDependencies[1].dstSubpass = 1;
-        subPassDependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        //Fragment shader writes are included for the overdraw image, which is written by the debug view pipeline.
+        subPassDependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
         subPassDependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-        subPassDependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        subPassDependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
         subPassDependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
         subPassDependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
         //Final dependency to transition out of the last sub pass.
+        //Transfers are included so that picking queries can copy from the G-buffer after the pass ends.
         subPassDependencies[2].srcSubpass = 1;
         subPassDependencies[2].dstSubpass = VK_SUBPASS_EXTERNAL;
         subPassDependencies[2].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
-        subPassDependencies[2].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+        subPassDependencies[2].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
         subPassDependencies[2].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-        subPassDependencies[2].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-        subPassDependencies[2].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+        subPassDependencies[2].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+        subPassDependencies[2].dependencyFlags = 0;
+
+        //The debug draw subpass blends over the shaded output, and tests against the depth written by the first subpass.
+        subPassDependencies[3].srcSubpass = 1;
+        subPassDependencies[3].dstSubpass = 2;
+        subPassDependencies[3].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT;
+        subPassDependencies[3].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+        subPassDependencies[3].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        subPassDependencies[3].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        subPassDependencies[3].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+        subPassDependencies[4].srcSubpass = 0;
+        subPassDependencies[4].dstSubpass = 2;
+        subPassDependencies[4].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        subPassDependencies[4].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+        subPassDependencies[4].srcStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        subPassDependencies[4].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        subPassDependencies[4].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+        //Transition out of the debug draw subpass, which is the last to write the swapchain image and read the depth.
+        subPassDependencies[5].srcSubpass = 2;
+        subPassDependencies[5].dstSubpass = VK_SUBPASS_EXTERNAL;
+        subPassDependencies[5].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+        subPassDependencies[5].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+        subPassDependencies[5].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        subPassDependencies[5].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+        subPassDependencies[5].dependencyFlags = 0;
+
+        //Contact shadows sample the depth at other pixels than the shaded one, so the depth has to be finished for the whole framebuffer, not per region.
+        subPassDependencies[6].srcSubpass = 0;
+        subPassDependencies[6].dstSubpass = 1;
+        subPassDependencies[6].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        subPassDependencies[6].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+        subPassDependencies[6].srcStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        subPassDependencies[6].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        subPassDependencies[6].dependencyFlags = 0;
 
         //Combine all these.
         VkRenderPassCreateInfo renderPassInfo{};
         renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
         renderPassInfo.attachmentCount = DEFERRED_ATTACHMENT_MAX_ENUM + 1;  //5 deferred attachments + 1 output to the swapchain.
         renderPassInfo.pAttachments = &attachments[0];
-        renderPassInfo.subpassCount = 2;
+        renderPassInfo.subpassCount = 3;
         renderPassInfo.pSubpasses = &subpass[0];
         renderPassInfo.pDependencies = &subPassDependencies[0];
-        renderPassInfo.dependencyCount = 3;
+        renderPassInfo.dependencyCount = 7;
 
         /*
          * And finally make the render pass.
@@ -187,6 +283,10 @@ namespace egg
             printf("Could not create render pass for pipeline!\n");
             return false;
         }
+        if (!a_RenderData.m_PipelineCache.RegisterRenderPass(renderPassInfo, m_DeferredRenderPassKey))
+        {
+            return false;
+        }
 
         /*
          * Set up a descriptor pool and set layout used to access the deferred subpass output.
@@ -197,12 +297,30 @@ namespace egg
         {
             attachmentDescriptorCreateInfo.AddBinding(i, 1, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_SHADER_STAGE_FRAGMENT_BIT);
         }
+        attachmentDescriptorCreateInfo.AddBinding(numDeferredReadDescriptors, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT);  //Sampled depth
         if (!RenderUtility::CreateDescriptorSetContainer(a_RenderData.m_Device, attachmentDescriptorCreateInfo, m_ProcessingDescriptors))
         {
             printf("Could not create descriptor sets!\n");
             return false;
         }
 
+        //Depth is read at exact texels, so it is never filtered.
+        VkSamplerCreateInfo depthSamplerInfo{};
+        depthSamplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        depthSamplerInfo.magFilter = VK_FILTER_NEAREST;
+        depthSamplerInfo.minFilter = VK_FILTER_NEAREST;
+        depthSamplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        depthSamplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        depthSamplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        depthSamplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        depthSamplerInfo.maxLod = 0.f;
+
+        if (vkCreateSampler(a_RenderData.m_Device, &depthSamplerInfo, nullptr, &m_DepthSampler) != VK_SUCCESS)
+        {
+            printf("Could not create depth sampler in deferred stage.\n");
+            return false;
+        }
+
         /*
          * Set up the buffers and objects per frame.
          */
@@ -216,15 +334,17 @@ namespace egg
             ImageInfo arrayImage;
             arrayImage.m_Format = DEFERRED_COLOR_FORMAT;
             arrayImage.m_ArrayLayers = DEFERRED_ATTACHMENT_MAX_ENUM - 1;
-            arrayImage.m_Usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+            arrayImage.m_Usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;  //Transfer source for picking.
             arrayImage.m_Dimensions = { a_RenderData.m_Settings.resolutionX, a_RenderData.m_Settings.resolutionY, 1 };
             arrayImage.m_ImageType = VK_IMAGE_TYPE_2D;
             arrayImage.m_MipLevels = 1;
+            arrayImage.m_MemoryCategory = MemoryCategory::G_BUFFER;
 
             ImageInfo depthImage;
             depthImage.m_Format = DEFERRED_DEPTH_FORMAT;
-            depthImage.m_Usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+            depthImage.m_Usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
             depthImage.m_Dimensions = { a_RenderData.m_Settings.resolutionX, a_RenderData.m_Settings.resolutionY, 1 };
+            depthImage.m_MemoryCategory = MemoryCategory::G_BUFFER;
 
             if (!RenderUtility::CreateImage(a_RenderData.m_Device, a_RenderData.m_Allocator, arrayImage, frame.m_DeferredArrayImage)
                 || !RenderUtility::CreateImage(a_RenderData.m_Device, a_RenderData.m_Allocator, depthImage, frame.m_DepthImage))
@@ -312,6 +432,49 @@ namespace egg
             }
             vkUpdateDescriptorSets(a_RenderData.m_Device, numDeferredReadDescriptors, &writeDescriptorSet[0], 0, nullptr);
 
+            //The depth is also sampled, in the same layout as the input attachment.
+            VkDescriptorImageInfo depthDescriptor{ m_DepthSampler, frame.m_DeferredImageViews[DEFERRED_ATTACHMENT_DEPTH], VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+            VkWriteDescriptorSet depthWriteDescriptorSet{};
+            depthWriteDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            depthWriteDescriptorSet.dstSet = m_ProcessingDescriptors.m_Sets[frameIndex];
+            depthWriteDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            depthWriteDescriptorSet.descriptorCount = 1;
+            depthWriteDescriptorSet.dstBinding = numDeferredReadDescriptors;
+            depthWriteDescriptorSet.pImageInfo = &depthDescriptor;
+            vkUpdateDescriptorSets(a_RenderData.m_Device, 1, &depthWriteDescriptorSet, 0, nullptr);
+
+            /*
+             * Scatters and their draw commands change every frame and are small, so they are written inline while recording instead of being uploaded.
+             * Neither buffer is ever replaced, so their descriptors are written once.
+             */
+            VkDevice device = a_RenderData.m_Device;
+            VmaAllocator allocator = a_RenderData.m_Allocator;
+            const size_t scatterBufferSize = sizeof(glm::mat4) + sizeof(PackedScatterData) * EggDrawData::MAX_SCATTERS;
+            const size_t scatterCommandBufferSize = sizeof(VkDrawIndexedIndirectCommand) * EggDrawData::MAX_SCATTERS;
+            if (!frame.m_ScatterBuffer.Init(GpuBufferSettings{ scatterBufferSize, 16, VMA_MEMORY_USAGE_GPU_ONLY,
+                    VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, MemoryCategory::FRAME_UPLOAD }, device, allocator)
+                || !frame.m_ScatterCommandBuffer.Init(GpuBufferSettings{ scatterCommandBufferSize, 16, VMA_MEMORY_USAGE_GPU_ONLY,
+                    VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, MemoryCategory::FRAME_UPLOAD }, device, allocator))
+            {
+                printf("Could not create scatter buffers in deferred stage.\n");
+                return false;
+            }
+
+            RenderUtility::WriteDescriptors(a_RenderData.m_Device, m_ScatterDescriptors)
+                .WriteBuffer(frameIndex, 0, frame.m_ScatterBuffer.GetBuffer(), 0, VK_WHOLE_SIZE)
+                .WriteBuffer(frameIndex, 1, frame.m_ScatterCommandBuffer.GetBuffer(), 0, VK_WHOLE_SIZE)
+                .Upload();
+
+            //Scattered instances are written and read by the GPU only, so they are kept out of the host visible upload buffers.
+            //Both start empty, and grow to the candidates of the frame when it is recorded.
+            const VkBufferUsageFlags scatterOutputUsage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | (m_BufferDeviceAddress ? VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT : 0);
+            if (!frame.m_ScatterInstanceBuffer.Init(GpuBufferSettings{ 0, 16, VMA_MEMORY_USAGE_GPU_ONLY, scatterOutputUsage, MemoryCategory::FRAME_UPLOAD }, device, allocator)
+                || !frame.m_ScatterIndirectionBuffer.Init(GpuBufferSettings{ 0, 16, VMA_MEMORY_USAGE_GPU_ONLY, scatterOutputUsage, MemoryCategory::FRAME_UPLOAD }, device, allocator))
+            {
+                printf("Could not create scatter output buffers in deferred stage.\n");
+                return false;
+            }
+
             ++frameIndex;
         }
 
@@ -321,19 +484,18 @@ namespace egg
         {
             PipelineCreateInfo pipelineInfo;
             pipelineInfo.m_Shaders.push_back({ "deferred_processing.vert.spv", "main", VK_SHADER_STAGE_VERTEX_BIT });
-            pipelineInfo.m_Shaders.push_back({ "deferred_processing.frag.spv", "main", VK_SHADER_STAGE_FRAGMENT_BIT });
-            pipelineInfo.resolution.m_ResolutionX = a_RenderData.m_Settings.resolutionX;
-            pipelineInfo.resolution.m_ResolutionY = a_RenderData.m_Settings.resolutionY;
+            pipelineInfo.m_Shaders.push_back({ "deferred_processing" + addressVariant + ".frag.spv", "main", VK_SHADER_STAGE_FRAGMENT_BIT });
             pipelineInfo.renderPass.m_RenderPass = m_DeferredRenderPass;
+            pipelineInfo.renderPass.m_CompatibilityKey = m_DeferredRenderPassKey;
             pipelineInfo.renderPass.m_SubpassIndex = 1;     //Use the 2nd sub-pass.
             pipelineInfo.depth.m_UseDepth = false;          //This is just shading so no need to use depth.
             pipelineInfo.depth.m_WriteDepth = false;
-            pipelineInfo.descriptors.m_Layouts.push_back(m_ProcessingDescriptors.m_Layout);
-            pipelineInfo.descriptors.m_Layouts.push_back(m_ShadingDescriptors.m_Layout);
+            pipelineInfo.descriptors.Add(m_ProcessingDescriptors);
+            pipelineInfo.descriptors.Add(m_ShadingDescriptors);
             pipelineInfo.attachments.m_NumAttachments = DEFERRED_ATTACHMENT_MAX_ENUM + 1;
             pipelineInfo.pushConstants.m_PushConstantRanges.push_back({ VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(DeferredProcessingPushConstants) });
 
-            if (!RenderUtility::CreatePipeline(pipelineInfo, a_RenderData.m_Device, a_RenderData.m_Settings.shadersPath, m_DeferredProcessingPipelineData))
+            if (!a_RenderData.m_PipelineCache.Acquire(pipelineInfo, m_DeferredProcessingPipelineData))
             {
                 return false;
             }
@@ -344,10 +506,8 @@ namespace egg
          */
         {
             PipelineCreateInfo pipelineInfo;
-            pipelineInfo.m_Shaders.push_back({ "deferred.vert.spv", "main", VK_SHADER_STAGE_VERTEX_BIT });
+            pipelineInfo.m_Shaders.push_back({ "deferred" + addressVariant + ".vert.spv", "main", VK_SHADER_STAGE_VERTEX_BIT });
             pipelineInfo.m_Shaders.push_back({ "deferred.frag.spv", "main", VK_SHADER_STAGE_FRAGMENT_BIT });
-            pipelineInfo.resolution.m_ResolutionX = a_RenderData.m_Settings.resolutionX;
-            pipelineInfo.resolution.m_ResolutionY = a_RenderData.m_Settings.resolutionY;
             pipelineInfo.vertexData.m_VertexBindings.push_back({ 0, sizeof(Vertex), VkVertexInputRate::VK_VERTEX_INPUT_RATE_VERTEX });
             pipelineInfo.vertexData.m_VertexAttributes.push_back({ 0, 0, VkFormat::VK_FORMAT_R32G32B32_SFLOAT, 0 });
             pipelineInfo.vertexData.m_VertexAttributes.push_back({ 1, 0, VkFormat::VK_FORMAT_R32G32B32_SFLOAT, 12 });
@@ -355,35 +515,235 @@ namespace egg
             pipelineInfo.vertexData.m_VertexAttributes.push_back({ 3, 0, VkFormat::VK_FORMAT_R32G32_SFLOAT, 40 });
             pipelineInfo.pushConstants.m_PushConstantRanges.push_back({ VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(DeferredPushConstants) });
             pipelineInfo.renderPass.m_RenderPass = m_DeferredRenderPass;
+            pipelineInfo.renderPass.m_CompatibilityKey = m_DeferredRenderPassKey;
             pipelineInfo.attachments.m_NumAttachments = DEFERRED_ATTACHMENT_MAX_ENUM - 1;
             pipelineInfo.culling.m_CullMode = VK_CULL_MODE_BACK_BIT;    //Cull back facing geometry.
-            pipelineInfo.descriptors.m_Layouts.push_back(m_InstanceDescriptors.m_Layout);
+            pipelineInfo.descriptors.Add(m_InstanceDescriptors);
+
+            if (!a_RenderData.m_PipelineCache.Acquire(pipelineInfo, m_DeferredPipelineData))
+            {
+                return false;
+            }
+        }
+
+        /*
+         * Terrain is drawn in the geometry sub-pass, so its pipeline is created for this render pass.
+         */
+        if (m_TerrainStage != nullptr && !m_TerrainStage->InitPipeline(a_RenderData, m_DeferredRenderPass, m_DeferredRenderPassKey, 0, DEFERRED_ATTACHMENT_MAX_ENUM - 1))
+        {
+            return false;
+        }
+
+        /*
+         * Scatter pipeline. The frame set is bound once, the surface set for every scatter.
+         */
+        {
+            PipelineCreateInfo pipelineInfo;
+            pipelineInfo.m_Shaders.push_back({ "scatter.comp.spv", "main", VK_SHADER_STAGE_COMPUTE_BIT });
+            pipelineInfo.pushConstants.m_PushConstantRanges.push_back({ VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ScatterPushConstants) });
+            pipelineInfo.descriptors.Add(m_ScatterDescriptors);
+            pipelineInfo.descriptors.Add(m_ScatterSurfaceDescriptors);
+
+            if (!a_RenderData.m_PipelineCache.Acquire(pipelineInfo, m_ScatterPipelineData))
+            {
+                return false;
+            }
+        }
+
+        /*
+         * Debug draw pipelines. Lines and triangles share the vertex layout and shaders, and only differ in topology.
+         */
+        for (int pipelineIndex = 0; pipelineIndex < 2; ++pipelineIndex)
+        {
+            PipelineCreateInfo pipelineInfo;
+            pipelineInfo.m_Shaders.push_back({ "debug_draw.vert.spv", "main", VK_SHADER_STAGE_VERTEX_BIT });
+            pipelineInfo.m_Shaders.push_back({ "debug_draw.frag.spv", "main", VK_SHADER_STAGE_FRAGMENT_BIT });
+            pipelineInfo.vertexData.m_VertexBindings.push_back({ 0, sizeof(PackedDebugVertex), VkVertexInputRate::VK_VERTEX_INPUT_RATE_VERTEX });
+            pipelineInfo.vertexData.m_VertexAttributes.push_back({ 0, 0, VkFormat::VK_FORMAT_R32G32B32_SFLOAT, offsetof(PackedDebugVertex, m_Position) });
+            pipelineInfo.vertexData.m_VertexAttributes.push_back({ 1, 0, VkFormat::VK_FORMAT_R8G8B8A8_UNORM, offsetof(PackedDebugVertex, m_Color) });
+            pipelineInfo.pushConstants.m_PushConstantRanges.push_back({ VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4) });
+            pipelineInfo.inputAssembly.m_Topology = pipelineIndex == 0 ? VK_PRIMITIVE_TOPOLOGY_LINE_LIST : VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+            pipelineInfo.renderPass.m_RenderPass = m_DeferredRenderPass;
+            pipelineInfo.renderPass.m_CompatibilityKey = m_DeferredRenderPassKey;
+            pipelineInfo.renderPass.m_SubpassIndex = 2;
+            pipelineInfo.depth.m_WriteDepth = false;
+            pipelineInfo.depth.m_CompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;   //Lines drawn exactly on a surface stay visible.
+            pipelineInfo.attachments.m_NumAttachments = 1;
+            pipelineInfo.attachments.m_AlphaBlending = true;
+            pipelineInfo.culling.m_CullMode = VK_CULL_MODE_NONE;            //Triangles are visible from both sides.
 
-            if (!RenderUtility::CreatePipeline(pipelineInfo, a_RenderData.m_Device, a_RenderData.m_Settings.shadersPath, m_DeferredPipelineData))
+            if (!a_RenderData.m_PipelineCache.Acquire(pipelineInfo,
+                pipelineIndex == 0 ? m_DebugLinePipelineData : m_DebugTrianglePipelineData))
             {
                 return false;
             }
         }
 
+        //Debug views write to storage images from fragment shaders, which is an optional feature.
+        m_DebugViewsSupported = a_RenderData.m_EnabledFeatures.fragmentStoresAndAtomics == VK_TRUE;
+        m_DebugViewsFailed = false;
+        if (m_DebugViewsSupported && !InitDebugViews(a_RenderData))
+        {
+            printf("Could not initialize debug views in deferred stage!\n");
+            return false;
+        }
+
         return true;
     }
 
-    bool RenderStage_Deferred::CleanUp(const RenderData& a_RenderData)
+    PipelineState RenderStage_Deferred::PollDebugViews(const RenderData& a_RenderData)
+    {
+        if (!m_DebugViewsSupported || m_DebugViewsFailed)
+        {
+            return PipelineState::FAILED;
+        }
+
+        //Both are polled, so that neither waits for the other to be swapped in.
+        const auto geometryState = a_RenderData.m_PipelineCache.Poll(m_DebugPipeline);
+        const auto processingState = a_RenderData.m_PipelineCache.Poll(m_DebugProcessingPipeline);
+        if (geometryState == PipelineState::FAILED || processingState == PipelineState::FAILED)
+        {
+            m_DebugViewsFailed = true;
+            return PipelineState::FAILED;
+        }
+        return geometryState == PipelineState::READY && processingState == PipelineState::READY ? PipelineState::READY : PipelineState::COMPILING;
+    }
+
+    bool RenderStage_Deferred::InitDebugViews(const RenderData& a_RenderData)
     {
-    	//Pipelines!
-        vkDestroyPipeline(a_RenderData.m_Device, m_DeferredPipelineData.m_Pipeline, nullptr);
-        vkDestroyPipelineLayout(a_RenderData.m_Device, m_DeferredPipelineData.m_PipelineLayout, nullptr);
-        vkDestroyPipeline(a_RenderData.m_Device, m_DeferredProcessingPipelineData.m_Pipeline, nullptr);
-        vkDestroyPipelineLayout(a_RenderData.m_Device, m_DeferredProcessingPipelineData.m_PipelineLayout, nullptr);
+        const std::string addressVariant = m_BufferDeviceAddress ? "_bda" : "";
 
-        //Destroy all shaders.
-        for (auto& shader : m_DeferredPipelineData.m_ShaderModules)
+        /*
+         * Both debug pipelines access the overdraw image and the counters.
+         */
+        if (!RenderUtility::CreateDescriptorSetContainer(a_RenderData.m_Device,
+            DescriptorSetContainerCreateInfo::Create(a_RenderData.m_Settings.m_SwapBufferCount)
+            .AddBinding(0, 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_FRAGMENT_BIT)     //Overdraw
+            .AddBinding(1, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT)    //Counters
+            , m_DebugDescriptors))
         {
-            vkDestroyShaderModule(a_RenderData.m_Device, shader, nullptr);
+            printf("Could not create descriptor sets!\n");
+            return false;
         }
-        for (auto& shader : m_DeferredProcessingPipelineData.m_ShaderModules)
+
+        for (uint32_t frameIndex = 0; frameIndex < static_cast<uint32_t>(m_Frames.size()); ++frameIndex)
+        {
+            auto& frame = m_Frames[frameIndex];
+
+            ImageInfo overdrawImage;
+            overdrawImage.m_Format = VK_FORMAT_R32_UINT;
+            overdrawImage.m_Usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;    //Cleared with a transfer every frame.
+            overdrawImage.m_Dimensions = { a_RenderData.m_Settings.resolutionX, a_RenderData.m_Settings.resolutionY, 1 };
+            overdrawImage.m_MemoryCategory = MemoryCategory::G_BUFFER;
+
+            if (!RenderUtility::CreateImage(a_RenderData.m_Device, a_RenderData.m_Allocator, overdrawImage, frame.m_OverdrawImage))
+            {
+                printf("Could not create overdraw image in deferred stage.\n");
+                return false;
+            }
+
+            ImageViewInfo overdrawViewInfo;
+            overdrawViewInfo.m_Format = overdrawImage.m_Format;
+            overdrawViewInfo.m_Image = frame.m_OverdrawImage.m_Image;
+            overdrawViewInfo.m_VisibleAspects = VK_IMAGE_ASPECT_COLOR_BIT;
+
+            if (!RenderUtility::CreateImageView(a_RenderData.m_Device, overdrawViewInfo, frame.m_OverdrawImageView))
+            {
+                printf("Could not create overdraw image view in deferred stage.\n");
+                return false;
+            }
+
+            //The image stays in the general layout, and the counter buffer is owned by the renderer. Neither changes, so they are written once.
+            VkDescriptorImageInfo imageDescriptor{ VK_NULL_HANDLE, frame.m_OverdrawImageView, VK_IMAGE_LAYOUT_GENERAL };
+            VkDescriptorBufferInfo bufferDescriptor{ a_RenderData.m_FrameData[frameIndex].m_DebugView.m_CounterBuffer.GetBuffer(), 0, DebugViewData::COUNTER_BUFFER_SIZE };
+
+            VkWriteDescriptorSet writeDescriptorSet[2]{ {}, {} };
+            writeDescriptorSet[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writeDescriptorSet[0].dstSet = m_DebugDescriptors.m_Sets[frameIndex];
+            writeDescriptorSet[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            writeDescriptorSet[0].descriptorCount = 1;
+            writeDescriptorSet[0].dstBinding = 0;
+            writeDescriptorSet[0].pImageInfo = &imageDescriptor;
+            writeDescriptorSet[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writeDescriptorSet[1].dstSet = m_DebugDescriptors.m_Sets[frameIndex];
+            writeDescriptorSet[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writeDescriptorSet[1].descriptorCount = 1;
+            writeDescriptorSet[1].dstBinding = 1;
+            writeDescriptorSet[1].pBufferInfo = &bufferDescriptor;
+            vkUpdateDescriptorSets(a_RenderData.m_Device, 2, &writeDescriptorSet[0], 0, nullptr);
+        }
+
+        /*
+         * Debug variant of the processing pipeline. The debug set is bound after the G-buffer and shading sets.
+         */
+        {
+            PipelineCreateInfo pipelineInfo;
+            pipelineInfo.m_Shaders.push_back({ "deferred_processing.vert.spv", "main", VK_SHADER_STAGE_VERTEX_BIT });
+            pipelineInfo.m_Shaders.push_back({ "deferred_processing_debug" + addressVariant + ".frag.spv", "main", VK_SHADER_STAGE_FRAGMENT_BIT });
+            pipelineInfo.renderPass.m_RenderPass = m_DeferredRenderPass;
+            pipelineInfo.renderPass.m_CompatibilityKey = m_DeferredRenderPassKey;
+            pipelineInfo.renderPass.m_SubpassIndex = 1;
+            pipelineInfo.depth.m_UseDepth = false;
+            pipelineInfo.depth.m_WriteDepth = false;
+            pipelineInfo.descriptors.Add(m_ProcessingDescriptors);
+            pipelineInfo.descriptors.Add(m_ShadingDescriptors);
+            pipelineInfo.descriptors.Add(m_DebugDescriptors);
+            pipelineInfo.attachments.m_NumAttachments = DEFERRED_ATTACHMENT_MAX_ENUM + 1;
+            pipelineInfo.pushConstants.m_PushConstantRanges.push_back({ VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(DeferredProcessingPushConstants) });
+
+            a_RenderData.m_PipelineCache.AcquireAsync(pipelineInfo, m_DebugProcessingPipeline);
+        }
+
+        /*
+         * Debug variant of the geometry pipeline. The fragment shader reads the draw call index and mode from the push constants.
+         */
+        {
+            PipelineCreateInfo pipelineInfo;
+            pipelineInfo.m_Shaders.push_back({ "deferred_debug" + addressVariant + ".vert.spv", "main", VK_SHADER_STAGE_VERTEX_BIT });
+            pipelineInfo.m_Shaders.push_back({ "deferred_debug.frag.spv", "main", VK_SHADER_STAGE_FRAGMENT_BIT });
+            pipelineInfo.vertexData.m_VertexBindings.push_back({ 0, sizeof(Vertex), VkVertexInputRate::VK_VERTEX_INPUT_RATE_VERTEX });
+            pipelineInfo.vertexData.m_VertexAttributes.push_back({ 0, 0, VkFormat::VK_FORMAT_R32G32B32_SFLOAT, 0 });
+            pipelineInfo.vertexData.m_VertexAttributes.push_back({ 1, 0, VkFormat::VK_FORMAT_R32G32B32_SFLOAT, 12 });
+            pipelineInfo.vertexData.m_VertexAttributes.push_back({ 2, 0, VkFormat::VK_FORMAT_R32G32B32A32_SFLOAT, 24 });
+            pipelineInfo.vertexData.m_VertexAttributes.push_back({ 3, 0, VkFormat::VK_FORMAT_R32G32_SFLOAT, 40 });
+            pipelineInfo.pushConstants.m_PushConstantRanges.push_back({ VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(DeferredPushConstants) });
+            pipelineInfo.renderPass.m_RenderPass = m_DeferredRenderPass;
+            pipelineInfo.renderPass.m_CompatibilityKey = m_DeferredRenderPassKey;
+            pipelineInfo.attachments.m_NumAttachments = DEFERRED_ATTACHMENT_MAX_ENUM - 1;
+            pipelineInfo.culling.m_CullMode = VK_CULL_MODE_BACK_BIT;
+            pipelineInfo.descriptors.Add(m_InstanceDescriptors);
+            pipelineInfo.descriptors.Add(m_DebugDescriptors);
+
+            a_RenderData.m_PipelineCache.AcquireAsync(pipelineInfo, m_DebugPipeline);
+        }
+
+        return true;
+    }
+
+    bool RenderStage_Deferred::CleanUp(const RenderData& a_RenderData)
+    {
+    	//Pipelines and their shaders are owned by the pipeline cache.
+        auto& pipelineCache = a_RenderData.m_PipelineCache;
+        pipelineCache.Release(m_DeferredPipelineData);
+        pipelineCache.Release(m_DeferredProcessingPipelineData);
+        pipelineCache.Release(m_DebugLinePipelineData);
+        pipelineCache.Release(m_DebugTrianglePipelineData);
+        pipelineCache.Release(m_ScatterPipelineData);
+
+        //Debug view resources only exist when supported.
+        if (m_DebugViewsSupported)
         {
-            vkDestroyShaderModule(a_RenderData.m_Device, shader, nullptr);
+            pipelineCache.Release(m_DebugPipeline);
+            pipelineCache.Release(m_DebugProcessingPipeline);
+
+            for (auto& frame : m_Frames)
+            {
+                vkDestroyImageView(a_RenderData.m_Device, frame.m_OverdrawImageView, nullptr);
+                MemoryTracker::Untrack(a_RenderData.m_Allocator, frame.m_OverdrawImage.m_Allocation);
+                vmaDestroyImage(a_RenderData.m_Allocator, frame.m_OverdrawImage.m_Image, frame.m_OverdrawImage.m_Allocation);
+            }
+
+            RenderUtility::DestroyDescriptorSetContainer(a_RenderData.m_Device, m_DebugDescriptors);
         }
 
         for (auto& frame : m_Frames)
@@ -394,16 +754,29 @@ namespace egg
                 vkDestroyImageView(a_RenderData.m_Device, frame.m_DeferredImageViews[index], nullptr);
             }
 
+            MemoryTracker::Untrack(a_RenderData.m_Allocator, frame.m_DeferredArrayImage.m_Allocation);
+            MemoryTracker::Untrack(a_RenderData.m_Allocator, frame.m_DepthImage.m_Allocation);
             vmaDestroyImage(a_RenderData.m_Allocator, frame.m_DeferredArrayImage.m_Image, frame.m_DeferredArrayImage.m_Allocation);
             vmaDestroyImage(a_RenderData.m_Allocator, frame.m_DepthImage.m_Image, frame.m_DepthImage.m_Allocation);
 
             vkDestroyFramebuffer(a_RenderData.m_Device, frame.m_DeferredBuffer, nullptr);
+
+            frame.m_ScatterBuffer.CleanUp();
+            frame.m_ScatterCommandBuffer.CleanUp();
+            frame.m_ScatterInstanceBuffer.CleanUp();
+            frame.m_ScatterIndirectionBuffer.CleanUp();
         }
 
+        //Buffers can only be initialized once, so the frames are created again by the next Init().
+        m_Frames.clear();
+
         //Destroy allocated descriptor set layouts and pools.
+        RenderUtility::DestroyDescriptorSetContainer(a_RenderData.m_Device, m_ScatterDescriptors);
+        RenderUtility::DestroyDescriptorSetContainer(a_RenderData.m_Device, m_ScatterSurfaceDescriptors);
         RenderUtility::DestroyDescriptorSetContainer(a_RenderData.m_Device, m_InstanceDescriptors);
         RenderUtility::DestroyDescriptorSetContainer(a_RenderData.m_Device, m_ShadingDescriptors);
         RenderUtility::DestroyDescriptorSetContainer(a_RenderData.m_Device, m_ProcessingDescriptors);
+        vkDestroySampler(a_RenderData.m_Device, m_DepthSampler, nullptr);
 
         vkDestroyRenderPass(a_RenderData.m_Device, m_DeferredRenderPass, nullptr);
 
@@ -420,62 +793,105 @@ namespace egg
         auto& frame = a_RenderData.m_FrameData[a_CurrentFrameIndex];
         auto& frameData = m_Frames[a_CurrentFrameIndex];
 
-		//Update the descriptor set to point to the instance data and indirection buffer.
-        VkDescriptorBufferInfo descriptorBufferInfo[2]{};
-        const auto& indirectionBuffer = a_RenderData.m_FrameData[a_CurrentFrameIndex].m_UploadData.m_IndirectionBuffer;
-        descriptorBufferInfo[0].offset = 0; //Note that this is relative to the buffer, so 0 for all of it.
-    										//This is NOT the same as the VMA allocation info offset, which refers to an entire block.
-        descriptorBufferInfo[0].buffer = indirectionBuffer.GetBuffer();
-        descriptorBufferInfo[0].range = VK_WHOLE_SIZE;
-    	
-        const auto& instanceBuffer = a_RenderData.m_FrameData[a_CurrentFrameIndex].m_UploadData.m_InstanceBuffer;
-        descriptorBufferInfo[1].offset = 0;
-        descriptorBufferInfo[1].buffer = instanceBuffer.GetBuffer();
-        descriptorBufferInfo[1].range = VK_WHOLE_SIZE;
-
-        VkWriteDescriptorSet setWrite[2]{};
-        setWrite[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        setWrite[0].descriptorCount = 1;
-        setWrite[0].descriptorType = VkDescriptorType::VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        setWrite[0].dstBinding = 0;
-        setWrite[0].dstArrayElement = 0;
-        setWrite[0].dstSet = m_InstanceDescriptors.m_Sets[a_CurrentFrameIndex];
-        setWrite[0].pBufferInfo = &descriptorBufferInfo[0];
-        setWrite[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        setWrite[1].descriptorCount = 1;
-        setWrite[1].descriptorType = VkDescriptorType::VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        setWrite[1].dstBinding = 1;
-        setWrite[1].dstArrayElement = 0;
-        setWrite[1].dstSet = m_InstanceDescriptors.m_Sets[a_CurrentFrameIndex];
-        setWrite[1].pBufferInfo = &descriptorBufferInfo[1];
-
-    	//Do two writes within the set: instance and indirection data.
-        vkUpdateDescriptorSets(a_RenderData.m_Device, 2, &setWrite[0], 0, nullptr);
-
-
-        const auto numAreaLights = static_cast<uint32_t>(frame.m_DrawData->m_PackedAreaLightData.size());
+        auto& statistics = a_RenderData.m_RecordingStatistics;
+        const auto& indirectionBuffer = frame.m_UploadData.m_IndirectionBuffer;
+        const auto& instanceBuffer = frame.m_UploadData.m_InstanceBuffer;
+        const auto& previousTransformBuffer = frame.m_UploadData.m_PreviousTransformBuffer;
+        const auto& animationStateBuffer = frame.m_UploadData.m_AnimationStateBuffer;
+        const auto& animationStorage = a_RenderData.m_VertexAnimationStorage->GetBuffer();
+        const auto& materialBuffer = frame.m_UploadData.m_MaterialBuffer;
+        const auto& lightsBuffer = frame.m_UploadData.m_LightsBuffer;
+
+        const auto numAreaLights = frame.m_UploadData.m_NumAreaLights;
         const auto numDirectionalLights = static_cast<uint32_t>(frame.m_DrawData->m_PackedDirectionalLightData.size());
         const auto areaLightSize = sizeof(PackedLightData) * numAreaLights;
         const auto directionalLightSize = sizeof(PackedLightData) * numDirectionalLights;
 
-
         /*
-         * Write to the shading descriptor set.
+         * Without buffer device addresses, the descriptor sets of this frame point to the buffers.
+         * Buffers are only replaced when they grow, so the sets are only written when a buffer or light range changed since the last time this frame was recorded.
          */
-        auto builder = RenderUtility::WriteDescriptors(a_RenderData.m_Device, m_ShadingDescriptors);
-        if(frame.m_DrawData->GetMaterialCount() > 0)
+        if (!m_BufferDeviceAddress)
         {
-            builder.WriteBuffer(a_CurrentFrameIndex, 0, frame.m_UploadData.m_MaterialBuffer.GetBuffer(), 0, VK_WHOLE_SIZE);
+            //Instance set: indirection buffer, instance data and previous transforms.
+            auto instanceBuilder = RenderUtility::WriteDescriptors(a_RenderData.m_Device, m_InstanceDescriptors);
+            if (frameData.m_WrittenIndirectionVersion != indirectionBuffer.GetVersion())
+            {
+                //Note that the offset is relative to the buffer, so 0 for all of it.
+                //This is NOT the same as the VMA allocation info offset, which refers to an entire block.
+                instanceBuilder.WriteBuffer(a_CurrentFrameIndex, 0, indirectionBuffer.GetBuffer(), 0, VK_WHOLE_SIZE);
+                frameData.m_WrittenIndirectionVersion = indirectionBuffer.GetVersion();
+            }
+            if (frameData.m_WrittenInstanceVersion != instanceBuffer.GetVersion())
+            {
+                instanceBuilder.WriteBuffer(a_CurrentFrameIndex, 1, instanceBuffer.GetBuffer(), 0, VK_WHOLE_SIZE);
+                frameData.m_WrittenInstanceVersion = instanceBuffer.GetVersion();
+            }
+
+            //Previous transforms only exist when the draw data contains interpolated instances.
+            if (!frame.m_DrawData->m_PreviousTransforms.empty() && frameData.m_WrittenPreviousTransformVersion != previousTransformBuffer.GetVersion())
+            {
+                instanceBuilder.WriteBuffer(a_CurrentFrameIndex, 2, previousTransformBuffer.GetBuffer(), 0, VK_WHOLE_SIZE);
+                frameData.m_WrittenPreviousTransformVersion = previousTransformBuffer.GetVersion();
+            }
+
+            //Animation states only exist when the draw data contains animated instances.
+            if (!frame.m_DrawData->m_AnimationStates.empty() && frameData.m_WrittenAnimationStateVersion != animationStateBuffer.GetVersion())
+            {
+                instanceBuilder.WriteBuffer(a_CurrentFrameIndex, 3, animationStateBuffer.GetBuffer(), 0, VK_WHOLE_SIZE);
+                frameData.m_WrittenAnimationStateVersion = animationStateBuffer.GetVersion();
+            }
+            statistics.m_NumDescriptorUpdates += instanceBuilder.Upload();
+
+            //Shading set: materials and both light ranges, which share one buffer.
+            auto builder = RenderUtility::WriteDescriptors(a_RenderData.m_Device, m_ShadingDescriptors);
+            if (frame.m_DrawData->GetMaterialCount() > 0 && frameData.m_WrittenMaterialVersion != materialBuffer.GetVersion())
+            {
+                builder.WriteBuffer(a_CurrentFrameIndex, 0, materialBuffer.GetBuffer(), 0, VK_WHOLE_SIZE);
+                frameData.m_WrittenMaterialVersion = materialBuffer.GetVersion();
+            }
+
+            //The directional range starts after the area lights, so both ranges are written again when either size changes.
+            if (frameData.m_WrittenLightsVersion != lightsBuffer.GetVersion() || frameData.m_WrittenAreaLightSize != areaLightSize
+                || frameData.m_WrittenDirectionalLightSize != directionalLightSize)
+            {
+                if (numAreaLights > 0)
+                {
+                    builder.WriteBuffer(a_CurrentFrameIndex, 1, lightsBuffer.GetBuffer(), 0, areaLightSize);
+                }
+                if (numDirectionalLights > 0)
+                {
+                    builder.WriteBuffer(a_CurrentFrameIndex, 2, lightsBuffer.GetBuffer(), areaLightSize, directionalLightSize);
+                }
+                frameData.m_WrittenLightsVersion = lightsBuffer.GetVersion();
+                frameData.m_WrittenAreaLightSize = areaLightSize;
+                frameData.m_WrittenDirectionalLightSize = directionalLightSize;
+            }
+            statistics.m_NumDescriptorUpdates += builder.Upload();
         }
-        if (numAreaLights > 0)
+
+        //The vertex animation storage is created once, so this is only written the first time a frame is recorded.
+        if (animationStorage.GetSize() > 0 && frameData.m_WrittenAnimationStorageVersion != animationStorage.GetVersion())
         {
-            builder.WriteBuffer(a_CurrentFrameIndex, 1, frame.m_UploadData.m_LightsBuffer.GetBuffer(), 0, areaLightSize);
+            auto storageBuilder = RenderUtility::WriteDescriptors(a_RenderData.m_Device, m_InstanceDescriptors);
+            storageBuilder.WriteBuffer(a_CurrentFrameIndex, 4, animationStorage.GetBuffer(), 0, VK_WHOLE_SIZE);
+            frameData.m_WrittenAnimationStorageVersion = animationStorage.GetVersion();
+            statistics.m_NumDescriptorUpdates += storageBuilder.Upload();
         }
-        if(numDirectionalLights > 0)
+
+        //Debug views swap in the pipeline variants that count overdraw and lights.
+        const auto& debugSettings = frame.m_DebugView.m_Settings;
+        const bool debugView = m_DebugViewsSupported && debugSettings.m_Mode != DebugViewMode::NONE && m_DebugPipeline.m_Ready && m_DebugProcessingPipeline.m_Ready;
+        const auto& geometryPipeline = debugView ? m_DebugPipeline.m_Data : m_DeferredPipelineData;
+        const auto& processingPipeline = debugView ? m_DebugProcessingPipeline.m_Data : m_DeferredProcessingPipelineData;
+        const VkShaderStageFlags geometryPushStages = debugView ? (VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT) : VK_SHADER_STAGE_VERTEX_BIT;
+        if (debugView)
         {
-            builder.WriteBuffer(a_CurrentFrameIndex, 2, frame.m_UploadData.m_LightsBuffer.GetBuffer(), areaLightSize, directionalLightSize);
+            RecordDebugViewClears(a_RenderData, a_CommandBuffer, a_CurrentFrameIndex);
         }
-        builder.Upload();
+
+        //Scattered instances have to exist before the geometry pass draws them.
+        const bool scattered = !frame.m_DrawData->m_Scatters.empty() && RecordScatters(a_RenderData, a_CommandBuffer, a_CurrentFrameIndex);
     	
         /*
          * Rendering the current frame.
@@ -502,26 +918,77 @@ namespace egg
         renderPassInfo.clearValueCount = DEFERRED_ATTACHMENT_MAX_ENUM + 1;
         renderPassInfo.pClearValues = &clearColors[0];
         vkCmdBeginRenderPass(a_CommandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-        vkCmdBindPipeline(a_CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_DeferredPipelineData.m_Pipeline);
+        RenderUtility::SetViewport(a_CommandBuffer, a_RenderData.m_Settings.resolutionX, a_RenderData.m_Settings.resolutionY);
+        auto& profiler = a_RenderData.m_GpuProfiler;
+        const auto geometryZone = profiler.BeginZone(a_CommandBuffer, a_CurrentFrameIndex, "Deferred Geometry", true);
+        vkCmdBindPipeline(a_CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, geometryPipeline.m_Pipeline);
 
         auto& drawData = *frame.m_DrawData;
     	
-        //Put the previous frame's camera in the push constants.
+        //Put the camera in the push constants. This is the draw data's camera, unless the frame was redrawn with a different one.
         DeferredPushConstants pushData;
-        pushData.m_VPMatrix = drawData.m_Camera.CalculateVPMatrix();
+        pushData.m_VPMatrix = frame.m_Camera.CalculateVPMatrix();
+        pushData.m_Data1.y = glm::uintBitsToFloat(static_cast<uint32_t>(debugSettings.m_Mode));    //Only read by the debug view shader.
+        pushData.m_Data1.z = frame.m_InterpolationFactor;                                          //Blends the transforms of interpolated instances.
+        pushData.m_Data1.w = glm::uintBitsToFloat(0u);                                             //Offset added to the instance index, only set for scattered draws.
+        if (m_BufferDeviceAddress)
+        {
+            pushData.m_IndirectionAddress = indirectionBuffer.GetDeviceAddress();
+            pushData.m_InstanceAddress = instanceBuffer.GetDeviceAddress();
+            pushData.m_PreviousTransformAddress = previousTransformBuffer.GetDeviceAddress();
+            pushData.m_AnimationStateAddress = animationStateBuffer.GetDeviceAddress();
+        }
 
         //Bind the push constants.
-        vkCmdPushConstants(a_CommandBuffer, m_DeferredPipelineData.m_PipelineLayout, VkShaderStageFlagBits::VK_SHADER_STAGE_VERTEX_BIT,
+        vkCmdPushConstants(a_CommandBuffer, geometryPipeline.m_PipelineLayout, geometryPushStages,
             0, sizeof(DeferredPushConstants), &pushData);
 
-        vkCmdBindDescriptorSets(a_CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_DeferredPipelineData.m_PipelineLayout,
-            0, 1, &m_InstanceDescriptors.m_Sets[a_CurrentFrameIndex], 0, nullptr);
+        VkDescriptorSet geometrySets[2]{ m_InstanceDescriptors.m_Sets[a_CurrentFrameIndex], debugView ? m_DebugDescriptors.m_Sets[a_CurrentFrameIndex] : VK_NULL_HANDLE };
+        vkCmdBindDescriptorSets(a_CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, geometryPipeline.m_PipelineLayout,
+            0, debugView ? 2 : 1, geometrySets, 0, nullptr);
+
+        /*
+         * Scattered draw calls read their instances from the scatter output buffers instead of the uploaded buffers.
+         * Switching also sets the offset that the vertex shader adds to the instance index, which is only used without drawIndirectFirstInstance.
+         * The offset and both addresses directly follow the view projection matrix, so they are pushed as one range.
+         */
+        static_assert(offsetof(DeferredPushConstants, m_InstanceAddress) == sizeof(glm::mat4) + sizeof(glm::vec4) + sizeof(VkDeviceAddress), "Instance source is pushed as one range.");
+        bool scatterInstancesBound = false;
+        const auto bindInstances = [&](const bool a_Scattered, const uint32_t a_InstanceOffset)
+        {
+            pushData.m_Data1.w = glm::uintBitsToFloat(a_InstanceOffset);
+            uint32_t pushSize = sizeof(glm::vec4);
+            if (m_BufferDeviceAddress)
+            {
+                pushData.m_IndirectionAddress = a_Scattered ? frameData.m_ScatterIndirectionBuffer.GetDeviceAddress() : indirectionBuffer.GetDeviceAddress();
+                pushData.m_InstanceAddress = a_Scattered ? frameData.m_ScatterInstanceBuffer.GetDeviceAddress() : instanceBuffer.GetDeviceAddress();
+                pushSize += 2 * sizeof(VkDeviceAddress);
+            }
+            else if (a_Scattered != scatterInstancesBound)
+            {
+                const auto setIndex = a_Scattered ? m_Frames.size() + a_CurrentFrameIndex : a_CurrentFrameIndex;
+                vkCmdBindDescriptorSets(a_CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, geometryPipeline.m_PipelineLayout,
+                    0, 1, &m_InstanceDescriptors.m_Sets[setIndex], 0, nullptr);
+            }
+            vkCmdPushConstants(a_CommandBuffer, geometryPipeline.m_PipelineLayout, geometryPushStages, sizeof(glm::mat4), pushSize, &pushData.m_Data1);
+            scatterInstancesBound = a_Scattered;
+        };
+
+        const bool profileDrawPasses = profiler.ProfileDrawPasses();
+        while (profileDrawPasses && m_DrawPassZoneNames.size() < drawData.m_DrawPasses.size())
+        {
+            m_DrawPassZoneNames.push_back("Draw Pass " + std::to_string(m_DrawPassZoneNames.size()));
+        }
 
-        for (auto& drawPass : drawData.m_DrawPasses)
+        for (size_t drawPassIndex = 0; drawPassIndex < drawData.m_DrawPasses.size(); ++drawPassIndex)
         {
+            auto& drawPass = drawData.m_DrawPasses[drawPassIndex];
+
         	//First do static deferred shading.
             if(drawPass.m_Type == DrawPassType::STATIC_DEFERRED_SHADING)
             {
+                const auto drawPassZone = profileDrawPasses ? profiler.BeginZone(a_CommandBuffer, a_CurrentFrameIndex, m_DrawPassZoneNames[drawPassIndex], true) : GpuProfiler::INVALID_ZONE;
+
 	            for(int drawCallIndex : drawPass.m_DrawCalls)
 	            {
                     auto& drawCall = drawData.m_DrawCalls[drawCallIndex];
@@ -538,36 +1005,396 @@ namespace egg
                     //Push constants contain the offset and and total instance count in the first vec4.
                     //vkCmdPushConstants(a_CommandBuffer, m_DeferredPipelineData.m_PipelineLayout, VkShaderStageFlagBits::VK_SHADER_STAGE_VERTEX_BIT, sizeof(glm::mat4), sizeof(glm::uvec4), &drawLocalData);
 
+                    //The debug view colors geometry by draw call, so the index is pushed before every draw.
+                    if (debugView)
+                    {
+                        pushData.m_Data1.x = glm::uintBitsToFloat(static_cast<uint32_t>(drawCallIndex));
+                        vkCmdPushConstants(a_CommandBuffer, geometryPipeline.m_PipelineLayout, geometryPushStages,
+                            sizeof(glm::mat4), sizeof(glm::vec4), &pushData.m_Data1);
+                    }
+
+                    //Scattered draw calls read their instance count from the draw command that the scatter shader counted the visible instances in.
+                    //Their triangles are not known on the CPU, so they are not part of the statistics.
+                    if (drawCall.m_ScatterIndex != 0)
+                    {
+                        if (!scattered)
+                        {
+                            continue;
+                        }
+
+                        //Without drawIndirectFirstInstance the command starts at instance 0, so the first indirection of the scatter is pushed instead.
+                        const auto firstIndirection = drawData.m_Scatters[drawCall.m_ScatterIndex - 1].m_Output.y;
+                        bindInstances(true, m_DrawIndirectFirstInstance ? 0u : firstIndirection);
+                        vkCmdDrawIndexedIndirect(a_CommandBuffer, frameData.m_ScatterCommandBuffer.GetBuffer(),
+                            sizeof(VkDrawIndexedIndirectCommand) * (drawCall.m_ScatterIndex - 1), 1, sizeof(VkDrawIndexedIndirectCommand));
+                        ++statistics.m_NumDrawCalls;
+                        continue;
+                    }
+
+                    if (scatterInstancesBound)
+                    {
+                        bindInstances(false, 0u);
+                    }
+
                     //Instanced draw call.
 	            	//Offset into the indirection buffer is passed as the first instance.
                     vkCmdDrawIndexed(a_CommandBuffer, static_cast<uint32_t>(mesh->GetNumIndices()), static_cast<uint32_t>(drawCall.m_NumInstances), 0, 0, drawCall.m_IndirectionBufferOffset);
+                    ++statistics.m_NumDrawCalls;
+                    statistics.m_NumTriangles += static_cast<uint64_t>(mesh->GetNumIndices() / 3) * drawCall.m_NumInstances;
 	            }
+
+                profiler.EndZone(a_CommandBuffer, a_CurrentFrameIndex, drawPassZone);
             }
         }
 
+        //Terrain is drawn after the draw passes, so that the meshes in front of it have already filled the depth buffer.
+        if (m_TerrainStage != nullptr && m_TerrainStage->IsEnabled())
+        {
+            m_TerrainStage->RecordDraw(a_RenderData, a_CommandBuffer, a_CurrentFrameIndex);
+        }
+        profiler.EndZone(a_CommandBuffer, a_CurrentFrameIndex, geometryZone);
+
         //Next pass!
         vkCmdNextSubpass(a_CommandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+        const auto shadingZone = profiler.BeginZone(a_CommandBuffer, a_CurrentFrameIndex, "Deferred Shading", true);
 
         //Process in the second stage.
-        vkCmdBindPipeline(a_CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_DeferredProcessingPipelineData.m_Pipeline);
+        vkCmdBindPipeline(a_CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, processingPipeline.m_Pipeline);
 
-        //Bind the descriptor set that handles G-Buffer input.
-        VkDescriptorSet sets[2]{ m_ProcessingDescriptors.m_Sets[a_CurrentFrameIndex], m_ShadingDescriptors.m_Sets[a_CurrentFrameIndex]};
-        vkCmdBindDescriptorSets(a_CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_DeferredProcessingPipelineData.m_PipelineLayout, 0, 2, sets, 0, nullptr);
+        //Bind the descriptor set that handles G-Buffer input. The debug view set is only bound for the debug pipeline.
+        VkDescriptorSet sets[3]{ m_ProcessingDescriptors.m_Sets[a_CurrentFrameIndex], m_ShadingDescriptors.m_Sets[a_CurrentFrameIndex], debugView ? m_DebugDescriptors.m_Sets[a_CurrentFrameIndex] : VK_NULL_HANDLE };
+        vkCmdBindDescriptorSets(a_CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, processingPipeline.m_PipelineLayout, 0, debugView ? 3 : 2, sets, 0, nullptr);
 
         DeferredProcessingPushConstants processingPushData;
-        processingPushData.m_CameraPosition = glm::vec4(drawData.m_Camera.GetTransform().GetTranslation(), 0.f);
+        processingPushData.m_CameraPosition = glm::vec4(frame.m_Camera.GetTransform().GetTranslation(), 0.f);
         processingPushData.m_LightCounts.x = numAreaLights;
         processingPushData.m_LightCounts.y = numDirectionalLights;
-        vkCmdPushConstants(a_CommandBuffer, m_DeferredProcessingPipelineData.m_PipelineLayout, VkShaderStageFlagBits::VK_SHADER_STAGE_FRAGMENT_BIT,
+        processingPushData.m_LightCounts.z = a_RenderData.m_Settings.contactShadowSteps;
+
+        //A perspective projection stores depth as -P[2][2] + P[3][2] / w, where w is the distance along the view direction.
+        const glm::mat4 projection = frame.m_Camera.GetProjectionMatrix();
+        const glm::mat4 viewProjection = frame.m_Camera.CalculateVPMatrix();
+        processingPushData.m_DepthToDistance = glm::vec2(projection[2][2], projection[3][2]);
+        for (int row = 0; row < 3; ++row)
+        {
+            const int matrixRow = row == 2 ? 3 : row;
+            processingPushData.m_ScreenProjection[row] = glm::vec4(viewProjection[0][matrixRow], viewProjection[1][matrixRow], viewProjection[2][matrixRow], viewProjection[3][matrixRow]);
+        }
+
+        //The viewport is flipped (see RenderUtility::SetViewport()), so texture coordinates grow downwards while clip space Y grows upwards.
+        processingPushData.m_ScreenProjection[1] = -processingPushData.m_ScreenProjection[1];
+        processingPushData.m_DebugData = glm::uvec4(static_cast<uint32_t>(debugSettings.m_Mode), debugSettings.m_HeatmapMaximum, 0, 0);
+        if (m_BufferDeviceAddress)
+        {
+            //Both light ranges share one buffer, directional lights are stored after the area lights.
+            const VkDeviceAddress lightsAddress = lightsBuffer.GetDeviceAddress();
+            processingPushData.m_MaterialAddress = materialBuffer.GetDeviceAddress();
+            processingPushData.m_AreaLightAddress = lightsAddress;
+            processingPushData.m_DirectionalLightAddress = lightsAddress != 0 ? lightsAddress + areaLightSize : 0;
+        }
+        vkCmdPushConstants(a_CommandBuffer, processingPipeline.m_PipelineLayout, VkShaderStageFlagBits::VK_SHADER_STAGE_FRAGMENT_BIT,
             0, sizeof(DeferredProcessingPushConstants), &processingPushData);
 
         vkCmdDraw(a_CommandBuffer, 3, 1, 0, 0); //Draw a full-screen triangle.
+        ++statistics.m_NumDrawCalls;
+        ++statistics.m_NumTriangles;
+        profiler.EndZone(a_CommandBuffer, a_CurrentFrameIndex, shadingZone);
+
+        //Debug primitives are drawn last, with a single draw call per primitive type.
+        vkCmdNextSubpass(a_CommandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+        const auto& uploadData = frame.m_UploadData;
+        if (uploadData.m_NumDebugLineVertices + uploadData.m_NumDebugTriangleVertices > 0)
+        {
+            const auto debugDrawZone = profiler.BeginZone(a_CommandBuffer, a_CurrentFrameIndex, "Debug Draw", true);
+            const VkBuffer debugVertexBuffer = uploadData.m_DebugVertexBuffer.GetBuffer();
+
+            //Lines are stored first, followed by the triangles.
+            const std::pair<const PipelineData*, uint32_t> debugDraws[2]
+            {
+                { &m_DebugLinePipelineData, uploadData.m_NumDebugLineVertices },
+                { &m_DebugTrianglePipelineData, uploadData.m_NumDebugTriangleVertices }
+            };
+
+            VkDeviceSize vertexOffset = 0;
+            for (const auto& debugDraw : debugDraws)
+            {
+                if (debugDraw.second > 0)
+                {
+                    vkCmdBindPipeline(a_CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, debugDraw.first->m_Pipeline);
+                    vkCmdPushConstants(a_CommandBuffer, debugDraw.first->m_PipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &pushData.m_VPMatrix);
+                    vkCmdBindVertexBuffers(a_CommandBuffer, 0, 1, &debugVertexBuffer, &vertexOffset);
+                    vkCmdDraw(a_CommandBuffer, debugDraw.second, 1, 0, 0);
+                    ++statistics.m_NumDrawCalls;
+                }
+                vertexOffset += static_cast<VkDeviceSize>(debugDraw.second) * sizeof(PackedDebugVertex);
+            }
+            statistics.m_NumTriangles += uploadData.m_NumDebugTriangleVertices / 3;
+
+            profiler.EndZone(a_CommandBuffer, a_CurrentFrameIndex, debugDrawZone);
+        }
+
         vkCmdEndRenderPass(a_CommandBuffer);
+
+        //Copy the G-buffer texels requested by picking queries.
+        RecordPickingCopies(a_RenderData, a_CommandBuffer, a_CurrentFrameIndex);
+
+        //Make the debug counters visible to the CPU once the frame fence is signaled.
+        if (debugView)
+        {
+            VkBufferMemoryBarrier bufferBarrier{};
+            bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            bufferBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+            bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            bufferBarrier.buffer = frame.m_DebugView.m_CounterBuffer.GetBuffer();
+            bufferBarrier.offset = 0;
+            bufferBarrier.size = VK_WHOLE_SIZE;
+
+            vkCmdPipelineBarrier(a_CommandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+                0, nullptr, 1, &bufferBarrier, 0, nullptr);
+        }
     	
         return true;
     }
 
+    void RenderStage_Deferred::RecordDebugViewClears(const RenderData& a_RenderData, VkCommandBuffer& a_CommandBuffer, const uint32_t a_CurrentFrameIndex)
+    {
+        auto& frameData = m_Frames[a_CurrentFrameIndex];
+        const auto counterBuffer = a_RenderData.m_FrameData[a_CurrentFrameIndex].m_DebugView.m_CounterBuffer.GetBuffer();
+
+        //The previous contents are not needed, so the image is transitioned from undefined every frame.
+        VkImageMemoryBarrier imageBarrier{};
+        imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        imageBarrier.srcAccessMask = 0;
+        imageBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        imageBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarrier.image = frameData.m_OverdrawImage.m_Image;
+        imageBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+        vkCmdPipelineBarrier(a_CommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+            0, nullptr, 0, nullptr, 1, &imageBarrier);
+
+        const VkClearColorValue clearValue{};
+        vkCmdClearColorImage(a_CommandBuffer, frameData.m_OverdrawImage.m_Image, VK_IMAGE_LAYOUT_GENERAL, &clearValue, 1, &imageBarrier.subresourceRange);
+        vkCmdFillBuffer(a_CommandBuffer, counterBuffer, 0, DebugViewData::COUNTER_BUFFER_SIZE, 0);
+
+        //Both are accessed with atomics in the fragment shaders of the render pass.
+        imageBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        imageBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        imageBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        VkBufferMemoryBarrier bufferBarrier{};
+        bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        bufferBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        bufferBarrier.buffer = counterBuffer;
+        bufferBarrier.offset = 0;
+        bufferBarrier.size = VK_WHOLE_SIZE;
+
+        vkCmdPipelineBarrier(a_CommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+            0, nullptr, 1, &bufferBarrier, 1, &imageBarrier);
+    }
+
+    bool RenderStage_Deferred::RecordScatters(const RenderData& a_RenderData, VkCommandBuffer& a_CommandBuffer, const uint32_t a_CurrentFrameIndex)
+    {
+        const auto& frame = a_RenderData.m_FrameData[a_CurrentFrameIndex];
+        auto& frameData = m_Frames[a_CurrentFrameIndex];
+        const auto& drawData = *frame.m_DrawData;
+        auto& instanceBuffer = frameData.m_ScatterInstanceBuffer;
+        auto& indirectionBuffer = frameData.m_ScatterIndirectionBuffer;
+        auto& statistics = a_RenderData.m_RecordingStatistics;
+        const auto numScatters = static_cast<uint32_t>(drawData.m_Scatters.size());
+
+        //The output buffers hold every candidate of the frame. The GPU of this frame is done with them, so they can be replaced when they grow.
+        const auto numCandidates = static_cast<size_t>(drawData.m_NumScatterCandidates);
+        if (!instanceBuffer.Reserve(std::max<size_t>(numCandidates, 1) * sizeof(PackedInstanceData))
+            || !indirectionBuffer.Reserve(std::max<size_t>(numCandidates, 1) * sizeof(uint32_t)))
+        {
+            printf("Could not reserve memory for %zu scattered instances! Scattered draw calls are skipped.\n", numCandidates);
+            return false;
+        }
+
+        //Without buffer device addresses the geometry pass reads the output buffers through the frame's scattered instance set.
+        auto builder = RenderUtility::WriteDescriptors(a_RenderData.m_Device, m_ScatterDescriptors);
+        auto instanceBuilder = RenderUtility::WriteDescriptors(a_RenderData.m_Device, m_InstanceDescriptors);
+        const auto scatteredInstanceSet = static_cast<uint32_t>(m_Frames.size()) + a_CurrentFrameIndex;
+        if (frameData.m_WrittenScatterInstanceVersion != instanceBuffer.GetVersion())
+        {
+            builder.WriteBuffer(a_CurrentFrameIndex, 2, instanceBuffer.GetBuffer(), 0, VK_WHOLE_SIZE);
+            if (!m_BufferDeviceAddress)
+            {
+                instanceBuilder.WriteBuffer(scatteredInstanceSet, 1, instanceBuffer.GetBuffer(), 0, VK_WHOLE_SIZE);
+            }
+            frameData.m_WrittenScatterInstanceVersion = instanceBuffer.GetVersion();
+        }
+        if (frameData.m_WrittenScatterIndirectionVersion != indirectionBuffer.GetVersion())
+        {
+            builder.WriteBuffer(a_CurrentFrameIndex, 3, indirectionBuffer.GetBuffer(), 0, VK_WHOLE_SIZE);
+            if (!m_BufferDeviceAddress)
+            {
+                instanceBuilder.WriteBuffer(scatteredInstanceSet, 0, indirectionBuffer.GetBuffer(), 0, VK_WHOLE_SIZE);
+            }
+            frameData.m_WrittenScatterIndirectionVersion = indirectionBuffer.GetVersion();
+        }
+        statistics.m_NumDescriptorUpdates += builder.Upload();
+        statistics.m_NumDescriptorUpdates += instanceBuilder.Upload();
+
+        //Every draw command starts without instances, and draws from the scatter's range of the indirection buffer.
+        //A non-zero first instance needs drawIndirectFirstInstance. Without it the geometry pass pushes the range's start instead.
+        std::vector<VkDrawIndexedIndirectCommand> commands(numScatters);
+        auto surfaceBuilder = RenderUtility::WriteDescriptors(a_RenderData.m_Device, m_ScatterSurfaceDescriptors);
+        for (uint32_t scatterIndex = 0; scatterIndex < numScatters; ++scatterIndex)
+        {
+            const auto& scatter = drawData.m_Scatters[scatterIndex];
+            const auto& mesh = std::static_pointer_cast<StaticMesh>(drawData.m_Meshes[scatter.m_Surface.w]);
+            commands[scatterIndex] = { static_cast<uint32_t>(mesh->GetNumIndices()), 0, 0, 0, m_DrawIndirectFirstInstance ? scatter.m_Output.y : 0 };
+
+            if (scatter.m_Counts.z > 0)
+            {
+                const auto& surface = std::static_pointer_cast<StaticMesh>(drawData.m_Meshes[scatter.m_Surface.z]);
+                surfaceBuilder.WriteBuffer(a_CurrentFrameIndex * EggDrawData::MAX_SCATTERS + scatterIndex, 0, surface->GetBuffer(), 0, VK_WHOLE_SIZE);
+            }
+        }
+        statistics.m_NumDescriptorUpdates += surfaceBuilder.Upload();
+
+        const auto scatterZone = a_RenderData.m_GpuProfiler.BeginZone(a_CommandBuffer, a_CurrentFrameIndex, "Scatter");
+
+        //The camera is the frame's camera, which differs from the draw data's camera when the frame is redrawn.
+        const glm::mat4 viewProjection = frame.m_Camera.CalculateVPMatrix();
+        const VkBuffer scatterBuffer = frameData.m_ScatterBuffer.GetBuffer();
+        const VkBuffer commandBuffer = frameData.m_ScatterCommandBuffer.GetBuffer();
+        vkCmdUpdateBuffer(a_CommandBuffer, scatterBuffer, 0, sizeof(glm::mat4), &viewProjection);
+        vkCmdUpdateBuffer(a_CommandBuffer, scatterBuffer, sizeof(glm::mat4), sizeof(PackedScatterData) * numScatters, drawData.m_Scatters.data());
+        vkCmdUpdateBuffer(a_CommandBuffer, commandBuffer, 0, sizeof(VkDrawIndexedIndirectCommand) * numScatters, commands.data());
+
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(a_CommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+            1, &barrier, 0, nullptr, 0, nullptr);
+
+        vkCmdBindPipeline(a_CommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_ScatterPipelineData.m_Pipeline);
+        vkCmdBindDescriptorSets(a_CommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_ScatterPipelineData.m_PipelineLayout,
+            0, 1, &m_ScatterDescriptors.m_Sets[a_CurrentFrameIndex], 0, nullptr);
+
+        //One thread per candidate. Scatters over an area bind a surface set that was never written, which their shader does not read.
+        ScatterPushConstants pushData{ 0 };
+        for (uint32_t scatterIndex = 0; scatterIndex < numScatters; ++scatterIndex)
+        {
+            const auto numCandidates = drawData.m_Scatters[scatterIndex].m_Counts.x;
+            if (numCandidates == 0)
+            {
+                continue;
+            }
+
+            vkCmdBindDescriptorSets(a_CommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_ScatterPipelineData.m_PipelineLayout,
+                1, 1, &m_ScatterSurfaceDescriptors.m_Sets[a_CurrentFrameIndex * EggDrawData::MAX_SCATTERS + scatterIndex], 0, nullptr);
+            pushData.m_ScatterIndex = scatterIndex;
+            vkCmdPushConstants(a_CommandBuffer, m_ScatterPipelineData.m_PipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ScatterPushConstants), &pushData);
+            vkCmdDispatch(a_CommandBuffer, (numCandidates + PackedScatterData::GROUP_SIZE - 1) / PackedScatterData::GROUP_SIZE, 1, 1);
+        }
+
+        //The geometry pass reads the instance counts as draw parameters, and the instances in its vertex shader.
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(a_CommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0,
+            1, &barrier, 0, nullptr, 0, nullptr);
+
+        a_RenderData.m_GpuProfiler.EndZone(a_CommandBuffer, a_CurrentFrameIndex, scatterZone);
+        return true;
+    }
+
+    void RenderStage_Deferred::RecordPickingCopies(const RenderData& a_RenderData, VkCommandBuffer& a_CommandBuffer, const uint32_t a_CurrentFrameIndex)
+    {
+        const auto& pickingData = a_RenderData.m_FrameData[a_CurrentFrameIndex].m_PickingData;
+        auto& frameData = m_Frames[a_CurrentFrameIndex];
+
+        /*
+         * Every query copies its custom ID texels followed by its depth texels.
+         * The depth is used to tell apart pixels that were not covered by geometry.
+         */
+        std::vector<VkBufferImageCopy> idCopies;
+        std::vector<VkBufferImageCopy> depthCopies;
+        for (const auto& query : pickingData.m_Queries)
+        {
+            //Queries may have been clamped to nothing when outside of the screen.
+            if (query.m_Size.x == 0 || query.m_Size.y == 0)
+            {
+                continue;
+            }
+
+            VkBufferImageCopy copy{};
+            copy.bufferOffset = query.m_BufferOffset;
+            copy.bufferRowLength = 0;       //Tightly packed.
+            copy.bufferImageHeight = 0;
+            copy.imageOffset = { static_cast<int32_t>(query.m_Offset.x), static_cast<int32_t>(query.m_Offset.y), 0 };
+            copy.imageExtent = { query.m_Size.x, query.m_Size.y, 1 };
+            copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            copy.imageSubresource.mipLevel = 0;
+            copy.imageSubresource.baseArrayLayer = DEFERRED_ATTACHMENT_UV_MATERIAL_ID - 1;   //Depth is not part of the array.
+            copy.imageSubresource.layerCount = 1;
+            idCopies.push_back(copy);
+
+            copy.bufferOffset += static_cast<VkDeviceSize>(query.m_Size.x) * query.m_Size.y * PickingData::ID_TEXEL_SIZE;
+            copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+            copy.imageSubresource.baseArrayLayer = 0;
+            depthCopies.push_back(copy);
+        }
+
+        if (idCopies.empty())
+        {
+            return;
+        }
+
+        //Transition the custom ID layer and the depth image so that they can be copied from.
+        VkImageMemoryBarrier imageBarriers[2]{ {}, {} };
+        imageBarriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        imageBarriers[0].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        imageBarriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        imageBarriers[0].oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        imageBarriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        imageBarriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarriers[0].image = frameData.m_DeferredArrayImage.m_Image;
+        imageBarriers[0].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, DEFERRED_ATTACHMENT_UV_MATERIAL_ID - 1, 1 };
+
+        imageBarriers[1] = imageBarriers[0];
+        imageBarriers[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        imageBarriers[1].oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        imageBarriers[1].image = frameData.m_DepthImage.m_Image;
+        imageBarriers[1].subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 };
+
+        vkCmdPipelineBarrier(a_CommandBuffer, VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+            0, nullptr, 0, nullptr, 2, &imageBarriers[0]);
+
+        const auto readbackBuffer = pickingData.m_ReadbackBuffer.GetBuffer();
+        vkCmdCopyImageToBuffer(a_CommandBuffer, frameData.m_DeferredArrayImage.m_Image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            readbackBuffer, static_cast<uint32_t>(idCopies.size()), idCopies.data());
+        vkCmdCopyImageToBuffer(a_CommandBuffer, frameData.m_DepthImage.m_Image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            readbackBuffer, static_cast<uint32_t>(depthCopies.size()), depthCopies.data());
+
+        //Make the copied texels visible to the CPU once the frame fence is signaled.
+        VkBufferMemoryBarrier bufferBarrier{};
+        bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        bufferBarrier.buffer = readbackBuffer;
+        bufferBarrier.offset = 0;
+        bufferBarrier.size = VK_WHOLE_SIZE;
+
+        vkCmdPipelineBarrier(a_CommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+            0, nullptr, 1, &bufferBarrier, 0, nullptr);
+    }
+
     void RenderStage_Deferred::WaitForIdle(const RenderData& a_RenderData)
     {
         //Nothing to wait for here.
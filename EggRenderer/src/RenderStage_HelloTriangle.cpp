@@ -241,6 +241,8 @@ namespace egg
         vkCmdBeginRenderPass(a_CommandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
         vkCmdBindPipeline(a_CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_Pipeline);
         vkCmdDraw(a_CommandBuffer, 3, 1, 0, 0);
+        ++a_RenderData.m_RecordingStatistics.m_NumDrawCalls;
+        ++a_RenderData.m_RecordingStatistics.m_NumTriangles;
         vkCmdEndRenderPass(a_CommandBuffer);
 
         return true;
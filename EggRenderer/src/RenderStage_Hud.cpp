@@ -0,0 +1,540 @@
+#include <algorithm>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "HudFont.h"
+#include "MemoryTracker.h"
+#include "Renderer.h"
+#include "RenderStage.h"
+#include "RenderUtility.h"
+
+namespace egg
+{
+    namespace
+    {
+        constexpr uint32_t ATLAS_GLYPHS_PER_ROW = 16;
+        constexpr uint32_t ATLAS_ROWS = HUD_FONT_NUM_GLYPHS / ATLAS_GLYPHS_PER_ROW;
+        constexpr uint32_t ATLAS_WIDTH = ATLAS_GLYPHS_PER_ROW * HUD_FONT_GLYPH_SIZE;
+        constexpr uint32_t ATLAS_HEIGHT = ATLAS_ROWS * HUD_FONT_GLYPH_SIZE;
+
+        constexpr uint32_t PackColor(uint32_t a_R, uint32_t a_G, uint32_t a_B, uint32_t a_A)
+        {
+            return a_R | (a_G << 8) | (a_B << 16) | (a_A << 24);
+        }
+
+        constexpr uint32_t COLOR_BACKGROUND = PackColor(0, 0, 0, 160);
+        constexpr uint32_t COLOR_GRAPH_BACKGROUND = PackColor(40, 40, 40, 200);
+        constexpr uint32_t COLOR_TEXT = PackColor(255, 255, 255, 255);
+        constexpr uint32_t COLOR_HEADER = PackColor(255, 220, 100, 255);
+        constexpr uint32_t COLOR_CPU = PackColor(255, 140, 40, 255);
+        constexpr uint32_t COLOR_GPU = PackColor(60, 200, 255, 255);
+        constexpr uint32_t COLOR_REFERENCE = PackColor(120, 255, 120, 160);
+
+        constexpr float GRAPH_HEIGHT = 48.f;                    //In font pixels.
+        constexpr double TARGET_FRAME_MILLISECONDS = 1000.0 / 60.0;
+
+        /*
+         * Format an amount of bytes with a readable unit.
+         */
+        void FormatBytes(uint64_t a_Bytes, char* a_Output, size_t a_Size)
+        {
+            if (a_Bytes >= 1024ull * 1024ull)
+            {
+                snprintf(a_Output, a_Size, "%.1f MB", static_cast<double>(a_Bytes) / (1024.0 * 1024.0));
+            }
+            else
+            {
+                snprintf(a_Output, a_Size, "%.1f KB", static_cast<double>(a_Bytes) / 1024.0);
+            }
+        }
+    }
+
+    bool RenderStage_Hud::Init(const RenderData& a_RenderData)
+    {
+        //Buffers keep their own copies of the handles.
+        VkDevice device = a_RenderData.m_Device;
+        VmaAllocator allocator = a_RenderData.m_Allocator;
+
+        m_Scale = static_cast<float>(std::max(a_RenderData.m_Settings.hudScale, 1u));
+        m_AtlasUploaded = false;
+
+        /*
+         * Draw on top of whatever is in the swap chain image, and leave it ready to be presented.
+         */
+        VkAttachmentDescription attachment{};
+        attachment.format = static_cast<VkFormat>(a_RenderData.m_Settings.outputFormat);
+        attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        attachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+        attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachment.initialLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+        VkAttachmentReference attachmentReference{};
+        attachmentReference.attachment = 0;
+        attachmentReference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+        VkSubpassDescription subpass{};
+        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass.colorAttachmentCount = 1;
+        subpass.pColorAttachments = &attachmentReference;
+
+        //Wait for the previous stages to finish writing the output before blending over it.
+        VkSubpassDependency subPassDependencies[2]{ {}, {} };
+        subPassDependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+        subPassDependencies[0].dstSubpass = 0;
+        subPassDependencies[0].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        subPassDependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        subPassDependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        subPassDependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        subPassDependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+        subPassDependencies[1].srcSubpass = 0;
+        subPassDependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+        subPassDependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        subPassDependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+        subPassDependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        subPassDependencies[1].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+        subPassDependencies[1].dependencyFlags = 0;
+
+        VkRenderPassCreateInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        renderPassInfo.attachmentCount = 1;
+        renderPassInfo.pAttachments = &attachment;
+        renderPassInfo.subpassCount = 1;
+        renderPassInfo.pSubpasses = &subpass;
+        renderPassInfo.dependencyCount = 2;
+        renderPassInfo.pDependencies = &subPassDependencies[0];
+
+        if (vkCreateRenderPass(a_RenderData.m_Device, &renderPassInfo, nullptr, &m_RenderPass) != VK_SUCCESS)
+        {
+            printf("Could not create render pass for HUD stage!\n");
+            return false;
+        }
+        if (!a_RenderData.m_PipelineCache.RegisterRenderPass(renderPassInfo, m_RenderPassKey))
+        {
+            return false;
+        }
+
+        /*
+         * Font atlas. The pixels are staged here, and copied into the image the first time the HUD is recorded.
+         */
+        std::vector<uint8_t> atlasPixels(ATLAS_WIDTH * ATLAS_HEIGHT, 0);
+        for (uint32_t glyph = 0; glyph < HUD_FONT_NUM_GLYPHS; ++glyph)
+        {
+            const uint32_t cellX = (glyph % ATLAS_GLYPHS_PER_ROW) * HUD_FONT_GLYPH_SIZE;
+            const uint32_t cellY = (glyph / ATLAS_GLYPHS_PER_ROW) * HUD_FONT_GLYPH_SIZE;
+            for (uint32_t row = 0; row < HUD_FONT_GLYPH_SIZE; ++row)
+            {
+                for (uint32_t column = 0; column < HUD_FONT_GLYPH_SIZE; ++column)
+                {
+                    const bool set = (HUD_FONT[glyph][row] >> column) & 1;
+                    atlasPixels[(cellY + row) * ATLAS_WIDTH + cellX + column] = set ? 255 : 0;
+                }
+            }
+        }
+
+        m_AtlasStagingBuffer.Init(
+            GpuBufferSettings{ atlasPixels.size(), 16, VMA_MEMORY_USAGE_CPU_TO_GPU, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, MemoryCategory::STAGING }
+        , device, allocator);
+        CPUWrite atlasWrite{ atlasPixels.data(), 0, atlasPixels.size() };
+        if (!m_AtlasStagingBuffer.Write(&atlasWrite, 1))
+        {
+            printf("Could not stage HUD font atlas!\n");
+            return false;
+        }
+
+        ImageInfo atlasImage;
+        atlasImage.m_Format = VK_FORMAT_R8_UNORM;
+        atlasImage.m_Usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        atlasImage.m_Dimensions = { ATLAS_WIDTH, ATLAS_HEIGHT, 1 };
+        atlasImage.m_MemoryCategory = MemoryCategory::OTHER;
+
+        if (!RenderUtility::CreateImage(a_RenderData.m_Device, a_RenderData.m_Allocator, atlasImage, m_AtlasImage))
+        {
+            printf("Could not create HUD font atlas.\n");
+            return false;
+        }
+
+        ImageViewInfo atlasViewInfo;
+        atlasViewInfo.m_Format = atlasImage.m_Format;
+        atlasViewInfo.m_Image = m_AtlasImage.m_Image;
+        atlasViewInfo.m_VisibleAspects = VK_IMAGE_ASPECT_COLOR_BIT;
+
+        if (!RenderUtility::CreateImageView(a_RenderData.m_Device, atlasViewInfo, m_AtlasImageView))
+        {
+            printf("Could not create HUD font atlas view.\n");
+            return false;
+        }
+
+        //Glyphs are read with texel fetches, so the sampler is never used for filtering.
+        VkSamplerCreateInfo samplerInfo{};
+        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerInfo.magFilter = VK_FILTER_NEAREST;
+        samplerInfo.minFilter = VK_FILTER_NEAREST;
+        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.maxLod = 0.f;
+
+        if (vkCreateSampler(a_RenderData.m_Device, &samplerInfo, nullptr, &m_AtlasSampler) != VK_SUCCESS)
+        {
+            printf("Could not create HUD font atlas sampler.\n");
+            return false;
+        }
+
+        //The atlas never changes, so a single set is shared by all frames.
+        if (!RenderUtility::CreateDescriptorSetContainer(a_RenderData.m_Device,
+            DescriptorSetContainerCreateInfo::Create(1)
+            .AddBinding(0, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
+            , m_AtlasDescriptors))
+        {
+            printf("Could not create descriptor sets!\n");
+            return false;
+        }
+
+        VkDescriptorImageInfo atlasDescriptor{ m_AtlasSampler, m_AtlasImageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+        VkWriteDescriptorSet writeDescriptorSet{};
+        writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writeDescriptorSet.dstSet = m_AtlasDescriptors.m_Sets[0];
+        writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        writeDescriptorSet.descriptorCount = 1;
+        writeDescriptorSet.dstBinding = 0;
+        writeDescriptorSet.pImageInfo = &atlasDescriptor;
+        vkUpdateDescriptorSets(a_RenderData.m_Device, 1, &writeDescriptorSet, 0, nullptr);
+
+        /*
+         * A glyph buffer and frame buffer for every frame.
+         */
+        m_Frames.resize(a_RenderData.m_Settings.m_SwapBufferCount);
+        for (uint32_t frameIndex = 0; frameIndex < static_cast<uint32_t>(m_Frames.size()); ++frameIndex)
+        {
+            auto& frame = m_Frames[frameIndex];
+            frame.m_GlyphBuffer.Init(
+                GpuBufferSettings{ 0, 16, VMA_MEMORY_USAGE_CPU_TO_GPU, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, MemoryCategory::FRAME_UPLOAD }
+            , device, allocator);
+
+            VkFramebufferCreateInfo frameBufferInfo{};
+            frameBufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+            frameBufferInfo.renderPass = m_RenderPass;
+            frameBufferInfo.attachmentCount = 1;
+            frameBufferInfo.pAttachments = &a_RenderData.m_FrameData[frameIndex].m_SwapchainView;
+            frameBufferInfo.width = a_RenderData.m_Settings.resolutionX;
+            frameBufferInfo.height = a_RenderData.m_Settings.resolutionY;
+            frameBufferInfo.layers = 1;
+            if (vkCreateFramebuffer(a_RenderData.m_Device, &frameBufferInfo, nullptr, &frame.m_Framebuffer) != VK_SUCCESS)
+            {
+                printf("Could not create frame buffer for HUD stage!\n");
+                return false;
+            }
+        }
+
+        /*
+         * Every glyph is an instance, the quad corners come from the vertex index.
+         */
+        PipelineCreateInfo pipelineInfo;
+        pipelineInfo.m_Shaders.push_back({ "hud.vert.spv", "main", VK_SHADER_STAGE_VERTEX_BIT });
+        pipelineInfo.m_Shaders.push_back({ "hud.frag.spv", "main", VK_SHADER_STAGE_FRAGMENT_BIT });
+        pipelineInfo.vertexData.m_VertexBindings.push_back({ 0, sizeof(HudGlyph), VkVertexInputRate::VK_VERTEX_INPUT_RATE_INSTANCE });
+        pipelineInfo.vertexData.m_VertexAttributes.push_back({ 0, 0, VkFormat::VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(HudGlyph, m_Rect) });
+        pipelineInfo.vertexData.m_VertexAttributes.push_back({ 1, 0, VkFormat::VK_FORMAT_R32_UINT, offsetof(HudGlyph, m_Glyph) });
+        pipelineInfo.vertexData.m_VertexAttributes.push_back({ 2, 0, VkFormat::VK_FORMAT_R8G8B8A8_UNORM, offsetof(HudGlyph, m_Color) });
+        pipelineInfo.pushConstants.m_PushConstantRanges.push_back({ VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(HudPushConstants) });
+        pipelineInfo.renderPass.m_RenderPass = m_RenderPass;
+        pipelineInfo.renderPass.m_CompatibilityKey = m_RenderPassKey;
+        pipelineInfo.depth.m_UseDepth = false;
+        pipelineInfo.depth.m_WriteDepth = false;
+        pipelineInfo.attachments.m_NumAttachments = 1;
+        pipelineInfo.attachments.m_AlphaBlending = true;
+        pipelineInfo.descriptors.Add(m_AtlasDescriptors);
+
+        if (!a_RenderData.m_PipelineCache.Acquire(pipelineInfo, m_PipelineData))
+        {
+            return false;
+        }
+
+        return true;
+    }
+
+    bool RenderStage_Hud::CleanUp(const RenderData& a_RenderData)
+    {
+        a_RenderData.m_PipelineCache.Release(m_PipelineData);
+
+        for (auto& frame : m_Frames)
+        {
+            frame.m_GlyphBuffer.CleanUp();
+            vkDestroyFramebuffer(a_RenderData.m_Device, frame.m_Framebuffer, nullptr);
+        }
+        m_Frames.clear();
+
+        RenderUtility::DestroyDescriptorSetContainer(a_RenderData.m_Device, m_AtlasDescriptors);
+        vkDestroySampler(a_RenderData.m_Device, m_AtlasSampler, nullptr);
+        vkDestroyImageView(a_RenderData.m_Device, m_AtlasImageView, nullptr);
+        MemoryTracker::Untrack(a_RenderData.m_Allocator, m_AtlasImage.m_Allocation);
+        vmaDestroyImage(a_RenderData.m_Allocator, m_AtlasImage.m_Image, m_AtlasImage.m_Allocation);
+        m_AtlasStagingBuffer.CleanUp();
+
+        vkDestroyRenderPass(a_RenderData.m_Device, m_RenderPass, nullptr);
+        return true;
+    }
+
+    bool RenderStage_Hud::RecordCommandBuffer(const RenderData& a_RenderData, VkCommandBuffer& a_CommandBuffer,
+        const uint32_t a_CurrentFrameIndex, std::vector<VkSemaphore>& a_WaitSemaphores,
+        std::vector<VkSemaphore>& a_SignalSemaphores, std::vector<VkPipelineStageFlags>& a_WaitStageFlags)
+    {
+        auto& frame = m_Frames[a_CurrentFrameIndex];
+
+        //Lay out the HUD and upload it in one go. The frame's fence has been waited on, so the buffer is not in use.
+        BuildGlyphs(a_RenderData.m_FrameData[a_CurrentFrameIndex].m_HudData);
+        CPUWrite write{ m_Glyphs.data(), 0, m_Glyphs.size() * sizeof(HudGlyph) };
+        if (!frame.m_GlyphBuffer.Write(&write, 1, true))
+        {
+            printf("Could not upload HUD glyphs!\n");
+            return false;
+        }
+
+        if (!m_AtlasUploaded)
+        {
+            RecordAtlasUpload(a_CommandBuffer);
+        }
+
+        VkRenderPassBeginInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = m_RenderPass;
+        renderPassInfo.framebuffer = frame.m_Framebuffer;
+        renderPassInfo.renderArea.offset = { 0, 0 };
+        renderPassInfo.renderArea.extent = { a_RenderData.m_Settings.resolutionX, a_RenderData.m_Settings.resolutionY };
+        renderPassInfo.clearValueCount = 0;     //The output is loaded, not cleared.
+        vkCmdBeginRenderPass(a_CommandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        RenderUtility::SetViewport(a_CommandBuffer, a_RenderData.m_Settings.resolutionX, a_RenderData.m_Settings.resolutionY);
+
+        vkCmdBindPipeline(a_CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineData.m_Pipeline);
+        vkCmdBindDescriptorSets(a_CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineData.m_PipelineLayout,
+            0, 1, &m_AtlasDescriptors.m_Sets[0], 0, nullptr);
+
+        const VkBuffer glyphBuffer = frame.m_GlyphBuffer.GetBuffer();
+        const VkDeviceSize glyphOffset = 0;
+        vkCmdBindVertexBuffers(a_CommandBuffer, 0, 1, &glyphBuffer, &glyphOffset);
+
+        HudPushConstants pushData;
+        pushData.m_InverseResolution = glm::vec2(1.f / static_cast<float>(a_RenderData.m_Settings.resolutionX), 1.f / static_cast<float>(a_RenderData.m_Settings.resolutionY));
+        pushData.m_AtlasGlyphs = glm::uvec2(HUD_FONT_FIRST_GLYPH, ATLAS_GLYPHS_PER_ROW);
+        vkCmdPushConstants(a_CommandBuffer, m_PipelineData.m_PipelineLayout, VkShaderStageFlagBits::VK_SHADER_STAGE_VERTEX_BIT,
+            0, sizeof(HudPushConstants), &pushData);
+
+        //Six vertices per quad, one instance per glyph.
+        const auto numGlyphs = static_cast<uint32_t>(m_Glyphs.size());
+        vkCmdDraw(a_CommandBuffer, 6, numGlyphs, 0, 0);
+
+        auto& statistics = a_RenderData.m_RecordingStatistics;
+        ++statistics.m_NumDrawCalls;
+        statistics.m_NumTriangles += static_cast<uint64_t>(numGlyphs) * 2;
+
+        vkCmdEndRenderPass(a_CommandBuffer);
+        return true;
+    }
+
+    void RenderStage_Hud::WaitForIdle(const RenderData& a_RenderData)
+    {
+        //Nothing to wait for here.
+    }
+
+    void RenderStage_Hud::BuildGlyphs(const HudData& a_Data)
+    {
+        const float glyphSize = static_cast<float>(HUD_FONT_GLYPH_SIZE) * m_Scale;
+        const float margin = glyphSize / 2.f;
+
+        //The background is drawn first, but its size is only known once everything is laid out.
+        m_Glyphs.clear();
+        m_Glyphs.push_back(HudGlyph{ glm::vec4(0.f), HUD_FONT_SOLID_GLYPH, COLOR_BACKGROUND });
+        m_Cursor = glm::vec2(2.f * margin, 2.f * margin);
+
+        if (a_Data.m_RecentFrames.empty())
+        {
+            AddLine(COLOR_TEXT, "Waiting for frame statistics...");
+        }
+        else
+        {
+            const auto& latest = a_Data.m_RecentFrames.back();
+            const double fps = latest.m_CpuFrameMilliseconds > 0.0 ? 1000.0 / latest.m_CpuFrameMilliseconds : 0.0;
+            if (latest.m_HasGpuTime)
+            {
+                AddLine(COLOR_HEADER, "FPS %6.1f  CPU %6.2f ms  GPU %6.2f ms", fps, latest.m_CpuFrameMilliseconds, latest.m_GpuMilliseconds);
+            }
+            else
+            {
+                AddLine(COLOR_HEADER, "FPS %6.1f  CPU %6.2f ms  GPU n/a", fps, latest.m_CpuFrameMilliseconds);
+            }
+
+            /*
+             * Frame time graph. Every frame gets a CPU and a GPU bar next to each other, newest on the right.
+             * The vertical scale doubles from 33 ms until the slowest frame fits.
+             */
+            double slowest = 0.0;
+            for (const auto& frame : a_Data.m_RecentFrames)
+            {
+                slowest = std::max(slowest, std::max(frame.m_CpuFrameMilliseconds, frame.m_GpuMilliseconds));
+            }
+            double graphMilliseconds = 2.0 * TARGET_FRAME_MILLISECONDS;
+            while (graphMilliseconds < slowest && graphMilliseconds < 10000.0)
+            {
+                graphMilliseconds *= 2.0;
+            }
+
+            const float barWidth = m_Scale;
+            const float graphWidth = static_cast<float>(GRAPH_FRAMES) * 2.f * barWidth;
+            const float graphHeight = GRAPH_HEIGHT * m_Scale;
+            const glm::vec2 graphOrigin = m_Cursor;
+            AddQuad(graphOrigin.x, graphOrigin.y, graphWidth, graphHeight, COLOR_GRAPH_BACKGROUND);
+
+            const auto numFrames = static_cast<uint32_t>(a_Data.m_RecentFrames.size());
+            for (uint32_t i = 0; i < numFrames; ++i)
+            {
+                const auto& frame = a_Data.m_RecentFrames[i];
+                const float x = graphOrigin.x + static_cast<float>(GRAPH_FRAMES - numFrames + i) * 2.f * barWidth;
+                const float cpuHeight = graphHeight * static_cast<float>(std::min(frame.m_CpuFrameMilliseconds / graphMilliseconds, 1.0));
+                AddQuad(x, graphOrigin.y + graphHeight - cpuHeight, barWidth, cpuHeight, COLOR_CPU);
+                if (frame.m_HasGpuTime)
+                {
+                    const float gpuHeight = graphHeight * static_cast<float>(std::min(frame.m_GpuMilliseconds / graphMilliseconds, 1.0));
+                    AddQuad(x + barWidth, graphOrigin.y + graphHeight - gpuHeight, barWidth, gpuHeight, COLOR_GPU);
+                }
+            }
+
+            //Line at the 60 FPS frame time.
+            const float targetHeight = graphHeight * static_cast<float>(TARGET_FRAME_MILLISECONDS / graphMilliseconds);
+            AddQuad(graphOrigin.x, graphOrigin.y + graphHeight - targetHeight, graphWidth, m_Scale, COLOR_REFERENCE);
+
+            m_Cursor.y += graphHeight + margin;
+            AddLine(COLOR_TEXT, "Graph: %.0f ms, line at 60 FPS", graphMilliseconds);
+
+            /*
+             * CPU phases of the latest frame, followed by the GPU zones of the latest measured frame.
+             */
+            AddLine(COLOR_CPU, "CPU  wait %5.2f  upload %5.2f  record %5.2f  submit %5.2f",
+                latest.m_FenceWaitMilliseconds, latest.m_UploadMilliseconds, latest.m_RecordMilliseconds, latest.m_SubmitMilliseconds);
+
+            if (a_Data.m_HasGpuTimings)
+            {
+                AddLine(COLOR_GPU, "GPU  frame %u  %6.2f ms", a_Data.m_GpuTimings.m_FrameIndex, a_Data.m_GpuTimings.m_TotalMilliseconds);
+                for (const auto& zone : a_Data.m_GpuTimings.m_Zones)
+                {
+                    //Draw passes are nested deeper, and would not fit.
+                    if (zone.m_Depth > 1)
+                    {
+                        continue;
+                    }
+                    AddLine(COLOR_GPU, "%*s%-24.24s %6.2f ms", static_cast<int>(2 + zone.m_Depth * 2), "", zone.m_Name.c_str(), zone.m_Milliseconds);
+                }
+            }
+
+            /*
+             * Workload of the latest frame.
+             */
+            char uploaded[32];
+            FormatBytes(latest.GetBytesUploaded(), uploaded, sizeof(uploaded));
+            AddLine(COLOR_TEXT, "Draws %u  Triangles %llu  Instances %u  Lights %u", latest.m_NumDrawCalls,
+                static_cast<unsigned long long>(latest.m_NumTriangles), latest.m_NumInstances, latest.m_NumLights);
+            AddLine(COLOR_TEXT, "Draw passes %u  Descriptors %u  Uploaded %s", latest.m_NumDrawPasses, latest.m_NumDescriptorUpdates, uploaded);
+        }
+
+        /*
+         * GPU memory per category.
+         */
+        for (uint32_t category = 0; category < static_cast<uint32_t>(MemoryCategory::MAX_ENUM); ++category)
+        {
+            const auto& usage = a_Data.m_Memory.m_Categories[category];
+            if (usage.m_NumAllocations == 0)
+            {
+                continue;
+            }
+            char bytes[32];
+            FormatBytes(usage.m_Bytes, bytes, sizeof(bytes));
+            AddLine(COLOR_TEXT, "%-16s %10s  (%u)", GetMemoryCategoryName(static_cast<MemoryCategory>(category)), bytes, usage.m_NumAllocations);
+        }
+
+        //Fit the background around everything that was added.
+        float right = 0.f;
+        for (size_t i = 1; i < m_Glyphs.size(); ++i)
+        {
+            right = std::max(right, m_Glyphs[i].m_Rect.x + m_Glyphs[i].m_Rect.z);
+        }
+        m_Glyphs[0].m_Rect = glm::vec4(margin, margin, right, m_Cursor.y);
+    }
+
+    void RenderStage_Hud::AddLine(uint32_t a_Color, const char* a_Format, ...)
+    {
+        char text[128];
+        va_list arguments;
+        va_start(arguments, a_Format);
+        vsnprintf(text, sizeof(text), a_Format, arguments);
+        va_end(arguments);
+
+        const float glyphSize = static_cast<float>(HUD_FONT_GLYPH_SIZE) * m_Scale;
+        float x = m_Cursor.x;
+        for (const char* character = text; *character != '\0'; ++character)
+        {
+            //Spaces cover nothing, so they only move the cursor.
+            auto glyph = static_cast<uint32_t>(static_cast<unsigned char>(*character));
+            if (glyph != ' ')
+            {
+                if (glyph < HUD_FONT_FIRST_GLYPH || glyph >= HUD_FONT_SOLID_GLYPH)
+                {
+                    glyph = '?';
+                }
+                m_Glyphs.push_back(HudGlyph{ glm::vec4(x, m_Cursor.y, glyphSize, glyphSize), glyph, a_Color });
+            }
+            x += glyphSize;
+        }
+
+        //A little spacing between lines.
+        m_Cursor.y += glyphSize + m_Scale * 2.f;
+    }
+
+    void RenderStage_Hud::AddQuad(float a_X, float a_Y, float a_Width, float a_Height, uint32_t a_Color)
+    {
+        m_Glyphs.push_back(HudGlyph{ glm::vec4(a_X, a_Y, a_Width, a_Height), HUD_FONT_SOLID_GLYPH, a_Color });
+    }
+
+    void RenderStage_Hud::RecordAtlasUpload(VkCommandBuffer& a_CommandBuffer)
+    {
+        VkImageMemoryBarrier imageBarrier{};
+        imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        imageBarrier.srcAccessMask = 0;
+        imageBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        imageBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarrier.image = m_AtlasImage.m_Image;
+        imageBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+        vkCmdPipelineBarrier(a_CommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+            0, nullptr, 0, nullptr, 1, &imageBarrier);
+
+        VkBufferImageCopy copy{};
+        copy.bufferOffset = 0;
+        copy.bufferRowLength = 0;       //Tightly packed.
+        copy.bufferImageHeight = 0;
+        copy.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+        copy.imageOffset = { 0, 0, 0 };
+        copy.imageExtent = { ATLAS_WIDTH, ATLAS_HEIGHT, 1 };
+        vkCmdCopyBufferToImage(a_CommandBuffer, m_AtlasStagingBuffer.GetBuffer(), m_AtlasImage.m_Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
+
+        imageBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        imageBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        imageBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        imageBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+        vkCmdPipelineBarrier(a_CommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+            0, nullptr, 0, nullptr, 1, &imageBarrier);
+
+        //The staging buffer is kept until clean-up, as the copy may still be in flight.
+        m_AtlasUploaded = true;
+    }
+}
@@ -0,0 +1,519 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "MemoryTracker.h"
+#include "Renderer.h"
+#include "RenderStage.h"
+#include "RenderUtility.h"
+
+namespace egg
+{
+    namespace
+    {
+        /*
+         * The heightmap texel that sample a_Sample of a level is stored in.
+         */
+        int32_t WrapSample(int32_t a_Sample, int32_t a_Size)
+        {
+            const int32_t wrapped = a_Sample % a_Size;
+            return wrapped < 0 ? wrapped + a_Size : wrapped;
+        }
+
+        /*
+         * Add the two triangles of a grid cell. The diagonal points away from the center of the grid, so the grid is symmetric around it.
+         */
+        void AddCell(std::vector<uint32_t>& a_Indices, uint32_t a_X, uint32_t a_Z, uint32_t a_GridSize)
+        {
+            const uint32_t rowSize = a_GridSize + 1;
+            const uint32_t p00 = a_Z * rowSize + a_X;
+            const uint32_t p10 = p00 + 1;
+            const uint32_t p01 = p00 + rowSize;
+            const uint32_t p11 = p01 + 1;
+
+            const uint32_t half = a_GridSize / 2;
+            if ((a_X < half) == (a_Z < half))
+            {
+                a_Indices.insert(a_Indices.end(), { p00, p01, p11, p00, p11, p10 });
+            }
+            else
+            {
+                a_Indices.insert(a_Indices.end(), { p00, p01, p10, p10, p01, p11 });
+            }
+        }
+    }
+
+    bool RenderStage_Terrain::Init(const RenderData& a_RenderData)
+    {
+        //Buffers keep their own copies of the handles.
+        VkDevice device = a_RenderData.m_Device;
+        VmaAllocator allocator = a_RenderData.m_Allocator;
+
+        //The rings leave a hole of half the grid, which has to be a whole amount of cells on both sides.
+        m_NumLevels = std::min(a_RenderData.m_Settings.terrainLevels, PackedTerrainData::MAX_LEVELS);
+        m_GridSize = std::max(a_RenderData.m_Settings.terrainGridSize / 4 * 4, 16u);
+        m_HeightmapSize = m_GridSize + 4;
+        m_RingIndexCount = 6 * (m_GridSize * m_GridSize - (m_GridSize / 2) * (m_GridSize / 2));
+
+        //Nothing is streamed in yet.
+        m_StreamedTerrain.reset();
+        m_HeightmapInitialized = false;
+        m_IndicesUploaded = false;
+
+        /*
+         * Grid indices. The ring variants move the hole by a cell on either axis, as the level inside it snaps to cells that are half as large.
+         */
+        std::vector<uint32_t> indices;
+        indices.reserve(static_cast<size_t>(m_RingIndexCount) * NUM_RING_VARIANTS + 6 * m_GridSize * m_GridSize);
+        for (int32_t offsetZ = -1; offsetZ <= 1; ++offsetZ)
+        {
+            for (int32_t offsetX = -1; offsetX <= 1; ++offsetX)
+            {
+                const int32_t holeMinX = static_cast<int32_t>(m_GridSize / 4) + offsetX;
+                const int32_t holeMinZ = static_cast<int32_t>(m_GridSize / 4) + offsetZ;
+                const int32_t holeSize = static_cast<int32_t>(m_GridSize / 2);
+                for (uint32_t z = 0; z < m_GridSize; ++z)
+                {
+                    for (uint32_t x = 0; x < m_GridSize; ++x)
+                    {
+                        const bool inHoleX = static_cast<int32_t>(x) >= holeMinX && static_cast<int32_t>(x) < holeMinX + holeSize;
+                        const bool inHoleZ = static_cast<int32_t>(z) >= holeMinZ && static_cast<int32_t>(z) < holeMinZ + holeSize;
+                        if (!(inHoleX && inHoleZ))
+                        {
+                            AddCell(indices, x, z, m_GridSize);
+                        }
+                    }
+                }
+            }
+        }
+        for (uint32_t z = 0; z < m_GridSize; ++z)
+        {
+            for (uint32_t x = 0; x < m_GridSize; ++x)
+            {
+                AddCell(indices, x, z, m_GridSize);
+            }
+        }
+
+        //Buffers cannot be initialized twice, so new ones are used when the stage is initialized again after a resize.
+        const size_t indexSize = indices.size() * sizeof(uint32_t);
+        m_IndexBuffer = GpuBuffer();
+        m_IndexStagingBuffer = GpuBuffer();
+        if (!m_IndexBuffer.Init(GpuBufferSettings{ indexSize, 16, VMA_MEMORY_USAGE_GPU_ONLY,
+                VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, MemoryCategory::MESH_GEOMETRY }, device, allocator)
+            || !m_IndexStagingBuffer.Init(GpuBufferSettings{ indexSize, 16, VMA_MEMORY_USAGE_CPU_TO_GPU,
+                VK_BUFFER_USAGE_TRANSFER_SRC_BIT, MemoryCategory::STAGING }, device, allocator))
+        {
+            printf("Could not create terrain index buffers!\n");
+            return false;
+        }
+
+        CPUWrite indexWrite{ indices.data(), 0, indexSize };
+        if (!m_IndexStagingBuffer.Write(&indexWrite, 1))
+        {
+            printf("Could not stage terrain indices!\n");
+            return false;
+        }
+
+        /*
+         * Heightmap with a layer for every level. Its contents are undefined until the first terrain is streamed in.
+         */
+        ImageInfo heightmapImage;
+        heightmapImage.m_Format = VK_FORMAT_R32_SFLOAT;
+        heightmapImage.m_Usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        heightmapImage.m_Dimensions = { m_HeightmapSize, m_HeightmapSize, 1 };
+        heightmapImage.m_ArrayLayers = m_NumLevels;
+        heightmapImage.m_MemoryCategory = MemoryCategory::MESH_GEOMETRY;
+
+        if (!RenderUtility::CreateImage(a_RenderData.m_Device, a_RenderData.m_Allocator, heightmapImage, m_HeightmapImage))
+        {
+            printf("Could not create terrain heightmap.\n");
+            return false;
+        }
+
+        ImageViewInfo heightmapViewInfo;
+        heightmapViewInfo.m_Format = heightmapImage.m_Format;
+        heightmapViewInfo.m_Image = m_HeightmapImage.m_Image;
+        heightmapViewInfo.m_ViewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+        heightmapViewInfo.m_ArrayLayers = m_NumLevels;
+        heightmapViewInfo.m_VisibleAspects = VK_IMAGE_ASPECT_COLOR_BIT;
+
+        if (!RenderUtility::CreateImageView(a_RenderData.m_Device, heightmapViewInfo, m_HeightmapImageView))
+        {
+            printf("Could not create terrain heightmap view.\n");
+            return false;
+        }
+
+        //Heights are read with texel fetches, so the sampler is never used for filtering.
+        VkSamplerCreateInfo samplerInfo{};
+        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerInfo.magFilter = VK_FILTER_NEAREST;
+        samplerInfo.minFilter = VK_FILTER_NEAREST;
+        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.maxLod = 0.f;
+
+        if (vkCreateSampler(a_RenderData.m_Device, &samplerInfo, nullptr, &m_HeightmapSampler) != VK_SUCCESS)
+        {
+            printf("Could not create terrain heightmap sampler.\n");
+            return false;
+        }
+
+        if (!RenderUtility::CreateDescriptorSetContainer(a_RenderData.m_Device,
+            DescriptorSetContainerCreateInfo::Create(a_RenderData.m_Settings.m_SwapBufferCount)
+            .AddBinding(0, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_VERTEX_BIT)
+            .AddBinding(1, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+            , m_Descriptors))
+        {
+            printf("Could not create descriptor sets!\n");
+            return false;
+        }
+
+        /*
+         * A staging buffer and terrain buffer for every frame. Neither the heightmap nor the terrain buffers are ever replaced, so the sets are written once.
+         */
+        const size_t stagingSize = sizeof(float) * m_HeightmapSize * m_HeightmapSize * m_NumLevels;
+        m_Frames.resize(a_RenderData.m_Settings.m_SwapBufferCount);
+        for (uint32_t frameIndex = 0; frameIndex < static_cast<uint32_t>(m_Frames.size()); ++frameIndex)
+        {
+            auto& frame = m_Frames[frameIndex];
+            if (!frame.m_StagingBuffer.Init(GpuBufferSettings{ stagingSize, 16, VMA_MEMORY_USAGE_CPU_TO_GPU,
+                    VK_BUFFER_USAGE_TRANSFER_SRC_BIT, MemoryCategory::STAGING }, device, allocator)
+                || !frame.m_TerrainBuffer.Init(GpuBufferSettings{ sizeof(PackedTerrainData), 16, VMA_MEMORY_USAGE_GPU_ONLY,
+                    VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, MemoryCategory::FRAME_UPLOAD }, device, allocator))
+            {
+                printf("Could not create terrain buffers!\n");
+                return false;
+            }
+
+            VkDescriptorImageInfo heightmapDescriptor{ m_HeightmapSampler, m_HeightmapImageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+            VkWriteDescriptorSet writeDescriptorSet{};
+            writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writeDescriptorSet.dstSet = m_Descriptors.m_Sets[frameIndex];
+            writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            writeDescriptorSet.descriptorCount = 1;
+            writeDescriptorSet.dstBinding = 0;
+            writeDescriptorSet.pImageInfo = &heightmapDescriptor;
+            vkUpdateDescriptorSets(a_RenderData.m_Device, 1, &writeDescriptorSet, 0, nullptr);
+
+            RenderUtility::WriteDescriptors(a_RenderData.m_Device, m_Descriptors)
+                .WriteBuffer(frameIndex, 1, frame.m_TerrainBuffer.GetBuffer(), 0, VK_WHOLE_SIZE)
+                .Upload();
+        }
+
+        return true;
+    }
+
+    bool RenderStage_Terrain::InitPipeline(const RenderData& a_RenderData, VkRenderPass a_RenderPass, const std::string& a_RenderPassKey, uint32_t a_SubpassIndex, uint32_t a_NumAttachments)
+    {
+        //Vertices come from the vertex index, and the fragment shader is shared with the deferred geometry pass.
+        PipelineCreateInfo pipelineInfo;
+        pipelineInfo.m_Shaders.push_back({ "terrain.vert.spv", "main", VK_SHADER_STAGE_VERTEX_BIT });
+        pipelineInfo.m_Shaders.push_back({ "deferred.frag.spv", "main", VK_SHADER_STAGE_FRAGMENT_BIT });
+        pipelineInfo.pushConstants.m_PushConstantRanges.push_back({ VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(TerrainPushConstants) });
+        pipelineInfo.renderPass.m_RenderPass = a_RenderPass;
+        pipelineInfo.renderPass.m_CompatibilityKey = a_RenderPassKey;
+        pipelineInfo.renderPass.m_SubpassIndex = a_SubpassIndex;
+        pipelineInfo.attachments.m_NumAttachments = a_NumAttachments;
+        pipelineInfo.culling.m_CullMode = VK_CULL_MODE_BACK_BIT;    //Terrain is only seen from above.
+        pipelineInfo.descriptors.Add(m_Descriptors);
+
+        return a_RenderData.m_PipelineCache.Acquire(pipelineInfo, m_PipelineData);
+    }
+
+    bool RenderStage_Terrain::CleanUp(const RenderData& a_RenderData)
+    {
+        a_RenderData.m_PipelineCache.Release(m_PipelineData);
+
+        for (auto& frame : m_Frames)
+        {
+            frame.m_StagingBuffer.CleanUp();
+            frame.m_TerrainBuffer.CleanUp();
+        }
+        m_Frames.clear();
+
+        RenderUtility::DestroyDescriptorSetContainer(a_RenderData.m_Device, m_Descriptors);
+        vkDestroySampler(a_RenderData.m_Device, m_HeightmapSampler, nullptr);
+        vkDestroyImageView(a_RenderData.m_Device, m_HeightmapImageView, nullptr);
+        MemoryTracker::Untrack(a_RenderData.m_Allocator, m_HeightmapImage.m_Allocation);
+        vmaDestroyImage(a_RenderData.m_Allocator, m_HeightmapImage.m_Image, m_HeightmapImage.m_Allocation);
+        m_IndexBuffer.CleanUp();
+        m_IndexStagingBuffer.CleanUp();
+
+        m_StreamedTerrain.reset();
+        return true;
+    }
+
+    bool RenderStage_Terrain::RecordCommandBuffer(const RenderData& a_RenderData, VkCommandBuffer& a_CommandBuffer,
+        const uint32_t a_CurrentFrameIndex, std::vector<VkSemaphore>& a_WaitSemaphores,
+        std::vector<VkSemaphore>& a_SignalSemaphores, std::vector<VkPipelineStageFlags>& a_WaitStageFlags)
+    {
+        auto& frame = a_RenderData.m_FrameData[a_CurrentFrameIndex];
+        auto& frameData = m_Frames[a_CurrentFrameIndex];
+        const auto& drawData = *frame.m_DrawData;
+
+        frameData.m_Draw = drawData.m_Terrain != nullptr;
+        if (!frameData.m_Draw)
+        {
+            //Let go of the terrain, it is streamed in again when it is drawn next.
+            m_StreamedTerrain.reset();
+            return true;
+        }
+
+        //The heightmap only holds a single terrain, so everything is streamed in again when it changes.
+        const Terrain& terrain = *drawData.m_Terrain;
+        const bool streamAll = m_StreamedTerrain != drawData.m_Terrain;
+        m_StreamedTerrain = drawData.m_Terrain;
+
+        /*
+         * Snap every level to two of its cells, so that the level inside it always covers whole cells.
+         * The camera of the frame is used, which differs from the draw data's camera when the frame is redrawn.
+         */
+        const glm::vec3 cameraPosition = frame.m_Camera.GetTransform().GetTranslation();
+        const int32_t heightmapSize = static_cast<int32_t>(m_HeightmapSize);
+        glm::ivec2 centers[PackedTerrainData::MAX_LEVELS];
+
+        m_StagedHeights.clear();
+        m_Copies.clear();
+        for (uint32_t level = 0; level < m_NumLevels; ++level)
+        {
+            const double doubleCellSize = static_cast<double>(terrain.GetSampleSpacing()) * static_cast<double>(2u << level);
+            centers[level] = glm::ivec2(
+                2 * static_cast<int32_t>(std::floor(static_cast<double>(cameraPosition.x) / doubleCellSize + 0.5)),
+                2 * static_cast<int32_t>(std::floor(static_cast<double>(cameraPosition.z) / doubleCellSize + 0.5)));
+
+            //Only the samples that entered the heightmap window since the last frame are requested.
+            const glm::ivec2 origin = centers[level] - heightmapSize / 2;
+            const glm::ivec2 previous = m_StreamedOrigins[level];
+            const glm::ivec2 end = origin + heightmapSize;
+            const glm::ivec2 previousEnd = previous + heightmapSize;
+            m_StreamedOrigins[level] = origin;
+
+            if (streamAll || std::abs(origin.x - previous.x) >= heightmapSize || std::abs(origin.y - previous.y) >= heightmapSize)
+            {
+                StageRect(terrain, level, origin, end);
+                continue;
+            }
+
+            //Columns that entered the window, followed by the rows that entered it within the columns that were already there.
+            if (origin.x != previous.x)
+            {
+                const int32_t minX = origin.x > previous.x ? previousEnd.x : origin.x;
+                const int32_t maxX = origin.x > previous.x ? end.x : previous.x;
+                StageRect(terrain, level, glm::ivec2(minX, origin.y), glm::ivec2(maxX, end.y));
+            }
+            if (origin.y != previous.y)
+            {
+                const int32_t minZ = origin.y > previous.y ? previousEnd.y : origin.y;
+                const int32_t maxZ = origin.y > previous.y ? end.y : previous.y;
+                StageRect(terrain, level, glm::ivec2(std::max(origin.x, previous.x), minZ), glm::ivec2(std::min(end.x, previousEnd.x), maxZ));
+            }
+        }
+
+        if (!m_IndicesUploaded)
+        {
+            RecordIndexUpload(a_CommandBuffer);
+        }
+
+        /*
+         * Copy the streamed heights into the heightmap. Earlier frames may still be reading it, so the copy waits for their vertex shaders.
+         */
+        VkImageMemoryBarrier imageBarrier{};
+        imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarrier.image = m_HeightmapImage.m_Image;
+        imageBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, m_NumLevels };
+
+        const bool copyHeights = !m_Copies.empty();
+        if (copyHeights)
+        {
+            CPUWrite heightWrite{ m_StagedHeights.data(), 0, m_StagedHeights.size() * sizeof(float) };
+            if (!frameData.m_StagingBuffer.Write(&heightWrite, 1, true))
+            {
+                printf("Could not stage terrain heights!\n");
+                return false;
+            }
+
+            imageBarrier.srcAccessMask = 0;
+            imageBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            imageBarrier.oldLayout = m_HeightmapInitialized ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
+            imageBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            vkCmdPipelineBarrier(a_CommandBuffer, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                0, nullptr, 0, nullptr, 1, &imageBarrier);
+
+            vkCmdCopyBufferToImage(a_CommandBuffer, frameData.m_StagingBuffer.GetBuffer(), m_HeightmapImage.m_Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                static_cast<uint32_t>(m_Copies.size()), m_Copies.data());
+            m_HeightmapInitialized = true;
+        }
+
+        /*
+         * Place the levels. Every level but the finest is drawn as a ring around the level inside it, so levels are grouped by the ring variant they need.
+         */
+        PackedTerrainData terrainData{};
+        terrainData.m_Scale = glm::vec4(terrain.GetSampleSpacing(), terrain.GetUvScale(), static_cast<float>(m_GridSize / 8), 0.f);
+        terrainData.m_Settings = glm::uvec4(m_GridSize, m_HeightmapSize, m_NumLevels, drawData.m_TerrainMaterial);
+        terrainData.m_Ids = glm::uvec4(drawData.m_TerrainCustomId, 0, 0, 0);
+
+        uint32_t levelVariants[PackedTerrainData::MAX_LEVELS];
+        for (uint32_t level = 0; level < m_NumLevels; ++level)
+        {
+            const glm::ivec2 origin = centers[level] - heightmapSize / 2;
+            terrainData.m_Levels[level] = glm::ivec4(centers[level], WrapSample(origin.x, heightmapSize), WrapSample(origin.y, heightmapSize));
+            if (level == 0)
+            {
+                levelVariants[level] = FULL_GRID_VARIANT;
+            }
+            else
+            {
+                //The hole is off center by a cell when the level inside it snapped to the other side of the center.
+                const glm::ivec2 holeOffset = centers[level - 1] / 2 - centers[level];
+                levelVariants[level] = static_cast<uint32_t>((holeOffset.x + 1) + 3 * (holeOffset.y + 1));
+            }
+        }
+
+        uint32_t numOrdered = 0;
+        for (uint32_t variant = 0; variant < NUM_MESH_VARIANTS; ++variant)
+        {
+            frameData.m_VariantInstances[variant] = 0;
+            for (uint32_t level = 0; level < m_NumLevels; ++level)
+            {
+                if (levelVariants[level] == variant)
+                {
+                    terrainData.m_LevelOrder[numOrdered / 4][numOrdered % 4] = level;
+                    ++numOrdered;
+                    ++frameData.m_VariantInstances[variant];
+                }
+            }
+        }
+
+        //The terrain buffer of this frame is no longer read, as the frame's fence has been waited on.
+        vkCmdUpdateBuffer(a_CommandBuffer, frameData.m_TerrainBuffer.GetBuffer(), 0, sizeof(PackedTerrainData), &terrainData);
+
+        VkBufferMemoryBarrier bufferBarrier{};
+        bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        bufferBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        bufferBarrier.buffer = frameData.m_TerrainBuffer.GetBuffer();
+        bufferBarrier.offset = 0;
+        bufferBarrier.size = VK_WHOLE_SIZE;
+
+        imageBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        imageBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        imageBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        imageBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+        vkCmdPipelineBarrier(a_CommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0,
+            0, nullptr, 1, &bufferBarrier, copyHeights ? 1 : 0, &imageBarrier);
+
+        return true;
+    }
+
+    void RenderStage_Terrain::RecordDraw(const RenderData& a_RenderData, VkCommandBuffer& a_CommandBuffer, const uint32_t a_CurrentFrameIndex)
+    {
+        const auto& frameData = m_Frames[a_CurrentFrameIndex];
+        if (!frameData.m_Draw)
+        {
+            return;
+        }
+
+        vkCmdBindPipeline(a_CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineData.m_Pipeline);
+        vkCmdBindDescriptorSets(a_CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineData.m_PipelineLayout,
+            0, 1, &m_Descriptors.m_Sets[a_CurrentFrameIndex], 0, nullptr);
+        vkCmdBindIndexBuffer(a_CommandBuffer, m_IndexBuffer.GetBuffer(), 0, VK_INDEX_TYPE_UINT32);
+
+        TerrainPushConstants pushData;
+        pushData.m_VPMatrix = a_RenderData.m_FrameData[a_CurrentFrameIndex].m_Camera.CalculateVPMatrix();
+        vkCmdPushConstants(a_CommandBuffer, m_PipelineData.m_PipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(TerrainPushConstants), &pushData);
+
+        //Every level is an instance. The first instance is the offset into the level order of the terrain buffer.
+        auto& statistics = a_RenderData.m_RecordingStatistics;
+        uint32_t firstInstance = 0;
+        for (uint32_t variant = 0; variant < NUM_MESH_VARIANTS; ++variant)
+        {
+            const uint32_t numInstances = frameData.m_VariantInstances[variant];
+            if (numInstances == 0)
+            {
+                continue;
+            }
+
+            const uint32_t numIndices = variant == FULL_GRID_VARIANT ? 6 * m_GridSize * m_GridSize : m_RingIndexCount;
+            vkCmdDrawIndexed(a_CommandBuffer, numIndices, numInstances, variant * m_RingIndexCount, 0, firstInstance);
+            firstInstance += numInstances;
+
+            ++statistics.m_NumDrawCalls;
+            statistics.m_NumTriangles += static_cast<uint64_t>(numIndices / 3) * numInstances;
+        }
+    }
+
+    void RenderStage_Terrain::WaitForIdle(const RenderData& a_RenderData)
+    {
+        //Nothing to wait for here.
+    }
+
+    void RenderStage_Terrain::RecordIndexUpload(VkCommandBuffer& a_CommandBuffer)
+    {
+        VkBufferCopy copy{};
+        copy.srcOffset = 0;
+        copy.dstOffset = 0;
+        copy.size = m_IndexBuffer.GetSize();
+        vkCmdCopyBuffer(a_CommandBuffer, m_IndexStagingBuffer.GetBuffer(), m_IndexBuffer.GetBuffer(), 1, &copy);
+
+        VkBufferMemoryBarrier bufferBarrier{};
+        bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        bufferBarrier.dstAccessMask = VK_ACCESS_INDEX_READ_BIT;
+        bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        bufferBarrier.buffer = m_IndexBuffer.GetBuffer();
+        bufferBarrier.offset = 0;
+        bufferBarrier.size = VK_WHOLE_SIZE;
+
+        vkCmdPipelineBarrier(a_CommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0,
+            0, nullptr, 1, &bufferBarrier, 0, nullptr);
+
+        //The staging buffer is kept until clean-up, as the copy may still be in flight.
+        m_IndicesUploaded = true;
+    }
+
+    void RenderStage_Terrain::StageRect(const Terrain& a_Terrain, uint32_t a_Level, const glm::ivec2& a_Min, const glm::ivec2& a_Max)
+    {
+        const int32_t heightmapSize = static_cast<int32_t>(m_HeightmapSize);
+        const int32_t sampleScale = 1 << a_Level;   //Level samples in finest samples.
+
+        //Split the rectangle where it wraps around the heightmap, so that every piece is a single copy.
+        for (int32_t minZ = a_Min.y; minZ < a_Max.y;)
+        {
+            const int32_t texelZ = WrapSample(minZ, heightmapSize);
+            const int32_t maxZ = std::min(a_Max.y, minZ + heightmapSize - texelZ);
+            for (int32_t minX = a_Min.x; minX < a_Max.x;)
+            {
+                const int32_t texelX = WrapSample(minX, heightmapSize);
+                const int32_t maxX = std::min(a_Max.x, minX + heightmapSize - texelX);
+
+                VkBufferImageCopy copy{};
+                copy.bufferOffset = m_StagedHeights.size() * sizeof(float);
+                copy.bufferRowLength = 0;       //Tightly packed.
+                copy.bufferImageHeight = 0;
+                copy.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, a_Level, 1 };
+                copy.imageOffset = { texelX, texelZ, 0 };
+                copy.imageExtent = { static_cast<uint32_t>(maxX - minX), static_cast<uint32_t>(maxZ - minZ), 1 };
+                m_Copies.push_back(copy);
+
+                for (int32_t z = minZ; z < maxZ; ++z)
+                {
+                    for (int32_t x = minX; x < maxX; ++x)
+                    {
+                        m_StagedHeights.push_back(a_Terrain.GetHeight(x * sampleScale, z * sampleScale));
+                    }
+                }
+                minX = maxX;
+            }
+            minZ = maxZ;
+        }
+    }
+}
@@ -1,7 +1,10 @@
 #include "Renderer.h"
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <cstdio>
+#include <cstring>
 #include <string>
 #include <vector>
 #include <GLFW/glfw3.h>
@@ -10,10 +13,12 @@
 #include <filesystem>
 #include <set>
 #include <glm/glm/glm.hpp>
+#include <glm/glm/gtc/packing.hpp>
 #include "vk_mem_alloc.h"
 
 #include "api/Profiler.h"
 #include "api/Timer.h"
+#include "api/TraceProfiler.h"
 
 namespace egg
 {
@@ -44,42 +49,56 @@ namespace egg
         m_RenderData.m_FrameCounter = 0;
         m_MeshCounter = 0;
 
-	    /*
-	     * Init GLFW and ensure that it supports Vulkan.
-	     */
-	    if(!glfwInit())
-	    {
-		    printf("Could not initialize GLFW!\n");
-		    return false;
-	    }
-
-	    if(!glfwVulkanSupported())
-	    {
-		    printf("Vulkan is not supported for GLFW!\n");
-		    return false;
-	    }
+        //CPU zones are recorded from here on. The thread that initializes the renderer is expected to draw frames as well.
+        TraceProfiler::SetEnabled(a_Settings.enableCpuTracing);
+        TraceProfiler::SetThreadName("Render Thread");
+        m_FrameStatistics.Init(a_Settings.statisticsHistorySize);
 
-        //Window creation
-        // With GLFW_CLIENT_API set to GLFW_NO_API there will be no OpenGL (ES) context.
-        glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-        glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
+        m_FullScreenResolution = { 0, 0 };
 
-        //Make the window in either full screen or windowed mode.
-        auto* mainMonitor = glfwGetPrimaryMonitor();
-        auto* videoMode = glfwGetVideoMode(mainMonitor);
-        if (a_Settings.fullScreen)
+        //Headless rendering has no window, so GLFW is not needed at all.
+        if(a_Settings.headless)
         {
-            m_FullScreenResolution = { videoMode->width, videoMode->height };
-            m_Window = glfwCreateWindow(videoMode->width, videoMode->height, a_Settings.windowName.c_str(), mainMonitor, nullptr);
+            m_RenderData.m_Settings.fullScreen = false;
         }
         else
         {
-            m_FullScreenResolution = { 0, 0 };
-            m_Window = glfwCreateWindow(a_Settings.resolutionX, a_Settings.resolutionY, a_Settings.windowName.c_str(), nullptr, nullptr);
-        }
-        if(a_Settings.lockCursor)
-        {
-            glfwSetInputMode(m_Window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+	        /*
+	         * Init GLFW and ensure that it supports Vulkan.
+	         */
+	        if(!glfwInit())
+	        {
+		        printf("Could not initialize GLFW!\n");
+		        return false;
+	        }
+
+	        if(!glfwVulkanSupported())
+	        {
+		        printf("Vulkan is not supported for GLFW!\n");
+		        return false;
+	        }
+
+            //Window creation
+            // With GLFW_CLIENT_API set to GLFW_NO_API there will be no OpenGL (ES) context.
+            glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+            glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
+
+            //Make the window in either full screen or windowed mode.
+            auto* mainMonitor = glfwGetPrimaryMonitor();
+            auto* videoMode = glfwGetVideoMode(mainMonitor);
+            if (a_Settings.fullScreen)
+            {
+                m_FullScreenResolution = { videoMode->width, videoMode->height };
+                m_Window = glfwCreateWindow(videoMode->width, videoMode->height, a_Settings.windowName.c_str(), mainMonitor, nullptr);
+            }
+            else
+            {
+                m_Window = glfwCreateWindow(a_Settings.resolutionX, a_Settings.resolutionY, a_Settings.windowName.c_str(), nullptr, nullptr);
+            }
+            if(a_Settings.lockCursor)
+            {
+                glfwSetInputMode(m_Window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+            }
         }
 
 
@@ -103,25 +122,58 @@ namespace egg
             return false;
         }
 
+        //Present latency is measured on a separate thread, which starts with every new swapchain.
+        m_PresentWaiter.Init(m_RenderData.m_Device, m_RenderData.m_PresentWaitSupported);
+
         /*
          * Create the per-frame data and initialize the upload buffers.
          */
         m_RenderData.m_FrameData.resize(m_RenderData.m_Settings.m_SwapBufferCount);
+
+        //Buffers read by shaders also get an address, when supported.
+        const VkBufferUsageFlags storageUsage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+            (m_RenderData.m_BufferDeviceAddressSupported ? VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT : 0);
         for (auto& frame : m_RenderData.m_FrameData)
         {
             //Create the upload data buffers.
             frame.m_UploadData.m_IndirectionBuffer.Init(
-                GpuBufferSettings{ 0, 0, VMA_MEMORY_USAGE_CPU_TO_GPU, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT }
+                GpuBufferSettings{ 0, 0, VMA_MEMORY_USAGE_CPU_TO_GPU, storageUsage, MemoryCategory::FRAME_UPLOAD }
             , m_RenderData.m_Device, m_RenderData.m_Allocator);
             frame.m_UploadData.m_InstanceBuffer.Init(
-                GpuBufferSettings{ 0, 16, VMA_MEMORY_USAGE_CPU_TO_GPU, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT }
+                GpuBufferSettings{ 0, 16, VMA_MEMORY_USAGE_CPU_TO_GPU, storageUsage, MemoryCategory::FRAME_UPLOAD }
             , m_RenderData.m_Device, m_RenderData.m_Allocator);
             frame.m_UploadData.m_MaterialBuffer.Init(
-                GpuBufferSettings{ 0, 16, VMA_MEMORY_USAGE_CPU_TO_GPU, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT }
+                GpuBufferSettings{ 0, 16, VMA_MEMORY_USAGE_CPU_TO_GPU, storageUsage, MemoryCategory::FRAME_UPLOAD }
             , m_RenderData.m_Device, m_RenderData.m_Allocator);
             frame.m_UploadData.m_LightsBuffer.Init(
-                GpuBufferSettings{ 0, 16, VMA_MEMORY_USAGE_CPU_TO_GPU, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT }
+                GpuBufferSettings{ 0, 16, VMA_MEMORY_USAGE_CPU_TO_GPU, storageUsage, MemoryCategory::FRAME_UPLOAD }
+            , m_RenderData.m_Device, m_RenderData.m_Allocator);
+            frame.m_UploadData.m_DebugVertexBuffer.Init(
+                GpuBufferSettings{ 0, 16, VMA_MEMORY_USAGE_CPU_TO_GPU, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, MemoryCategory::FRAME_UPLOAD }
             , m_RenderData.m_Device, m_RenderData.m_Allocator);
+            frame.m_UploadData.m_PreviousTransformBuffer.Init(
+                GpuBufferSettings{ 0, 16, VMA_MEMORY_USAGE_CPU_TO_GPU, storageUsage, MemoryCategory::FRAME_UPLOAD }
+            , m_RenderData.m_Device, m_RenderData.m_Allocator);
+            frame.m_UploadData.m_AnimationStateBuffer.Init(
+                GpuBufferSettings{ 0, 16, VMA_MEMORY_USAGE_CPU_TO_GPU, storageUsage, MemoryCategory::FRAME_UPLOAD }
+            , m_RenderData.m_Device, m_RenderData.m_Allocator);
+
+            //Picking results are copied into this buffer, which grows when needed.
+            frame.m_PickingData.m_ReadbackBuffer.Init(
+                GpuBufferSettings{ 0, 16, VMA_MEMORY_USAGE_GPU_TO_CPU, VK_BUFFER_USAGE_TRANSFER_DST_BIT, MemoryCategory::READBACK }
+            , m_RenderData.m_Device, m_RenderData.m_Allocator);
+
+            //Debug view counters are accumulated by the shaders, and cleared with a transfer before use.
+            frame.m_DebugView.m_CounterBuffer.Init(
+                GpuBufferSettings{ DebugViewData::COUNTER_BUFFER_SIZE, 16, VMA_MEMORY_USAGE_GPU_TO_CPU, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, MemoryCategory::READBACK }
+            , m_RenderData.m_Device, m_RenderData.m_Allocator);
+        }
+
+        //All vertex animations share one buffer, which is reserved up front so that ranges in use never move.
+        if (!m_RenderData.m_VertexAnimationStorage->Init(static_cast<size_t>(m_RenderData.m_Settings.vertexAnimationMemory), m_RenderData.m_Device, m_RenderData.m_Allocator))
+        {
+            printf("Could not allocate vertex animation memory!\n");
+            return false;
         }
 
         //Swapchain used for presenting.
@@ -137,6 +189,14 @@ namespace egg
             printf("Could not initialize Vulkan pipeline!\n");
             return false;
         }
+
+        //GPU queries are recorded in the frame command buffers, so they use the present queue.
+        if(!m_RenderData.m_GpuProfiler.Init(m_RenderData.m_Device, m_RenderData.m_PhysicalDevice, m_RenderData.m_PresentQueue->m_FamilyIndex,
+            m_RenderData.m_Settings.m_SwapBufferCount, m_RenderData.m_EnabledFeatures.pipelineStatisticsQuery == VK_TRUE, m_RenderData.m_Settings))
+        {
+            printf("Could not initialize GPU profiler!\n");
+            return false;
+        }
 	    
         //Create the render targets for the pipeline.
 	    if(!CreateSwapChainFrameData())
@@ -189,26 +249,39 @@ namespace egg
             stage->WaitForIdle(m_RenderData);
         }
 
-        //Resize the GLFW window.
-        glfwSetWindowSize(m_Window, a_Width, a_Height);
-        auto* mainMonitor = glfwGetPrimaryMonitor();
-        auto* videoMode = glfwGetVideoMode(mainMonitor);
-        if (a_FullScreen)
+        //All frames are done, so picking results can be resolved before the G-buffers are destroyed.
+        for (auto& frame : m_RenderData.m_FrameData)
+        {
+            ResolvePickingQueries(frame);
+        }
+
+        //Resize the GLFW window. Headless surfaces have no window and can not be full-screen.
+        if (m_RenderData.m_Settings.headless)
         {
-            glfwSetWindowMonitor(m_Window, mainMonitor, 0, 0, videoMode->width, videoMode->height, videoMode->refreshRate);
-            m_FullScreenResolution = { videoMode->width, videoMode->height };
+            a_FullScreen = false;
         }
         else
         {
-            //First set the window to a non-full-screen position.
-            glfwSetWindowMonitor(m_Window, nullptr, 0, 0, a_Width, a_Height, videoMode->refreshRate);
+            glfwSetWindowSize(m_Window, a_Width, a_Height);
+            auto* mainMonitor = glfwGetPrimaryMonitor();
+            auto* videoMode = glfwGetVideoMode(mainMonitor);
+            if (a_FullScreen)
+            {
+                glfwSetWindowMonitor(m_Window, mainMonitor, 0, 0, videoMode->width, videoMode->height, videoMode->refreshRate);
+                m_FullScreenResolution = { videoMode->width, videoMode->height };
+            }
+            else
+            {
+                //First set the window to a non-full-screen position.
+                glfwSetWindowMonitor(m_Window, nullptr, 0, 0, a_Width, a_Height, videoMode->refreshRate);
 
-            //Get the window decorations size (top bar and frame etc in pixels).
-            int left, right, top, bottom;
-            glfwGetWindowFrameSize(m_Window, &left, &top, &right, &bottom);
+                //Get the window decorations size (top bar and frame etc in pixels).
+                int left, right, top, bottom;
+                glfwGetWindowFrameSize(m_Window, &left, &top, &right, &bottom);
 
-            //Again set the window at the right offsets. This is required because when switching from full-screen initially, the window frame sizes are all 0.
-            glfwSetWindowMonitor(m_Window, nullptr, left, top, a_Width, a_Height, videoMode->refreshRate);
+                //Again set the window at the right offsets. This is required because when switching from full-screen initially, the window frame sizes are all 0.
+                glfwSetWindowMonitor(m_Window, nullptr, left, top, a_Width, a_Height, videoMode->refreshRate);
+            }
         }
 	    
 	    /*
@@ -252,6 +325,9 @@ namespace egg
             }
 	    }
 
+        //Pipelines and shader modules were kept while the stages were recreated. Only the ones no stage asked for again are destroyed.
+        m_RenderData.m_PipelineCache.DestroyUnused();
+
 	    //Create the frame buffers and semaphores/fences.
 	    //This happens after the render stages because a render pass has to be defined by the last stage.
 	    //This pass is then passed into the FBO create struct.
@@ -280,15 +356,21 @@ namespace egg
 
     InputData Renderer::QueryInput()
     {
-        //Retrieve input.
-        glfwPollEvents();
+        //Retrieve input. Headless renderers never receive any.
+        if (m_Window != nullptr)
+        {
+            glfwPollEvents();
+        }
 
         return m_InputQueue.GetQueuedEvents();
     }
 	
     std::shared_ptr<EggMaterial> Renderer::CreateMaterial(const MaterialCreateInfo& a_Info)
     {
-        return std::make_shared<Material>(a_Info);
+        LiveResourceTracker::CreationSiteScope creationSite("CreateMaterial", EGG_RETURN_ADDRESS());
+        auto material = std::make_shared<Material>(a_Info);
+        LiveResourceTracker::Register(material.get(), "Material", m_RenderData.m_FrameCounter);
+        return material;
     }
 
     std::unique_ptr<EggDrawData> Renderer::CreateDrawData()
@@ -296,6 +378,171 @@ namespace egg
         return std::make_unique<DrawData>();
     }
 
+    std::future<std::vector<uint32_t>> Renderer::QueryCustomIds(std::uint32_t a_X, std::uint32_t a_Y, std::uint32_t a_Width, std::uint32_t a_Height)
+    {
+        PickingQuery query;
+        query.m_Offset = glm::uvec2(a_X, a_Y);
+        query.m_Size = glm::uvec2(a_Width, a_Height);
+        auto future = query.m_Promise.get_future();
+
+        //Queued until the next frame is drawn.
+        std::lock_guard<std::mutex> lock(m_PickingMutex);
+        m_PendingPickingQueries.emplace_back(std::move(query));
+        return future;
+    }
+
+    std::vector<GpuFrameTimings> Renderer::GetGpuTimingHistory() const
+    {
+        return m_RenderData.m_GpuProfiler.GetHistory();
+    }
+
+    std::vector<FrameStatistics> Renderer::GetFrameStatisticsHistory() const
+    {
+        return m_FrameStatistics.GetHistory();
+    }
+
+    FrameStatisticsSummary Renderer::GetFrameStatisticsSummary() const
+    {
+        return m_FrameStatistics.GetSummary();
+    }
+
+    bool Renderer::StartStatisticsStream(const std::string& a_FilePath, StatisticsStreamFormat a_Format)
+    {
+        return m_FrameStatistics.StartStream(a_FilePath, a_Format);
+    }
+
+    void Renderer::StopStatisticsStream()
+    {
+        m_FrameStatistics.StopStream();
+    }
+
+    bool Renderer::StartDrawDataCapture(const std::string& a_FilePath)
+    {
+        return m_DrawDataCapture.Open(a_FilePath);
+    }
+
+    void Renderer::StopDrawDataCapture()
+    {
+        m_DrawDataCapture.Close();
+    }
+
+    MemoryReport Renderer::GetMemoryReport() const
+    {
+        MemoryReport report;
+        MemoryTracker::GetCategoryUsage(report);
+        report.m_LiveResources = LiveResourceTracker::GetLiveResources();
+
+        if (!m_Initialized)
+        {
+            return report;
+        }
+
+        const VkPhysicalDeviceMemoryProperties* memoryProperties = nullptr;
+        vmaGetMemoryProperties(m_RenderData.m_Allocator, &memoryProperties);
+
+        //Budgets are estimated from the heap sizes when VK_EXT_memory_budget is not available.
+        VmaBudget budgets[VK_MAX_MEMORY_HEAPS]{};
+        vmaGetBudget(m_RenderData.m_Allocator, budgets);
+
+        VmaStats stats{};
+        vmaCalculateStats(m_RenderData.m_Allocator, &stats);
+
+        for (uint32_t heapIndex = 0; heapIndex < memoryProperties->memoryHeapCount; ++heapIndex)
+        {
+            const auto& heap = memoryProperties->memoryHeaps[heapIndex];
+            const auto& budget = budgets[heapIndex];
+            const auto& heapStats = stats.memoryHeap[heapIndex];
+
+            auto& heapReport = report.m_Heaps.emplace_back();
+            heapReport.m_HeapIndex = heapIndex;
+            heapReport.m_DeviceLocal = (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+            heapReport.m_Size = heap.size;
+            heapReport.m_Budget = budget.budget;
+            heapReport.m_Usage = budget.usage;
+            heapReport.m_NumBlocks = heapStats.blockCount;
+            heapReport.m_NumAllocations = heapStats.allocationCount;
+            heapReport.m_BlockBytes = budget.blockBytes;
+            heapReport.m_AllocationBytes = budget.allocationBytes;
+            heapReport.m_NumUnusedRanges = heapStats.unusedRangeCount;
+            heapReport.m_UnusedBytes = heapStats.unusedBytes;
+            heapReport.m_LargestUnusedRange = heapStats.unusedRangeCount > 0 ? heapStats.unusedRangeSizeMax : 0;
+
+            //Unused memory that can't be used for a single allocation of the same total size is fragmented.
+            if (heapStats.unusedBytes > 0)
+            {
+                heapReport.m_Fragmentation = 1.f - static_cast<float>(static_cast<double>(heapReport.m_LargestUnusedRange) / static_cast<double>(heapStats.unusedBytes));
+            }
+        }
+
+        return report;
+    }
+
+    bool Renderer::WriteMemoryStatistics(const std::string& a_FilePath, bool a_Detailed) const
+    {
+        if (!m_Initialized)
+        {
+            printf("Cannot write memory statistics: renderer not initialized!\n");
+            return false;
+        }
+
+        std::ofstream file(a_FilePath, std::ios::out | std::ios::trunc);
+        if (!file.is_open())
+        {
+            printf("Could not open file for writing memory statistics: %s\n", a_FilePath.c_str());
+            return false;
+        }
+
+        char* statsString = nullptr;
+        vmaBuildStatsString(m_RenderData.m_Allocator, &statsString, a_Detailed ? VK_TRUE : VK_FALSE);
+        file << statsString;
+        vmaFreeStatsString(m_RenderData.m_Allocator, statsString);
+
+        file.close();
+        return !file.fail();
+    }
+
+    bool Renderer::SetDebugView(const DebugViewSettings& a_Settings)
+    {
+        if (a_Settings.m_Mode >= DebugViewMode::MAX_ENUM)
+        {
+            printf("Invalid debug view mode!\n");
+            return false;
+        }
+
+        if (a_Settings.m_Mode != DebugViewMode::NONE && (m_DeferredStage == nullptr || !m_DeferredStage->SupportsDebugViews()))
+        {
+            printf("Debug views are not supported: the GPU does not support fragment stores and atomics, or the debug view pipelines could not be compiled.\n");
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(m_DebugViewMutex);
+        m_DebugViewSettings = a_Settings;
+        m_DebugViewSettings.m_HeatmapMaximum = std::max(a_Settings.m_HeatmapMaximum, 1u);
+        return true;
+    }
+
+    DebugViewSettings Renderer::GetDebugView() const
+    {
+        std::lock_guard<std::mutex> lock(m_DebugViewMutex);
+        return m_DebugViewSettings;
+    }
+
+    DebugCounters Renderer::GetDebugCounters() const
+    {
+        std::lock_guard<std::mutex> lock(m_DebugViewMutex);
+        return m_DebugCounters;
+    }
+
+    void Renderer::SetHudEnabled(bool a_Enabled)
+    {
+        m_HudEnabled = a_Enabled;
+    }
+
+    bool Renderer::IsHudEnabled() const
+    {
+        return m_HudEnabled;
+    }
+
     bool Renderer::CleanUp()
     {
         PROFILING_START(Clean_Up_Renderer)
@@ -323,11 +570,30 @@ namespace egg
             stage->WaitForIdle(m_RenderData);
         }
 
+        //Resolve all recorded picking queries. Queries that never made it into a frame get an empty result.
+        for (auto& frame : m_RenderData.m_FrameData)
+        {
+            ResolvePickingQueries(frame);
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_PickingMutex);
+            for (auto& query : m_PendingPickingQueries)
+            {
+                query.m_Promise.set_value({});
+            }
+            m_PendingPickingQueries.clear();
+        }
+
         /*
          * Get rid of that pesky bindless system thing.
          */
         m_BindlessSystem.CleanUp(m_RenderData.m_Device);
 
+        m_RenderData.m_GpuProfiler.CleanUp();
+        m_FrameStatistics.CleanUp();
+        m_DrawDataCapture.Close();
+        m_MeshCache.Clear();
+
 	    /*
 	     * Clean up the render stages.
 	     * This happens in reverse order.
@@ -336,6 +602,7 @@ namespace egg
         {
             m_RenderStages[i]->CleanUp(m_RenderData);
         }
+        m_RenderData.m_PipelineCache.CleanUp();
 
         //Destroy the resources per frame.
         for(auto& frame : m_RenderData.m_FrameData)
@@ -348,10 +615,19 @@ namespace egg
             frame.m_UploadData.m_InstanceBuffer.CleanUp();
             frame.m_UploadData.m_MaterialBuffer.CleanUp();
             frame.m_UploadData.m_LightsBuffer.CleanUp();
+            frame.m_UploadData.m_DebugVertexBuffer.CleanUp();
+            frame.m_UploadData.m_PreviousTransformBuffer.CleanUp();
+            frame.m_UploadData.m_AnimationStateBuffer.CleanUp();
+            frame.m_PickingData.m_ReadbackBuffer.CleanUp();
+            frame.m_DebugView.m_CounterBuffer.CleanUp();
 
             //Free any data that could be kept alive at this point.
             frame.m_DrawData.reset();
         }
+        m_LastDrawData.reset();
+
+        //Animations that the application still holds can no longer be drawn.
+        m_RenderData.m_VertexAnimationStorage->CleanUp();
 
 	    //Clean the swapchain and associated frame buffers.
         CleanUpSwapChain();
@@ -367,7 +643,11 @@ namespace egg
         vkDestroyDevice(m_RenderData.m_Device, nullptr);
         vkDestroyInstance(m_RenderData.m_VulkanInstance, nullptr);
 
-        glfwDestroyWindow(m_Window);
+        if (m_Window != nullptr)
+        {
+            glfwDestroyWindow(m_Window);
+            m_Window = nullptr;
+        }
 
         PROFILING_END(Clean_Up_Renderer, MILLIS, "")
         return true;
@@ -376,20 +656,24 @@ namespace egg
     Renderer::Renderer() :
 	    m_Initialized(false),
 	    m_MeshCounter(0),
+	    m_LightTreeDrawDataId(0),
 	    m_Window(nullptr),
 	    m_SwapChain(nullptr),
 	    m_CopyBuffer(nullptr),
 	    m_CopyCommandPool(nullptr),
+	    m_HudEnabled(false),
+	    m_SubmissionCounter(0),
 	    m_SwapChainIndex(0),
 	    m_FrameReadySemaphore(nullptr),
 	    m_HelloTriangleStage(nullptr),
-		m_DeferredStage(nullptr)
+		m_TerrainStage(nullptr),
+		m_DeferredStage(nullptr),
+		m_HudStage(nullptr)
     {
     }
 
     bool Renderer::DrawFrame(std::unique_ptr<EggDrawData>& a_DrawData)
     {
-        PROFILING_START(Cpu_Frame_Building)
         //Ensure that the renderer has been properly set-up.
         if (!m_Initialized)
         {
@@ -397,37 +681,86 @@ namespace egg
             return false;
         }
 
-        //Close the window when requested.
-        if(glfwWindowShouldClose(m_Window) == GLFW_TRUE)
+        if (!PollWindow())
         {
             return false;
         }
 
-        //Detect if the window has resized by means that did not involve the Renderer API.
-        //Resize the window if that has happened.
-        int32_t width, height;
-        glfwGetWindowSize(m_Window, &width, &height);
-        if(m_RenderData.m_Settings.resolutionX != static_cast<uint32_t>(width) || m_RenderData.m_Settings.resolutionY != static_cast<uint32_t>(height))
+        //Nullptr draw data provided. Do nothing.
+        if (!a_DrawData)
         {
-            Resize(m_RenderData.m_Settings.fullScreen, width, height);
+            return true;
         }
 
-        //Nullptr draw data provided. Do nothing.
-        if (!a_DrawData)
+        /*
+		 * Take ownership of the draw data. It is kept alive until every frame that draws it has been reused.
+		 */
+        std::shared_ptr<DrawData> drawData = std::shared_ptr<DrawData>(static_cast<DrawData*>(a_DrawData.release()));
+        drawData->m_SubmissionId = ++m_SubmissionCounter;
+        m_LastDrawData = drawData;
+
+        return SubmitFrame(drawData, drawData->m_Camera, drawData->m_InterpolationFactor);
+    }
+
+    bool Renderer::RedrawFrame(const Camera& a_Camera, float a_InterpolationFactor)
+    {
+        if (!m_Initialized)
+        {
+            printf("Renderer not initialized!\n");
+            return false;
+        }
+
+        if (!PollWindow())
+        {
+            return false;
+        }
+
+        //Nothing was drawn yet.
+        if (!m_LastDrawData)
         {
             return true;
         }
-    	
+
+        return SubmitFrame(m_LastDrawData, a_Camera, a_InterpolationFactor);
+    }
+
+    bool Renderer::PollWindow()
+    {
+        if (m_Window != nullptr)
+        {
+            //Close the window when requested.
+            if(glfwWindowShouldClose(m_Window) == GLFW_TRUE)
+            {
+                return false;
+            }
+
+            //Detect if the window has resized by means that did not involve the Renderer API.
+            //Resize the window if that has happened.
+            int32_t width, height;
+            glfwGetWindowSize(m_Window, &width, &height);
+            if(m_RenderData.m_Settings.resolutionX != static_cast<uint32_t>(width) || m_RenderData.m_Settings.resolutionY != static_cast<uint32_t>(height))
+            {
+                Resize(m_RenderData.m_Settings.fullScreen, width, height);
+            }
+        }
+        return true;
+    }
+
+    bool Renderer::SubmitFrame(const std::shared_ptr<DrawData>& a_DrawData, const Camera& a_Camera, float a_InterpolationFactor)
+    {
+        PROFILING_START(Cpu_Frame_Building)
+        EGG_TRACE_ZONE("DrawFrame");
+        Timer frameTimer;
+
         //The frame data and command buffer for the current frame.
         auto& frameData = m_RenderData.m_FrameData[m_SwapChainIndex];
         auto& uploadData = frameData.m_UploadData;
         auto& cmdBuffer = frameData.m_CommandBuffer;
 
-        /*
-		 * Take ownership of the draw data for this frame.
-		 */
-        std::unique_ptr<DrawData> ptr = std::unique_ptr<DrawData>(static_cast<DrawData*>(a_DrawData.release()));
-        frameData.m_DrawData = std::move(ptr);
+        //Keep the draw data alive until this frame is reused.
+        frameData.m_DrawData = a_DrawData;
+        frameData.m_Camera = a_Camera;
+        frameData.m_InterpolationFactor = a_InterpolationFactor;
         auto& drawData = *frameData.m_DrawData;
     	
         //Nothing to draw :(
@@ -437,77 +770,114 @@ namespace egg
         }
 
         //Only draw when the window is not minimized.
-        const bool minimized = glfwGetWindowAttrib(m_Window, GLFW_ICONIFIED);
+        const bool minimized = m_Window != nullptr && glfwGetWindowAttrib(m_Window, GLFW_ICONIFIED);
         if (minimized)
         {
             return true;
         }
 
+        //Write the draw data to the capture before it is consumed. Meshes are read back the first time they are captured.
+        if (m_DrawDataCapture.IsOpen())
+        {
+            EGG_TRACE_ZONE("Capture Draw Data");
+            const glm::uvec2 resolution(m_RenderData.m_Settings.resolutionX, m_RenderData.m_Settings.resolutionY);
+            m_DrawDataCapture.WriteFrame(drawData, a_Camera, a_InterpolationFactor, m_RenderData.m_FrameCounter, resolution, [this](StaticMesh& a_Mesh, std::vector<Vertex>& a_Vertices, std::vector<uint32_t>& a_Indices)
+            {
+                return ReadMeshGeometry(a_Mesh, a_Vertices, a_Indices);
+            });
+        }
+
+        //Start counting the statistics for this frame. Stages add their draws and descriptor updates while recording.
+        auto& statistics = m_RenderData.m_RecordingStatistics;
+        statistics = FrameStatistics{};
+        statistics.m_FrameIndex = m_RenderData.m_FrameCounter;
+        Timer phaseTimer;
+
         /*
          * Wait for resources to become available.
          */
         PROFILING_START(Waiting_For_Frame_Available_Fence)
+        TraceZone fenceZone("Wait For Frame Fence");
+
+        //Frames in flight may have finished since the last check. Checking again after the wait catches this frame.
+        ObserveGpuCompletion();
 
         //Ensure that command buffer execution is done for this frame by waiting for fence completion.
         vkWaitForFences(m_RenderData.m_Device, 1, &frameData.m_Fence, true, std::numeric_limits<std::uint32_t>::max());
+        ObserveGpuCompletion();
 
         //Reset the fence now that it has been signaled.
         vkResetFences(m_RenderData.m_Device, 1, &frameData.m_Fence);
 
+        fenceZone.End();
+        statistics.m_FenceWaitMilliseconds = phaseTimer.Measure(TimeUnit::MILLIS);
         PROFILING_END(Waiting_For_Frame_Available_Fence, MILLIS, "")
 
+        //The previous use of this frame has finished, so its picking results can be read back.
+        //New picking queries are then recorded into this frame.
+        ResolvePickingQueries(frameData);
+        if(!PreparePickingQueries(frameData))
+        {
+            printf("Could not prepare picking queries!\n");
+            return false;
+        }
+
+        //Same for the debug counters. The current debug view is then recorded into this frame.
+        ResolveDebugCounters(frameData);
+        {
+            std::lock_guard<std::mutex> lock(m_DebugViewMutex);
+            frameData.m_DebugView.m_Settings = m_DebugViewSettings;
+        }
+        //Debug view pipelines are compiled in the background. Until they are ready, frames are drawn without the debug view.
+        if (frameData.m_DebugView.m_Settings.m_Mode != DebugViewMode::NONE)
+        {
+            const auto debugViewState = m_DeferredStage->PollDebugViews(m_RenderData);
+            if (debugViewState == PipelineState::FAILED)
+            {
+                //The requested mode is turned off, so that the application sees it through GetDebugView() and this is only reported once.
+                printf("Debug view pipelines could not be compiled. Debug views are disabled.\n");
+                std::lock_guard<std::mutex> lock(m_DebugViewMutex);
+                m_DebugViewSettings.m_Mode = DebugViewMode::NONE;
+            }
+            if (debugViewState != PipelineState::READY)
+            {
+                frameData.m_DebugView.m_Settings.m_Mode = DebugViewMode::NONE;
+            }
+        }
+        frameData.m_DebugView.m_CountersPending = frameData.m_DebugView.m_Settings.m_Mode != DebugViewMode::NONE;
+        frameData.m_DebugView.m_FrameIndex = m_RenderData.m_FrameCounter;
+
     	/*
     	 * Upload all per-frame data to the GPU.
     	 * Instances, materials, indirection buffer etc.
     	 * This automatically resizes the buffers when needed.
     	 */
         PROFILING_START(Upload_Frame_Data)
-    	const auto requiredInstanceDataSize = drawData.m_PackedInstanceData.size() * sizeof(PackedInstanceData);
-        CPUWrite write{ drawData.m_PackedInstanceData.data(), 0, requiredInstanceDataSize};
-    	if(!uploadData.m_InstanceBuffer.Write(&write, 1, true))
-    	{
-            printf("Could not upload instance data!\n");
-            return false;
-    	}
+        TraceZone uploadZone("Upload Frame Data");
+        phaseTimer.Reset();
 
-        const auto requiredMaterialDataSize = drawData.m_PackedMaterialData.size() * sizeof(PackedMaterialData);
-        write = { drawData.m_PackedMaterialData.data(), 0, requiredMaterialDataSize };
-        if (!uploadData.m_MaterialBuffer.Write(&write, 1, true))
+        //Redraws reuse the data when it was already uploaded into this frame.
+        const bool uploadDrawData = uploadData.m_UploadedDrawDataId != drawData.m_SubmissionId;
+        if (uploadDrawData && !UploadDrawData(drawData, uploadData, statistics))
         {
-            printf("Could not upload material data!\n");
             return false;
         }
 
-        /*
-         * Prepare lights for uploading.
-         *
-         */
-        const auto totalNumLights = (drawData.m_PackedAreaLightData.size() + drawData.m_PackedDirectionalLightData.size());
-        const auto requiredLightSize = totalNumLights * sizeof(PackedLightData);
-
-        //Pack it all into a single continuous piece of memory.
-        std::vector<PackedLightData> allLightData;
-        allLightData.reserve(totalNumLights);
-        allLightData.insert(allLightData.end(), drawData.m_PackedAreaLightData.begin(), drawData.m_PackedAreaLightData.end());
-        allLightData.insert(allLightData.end(), drawData.m_PackedDirectionalLightData.begin(), drawData.m_PackedDirectionalLightData.end());
-
-        write = { allLightData.data(), 0, requiredLightSize };
-        if (!uploadData.m_LightsBuffer.Write(&write, 1, true))
+        //Merged lights depend on the camera, which a redraw can change, so they are selected again for every frame.
+        if ((uploadDrawData || UsesLightTree(drawData)) && !UploadLights(drawData, frameData.m_Camera, uploadData, statistics))
         {
-            printf("Could not upload light data!\n");
             return false;
         }
-
-        const auto requiredIndirectionSize = drawData.m_IndirectionBuffer.size() * sizeof(uint32_t);
-        write = { drawData.m_IndirectionBuffer.data(), 0, requiredIndirectionSize };
-    	if(!uploadData.m_IndirectionBuffer.Write(&write, 1, true))
-    	{
-            printf("Could not upload indirection data!\n");
-            return false;
-    	}
+        uploadData.m_UploadedDrawDataId = drawData.m_SubmissionId;
+        uploadZone.End();
+        statistics.m_UploadMilliseconds = phaseTimer.Measure(TimeUnit::MILLIS);
+        statistics.m_NumInstances = static_cast<uint32_t>(drawData.m_PackedInstanceData.size());
+        statistics.m_NumDrawPasses = drawData.GetDrawPassCount();
+        statistics.m_NumLights = static_cast<uint32_t>(drawData.m_PackedAreaLightData.size() + drawData.m_PackedDirectionalLightData.size());
         PROFILING_END(Upload_Frame_Data, MILLIS, "")
 
         //Prepare the command buffer for rendering
+        TraceZone recordZone("Record Command Buffer");
         vkResetCommandPool(m_RenderData.m_Device, frameData.m_CommandPool, 0);
         VkCommandBufferBeginInfo beginInfo{};
         beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -519,6 +889,28 @@ namespace egg
             return false;
         }
 
+        //Read back the GPU timings from the last time this frame was used, and reset the queries.
+        m_RenderData.m_GpuProfiler.BeginFrame(cmdBuffer, m_SwapChainIndex, m_RenderData.m_FrameCounter);
+
+        //The GPU time of the previous use of this frame is now known, so its statistics are complete.
+        PublishFrameStatistics(frameData);
+        phaseTimer.Reset();
+
+        //Start measuring the latency of the input this frame reacts to.
+        frameData.m_Latency = LatencyData{};
+        frameData.m_Latency.m_InputTimestamp = drawData.m_InputTimestamp;
+
+        //The HUD shows everything published so far, so its snapshot is taken right before recording.
+        m_HudStage->SetEnabled(m_HudEnabled);
+        if (m_HudStage->IsEnabled())
+        {
+            EGG_TRACE_ZONE("Gather HUD Data");
+            auto& hudData = frameData.m_HudData;
+            m_FrameStatistics.GetRecentHistory(RenderStage_Hud::GRAPH_FRAMES, hudData.m_RecentFrames);
+            hudData.m_HasGpuTimings = m_RenderData.m_GpuProfiler.GetLatestFrame(hudData.m_GpuTimings);
+            MemoryTracker::GetCategoryUsage(hudData.m_Memory);
+        }
+
 	    //All semapores the command buffer should wait for and signal.
         std::vector<VkSemaphore> waitSemaphores;
         std::vector<VkSemaphore> signalSemaphores;
@@ -532,7 +924,10 @@ namespace egg
 		    if(stage->IsEnabled())
 		    {
                 //These functions may add waiting dependencies to the semaphore vectors.
+                EGG_TRACE_ZONE(stage->GetName());
+                const auto zone = m_RenderData.m_GpuProfiler.BeginZone(cmdBuffer, m_SwapChainIndex, stage->GetName());
                 stage->RecordCommandBuffer(m_RenderData, cmdBuffer, m_SwapChainIndex, waitSemaphores, signalSemaphores, waitStageFlags);
+                m_RenderData.m_GpuProfiler.EndZone(cmdBuffer, m_SwapChainIndex, zone);
 		    }
 	    }
 
@@ -544,6 +939,8 @@ namespace egg
             printf("Could not end recording of command buffer!\n");
             return false;
         }
+        recordZone.End();
+        statistics.m_RecordMilliseconds = phaseTimer.Measure(TimeUnit::MILLIS);
 
 	    //Ensure that the command buffer waits for the frame to be ready, and signals to the swapchain that it's ready to be presented.
         signalSemaphores.push_back(frameData.m_WaitForRenderSemaphore);
@@ -558,6 +955,8 @@ namespace egg
 	    }
 
         //Submit the command queue. Signal the fence once done.
+        TraceZone submitZone("Submit And Present");
+        phaseTimer.Reset();
         VkSubmitInfo submitInfo{};
         submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
         submitInfo.commandBufferCount = 1;
@@ -576,6 +975,7 @@ namespace egg
             printf("Could not submit queue in swapchain!\n");
             return false;
         }
+        frameData.m_Latency.m_SubmitTimestamp = GetTimestampMicroseconds();
 
         //Start building the command buffer.
         VkPresentInfoKHR presentInfo{};
@@ -587,12 +987,29 @@ namespace egg
         presentInfo.pImageIndices = &m_SwapChainIndex;
         presentInfo.pResults = nullptr;
 
+        //Tag the present of frames with input latency, so that the time they reach the screen is measured.
+        const uint64_t presentIdValue = m_PresentWaiter.IsEnabled() && frameData.m_Latency.m_InputTimestamp != 0 ? m_PresentWaiter.GetNextPresentId() : 0;
+        VkPresentIdKHR presentId{};
+        if (presentIdValue != 0)
+        {
+            presentId.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+            presentId.swapchainCount = 1;
+            presentId.pPresentIds = &presentIdValue;
+            presentInfo.pNext = &presentId;
+        }
+
         if(vkQueuePresentKHR(queue.m_Queue, &presentInfo) != VK_SUCCESS)
         {
             printf("Could not present swapchain!\n");
             return false;
         }
 
+        if (presentIdValue != 0)
+        {
+            m_PresentWaiter.AddPresent(presentIdValue);
+            frameData.m_Latency.m_PresentId = presentIdValue;
+        }
+
         /*
          * Retrieve the next available frame index.
          * The semaphore will be signaled as soon as the frame becomes available.
@@ -600,17 +1017,144 @@ namespace egg
          */
         if(vkAcquireNextImageKHR(m_RenderData.m_Device, m_SwapChain, std::numeric_limits<unsigned>::max(), frameData.m_WaitForFrameSemaphore, nullptr, &m_SwapChainIndex) != VK_SUCCESS)
         {
-            printf("Could not get next image in swap chain!\n");
+            printf("Could not get next image in swap chain!\n");
+            return false;
+        }
+        m_FrameReadySemaphore = frameData.m_WaitForFrameSemaphore;
+        submitZone.End();
+        statistics.m_SubmitMilliseconds = phaseTimer.Measure(TimeUnit::MILLIS);
+        statistics.m_CpuFrameMilliseconds = frameTimer.Measure(TimeUnit::MILLIS);
+
+        //Keep the statistics with the frame until the GPU has finished it.
+        frameData.m_Statistics = statistics;
+        frameData.m_StatisticsPending = true;
+
+	    //Increment the frame index.
+        ++m_RenderData.m_FrameCounter;
+
+        PROFILING_END(Cpu_Frame_Building, MILLIS, "")
+	    
+	    return true;
+    }
+
+    bool Renderer::UploadDrawData(const DrawData& a_DrawData, UploadData& a_UploadData, FrameStatistics& a_Statistics)
+    {
+        const auto requiredInstanceDataSize = a_DrawData.m_PackedInstanceData.size() * sizeof(PackedInstanceData);
+        CPUWrite write{ a_DrawData.m_PackedInstanceData.data(), 0, requiredInstanceDataSize};
+    	if(!a_UploadData.m_InstanceBuffer.Write(&write, 1, true))
+    	{
+            printf("Could not upload instance data!\n");
+            return false;
+    	}
+
+        const auto requiredMaterialDataSize = a_DrawData.m_PackedMaterialData.size() * sizeof(PackedMaterialData);
+        write = { a_DrawData.m_PackedMaterialData.data(), 0, requiredMaterialDataSize };
+        if (!a_UploadData.m_MaterialBuffer.Write(&write, 1, true))
+        {
+            printf("Could not upload material data!\n");
+            return false;
+        }
+
+        const auto requiredIndirectionSize = a_DrawData.m_IndirectionBuffer.size() * sizeof(uint32_t);
+        write = { a_DrawData.m_IndirectionBuffer.data(), 0, requiredIndirectionSize };
+    	if(!a_UploadData.m_IndirectionBuffer.Write(&write, 1, true))
+    	{
+            printf("Could not upload indirection data!\n");
+            return false;
+    	}
+
+        //Debug lines and triangles share a single vertex buffer, so that each type is drawn with one draw call.
+        const auto debugLineSize = a_DrawData.m_DebugLineVertices.size() * sizeof(PackedDebugVertex);
+        const auto debugTriangleSize = a_DrawData.m_DebugTriangleVertices.size() * sizeof(PackedDebugVertex);
+        a_UploadData.m_NumDebugLineVertices = static_cast<uint32_t>(a_DrawData.m_DebugLineVertices.size());
+        a_UploadData.m_NumDebugTriangleVertices = static_cast<uint32_t>(a_DrawData.m_DebugTriangleVertices.size());
+        if (debugLineSize + debugTriangleSize > 0)
+        {
+            CPUWrite debugWrites[2] =
+            {
+                { a_DrawData.m_DebugLineVertices.data(), 0, debugLineSize },
+                { a_DrawData.m_DebugTriangleVertices.data(), debugLineSize, debugTriangleSize }
+            };
+            if (!a_UploadData.m_DebugVertexBuffer.Write(debugWrites, 2, true))
+            {
+                printf("Could not upload debug draw data!\n");
+                return false;
+            }
+        }
+
+        //Previous transforms of interpolated instances.
+        const auto requiredPreviousTransformSize = a_DrawData.m_PreviousTransforms.size() * sizeof(glm::mat4);
+        if (requiredPreviousTransformSize > 0)
+        {
+            write = { a_DrawData.m_PreviousTransforms.data(), 0, requiredPreviousTransformSize };
+            if (!a_UploadData.m_PreviousTransformBuffer.Write(&write, 1, true))
+            {
+                printf("Could not upload previous transforms!\n");
+                return false;
+            }
+        }
+
+        //Frames of animated instances.
+        const auto requiredAnimationStateSize = a_DrawData.m_AnimationStates.size() * sizeof(PackedAnimationState);
+        if (requiredAnimationStateSize > 0)
+        {
+            write = { a_DrawData.m_AnimationStates.data(), 0, requiredAnimationStateSize };
+            if (!a_UploadData.m_AnimationStateBuffer.Write(&write, 1, true))
+            {
+                printf("Could not upload animation states!\n");
+                return false;
+            }
+        }
+
+        a_Statistics.m_InstanceBytesUploaded = requiredInstanceDataSize;
+        a_Statistics.m_MaterialBytesUploaded = requiredMaterialDataSize;
+        a_Statistics.m_IndirectionBytesUploaded = requiredIndirectionSize;
+        a_Statistics.m_DebugDrawBytesUploaded = debugLineSize + debugTriangleSize;
+        a_Statistics.m_PreviousTransformBytesUploaded = requiredPreviousTransformSize;
+        a_Statistics.m_AnimationStateBytesUploaded = requiredAnimationStateSize;
+        return true;
+    }
+
+    bool Renderer::UsesLightTree(const DrawData& a_DrawData) const
+    {
+        return m_RenderData.m_Settings.lightTreeErrorPixels > 0.f && a_DrawData.m_PackedAreaLightData.size() > 1;
+    }
+
+    bool Renderer::UploadLights(const DrawData& a_DrawData, const Camera& a_Camera, UploadData& a_UploadData, FrameStatistics& a_Statistics)
+    {
+        std::vector<PackedLightData> allLightData;
+        if (UsesLightTree(a_DrawData))
+        {
+            //The tree only depends on the lights, so redraws of the same draw data only select a new cut.
+            if (m_LightTreeDrawDataId != a_DrawData.m_SubmissionId)
+            {
+                m_LightTree.Build(a_DrawData.m_PackedAreaLightData);
+                m_LightTreeDrawDataId = a_DrawData.m_SubmissionId;
+            }
+
+            //Groups of sphere lights that are too small on screen to tell apart are replaced by a single light.
+            const float pixelsPerUnit = static_cast<float>(m_RenderData.m_Settings.resolutionY) / (2.f * std::tan(glm::radians(a_Camera.GetFov()) * 0.5f));
+            m_LightTree.SelectCut(a_Camera.GetTransform().GetTranslation(), pixelsPerUnit, m_RenderData.m_Settings.lightTreeErrorPixels, allLightData);
+            a_UploadData.m_NumAreaLights = static_cast<uint32_t>(allLightData.size());
+            allLightData.insert(allLightData.end(), a_DrawData.m_PackedDirectionalLightData.begin(), a_DrawData.m_PackedDirectionalLightData.end());
+        }
+        else
+        {
+            //Pack it all into a single continuous piece of memory.
+            a_DrawData.PackLights(allLightData);
+            a_UploadData.m_NumAreaLights = static_cast<uint32_t>(a_DrawData.m_PackedAreaLightData.size());
+        }
+        const auto requiredLightSize = allLightData.size() * sizeof(PackedLightData);
+
+        const CPUWrite write{ allLightData.data(), 0, requiredLightSize };
+        if (!a_UploadData.m_LightsBuffer.Write(&write, 1, true))
+        {
+            printf("Could not upload light data!\n");
             return false;
         }
-        m_FrameReadySemaphore = frameData.m_WaitForFrameSemaphore;
-
-	    //Increment the frame index.
-        ++m_RenderData.m_FrameCounter;
 
-        PROFILING_END(Cpu_Frame_Building, MILLIS, "")
-	    
-	    return true;
+        a_Statistics.m_LightBytesUploaded = requiredLightSize;
+        return true;
     }
 
     glm::vec2 Renderer::GetResolution() const
@@ -634,6 +1178,8 @@ namespace egg
     std::vector<std::shared_ptr<EggStaticMesh>> Renderer::CreateMeshes(const std::vector<StaticMeshCreateInfo>& a_MeshCreateInfos)
     {
         PROFILING_START(Create_Meshes)
+        EGG_TRACE_ZONE("CreateMeshes");
+        LiveResourceTracker::CreationSiteScope creationSite("CreateMeshes", EGG_RETURN_ADDRESS());
 
         //First lock this mutex so that no other thread can start accessing the upload.
         std::lock_guard<std::mutex> lock(m_CopyMutex);
@@ -646,6 +1192,8 @@ namespace egg
 
         for (auto& info : a_MeshCreateInfos)
         {
+            EGG_TRACE_ZONE("Upload Mesh");
+
             //If invalid, return nullptr.
             if(info.m_NumIndices == 0 || info.m_NumVertices == 0 || info.m_IndexBuffer == nullptr || info.m_VertexBuffer == nullptr)
             {
@@ -654,6 +1202,18 @@ namespace egg
                 continue;
             }
 
+            //Geometry that is identical to a mesh that is still alive shares that mesh.
+            std::string contentKey;
+            if (m_RenderData.m_Settings.deduplicateMeshes)
+            {
+                contentKey = MeshCache::CreateKey(info);
+                if (auto existing = m_MeshCache.Find(contentKey, info))
+                {
+                    meshes.push_back(existing);
+                    continue;
+                }
+            }
+
             //Calculate buffer size. Offset to be 16-byte aligned.
             const auto vertexSizeBytes = sizeof(Vertex) * info.m_NumVertices;
             const auto indexSizeBytes = sizeof(std::uint32_t) * info.m_NumIndices;
@@ -668,7 +1228,9 @@ namespace egg
             VkBufferCreateInfo bufferInfo{};
             bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
             bufferInfo.size = bufferSize;
-            bufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+            //Transfer source is needed to read the geometry back for draw data captures. Scattering reads surface meshes as a storage buffer.
+            bufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT
+                | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
             bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
             //Allocate some GPU-only memory.
@@ -683,6 +1245,7 @@ namespace egg
                 printf("Error! Could not allocate memory for mesh.\n");
                 return {};
             }
+            MemoryTracker::Track(m_RenderData.m_Allocator, allocation, MemoryCategory::MESH_GEOMETRY);
 
             //Create a buffer on the GPU that can be copied into from the CPU.
             VkBuffer stagingBuffer;
@@ -694,6 +1257,7 @@ namespace egg
                 printf("Error! Could not allocate copy memory for mesh.\n");
                 return {};
             }
+            MemoryTracker::Track(m_RenderData.m_Allocator, stagingBufferAllocation, MemoryCategory::STAGING);
 
             //Retrieve information about the staging and GPU buffers (handles)
             VmaAllocationInfo stagingBufferInfo;
@@ -769,11 +1333,17 @@ namespace egg
             vkWaitForFences(m_RenderData.m_Device, 1, &m_CopyFence, true, std::numeric_limits<uint32_t>::max());
 
             //Free the staging buffer
+            MemoryTracker::Untrack(m_RenderData.m_Allocator, stagingBufferAllocation);
             vmaDestroyBuffer(m_RenderData.m_Allocator, stagingBuffer, stagingBufferAllocation);
 
             //Finally create a shared pointer and return a copy of it after putting it in the registry.
-            auto ptr = std::make_shared<StaticMesh>(m_MeshCounter, m_RenderData.m_Allocator, allocation, buffer, info.m_NumIndices, info.m_NumVertices, indexOffset, vertexOffset);
+            auto ptr = std::make_shared<StaticMesh>(m_MeshCounter, m_RenderData.m_Allocator, allocation, buffer, info.m_NumIndices, info.m_NumVertices, indexOffset, vertexOffset, CalculateMeshBounds(info));
             ++m_MeshCounter;
+            LiveResourceTracker::Register(ptr.get(), "StaticMesh", m_RenderData.m_FrameCounter);
+            if (!contentKey.empty())
+            {
+                m_MeshCache.Insert(contentKey, info, ptr);
+            }
             meshes.push_back(ptr);
         }
 
@@ -782,8 +1352,128 @@ namespace egg
         return meshes;
     }
 
+    MeshBounds Renderer::CalculateMeshBounds(const StaticMeshCreateInfo& a_CreateInfo)
+    {
+        MeshBounds bounds;
+        for (uint32_t i = 0; i < a_CreateInfo.m_NumVertices; ++i)
+        {
+            bounds.m_Radius = std::max(bounds.m_Radius, glm::length(a_CreateInfo.m_VertexBuffer[i].position));
+        }
+
+        //Indices outside of the vertex buffer are skipped, they are not drawn either.
+        for (uint32_t i = 0; i + 2 < a_CreateInfo.m_NumIndices; i += 3)
+        {
+            const uint32_t* triangle = &a_CreateInfo.m_IndexBuffer[i];
+            if (triangle[0] >= a_CreateInfo.m_NumVertices || triangle[1] >= a_CreateInfo.m_NumVertices || triangle[2] >= a_CreateInfo.m_NumVertices)
+            {
+                continue;
+            }
+
+            const glm::vec3& a = a_CreateInfo.m_VertexBuffer[triangle[0]].position;
+            const glm::vec3& b = a_CreateInfo.m_VertexBuffer[triangle[1]].position;
+            const glm::vec3& c = a_CreateInfo.m_VertexBuffer[triangle[2]].position;
+            const float area = 0.5f * glm::length(glm::cross(b - a, c - a));
+            bounds.m_SurfaceArea += area;
+            bounds.m_MaxTriangleArea = std::max(bounds.m_MaxTriangleArea, area);
+        }
+        return bounds;
+    }
+
+    bool Renderer::ReadMeshGeometry(StaticMesh& a_Mesh, std::vector<Vertex>& a_Vertices, std::vector<uint32_t>& a_Indices)
+    {
+        EGG_TRACE_ZONE("ReadMeshGeometry");
+
+        //The copy command buffer is shared with mesh uploads.
+        std::lock_guard<std::mutex> lock(m_CopyMutex);
+        vkWaitForFences(m_RenderData.m_Device, 1, &m_CopyFence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+
+        const auto vertexSizeBytes = sizeof(Vertex) * a_Mesh.GetNumVertices();
+        const auto indexSizeBytes = sizeof(std::uint32_t) * a_Mesh.GetNumIndices();
+        const auto bufferSize = a_Mesh.GetIndexBufferOffset() + indexSizeBytes;
+
+        //Create a buffer on the CPU that the mesh buffer can be copied into.
+        VkBufferCreateInfo bufferInfo{};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = bufferSize;
+        bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        VmaAllocationCreateInfo allocInfo = {};
+        allocInfo.usage = VMA_MEMORY_USAGE_GPU_TO_CPU;
+
+        VkBuffer readbackBuffer;
+        VmaAllocation readbackAllocation;
+        if (vmaCreateBuffer(m_RenderData.m_Allocator, &bufferInfo, &allocInfo, &readbackBuffer, &readbackAllocation, nullptr) != VK_SUCCESS)
+        {
+            printf("Error! Could not allocate readback memory for mesh.\n");
+            return false;
+        }
+        MemoryTracker::Track(m_RenderData.m_Allocator, readbackAllocation, MemoryCategory::READBACK);
+
+        vkResetCommandPool(m_RenderData.m_Device, m_CopyCommandPool, 0);
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+        bool success = vkBeginCommandBuffer(m_CopyBuffer, &beginInfo) == VK_SUCCESS;
+        if (success)
+        {
+            VkBufferCopy copyInfo{};
+            copyInfo.size = bufferSize;
+            vkCmdCopyBuffer(m_CopyBuffer, a_Mesh.GetBuffer(), readbackBuffer, 1, &copyInfo);
+            vkEndCommandBuffer(m_CopyBuffer);
+
+            VkSubmitInfo submitInfo{};
+            submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            submitInfo.commandBufferCount = 1;
+            submitInfo.pCommandBuffers = &m_CopyBuffer;
+
+            vkResetFences(m_RenderData.m_Device, 1, &m_CopyFence);
+            vkQueueSubmit(m_RenderData.m_MeshUploadQueue->m_Queue, 1, &submitInfo, m_CopyFence);
+            vkWaitForFences(m_RenderData.m_Device, 1, &m_CopyFence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+        }
+        else
+        {
+            printf("Could not begin recording copy command buffer!\n");
+        }
+
+        void* data = nullptr;
+        if (success && vmaMapMemory(m_RenderData.m_Allocator, readbackAllocation, &data) == VK_SUCCESS)
+        {
+            vmaInvalidateAllocation(m_RenderData.m_Allocator, readbackAllocation, 0, VK_WHOLE_SIZE);
+
+            a_Vertices.resize(a_Mesh.GetNumVertices());
+            a_Indices.resize(a_Mesh.GetNumIndices());
+            memcpy(a_Vertices.data(), static_cast<const uint8_t*>(data) + a_Mesh.GetVertexBufferOffset(), vertexSizeBytes);
+            memcpy(a_Indices.data(), static_cast<const uint8_t*>(data) + a_Mesh.GetIndexBufferOffset(), indexSizeBytes);
+            vmaUnmapMemory(m_RenderData.m_Allocator, readbackAllocation);
+        }
+        else
+        {
+            success = false;
+        }
+
+        MemoryTracker::Untrack(m_RenderData.m_Allocator, readbackAllocation);
+        vmaDestroyBuffer(m_RenderData.m_Allocator, readbackBuffer, readbackAllocation);
+        return success;
+    }
+
     std::shared_ptr<EggStaticMesh> Renderer::CreateMesh(const ShapeCreateInfo& a_ShapeCreateInfo)
     {
+        LiveResourceTracker::CreationSiteScope creationSite("CreateMesh(ShapeCreateInfo)", EGG_RETURN_ADDRESS());
+
+        //Shapes with the same parameters are shared without generating their vertices again.
+        std::string shapeKey;
+        if (m_RenderData.m_Settings.deduplicateMeshes)
+        {
+            shapeKey = MeshCache::CreateKey(a_ShapeCreateInfo);
+            if (auto existing = m_MeshCache.Find(shapeKey))
+            {
+                return existing;
+            }
+        }
+
         std::vector<Vertex> vertices;
         std::vector<uint32_t> indices;
 
@@ -979,11 +1669,17 @@ namespace egg
         meshInfo.m_VertexBuffer = vertices.data();
         meshInfo.m_NumVertices = vertices.size();
         meshInfo.m_NumIndices = indices.size();
-        return CreateMesh(meshInfo);
+        auto mesh = CreateMesh(meshInfo);
+        if (mesh != nullptr && !shapeKey.empty())
+        {
+            m_MeshCache.Insert(shapeKey, mesh);
+        }
+        return mesh;
     }
 
     std::shared_ptr<EggStaticMesh> Renderer::CreateMesh(const StaticMeshCreateInfo& a_MeshCreateInfo)
     {
+        LiveResourceTracker::CreationSiteScope creationSite("CreateMesh(StaticMeshCreateInfo)", EGG_RETURN_ADDRESS());
         auto vector = CreateMeshes(std::vector<StaticMeshCreateInfo>{a_MeshCreateInfo});
         if (!vector.empty())
         {
@@ -992,6 +1688,124 @@ namespace egg
         return nullptr;
     }
 
+    std::shared_ptr<EggVertexAnimation> Renderer::CreateVertexAnimation(const VertexAnimationCreateInfo& a_CreateInfo)
+    {
+        EGG_TRACE_ZONE("CreateVertexAnimation");
+        LiveResourceTracker::CreationSiteScope creationSite("CreateVertexAnimation", EGG_RETURN_ADDRESS());
+
+        if (a_CreateInfo.m_Positions == nullptr || a_CreateInfo.m_Normals == nullptr || a_CreateInfo.m_NumVertices == 0 || a_CreateInfo.m_NumFrames == 0
+            || a_CreateInfo.m_FramesPerSecond <= 0.f)
+        {
+            printf("Invalid vertex animation info provided! Nullptr or 0 sized arrays.\n");
+            return nullptr;
+        }
+
+        //Shaders index the frames in whole vertices, so everything has to be addressable with 32 bits.
+        const uint64_t numAnimatedVertices = static_cast<uint64_t>(a_CreateInfo.m_NumVertices) * a_CreateInfo.m_NumFrames;
+        const uint64_t sizeBytes = numAnimatedVertices * sizeof(PackedAnimatedVertex);
+        size_t offset = 0;
+        if (numAnimatedVertices > std::numeric_limits<uint32_t>::max() || !m_RenderData.m_VertexAnimationStorage->Allocate(static_cast<size_t>(sizeBytes), offset))
+        {
+            printf("Not enough vertex animation memory left for an animation of %llu bytes!\n", static_cast<unsigned long long>(sizeBytes));
+            return nullptr;
+        }
+
+        //The animation owns the range from here on, and returns it when it is destroyed.
+        auto animation = std::make_shared<VertexAnimation>(m_RenderData.m_VertexAnimationStorage, offset, a_CreateInfo.m_NumVertices, a_CreateInfo.m_NumFrames,
+            a_CreateInfo.m_FramesPerSecond, a_CreateInfo.m_Loop);
+
+        //Pack the frames straight into a staging buffer.
+        VkBufferCreateInfo bufferInfo{};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = sizeBytes;
+        bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        VmaAllocationCreateInfo allocInfo = {};
+        allocInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+
+        VkBuffer stagingBuffer;
+        VmaAllocation stagingBufferAllocation;
+        if (vmaCreateBuffer(m_RenderData.m_Allocator, &bufferInfo, &allocInfo, &stagingBuffer, &stagingBufferAllocation, nullptr) != VK_SUCCESS)
+        {
+            printf("Error! Could not allocate copy memory for vertex animation.\n");
+            return nullptr;
+        }
+        MemoryTracker::Track(m_RenderData.m_Allocator, stagingBufferAllocation, MemoryCategory::STAGING);
+
+        void* data;
+        vmaMapMemory(m_RenderData.m_Allocator, stagingBufferAllocation, &data);
+        auto* vertices = static_cast<PackedAnimatedVertex*>(data);
+        for (uint64_t i = 0; i < numAnimatedVertices; ++i)
+        {
+            vertices[i].m_Position = a_CreateInfo.m_Positions[i];
+            vertices[i].m_Normal = glm::packSnorm4x8(glm::vec4(a_CreateInfo.m_Normals[i], 0.f));
+        }
+        vmaUnmapMemory(m_RenderData.m_Allocator, stagingBufferAllocation);
+
+        bool success = true;
+        {
+            //Uploads share the copy command buffer with mesh creation.
+            std::lock_guard<std::mutex> lock(m_CopyMutex);
+            vkWaitForFences(m_RenderData.m_Device, 1, &m_CopyFence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+            vkResetCommandPool(m_RenderData.m_Device, m_CopyCommandPool, 0);
+
+            VkCommandBufferBeginInfo beginInfo{};
+            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            if (vkBeginCommandBuffer(m_CopyBuffer, &beginInfo) != VK_SUCCESS)
+            {
+                printf("Could not begin recording copy command buffer!\n");
+                success = false;
+            }
+            else
+            {
+                VkBufferCopy copyInfo{};
+                copyInfo.size = sizeBytes;
+                copyInfo.srcOffset = 0;
+                copyInfo.dstOffset = offset;
+                vkCmdCopyBuffer(m_CopyBuffer, stagingBuffer, m_RenderData.m_VertexAnimationStorage->GetBuffer().GetBuffer(), 1, &copyInfo);
+                vkEndCommandBuffer(m_CopyBuffer);
+
+                VkSubmitInfo submitInfo{};
+                submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+                submitInfo.commandBufferCount = 1;
+                submitInfo.pCommandBuffers = &m_CopyBuffer;
+
+                vkResetFences(m_RenderData.m_Device, 1, &m_CopyFence);
+                vkQueueSubmit(m_RenderData.m_MeshUploadQueue->m_Queue, 1, &submitInfo, m_CopyFence);
+                vkWaitForFences(m_RenderData.m_Device, 1, &m_CopyFence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+            }
+        }
+
+        MemoryTracker::Untrack(m_RenderData.m_Allocator, stagingBufferAllocation);
+        vmaDestroyBuffer(m_RenderData.m_Allocator, stagingBuffer, stagingBufferAllocation);
+
+        if (!success)
+        {
+            return nullptr;
+        }
+
+        LiveResourceTracker::Register(animation.get(), "VertexAnimation", m_RenderData.m_FrameCounter);
+        return animation;
+    }
+
+    std::shared_ptr<EggTerrain> Renderer::CreateTerrain(const TerrainCreateInfo& a_CreateInfo)
+    {
+        LiveResourceTracker::CreationSiteScope creationSite("CreateTerrain", EGG_RETURN_ADDRESS());
+
+        if (!a_CreateInfo.m_HeightCallback || a_CreateInfo.m_SampleSpacing <= 0.f)
+        {
+            printf("Invalid terrain info provided! No height callback or sample spacing.\n");
+            return nullptr;
+        }
+
+        //Heights are only requested by the terrain stage while recording, so nothing is uploaded here.
+        auto terrain = std::make_shared<Terrain>(a_CreateInfo);
+        LiveResourceTracker::Register(terrain.get(), "Terrain", m_RenderData.m_FrameCounter);
+        return terrain;
+    }
+
     bool Renderer::InitVulkan()
     {
         /*
@@ -1000,11 +1814,19 @@ namespace egg
 
          //Get all the vulkan extensions required for GLTF to work.
         std::vector<const char*> extensions{};
-        uint32_t count;
-        const char** surfaceExtensions = glfwGetRequiredInstanceExtensions(&count);
-        for (uint32_t i = 0; i < count; i++)
+        if (m_RenderData.m_Settings.headless)
+        {
+            extensions.push_back(VK_KHR_SURFACE_EXTENSION_NAME);
+            extensions.push_back(VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME);
+        }
+        else
         {
-            extensions.push_back(surfaceExtensions[i]);
+            uint32_t count;
+            const char** surfaceExtensions = glfwGetRequiredInstanceExtensions(&count);
+            for (uint32_t i = 0; i < count; i++)
+            {
+                extensions.push_back(surfaceExtensions[i]);
+            }
         }
 
         //Generic information about the application such as names and versions.
@@ -1098,6 +1920,20 @@ namespace egg
 
         printf("Vulkan instance successfully created.\n");
 
+        //Without a window, the swap chain is created on a headless surface instead.
+        if (m_RenderData.m_Settings.headless)
+        {
+            const auto createHeadlessSurface = reinterpret_cast<PFN_vkCreateHeadlessSurfaceEXT>(vkGetInstanceProcAddr(m_RenderData.m_VulkanInstance, "vkCreateHeadlessSurfaceEXT"));
+            VkHeadlessSurfaceCreateInfoEXT surfaceInfo{};
+            surfaceInfo.sType = VK_STRUCTURE_TYPE_HEADLESS_SURFACE_CREATE_INFO_EXT;
+            if (createHeadlessSurface == nullptr || createHeadlessSurface(m_RenderData.m_VulkanInstance, &surfaceInfo, nullptr, &m_RenderData.m_Surface) != VK_SUCCESS)
+            {
+                printf("Could not create headless surface. VK_EXT_headless_surface may not be supported.\n");
+                return false;
+            }
+            return true;
+        }
+
         /*
          * Bind GLFW and Vulkan.
          */
@@ -1122,14 +1958,25 @@ namespace egg
     void Renderer::KeyCallback(GLFWwindow* a_Window, int a_Key, int a_Scancode, int a_Action, int a_Mods)
     {
         Renderer* renderer = static_cast<Renderer*>(glfwGetWindowUserPointer(a_Window));
+        const auto timestamp = GetTimestampMicroseconds();
+
+        //The HUD toggle key is handled here and consumed, so the application never sees it.
+        if (a_Key == renderer->m_RenderData.m_Settings.hudToggleKey)
+        {
+            if (a_Action == GLFW_PRESS)
+            {
+                renderer->m_HudEnabled = !renderer->m_HudEnabled;
+            }
+            return;
+        }
 
         switch (a_Action)
         {
         case GLFW_PRESS:
-            renderer->m_InputQueue.AddKeyboardEvent({KeyboardAction::KEY_PRESSED, static_cast<uint16_t>(a_Key)});
+            renderer->m_InputQueue.AddKeyboardEvent({KeyboardAction::KEY_PRESSED, static_cast<uint16_t>(a_Key), timestamp});
             break;
         case GLFW_RELEASE:
-            renderer->m_InputQueue.AddKeyboardEvent({ KeyboardAction::KEY_RELEASED, static_cast<uint16_t>(a_Key) });
+            renderer->m_InputQueue.AddKeyboardEvent({ KeyboardAction::KEY_RELEASED, static_cast<uint16_t>(a_Key), timestamp });
             break;
         default:
             break;
@@ -1139,6 +1986,7 @@ namespace egg
     void Renderer::MousePositionCallback(GLFWwindow* a_Window, double a_Xpos, double a_Ypos)
     {
         Renderer* renderer = static_cast<Renderer*>(glfwGetWindowUserPointer(a_Window));
+        const auto timestamp = GetTimestampMicroseconds();
 
         float deltaX = static_cast<float>(a_Xpos) - renderer->m_LastMousePos.x;
         float deltaY = static_cast<float>(a_Ypos) - renderer->m_LastMousePos.y;
@@ -1146,17 +1994,18 @@ namespace egg
 
         if(deltaX != 0.f)
         {
-            renderer->m_InputQueue.AddMouseEvent({ MouseAction::MOVE_X, deltaX, MouseButton::NONE});
+            renderer->m_InputQueue.AddMouseEvent({ MouseAction::MOVE_X, deltaX, MouseButton::NONE, timestamp });
         }
         if (deltaY != 0.f)
         {
-            renderer->m_InputQueue.AddMouseEvent({ MouseAction::MOVE_Y, deltaY, MouseButton::NONE });
+            renderer->m_InputQueue.AddMouseEvent({ MouseAction::MOVE_Y, deltaY, MouseButton::NONE, timestamp });
         }
     }
 
     void Renderer::MouseButtonCallback(GLFWwindow* a_Window, int a_Button, int a_Action, int a_Mods)
     {
         Renderer* renderer = static_cast<Renderer*>(glfwGetWindowUserPointer(a_Window));
+        const auto timestamp = GetTimestampMicroseconds();
 
         MouseAction action;
         MouseButton button;
@@ -1190,21 +2039,22 @@ namespace egg
             break;
         }
 
-        renderer->m_InputQueue.AddMouseEvent({ action, 0, button });
+        renderer->m_InputQueue.AddMouseEvent({ action, 0, button, timestamp });
     }
 
     void Renderer::MouseScrollCallback(GLFWwindow* a_Window, double a_Xoffset, double a_Yoffset)
     {
         Renderer* renderer = static_cast<Renderer*>(glfwGetWindowUserPointer(a_Window));
+        const auto timestamp = GetTimestampMicroseconds();
 
         if(a_Xoffset != 0.0)
         {
-            renderer->m_InputQueue.AddMouseEvent({ MouseAction::SCROLL, static_cast<float>(a_Xoffset), MouseButton::NONE});
+            renderer->m_InputQueue.AddMouseEvent({ MouseAction::SCROLL, static_cast<float>(a_Xoffset), MouseButton::NONE, timestamp });
         }
 
         if(a_Yoffset != 0.0)
         {
-            renderer->m_InputQueue.AddMouseEvent({ MouseAction::SCROLL, static_cast<float>(a_Yoffset), MouseButton::NONE });
+            renderer->m_InputQueue.AddMouseEvent({ MouseAction::SCROLL, static_cast<float>(a_Yoffset), MouseButton::NONE, timestamp });
         }
 
     }
@@ -1450,8 +2300,78 @@ namespace egg
             return false;
         }
 
+        //Enable the optional core features that are supported.
+        m_RenderData.m_EnabledFeatures = VkPhysicalDeviceFeatures{};
+        m_RenderData.m_EnabledFeatures.pipelineStatisticsQuery = physicalDeviceFeatures.features.pipelineStatisticsQuery;
+        m_RenderData.m_EnabledFeatures.fragmentStoresAndAtomics = physicalDeviceFeatures.features.fragmentStoresAndAtomics;  //Needed for debug views.
+        m_RenderData.m_EnabledFeatures.drawIndirectFirstInstance = physicalDeviceFeatures.features.drawIndirectFirstInstance;  //Lets scattered draw commands start at their instances.
+
+        //Memory budget lets the memory allocator report the real usage and budget per heap, when available.
+        //Present ID and present wait are used to measure when frames reach the screen.
+        std::vector<const char*> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+        uint32_t extensionCount = 0;
+        vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+        std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+        vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+        m_RenderData.m_MemoryBudgetSupported = false;
+        bool presentIdAvailable = false;
+        bool presentWaitAvailable = false;
+        for (const auto& extension : availableExtensions)
+        {
+            if (strcmp(extension.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0)
+            {
+                deviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+                m_RenderData.m_MemoryBudgetSupported = true;
+            }
+            presentIdAvailable |= strcmp(extension.extensionName, VK_KHR_PRESENT_ID_EXTENSION_NAME) == 0;
+            presentWaitAvailable |= strcmp(extension.extensionName, VK_KHR_PRESENT_WAIT_EXTENSION_NAME) == 0;
+        }
+
+        //Buffer device addresses let shaders read the per-frame buffers without writing descriptors every frame. Core in Vulkan 1.2, but optional.
+        VkPhysicalDeviceBufferDeviceAddressFeatures bufferDeviceAddressFeatures{};
+        bufferDeviceAddressFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES;
+        {
+            VkPhysicalDeviceFeatures2 addressFeatures{};
+            addressFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+            addressFeatures.pNext = &bufferDeviceAddressFeatures;
+            vkGetPhysicalDeviceFeatures2(device, &addressFeatures);
+        }
+        m_RenderData.m_BufferDeviceAddressSupported = bufferDeviceAddressFeatures.bufferDeviceAddress == VK_TRUE;
+
+        //Only the base feature is enabled.
+        bufferDeviceAddressFeatures.bufferDeviceAddressCaptureReplay = VK_FALSE;
+        bufferDeviceAddressFeatures.bufferDeviceAddressMultiDevice = VK_FALSE;
+
+        //The present features are only chained into the device when both extensions are enabled.
+        VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+        presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+        VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+        presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+        presentWaitFeatures.pNext = &presentIdFeatures;
+        m_RenderData.m_PresentWaitSupported = false;
+        if (presentIdAvailable && presentWaitAvailable)
+        {
+            VkPhysicalDeviceFeatures2 presentFeatures{};
+            presentFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+            presentFeatures.pNext = &presentWaitFeatures;
+            vkGetPhysicalDeviceFeatures2(device, &presentFeatures);
+
+            if (presentIdFeatures.presentId == VK_TRUE && presentWaitFeatures.presentWait == VK_TRUE)
+            {
+                deviceExtensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+                deviceExtensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+                descriptorFeatures.pNext = &presentWaitFeatures;
+                m_RenderData.m_PresentWaitSupported = true;
+            }
+        }
+
+        if (m_RenderData.m_BufferDeviceAddressSupported)
+        {
+            bufferDeviceAddressFeatures.pNext = descriptorFeatures.pNext;
+            descriptorFeatures.pNext = &bufferDeviceAddressFeatures;
+        }
+
         VkDeviceCreateInfo createInfo;
-        const std::vector<const char*> swapchainExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
         std::vector<const char*> validationLayers{ "VK_LAYER_KHRONOS_validation" };
         {
             createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -1462,9 +2382,9 @@ namespace egg
             createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
             createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
-            createInfo.pEnabledFeatures = nullptr;
-            createInfo.enabledExtensionCount = (uint32_t)swapchainExtensions.size();
-            createInfo.ppEnabledExtensionNames = swapchainExtensions.data();
+            createInfo.pEnabledFeatures = &m_RenderData.m_EnabledFeatures;
+            createInfo.enabledExtensionCount = (uint32_t)deviceExtensions.size();
+            createInfo.ppEnabledExtensionNames = deviceExtensions.data();
             createInfo.enabledLayerCount = 0;
 
             if (m_RenderData.m_Settings.enableDebugMode)
@@ -1530,6 +2450,11 @@ namespace egg
         allocatorInfo.physicalDevice = m_RenderData.m_PhysicalDevice;
         allocatorInfo.device = m_RenderData.m_Device;
         allocatorInfo.instance = m_RenderData.m_VulkanInstance;
+        allocatorInfo.flags = m_RenderData.m_MemoryBudgetSupported ? VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT : 0;
+        if (m_RenderData.m_BufferDeviceAddressSupported)
+        {
+            allocatorInfo.flags |= VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
+        }
         if(vmaCreateAllocator(&allocatorInfo, &m_RenderData.m_Allocator) != VK_SUCCESS)
         {
             printf("Vma could not be initialized.\n");
@@ -1584,8 +2509,25 @@ namespace egg
          */
         uint32_t swapBufferCount = surfaceCapabilities.minImageCount;
         swapBufferCount = std::max(swapBufferCount, m_RenderData.m_Settings.m_SwapBufferCount);
-        swapBufferCount = std::min(surfaceCapabilities.maxImageCount, swapBufferCount);
+        if (surfaceCapabilities.maxImageCount != 0)     //0 means there is no maximum.
+        {
+            swapBufferCount = std::min(surfaceCapabilities.maxImageCount, swapBufferCount);
+        }
         m_RenderData.m_Settings.m_SwapBufferCount = swapBufferCount;
+
+        //FIFO is always supported. Immediate mode is not, so fall back to FIFO when it's missing.
+        VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+        if (!m_RenderData.m_Settings.vSync)
+        {
+            uint32_t presentModeCount = 0;
+            vkGetPhysicalDeviceSurfacePresentModesKHR(m_RenderData.m_PhysicalDevice, m_RenderData.m_Surface, &presentModeCount, nullptr);
+            std::vector<VkPresentModeKHR> presentModes(presentModeCount);
+            vkGetPhysicalDeviceSurfacePresentModesKHR(m_RenderData.m_PhysicalDevice, m_RenderData.m_Surface, &presentModeCount, presentModes.data());
+            if (std::find(presentModes.begin(), presentModes.end(), VK_PRESENT_MODE_IMMEDIATE_KHR) != presentModes.end())
+            {
+                presentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+            }
+        }
 	    
         VkSwapchainCreateInfoKHR swapChainInfo;
         swapChainInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
@@ -1603,7 +2545,7 @@ namespace egg
         swapChainInfo.pQueueFamilyIndices = NULL;                           //Again only relevant when set to concurrent.
         swapChainInfo.preTransform = surfaceCapabilities.currentTransform;
         swapChainInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
-        swapChainInfo.presentMode = m_RenderData.m_Settings.vSync ? VK_PRESENT_MODE_FIFO_KHR : VK_PRESENT_MODE_IMMEDIATE_KHR;
+        swapChainInfo.presentMode = presentMode;
         swapChainInfo.clipped = VK_TRUE;
         swapChainInfo.oldSwapchain = VK_NULL_HANDLE;
 
@@ -1651,6 +2593,8 @@ namespace egg
             }
         }
 
+        m_PresentWaiter.Start(m_SwapChain);
+
         printf("SwapChain successfully created.\n");
 
         return true;
@@ -1686,6 +2630,9 @@ namespace egg
 
     bool Renderer::CleanUpSwapChain()
     {
+        //The present wait thread uses the swapchain.
+        m_PresentWaiter.Stop();
+
         //Destroy frame buffers and such. Also synchronization objects.
         for (auto& frame : m_RenderData.m_FrameData)
         {
@@ -1734,8 +2681,24 @@ namespace egg
          * Add all the stages to the stage buffer.
          */
         //m_HelloTriangleStage = AddRenderStage(std::make_unique<RenderStage_HelloTriangle>());
+        if (m_RenderData.m_Settings.terrainLevels > 0)
+        {
+            //Streams the heightmap before the deferred stage begins its render pass, and draws into its G-buffer.
+            m_TerrainStage = AddRenderStage(std::make_unique<RenderStage_Terrain>());
+        }
         m_DeferredStage = AddRenderStage(std::make_unique<RenderStage_Deferred>());   //TODO
+        m_DeferredStage->SetTerrainStage(m_TerrainStage);
+        m_HudStage = AddRenderStage(std::make_unique<RenderStage_Hud>());              //Drawn last, on top of the output.
+        m_HudStage->SetEnabled(m_RenderData.m_Settings.enableHud);
+        m_HudEnabled = m_RenderData.m_Settings.enableHud;
 	    
+        //Pipelines and shader modules of all stages are shared through the cache.
+        if (!m_RenderData.m_PipelineCache.Init(m_RenderData.m_Device, m_RenderData.m_Settings.shadersPath, m_RenderData.m_ThreadPool))
+        {
+            printf("Could not initialize pipeline cache!\n");
+            return false;
+        }
+
         /*
          * Init the render stages for each frame.
          */
@@ -1786,6 +2749,182 @@ namespace egg
         return true;
     }
 
+    bool Renderer::PreparePickingQueries(Frame& a_Frame)
+    {
+        auto& pickingData = a_Frame.m_PickingData;
+        {
+            std::lock_guard<std::mutex> lock(m_PickingMutex);
+            if (m_PendingPickingQueries.empty())
+            {
+                return true;
+            }
+            pickingData.m_Queries = std::move(m_PendingPickingQueries);
+            m_PendingPickingQueries.clear();
+        }
+
+        //Clamp each query to the screen and place it in the readback buffer. Offsets are 16 byte aligned.
+        const glm::uvec2 resolution(m_RenderData.m_Settings.resolutionX, m_RenderData.m_Settings.resolutionY);
+        size_t requiredSize = 0;
+        for (auto& query : pickingData.m_Queries)
+        {
+            query.m_Offset = glm::min(query.m_Offset, resolution);
+            query.m_Size = glm::min(query.m_Size, resolution - query.m_Offset);
+            query.m_BufferOffset = requiredSize;
+
+            const size_t numTexels = static_cast<size_t>(query.m_Size.x) * query.m_Size.y;
+            requiredSize += numTexels * (PickingData::ID_TEXEL_SIZE + PickingData::DEPTH_TEXEL_SIZE);
+            requiredSize = (requiredSize + 15) & ~static_cast<size_t>(15);
+        }
+
+        //Grow the readback buffer if it is too small.
+        auto& buffer = pickingData.m_ReadbackBuffer;
+        if (buffer.GetSize() < requiredSize)
+        {
+            if (!buffer.Resize(GpuBufferSettings{ requiredSize, 16, VMA_MEMORY_USAGE_GPU_TO_CPU, VK_BUFFER_USAGE_TRANSFER_DST_BIT, MemoryCategory::READBACK }))
+            {
+                printf("Could not resize picking readback buffer!\n");
+
+                //Don't leave anyone waiting on results that will never be copied.
+                for (auto& query : pickingData.m_Queries)
+                {
+                    query.m_Promise.set_value({});
+                }
+                pickingData.m_Queries.clear();
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    void Renderer::ResolvePickingQueries(Frame& a_Frame)
+    {
+        auto& pickingData = a_Frame.m_PickingData;
+        if (pickingData.m_Queries.empty())
+        {
+            return;
+        }
+
+        //Queries are stored back to back, so the last one marks the end of the used data.
+        const auto& lastQuery = pickingData.m_Queries.back();
+        const size_t usedSize = lastQuery.m_BufferOffset + static_cast<size_t>(lastQuery.m_Size.x) * lastQuery.m_Size.y * (PickingData::ID_TEXEL_SIZE + PickingData::DEPTH_TEXEL_SIZE);
+
+        std::vector<uint8_t> texels(usedSize);
+        const bool read = usedSize == 0 || pickingData.m_ReadbackBuffer.Read(texels.data(), 0, usedSize);
+        if (!read)
+        {
+            printf("Could not read back picking results!\n");
+        }
+
+        for (auto& query : pickingData.m_Queries)
+        {
+            const size_t numTexels = read ? static_cast<size_t>(query.m_Size.x) * query.m_Size.y : 0;
+            const uint8_t* idTexels = texels.data() + query.m_BufferOffset;
+            const uint8_t* depthTexels = idTexels + numTexels * PickingData::ID_TEXEL_SIZE;
+
+            std::vector<uint32_t> ids(numTexels);
+            for (size_t texel = 0; texel < numTexels; ++texel)
+            {
+                //Depth is cleared to 1, so anything at that depth was never drawn to.
+                float depth;
+                memcpy(&depth, depthTexels + texel * PickingData::DEPTH_TEXEL_SIZE, sizeof(float));
+                if (depth >= 1.f)
+                {
+                    ids[texel] = INVALID_CUSTOM_ID;
+                    continue;
+                }
+
+                //The custom ID is stored as two half floats in the last two components. Their bits form the ID.
+                uint16_t halves[2];
+                memcpy(&halves[0], idTexels + texel * PickingData::ID_TEXEL_SIZE + 2 * sizeof(uint16_t), sizeof(halves));
+                ids[texel] = static_cast<uint32_t>(halves[0]) | (static_cast<uint32_t>(halves[1]) << 16);
+            }
+
+            query.m_Promise.set_value(std::move(ids));
+        }
+
+        pickingData.m_Queries.clear();
+    }
+
+    void Renderer::ResolveDebugCounters(Frame& a_Frame)
+    {
+        auto& debugView = a_Frame.m_DebugView;
+        if (!debugView.m_CountersPending)
+        {
+            return;
+        }
+        debugView.m_CountersPending = false;
+
+        //Layout of the DebugCounters block in deferred_processing.frag. 64-bit totals are split into a low and a high part.
+        uint32_t counters[DebugViewData::COUNTER_BUFFER_SIZE / sizeof(uint32_t)];
+        if (!debugView.m_CounterBuffer.Read(&counters[0], 0, sizeof(counters)))
+        {
+            printf("Could not read back debug view counters!\n");
+            return;
+        }
+
+        DebugCounters result;
+        result.m_FrameIndex = debugView.m_FrameIndex;
+        result.m_Mode = debugView.m_Settings.m_Mode;
+        result.m_NumShadedPixels = counters[0];
+        result.m_NumLightsEvaluated = static_cast<uint64_t>(counters[1]) | (static_cast<uint64_t>(counters[2]) << 32);
+        result.m_MaxLightsPerPixel = counters[3];
+        result.m_NumFragments = static_cast<uint64_t>(counters[4]) | (static_cast<uint64_t>(counters[5]) << 32);
+        result.m_MaxOverdraw = counters[6];
+
+        std::lock_guard<std::mutex> lock(m_DebugViewMutex);
+        m_DebugCounters = result;
+    }
+
+    void Renderer::PublishFrameStatistics(Frame& a_Frame)
+    {
+        if (!a_Frame.m_StatisticsPending)
+        {
+            return;
+        }
+
+        auto& statistics = a_Frame.m_Statistics;
+        statistics.m_HasGpuTime = m_RenderData.m_GpuProfiler.GetFrameMilliseconds(statistics.m_FrameIndex, statistics.m_GpuMilliseconds);
+
+        //Latencies are relative to the input timestamp the draw data was tagged with.
+        const auto& latency = a_Frame.m_Latency;
+        const auto millisecondsSinceInput = [&latency](uint64_t a_Timestamp)
+        {
+            return static_cast<double>(static_cast<int64_t>(a_Timestamp - latency.m_InputTimestamp)) / 1000.0;
+        };
+
+        statistics.m_HasInputLatency = latency.m_InputTimestamp != 0 && latency.m_GpuCompleteTimestamp != 0;
+        if (statistics.m_HasInputLatency)
+        {
+            statistics.m_InputToSubmitMilliseconds = millisecondsSinceInput(latency.m_SubmitTimestamp);
+            statistics.m_InputToGpuCompleteMilliseconds = millisecondsSinceInput(latency.m_GpuCompleteTimestamp);
+
+            //The present may not have completed yet, in which case it is not measured.
+            uint64_t presentTimestamp = 0;
+            statistics.m_HasPresentLatency = latency.m_PresentId != 0 && m_PresentWaiter.GetPresentTimestamp(latency.m_PresentId, presentTimestamp);
+            if (statistics.m_HasPresentLatency)
+            {
+                statistics.m_InputToPresentMilliseconds = millisecondsSinceInput(presentTimestamp);
+            }
+        }
+
+        m_FrameStatistics.AddFrame(statistics);
+        a_Frame.m_StatisticsPending = false;
+    }
+
+    void Renderer::ObserveGpuCompletion()
+    {
+        for (auto& frame : m_RenderData.m_FrameData)
+        {
+            auto& latency = frame.m_Latency;
+            if (frame.m_StatisticsPending && latency.m_InputTimestamp != 0 && latency.m_GpuCompleteTimestamp == 0
+                && vkGetFenceStatus(m_RenderData.m_Device, frame.m_Fence) == VK_SUCCESS)
+            {
+                latency.m_GpuCompleteTimestamp = GetTimestampMicroseconds();
+            }
+        }
+    }
+
     VkBool32 Renderer::debugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
                                      VkDebugUtilsMessageTypeFlagsEXT messageType, const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData,
                                      void* pUserData)
@@ -0,0 +1,428 @@
+#include "api/StaticBatch.h"
+
+#include <cassert>
+#include <cfloat>
+#include <cstdio>
+
+#include "api/EggRenderer.h"
+
+namespace egg
+{
+	StaticBatch::StaticBatch() : m_NumClusters(0)
+	{
+	}
+
+	uint32_t StaticBatch::AddSourceMesh(const StaticMeshCreateInfo& a_Mesh)
+	{
+		assert(a_Mesh.m_VertexBuffer != nullptr && a_Mesh.m_IndexBuffer != nullptr && "Source meshes need vertices and indices!");
+
+		SourceMesh mesh;
+		mesh.m_Geometry.m_Vertices.assign(a_Mesh.m_VertexBuffer, a_Mesh.m_VertexBuffer + a_Mesh.m_NumVertices);
+		mesh.m_Geometry.m_Indices.assign(a_Mesh.m_IndexBuffer, a_Mesh.m_IndexBuffer + a_Mesh.m_NumIndices);
+
+		glm::vec3 min(FLT_MAX);
+		glm::vec3 max(-FLT_MAX);
+		for (const auto& vertex : mesh.m_Geometry.m_Vertices)
+		{
+			min = glm::min(min, vertex.position);
+			max = glm::max(max, vertex.position);
+		}
+		mesh.m_Center = mesh.m_Geometry.m_Vertices.empty() ? glm::vec3(0.f) : (min + max) * 0.5f;
+
+		m_SourceMeshes.push_back(std::move(mesh));
+		return static_cast<uint32_t>(m_SourceMeshes.size()) - 1;
+	}
+
+	void StaticBatch::AddInstance(uint32_t a_SourceMesh, const std::shared_ptr<EggMaterial>& a_Material, const glm::mat4& a_Transform)
+	{
+		assert(a_SourceMesh < m_SourceMeshes.size() && "Invalid source mesh!");
+		assert(a_Material != nullptr && "Instances need a material!");
+
+		uint32_t material;
+		const auto found = m_MaterialLookup.find(a_Material.get());
+		if (found != m_MaterialLookup.end())
+		{
+			material = found->second;
+		}
+		else
+		{
+			material = static_cast<uint32_t>(m_Materials.size());
+			m_Materials.push_back(a_Material);
+			m_MaterialLookup.emplace(a_Material.get(), material);
+		}
+
+		m_Instances.push_back(Instance{ a_Transform, a_SourceMesh, material });
+	}
+
+	void StaticBatch::Build(const StaticBatchSettings& a_Settings)
+	{
+		assert(a_Settings.m_ClusterSize > 0.f && a_Settings.m_LodResolution > 0 && "Invalid static batch settings!");
+
+		m_Settings = a_Settings;
+		m_Nodes.clear();
+		m_Roots.clear();
+
+		std::unordered_map<uint64_t, uint32_t> cellLookup;
+
+		//Group the instances into clusters by the world space center of their bounds, and merge their geometry in world space.
+		for (const auto& instance : m_Instances)
+		{
+			const auto& source = m_SourceMeshes[instance.m_SourceMesh].m_Geometry;
+			const glm::vec3 center = glm::vec3(instance.m_Transform * glm::vec4(m_SourceMeshes[instance.m_SourceMesh].m_Center, 1.f));
+			const glm::ivec3 cell = glm::ivec3(glm::floor(center / m_Settings.m_ClusterSize));
+
+			const auto inserted = cellLookup.emplace(CellKey(cell), static_cast<uint32_t>(m_Nodes.size()));
+			if (inserted.second)
+			{
+				m_Nodes.emplace_back();
+				m_Nodes.back().m_Cell = cell;
+				m_Nodes.back().m_Min = glm::vec3(FLT_MAX);
+				m_Nodes.back().m_Max = glm::vec3(-FLT_MAX);
+			}
+
+			auto& node = m_Nodes[inserted.first->second];
+			auto& geometry = GetPart(node, instance.m_Material).m_Geometry;
+
+			const glm::mat3 rotation = glm::mat3(instance.m_Transform);
+			const glm::mat3 normalMatrix = glm::transpose(glm::inverse(rotation));
+
+			//Mirroring transforms flip the winding and the handedness of the tangent space.
+			const bool mirrored = glm::determinant(rotation) < 0.f;
+
+			const auto offset = static_cast<uint32_t>(geometry.m_Vertices.size());
+			for (const auto& vertex : source.m_Vertices)
+			{
+				Vertex transformed;
+				transformed.position = glm::vec3(instance.m_Transform * glm::vec4(vertex.position, 1.f));
+				transformed.normal = glm::normalize(normalMatrix * vertex.normal);
+				transformed.tangent = glm::vec4(glm::normalize(rotation * glm::vec3(vertex.tangent)), mirrored ? -vertex.tangent.w : vertex.tangent.w);
+				transformed.uv = vertex.uv;
+				geometry.m_Vertices.push_back(transformed);
+
+				node.m_Min = glm::min(node.m_Min, transformed.position);
+				node.m_Max = glm::max(node.m_Max, transformed.position);
+			}
+
+			for (size_t i = 0; i + 2 < source.m_Indices.size(); i += 3)
+			{
+				geometry.m_Indices.push_back(offset + source.m_Indices[i]);
+				geometry.m_Indices.push_back(offset + source.m_Indices[mirrored ? i + 2 : i + 1]);
+				geometry.m_Indices.push_back(offset + source.m_Indices[mirrored ? i + 1 : i + 2]);
+			}
+		}
+		m_NumClusters = static_cast<uint32_t>(m_Nodes.size());
+
+		//Every level merges the nodes of the level below that share a parent cell, and simplifies the result.
+		uint32_t levelBegin = 0;
+		for (uint32_t level = 1; level <= m_Settings.m_NumLodLevels; ++level)
+		{
+			const auto levelEnd = static_cast<uint32_t>(m_Nodes.size());
+			cellLookup.clear();
+
+			//Create all nodes of the level before filling them, as adding nodes moves the others.
+			for (uint32_t child = levelBegin; child < levelEnd; ++child)
+			{
+				const glm::ivec3 cell = ParentCell(m_Nodes[child].m_Cell);
+				const auto inserted = cellLookup.emplace(CellKey(cell), static_cast<uint32_t>(m_Nodes.size()));
+				if (inserted.second)
+				{
+					m_Nodes.emplace_back();
+					m_Nodes.back().m_Level = level;
+					m_Nodes.back().m_Cell = cell;
+					m_Nodes.back().m_Min = glm::vec3(FLT_MAX);
+					m_Nodes.back().m_Max = glm::vec3(-FLT_MAX);
+				}
+				m_Nodes[inserted.first->second].m_Children.push_back(child);
+			}
+
+			const float nodeSize = m_Settings.m_ClusterSize * static_cast<float>(1u << level);
+			for (uint32_t parent = levelEnd; parent < m_Nodes.size(); ++parent)
+			{
+				auto& node = m_Nodes[parent];
+				for (const uint32_t child : node.m_Children)
+				{
+					const auto& childNode = m_Nodes[child];
+					node.m_Min = glm::min(node.m_Min, childNode.m_Min);
+					node.m_Max = glm::max(node.m_Max, childNode.m_Max);
+					for (const auto& part : childNode.m_Parts)
+					{
+						Append(part.m_Geometry, GetPart(node, part.m_Material).m_Geometry);
+					}
+				}
+
+				for (auto& part : node.m_Parts)
+				{
+					Simplify(part.m_Geometry.m_Vertices, part.m_Geometry.m_Indices, glm::vec3(node.m_Cell) * nodeSize, nodeSize / static_cast<float>(m_Settings.m_LodResolution));
+				}
+			}
+
+			levelBegin = levelEnd;
+		}
+
+		for (auto& node : m_Nodes)
+		{
+			for (auto& part : node.m_Parts)
+			{
+				part.m_NumTriangles = static_cast<uint32_t>(part.m_Geometry.m_Indices.size() / 3);
+			}
+		}
+
+		for (uint32_t i = levelBegin; i < m_Nodes.size(); ++i)
+		{
+			m_Roots.push_back(i);
+		}
+	}
+
+	bool StaticBatch::Upload(EggRenderer& a_Renderer)
+	{
+		std::vector<StaticMeshCreateInfo> createInfos;
+		std::vector<Part*> parts;
+		for (auto& node : m_Nodes)
+		{
+			for (auto& part : node.m_Parts)
+			{
+				if (part.m_NumTriangles == 0)
+				{
+					continue;
+				}
+
+				StaticMeshCreateInfo createInfo;
+				createInfo.m_VertexBuffer = part.m_Geometry.m_Vertices.data();
+				createInfo.m_IndexBuffer = part.m_Geometry.m_Indices.data();
+				createInfo.m_NumVertices = static_cast<uint32_t>(part.m_Geometry.m_Vertices.size());
+				createInfo.m_NumIndices = static_cast<uint32_t>(part.m_Geometry.m_Indices.size());
+				createInfos.push_back(createInfo);
+				parts.push_back(&part);
+			}
+		}
+
+		const auto meshes = a_Renderer.CreateMeshes(createInfos);
+		if (meshes.size() != createInfos.size())
+		{
+			printf("Could not create the meshes of a static batch!\n");
+			return false;
+		}
+
+		for (size_t i = 0; i < parts.size(); ++i)
+		{
+			parts[i]->m_Mesh = meshes[i];
+			parts[i]->m_Geometry = Geometry{};
+		}
+		return true;
+	}
+
+	void StaticBatch::AddToDrawData(EggDrawData& a_DrawData, const glm::vec3& a_CameraPosition, uint32_t a_CustomId, std::vector<DrawCallHandle>& a_DrawCalls)
+	{
+		a_DrawCalls.clear();
+
+		//Materials are added the first time a visible part uses them.
+		m_MaterialHandles.resize(m_Materials.size());
+		m_MaterialAdded.assign(m_Materials.size(), 0);
+
+		for (const uint32_t root : m_Roots)
+		{
+			AddNode(a_DrawData, a_CameraPosition, root, a_CustomId, a_DrawCalls);
+		}
+	}
+
+	uint32_t StaticBatch::GetInstanceCount() const
+	{
+		return static_cast<uint32_t>(m_Instances.size());
+	}
+
+	uint32_t StaticBatch::GetClusterCount() const
+	{
+		return m_NumClusters;
+	}
+
+	uint32_t StaticBatch::GetNodeCount() const
+	{
+		return static_cast<uint32_t>(m_Nodes.size());
+	}
+
+	uint32_t StaticBatch::GetMeshCount() const
+	{
+		uint32_t count = 0;
+		for (const auto& node : m_Nodes)
+		{
+			for (const auto& part : node.m_Parts)
+			{
+				count += part.m_NumTriangles > 0 ? 1 : 0;
+			}
+		}
+		return count;
+	}
+
+	uint64_t StaticBatch::GetTriangleCount(uint32_t a_Level) const
+	{
+		uint64_t count = 0;
+		for (const auto& node : m_Nodes)
+		{
+			if (node.m_Level != a_Level)
+			{
+				continue;
+			}
+
+			for (const auto& part : node.m_Parts)
+			{
+				count += part.m_NumTriangles;
+			}
+		}
+		return count;
+	}
+
+	uint32_t StaticBatch::GetNodeCount(uint32_t a_Level) const
+	{
+		uint32_t count = 0;
+		for (const auto& node : m_Nodes)
+		{
+			count += node.m_Level == a_Level ? 1 : 0;
+		}
+		return count;
+	}
+
+	uint64_t StaticBatch::CellKey(const glm::ivec3& a_Cell)
+	{
+		constexpr uint64_t mask = (1ull << 21) - 1;
+		return ((static_cast<uint64_t>(a_Cell.x) & mask) << 42) | ((static_cast<uint64_t>(a_Cell.y) & mask) << 21) | (static_cast<uint64_t>(a_Cell.z) & mask);
+	}
+
+	glm::ivec3 StaticBatch::ParentCell(const glm::ivec3& a_Cell)
+	{
+		//Integer division rounds towards zero, which would put cells -1 and 0 in the same parent.
+		glm::ivec3 parent;
+		for (int i = 0; i < 3; ++i)
+		{
+			parent[i] = a_Cell[i] >= 0 ? a_Cell[i] / 2 : (a_Cell[i] - 1) / 2;
+		}
+		return parent;
+	}
+
+	StaticBatch::Part& StaticBatch::GetPart(Node& a_Node, uint32_t a_Material)
+	{
+		//Nodes use few materials, so a linear search is faster than a lookup.
+		for (auto& part : a_Node.m_Parts)
+		{
+			if (part.m_Material == a_Material)
+			{
+				return part;
+			}
+		}
+
+		a_Node.m_Parts.emplace_back();
+		a_Node.m_Parts.back().m_Material = a_Material;
+		return a_Node.m_Parts.back();
+	}
+
+	void StaticBatch::Append(const Geometry& a_Source, Geometry& a_Destination)
+	{
+		const auto offset = static_cast<uint32_t>(a_Destination.m_Vertices.size());
+		a_Destination.m_Vertices.insert(a_Destination.m_Vertices.end(), a_Source.m_Vertices.begin(), a_Source.m_Vertices.end());
+		a_Destination.m_Indices.reserve(a_Destination.m_Indices.size() + a_Source.m_Indices.size());
+		for (const uint32_t index : a_Source.m_Indices)
+		{
+			a_Destination.m_Indices.push_back(offset + index);
+		}
+	}
+
+	void StaticBatch::Simplify(std::vector<Vertex>& a_Vertices, std::vector<uint32_t>& a_Indices, const glm::vec3& a_Origin, float a_CellSize)
+	{
+		//Accumulate every vertex into the merged vertex of its grid cell.
+		std::unordered_map<uint64_t, uint32_t> cellLookup;
+		std::vector<uint32_t> remap(a_Vertices.size());
+		std::vector<Vertex> merged;
+		std::vector<uint32_t> counts;
+
+		for (size_t i = 0; i < a_Vertices.size(); ++i)
+		{
+			const auto& vertex = a_Vertices[i];
+			const glm::ivec3 cell = glm::ivec3(glm::floor((vertex.position - a_Origin) / a_CellSize));
+			const auto inserted = cellLookup.emplace(CellKey(cell), static_cast<uint32_t>(merged.size()));
+			if (inserted.second)
+			{
+				//The first vertex in a cell provides the UV and handedness.
+				merged.push_back(vertex);
+				counts.push_back(1);
+			}
+			else
+			{
+				auto& target = merged[inserted.first->second];
+				target.position += vertex.position;
+				target.normal += vertex.normal;
+				target.tangent += glm::vec4(glm::vec3(vertex.tangent), 0.f);
+				++counts[inserted.first->second];
+			}
+			remap[i] = inserted.first->second;
+		}
+
+		for (size_t i = 0; i < merged.size(); ++i)
+		{
+			auto& vertex = merged[i];
+			vertex.position /= static_cast<float>(counts[i]);
+
+			//Opposing normals can cancel out, in which case any direction is as good as another.
+			const float normalLength = glm::length(vertex.normal);
+			vertex.normal = normalLength > 0.f ? vertex.normal / normalLength : glm::vec3(0.f, 1.f, 0.f);
+			const float tangentLength = glm::length(glm::vec3(vertex.tangent));
+			vertex.tangent = glm::vec4(tangentLength > 0.f ? glm::vec3(vertex.tangent) / tangentLength : glm::vec3(1.f, 0.f, 0.f), vertex.tangent.w);
+		}
+
+		//Triangles with two corners in the same cell collapse and are removed.
+		std::vector<uint32_t> indices;
+		indices.reserve(a_Indices.size());
+		for (size_t i = 0; i + 2 < a_Indices.size(); i += 3)
+		{
+			const uint32_t a = remap[a_Indices[i]];
+			const uint32_t b = remap[a_Indices[i + 1]];
+			const uint32_t c = remap[a_Indices[i + 2]];
+			if (a != b && b != c && a != c)
+			{
+				indices.push_back(a);
+				indices.push_back(b);
+				indices.push_back(c);
+			}
+		}
+
+		a_Vertices = std::move(merged);
+		a_Indices = std::move(indices);
+	}
+
+	void StaticBatch::AddNode(EggDrawData& a_DrawData, const glm::vec3& a_CameraPosition, uint32_t a_Node, uint32_t a_CustomId, std::vector<DrawCallHandle>& a_DrawCalls)
+	{
+		const auto& node = m_Nodes[a_Node];
+
+		//Clusters are always drawn with their full geometry. Nodes above them are drawn when they are far enough away.
+		if (node.m_Level > 0)
+		{
+			const glm::vec3 outside = glm::max(glm::max(node.m_Min - a_CameraPosition, a_CameraPosition - node.m_Max), glm::vec3(0.f));
+			const float nodeSize = m_Settings.m_ClusterSize * static_cast<float>(1u << node.m_Level);
+			if (glm::length(outside) <= m_Settings.m_LodDistance * nodeSize)
+			{
+				for (const uint32_t child : node.m_Children)
+				{
+					AddNode(a_DrawData, a_CameraPosition, child, a_CustomId, a_DrawCalls);
+				}
+				return;
+			}
+		}
+
+		//The geometry is in world space, so every part is a single instance without a transform.
+		for (const auto& part : node.m_Parts)
+		{
+			if (part.m_Mesh == nullptr)
+			{
+				continue;
+			}
+
+			if (!m_MaterialAdded[part.m_Material])
+			{
+				m_MaterialHandles[part.m_Material] = a_DrawData.AddMaterial(m_Materials[part.m_Material]);
+				m_MaterialAdded[part.m_Material] = 1;
+			}
+
+			const auto instance = a_DrawData.AddInstance(glm::mat4(1.f), m_MaterialHandles[part.m_Material], a_CustomId);
+			const auto meshHandle = a_DrawData.AddMesh(part.m_Mesh);
+			a_DrawCalls.push_back(a_DrawData.AddDrawCall(meshHandle, &instance, 1));
+		}
+	}
+}
@@ -38,4 +38,9 @@ namespace egg
 	{
 		m_Begin = std::chrono::high_resolution_clock::now();
 	}
+
+	std::uint64_t GetTimestampMicroseconds()
+	{
+		return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
 }
@@ -0,0 +1,266 @@
+#include "api/TraceProfiler.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace egg
+{
+	namespace
+	{
+		/*
+		 * A single finished zone.
+		 */
+		struct TraceEvent
+		{
+			const char* m_Name;
+			uint64_t m_Start;
+			uint64_t m_End;
+			uint32_t m_Depth;
+		};
+
+		/*
+		 * A slot in the ring buffer of a thread.
+		 * Exporting threads read slots while the owning thread may be overwriting them, so every field is atomic.
+		 * m_Sequence is the index of the event in the slot plus one, or WRITING_SEQUENCE while the payload is being written.
+		 * A reader only keeps an event when the sequence matches before and after reading the payload.
+		 */
+		struct TraceSlot
+		{
+			static constexpr uint64_t WRITING_SEQUENCE = ~uint64_t{ 0 };
+
+			std::atomic<uint64_t> m_Sequence{ 0 };
+			std::atomic<const char*> m_Name{ nullptr };
+			std::atomic<uint64_t> m_Start{ 0 };
+			std::atomic<uint64_t> m_End{ 0 };
+			std::atomic<uint32_t> m_Depth{ 0 };
+		};
+
+		/*
+		 * The ring buffer of a single thread.
+		 * Only the owning thread writes events. The write index is published with release semantics so that exporting threads know which slots to read.
+		 */
+		struct ThreadBuffer
+		{
+			std::array<TraceSlot, TraceProfiler::EVENTS_PER_THREAD> m_Events;
+			std::atomic<uint64_t> m_WriteIndex{ 0 };		//Total amount of events ever written.
+			std::atomic<uint64_t> m_ClearIndex{ 0 };		//Events before this index were cleared.
+			uint32_t m_ThreadId = 0;
+			std::string m_Name;								//Guarded by the registry mutex.
+		};
+
+		/*
+		 * All thread buffers that were ever created.
+		 * Buffers outlive their threads so that their events can still be exported.
+		 */
+		struct Registry
+		{
+			std::mutex m_Mutex;
+			std::vector<std::shared_ptr<ThreadBuffer>> m_Buffers;
+		};
+
+		Registry& GetRegistry()
+		{
+			static Registry registry;
+			return registry;
+		}
+
+		const std::chrono::steady_clock::time_point& GetEpoch()
+		{
+			static const auto epoch = std::chrono::steady_clock::now();
+			return epoch;
+		}
+
+		thread_local uint32_t t_Depth = 0;
+		thread_local ThreadBuffer* t_Buffer = nullptr;
+
+		ThreadBuffer& GetThreadBuffer()
+		{
+			if (t_Buffer == nullptr)
+			{
+				auto buffer = std::make_shared<ThreadBuffer>();
+				auto& registry = GetRegistry();
+				std::lock_guard<std::mutex> lock(registry.m_Mutex);
+				buffer->m_ThreadId = static_cast<uint32_t>(registry.m_Buffers.size());
+				buffer->m_Name = "Thread " + std::to_string(buffer->m_ThreadId);
+				registry.m_Buffers.push_back(buffer);
+				t_Buffer = buffer.get();
+			}
+			return *t_Buffer;
+		}
+
+		void WriteEscaped(std::ostream& a_Stream, const char* a_String)
+		{
+			for (const char* c = a_String; *c != '\0'; ++c)
+			{
+				switch (*c)
+				{
+				case '"':
+					a_Stream << "\\\"";
+					break;
+				case '\\':
+					a_Stream << "\\\\";
+					break;
+				default:
+					if (static_cast<unsigned char>(*c) < 0x20)
+					{
+						char escaped[8];
+						snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(*c));
+						a_Stream << escaped;
+					}
+					else
+					{
+						a_Stream << *c;
+					}
+				}
+			}
+		}
+	}
+
+	void TraceProfiler::SetEnabled(bool a_Enabled)
+	{
+		//Make sure the epoch is set before the first zone is recorded.
+		GetEpoch();
+		s_Enabled.store(a_Enabled, std::memory_order_relaxed);
+	}
+
+	void TraceProfiler::SetThreadName(const std::string& a_Name)
+	{
+		auto& buffer = GetThreadBuffer();
+		std::lock_guard<std::mutex> lock(GetRegistry().m_Mutex);
+		buffer.m_Name = a_Name;
+	}
+
+	uint64_t TraceProfiler::Now()
+	{
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - GetEpoch()).count());
+	}
+
+	uint32_t TraceProfiler::PushDepth()
+	{
+		return t_Depth++;
+	}
+
+	void TraceProfiler::PopDepth()
+	{
+		--t_Depth;
+	}
+
+	void TraceProfiler::Record(const char* a_Name, uint64_t a_Start, uint64_t a_End, uint32_t a_Depth)
+	{
+		auto& buffer = GetThreadBuffer();
+		const uint64_t index = buffer.m_WriteIndex.load(std::memory_order_relaxed);
+		auto& slot = buffer.m_Events[index % EVENTS_PER_THREAD];
+
+		//Mark the slot as being written before any of the payload changes.
+		slot.m_Sequence.store(TraceSlot::WRITING_SEQUENCE, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		slot.m_Name.store(a_Name, std::memory_order_relaxed);
+		slot.m_Start.store(a_Start, std::memory_order_relaxed);
+		slot.m_End.store(a_End, std::memory_order_relaxed);
+		slot.m_Depth.store(a_Depth, std::memory_order_relaxed);
+		slot.m_Sequence.store(index + 1, std::memory_order_release);
+
+		buffer.m_WriteIndex.store(index + 1, std::memory_order_release);
+	}
+
+	bool TraceProfiler::ExportChromeTrace(const std::string& a_FilePath)
+	{
+		std::ofstream file(a_FilePath, std::ios::out | std::ios::trunc);
+		if (!file.is_open())
+		{
+			printf("Could not open file for writing CPU trace: %s\n", a_FilePath.c_str());
+			return false;
+		}
+
+		std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+		std::vector<std::string> names;
+		{
+			auto& registry = GetRegistry();
+			std::lock_guard<std::mutex> lock(registry.m_Mutex);
+			buffers = registry.m_Buffers;
+			for (auto& buffer : buffers)
+			{
+				names.push_back(buffer->m_Name);
+			}
+		}
+
+		//Timestamps are written in microseconds with nanosecond precision.
+		file << std::fixed << std::setprecision(3);
+		file << "{\"traceEvents\":[";
+		bool first = true;
+		std::vector<TraceEvent> events;
+
+		for (size_t bufferIndex = 0; bufferIndex < buffers.size(); ++bufferIndex)
+		{
+			const auto& buffer = *buffers[bufferIndex];
+
+			file << (first ? "\n" : ",\n");
+			first = false;
+			file << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":0,\"tid\":" << buffer.m_ThreadId << ",\"args\":{\"name\":\"";
+			WriteEscaped(file, names[bufferIndex].c_str());
+			file << "\"}}";
+
+			/*
+			 * Copy the events that have not been overwritten yet.
+			 * The owning thread may still be recording, so a slot is only kept when it held the expected event both before and after its payload was read.
+			 */
+			const uint64_t end = buffer.m_WriteIndex.load(std::memory_order_acquire);
+			const uint64_t begin = std::max(buffer.m_ClearIndex.load(std::memory_order_relaxed), end > EVENTS_PER_THREAD ? end - EVENTS_PER_THREAD : uint64_t{ 0 });
+
+			events.clear();
+			for (uint64_t i = begin; i < end; ++i)
+			{
+				const auto& slot = buffer.m_Events[i % EVENTS_PER_THREAD];
+				if (slot.m_Sequence.load(std::memory_order_acquire) != i + 1)
+				{
+					continue;
+				}
+
+				const TraceEvent event{ slot.m_Name.load(std::memory_order_relaxed), slot.m_Start.load(std::memory_order_relaxed),
+					slot.m_End.load(std::memory_order_relaxed), slot.m_Depth.load(std::memory_order_relaxed) };
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if (slot.m_Sequence.load(std::memory_order_relaxed) == i + 1)
+				{
+					events.push_back(event);
+				}
+			}
+
+			for (const auto& event : events)
+			{
+				file << ",\n{\"ph\":\"X\",\"name\":\"";
+				WriteEscaped(file, event.m_Name);
+				file << "\",\"cat\":\"cpu\",\"pid\":0,\"tid\":" << buffer.m_ThreadId
+					<< ",\"ts\":" << static_cast<double>(event.m_Start) / 1000.0
+					<< ",\"dur\":" << static_cast<double>(event.m_End - event.m_Start) / 1000.0
+					<< ",\"args\":{\"depth\":" << event.m_Depth << "}}";
+			}
+		}
+
+		file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+		file.close();
+
+		if (file.fail())
+		{
+			printf("Could not write CPU trace: %s\n", a_FilePath.c_str());
+			return false;
+		}
+		return true;
+	}
+
+	void TraceProfiler::Clear()
+	{
+		auto& registry = GetRegistry();
+		std::lock_guard<std::mutex> lock(registry.m_Mutex);
+		for (auto& buffer : registry.m_Buffers)
+		{
+			buffer->m_ClearIndex.store(buffer->m_WriteIndex.load(std::memory_order_acquire), std::memory_order_relaxed);
+		}
+	}
+}
@@ -0,0 +1,400 @@
+#include "api/TransformHierarchy.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+
+#include "ThreadPool.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define EGG_TRANSFORM_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace egg
+{
+	namespace
+	{
+		/*
+		 * Calculate a_Left * a_Right. a_Result may not alias a_Left.
+		 * Every column of the result is a sum of the columns of a_Left, scaled by the elements of the matching column of a_Right.
+		 */
+		inline void MultiplyMatrices(const glm::mat4& a_Left, const glm::mat4& a_Right, glm::mat4& a_Result)
+		{
+#ifdef EGG_TRANSFORM_SSE
+			const __m128 left0 = _mm_loadu_ps(&a_Left[0][0]);
+			const __m128 left1 = _mm_loadu_ps(&a_Left[1][0]);
+			const __m128 left2 = _mm_loadu_ps(&a_Left[2][0]);
+			const __m128 left3 = _mm_loadu_ps(&a_Left[3][0]);
+
+			for (int column = 0; column < 4; ++column)
+			{
+				const float* right = &a_Right[column][0];
+				__m128 result = _mm_mul_ps(left0, _mm_set1_ps(right[0]));
+				result = _mm_add_ps(result, _mm_mul_ps(left1, _mm_set1_ps(right[1])));
+				result = _mm_add_ps(result, _mm_mul_ps(left2, _mm_set1_ps(right[2])));
+				result = _mm_add_ps(result, _mm_mul_ps(left3, _mm_set1_ps(right[3])));
+				_mm_storeu_ps(&a_Result[column][0], result);
+			}
+#else
+			a_Result = a_Left * a_Right;
+#endif
+		}
+
+		/*
+		 * Build a matrix that scales, then rotates, then translates.
+		 */
+		inline glm::mat4 ComposeMatrix(const glm::vec3& a_Translation, const glm::quat& a_Rotation, const glm::vec3& a_Scale)
+		{
+			glm::mat4 matrix = glm::mat4_cast(a_Rotation);
+			matrix[0] *= a_Scale.x;
+			matrix[1] *= a_Scale.y;
+			matrix[2] *= a_Scale.z;
+			matrix[3] = glm::vec4(a_Translation, 1.f);
+			return matrix;
+		}
+
+		/*
+		 * Reorder a_Data so that element i becomes the element at a_Order[i].
+		 */
+		template<typename T>
+		void Reorder(std::vector<T>& a_Data, const std::vector<uint32_t>& a_Order)
+		{
+			std::vector<T> reordered;
+			reordered.reserve(a_Order.size());
+			for (const uint32_t index : a_Order)
+			{
+				reordered.push_back(a_Data[index]);
+			}
+			a_Data.swap(reordered);
+		}
+	}
+
+	TransformHierarchy::TransformHierarchy(uint32_t a_NumThreads) : m_LevelsChanged(false), m_NumTransforms(0)
+	{
+		if (a_NumThreads > 0)
+		{
+			m_ThreadPool = std::make_unique<ThreadPool>(a_NumThreads);
+		}
+	}
+
+	TransformHierarchy::~TransformHierarchy() = default;
+
+	TransformHandle TransformHierarchy::Create(TransformHandle a_Parent)
+	{
+		assert((a_Parent == NO_PARENT_TRANSFORM || GetIndex(a_Parent) != INVALID_INDEX) && "Parent transform does not exist!");
+
+		uint32_t handle;
+		if (!m_FreeHandles.empty())
+		{
+			handle = m_FreeHandles.back();
+			m_FreeHandles.pop_back();
+		}
+		else
+		{
+			handle = static_cast<uint32_t>(m_HandleIndices.size());
+			m_HandleIndices.push_back(INVALID_INDEX);
+			m_ParentHandles.push_back(INVALID_INDEX);
+		}
+
+		//Appended at the end until the next update sorts it into its level.
+		m_HandleIndices[handle] = static_cast<uint32_t>(m_Handles.size());
+		m_ParentHandles[handle] = static_cast<uint32_t>(a_Parent);
+		m_Handles.push_back(handle);
+		m_Parents.push_back(INVALID_INDEX);
+		m_Translations.emplace_back(0.f);
+		m_Rotations.emplace_back(1.f, 0.f, 0.f, 0.f);	//Identity, w first.
+		m_Scales.emplace_back(1.f);
+		m_WorldTransforms.emplace_back(1.f);
+		m_Dirty.push_back(1);
+
+		m_LevelsChanged = true;
+		++m_NumTransforms;
+		return static_cast<TransformHandle>(handle);
+	}
+
+	void TransformHierarchy::Remove(TransformHandle a_Handle)
+	{
+		const uint32_t index = GetIndex(a_Handle);
+		const uint32_t handle = static_cast<uint32_t>(a_Handle);
+
+		//Attach the children to the parent of the removed transform.
+		for (uint32_t child = 0; child < static_cast<uint32_t>(m_ParentHandles.size()); ++child)
+		{
+			if (m_ParentHandles[child] == handle)
+			{
+				m_ParentHandles[child] = m_ParentHandles[handle];
+				m_Dirty[m_HandleIndices[child]] = 1;
+			}
+		}
+
+		//The slot is dropped when the levels are rebuilt.
+		m_Handles[index] = INVALID_INDEX;
+		m_HandleIndices[handle] = INVALID_INDEX;
+		m_ParentHandles[handle] = INVALID_INDEX;
+		m_FreeHandles.push_back(handle);
+
+		m_LevelsChanged = true;
+		--m_NumTransforms;
+	}
+
+	bool TransformHierarchy::SetParent(TransformHandle a_Handle, TransformHandle a_Parent)
+	{
+		const uint32_t index = GetIndex(a_Handle);
+		const uint32_t handle = static_cast<uint32_t>(a_Handle);
+
+		//Walk up from the new parent to make sure that no cycle is created.
+		for (uint32_t ancestor = static_cast<uint32_t>(a_Parent); ancestor != INVALID_INDEX; ancestor = m_ParentHandles[ancestor])
+		{
+			assert(m_HandleIndices[ancestor] != INVALID_INDEX && "Parent transform does not exist!");
+			if (ancestor == handle)
+			{
+				printf("Cannot attach a transform to itself or one of its descendants!\n");
+				return false;
+			}
+		}
+
+		m_ParentHandles[handle] = static_cast<uint32_t>(a_Parent);
+		m_Dirty[index] = 1;
+		m_LevelsChanged = true;
+		return true;
+	}
+
+	TransformHandle TransformHierarchy::GetParent(TransformHandle a_Handle) const
+	{
+		GetIndex(a_Handle);
+		return static_cast<TransformHandle>(m_ParentHandles[static_cast<uint32_t>(a_Handle)]);
+	}
+
+	void TransformHierarchy::SetLocal(TransformHandle a_Handle, const glm::vec3& a_Translation, const glm::quat& a_Rotation, const glm::vec3& a_Scale)
+	{
+		const uint32_t index = GetIndex(a_Handle);
+		m_Translations[index] = a_Translation;
+		m_Rotations[index] = a_Rotation;
+		m_Scales[index] = a_Scale;
+		m_Dirty[index] = 1;
+	}
+
+	void TransformHierarchy::SetLocalTranslation(TransformHandle a_Handle, const glm::vec3& a_Translation)
+	{
+		const uint32_t index = GetIndex(a_Handle);
+		m_Translations[index] = a_Translation;
+		m_Dirty[index] = 1;
+	}
+
+	void TransformHierarchy::SetLocalRotation(TransformHandle a_Handle, const glm::quat& a_Rotation)
+	{
+		const uint32_t index = GetIndex(a_Handle);
+		m_Rotations[index] = a_Rotation;
+		m_Dirty[index] = 1;
+	}
+
+	void TransformHierarchy::SetLocalScale(TransformHandle a_Handle, const glm::vec3& a_Scale)
+	{
+		const uint32_t index = GetIndex(a_Handle);
+		m_Scales[index] = a_Scale;
+		m_Dirty[index] = 1;
+	}
+
+	glm::vec3 TransformHierarchy::GetLocalTranslation(TransformHandle a_Handle) const
+	{
+		return m_Translations[GetIndex(a_Handle)];
+	}
+
+	glm::quat TransformHierarchy::GetLocalRotation(TransformHandle a_Handle) const
+	{
+		return m_Rotations[GetIndex(a_Handle)];
+	}
+
+	glm::vec3 TransformHierarchy::GetLocalScale(TransformHandle a_Handle) const
+	{
+		return m_Scales[GetIndex(a_Handle)];
+	}
+
+	const glm::mat4& TransformHierarchy::GetWorldTransform(TransformHandle a_Handle) const
+	{
+		return m_WorldTransforms[GetIndex(a_Handle)];
+	}
+
+	uint32_t TransformHierarchy::Update()
+	{
+		if (m_LevelsChanged)
+		{
+			RebuildLevels();
+		}
+
+		//Parents are always in an earlier level, so each level only depends on the ones before it.
+		uint32_t numUpdated = 0;
+		for (size_t level = 0; level + 1 < m_LevelOffsets.size(); ++level)
+		{
+			const uint32_t begin = m_LevelOffsets[level];
+			const uint32_t end = m_LevelOffsets[level + 1];
+			const uint32_t count = end - begin;
+
+			if (m_ThreadPool == nullptr || count < MIN_NODES_PER_TASK * 2)
+			{
+				numUpdated += UpdateRange(begin, end);
+				continue;
+			}
+
+			//Split the level into tasks, and let the calling thread take the first one.
+			const uint32_t numTasks = std::min(count / MIN_NODES_PER_TASK, static_cast<uint32_t>(m_ThreadPool->numThreads()) + 1);
+			const uint32_t taskSize = (count + numTasks - 1) / numTasks;
+
+			std::atomic<uint32_t> levelUpdated(0);
+			uint32_t numRemaining = numTasks - 1;
+			std::mutex mutex;
+			std::condition_variable finished;
+
+			for (uint32_t task = 1; task < numTasks; ++task)
+			{
+				const uint32_t taskBegin = begin + task * taskSize;
+				const uint32_t taskEnd = std::min(end, taskBegin + taskSize);
+				m_ThreadPool->enqueue([this, taskBegin, taskEnd, &levelUpdated, &numRemaining, &mutex, &finished]()
+				{
+					levelUpdated += UpdateRange(taskBegin, taskEnd);
+
+					std::lock_guard<std::mutex> lock(mutex);
+					if (--numRemaining == 0)
+					{
+						finished.notify_one();
+					}
+				});
+			}
+
+			levelUpdated += UpdateRange(begin, std::min(end, begin + taskSize));
+
+			std::unique_lock<std::mutex> lock(mutex);
+			finished.wait(lock, [&numRemaining]() { return numRemaining == 0; });
+			numUpdated += levelUpdated;
+		}
+
+		std::fill(m_Dirty.begin(), m_Dirty.end(), static_cast<uint8_t>(0));
+		return numUpdated;
+	}
+
+	uint32_t TransformHierarchy::GetCount() const
+	{
+		return m_NumTransforms;
+	}
+
+	uint32_t TransformHierarchy::GetLevelCount() const
+	{
+		return m_LevelOffsets.empty() ? 0 : static_cast<uint32_t>(m_LevelOffsets.size() - 1);
+	}
+
+	void TransformHierarchy::RebuildLevels()
+	{
+		//Calculate the depth of every transform. Chains of parents are walked once, and every depth is remembered.
+		std::vector<uint32_t> depths(m_HandleIndices.size(), INVALID_INDEX);
+		std::vector<uint32_t> chain;
+		uint32_t maxDepth = 0;
+		for (uint32_t handle = 0; handle < static_cast<uint32_t>(m_HandleIndices.size()); ++handle)
+		{
+			if (m_HandleIndices[handle] == INVALID_INDEX)
+			{
+				continue;
+			}
+
+			uint32_t current = handle;
+			while (current != INVALID_INDEX && depths[current] == INVALID_INDEX)
+			{
+				chain.push_back(current);
+				current = m_ParentHandles[current];
+			}
+
+			uint32_t depth = current == INVALID_INDEX ? 0 : depths[current] + 1;
+			while (!chain.empty())
+			{
+				depths[chain.back()] = depth++;
+				chain.pop_back();
+			}
+			maxDepth = std::max(maxDepth, depth - 1);
+		}
+
+		//Counting sort by depth. Transforms keep their relative order within a level.
+		m_LevelOffsets.assign(m_NumTransforms == 0 ? 0 : maxDepth + 2, 0);
+		for (const uint32_t handle : m_Handles)
+		{
+			if (handle != INVALID_INDEX)
+			{
+				++m_LevelOffsets[depths[handle] + 1];
+			}
+		}
+		for (size_t level = 1; level < m_LevelOffsets.size(); ++level)
+		{
+			m_LevelOffsets[level] += m_LevelOffsets[level - 1];
+		}
+
+		std::vector<uint32_t> order(m_NumTransforms);
+		std::vector<uint32_t> cursors(m_LevelOffsets.begin(), m_LevelOffsets.end());
+		for (uint32_t index = 0; index < static_cast<uint32_t>(m_Handles.size()); ++index)
+		{
+			const uint32_t handle = m_Handles[index];
+			if (handle != INVALID_INDEX)
+			{
+				order[cursors[depths[handle]]++] = index;
+			}
+		}
+
+		Reorder(m_Handles, order);
+		Reorder(m_Translations, order);
+		Reorder(m_Rotations, order);
+		Reorder(m_Scales, order);
+		Reorder(m_WorldTransforms, order);
+		Reorder(m_Dirty, order);
+
+		for (uint32_t index = 0; index < m_NumTransforms; ++index)
+		{
+			m_HandleIndices[m_Handles[index]] = index;
+		}
+
+		m_Parents.resize(m_NumTransforms);
+		for (uint32_t index = 0; index < m_NumTransforms; ++index)
+		{
+			const uint32_t parentHandle = m_ParentHandles[m_Handles[index]];
+			m_Parents[index] = parentHandle == INVALID_INDEX ? INVALID_INDEX : m_HandleIndices[parentHandle];
+		}
+
+		m_LevelsChanged = false;
+	}
+
+	uint32_t TransformHierarchy::UpdateRange(uint32_t a_Begin, uint32_t a_End)
+	{
+		uint32_t numUpdated = 0;
+		for (uint32_t index = a_Begin; index < a_End; ++index)
+		{
+			const uint32_t parent = m_Parents[index];
+			const bool parentChanged = parent != INVALID_INDEX && m_Dirty[parent] != 0;
+			if (m_Dirty[index] == 0 && !parentChanged)
+			{
+				continue;
+			}
+
+			const glm::mat4 local = ComposeMatrix(m_Translations[index], m_Rotations[index], m_Scales[index]);
+			if (parent == INVALID_INDEX)
+			{
+				m_WorldTransforms[index] = local;
+			}
+			else
+			{
+				MultiplyMatrices(m_WorldTransforms[parent], local, m_WorldTransforms[index]);
+			}
+
+			//Children in the next level check this flag.
+			m_Dirty[index] = 1;
+			++numUpdated;
+		}
+		return numUpdated;
+	}
+
+	uint32_t TransformHierarchy::GetIndex(TransformHandle a_Handle) const
+	{
+		const uint32_t handle = static_cast<uint32_t>(a_Handle);
+		assert(handle < m_HandleIndices.size() && m_HandleIndices[handle] != INVALID_INDEX && "Transform does not exist!");
+		return m_HandleIndices[handle];
+	}
+}
@@ -0,0 +1,56 @@
+#include "VertexAnimationStorage.h"
+
+namespace egg
+{
+	VertexAnimationStorage::VertexAnimationStorage() : m_Initialized(false)
+	{
+	}
+
+	bool VertexAnimationStorage::Init(size_t a_SizeInBytes, VkDevice& a_Device, VmaAllocator& a_Allocator)
+	{
+		//Frames are copied in from a staging buffer and read as a storage buffer.
+		const GpuBufferSettings settings{ a_SizeInBytes, ALIGNMENT, VMA_MEMORY_USAGE_GPU_ONLY,
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, MemoryCategory::MESH_GEOMETRY };
+		if (!m_Buffer.Init(settings, a_Device, a_Allocator))
+		{
+			return false;
+		}
+
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Ranges.Reset(a_SizeInBytes, ALIGNMENT);
+		m_Initialized = true;
+		return true;
+	}
+
+	void VertexAnimationStorage::CleanUp()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Ranges.Reset(0, ALIGNMENT);
+		m_Initialized = false;
+		m_Buffer.CleanUp();
+	}
+
+	bool VertexAnimationStorage::Allocate(size_t a_Size, size_t& a_Offset)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		return m_Ranges.Allocate(a_Size, a_Offset);
+	}
+
+	void VertexAnimationStorage::Free(size_t a_Offset, size_t a_Size)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		//Animations may outlive the renderer, and the buffer that held them.
+		if (!m_Initialized)
+		{
+			return;
+		}
+
+		m_Ranges.Free(a_Offset, a_Size);
+	}
+
+	const GpuBuffer& VertexAnimationStorage::GetBuffer() const
+	{
+		return m_Buffer;
+	}
+}
@@ -0,0 +1,170 @@
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "DrawData.h"
+#include "DrawDataCapture.h"
+#include "api/EggRenderer.h"
+
+/*
+ * Replays a draw data capture frame by frame, so that a captured workload can be profiled without the application that produced it.
+ * The capture is memory-mapped. Only the meshes are uploaded up front; every frame is read straight from the mapping into draw data.
+ *
+ * Usage: EggReplay <capture file> [--loops=N] [--window] [--gpu=N] [--shaders=path] [--csv=path]
+ * Captures are written by EggRenderer::StartDrawDataCapture().
+ */
+
+struct ReplaySettings
+{
+    std::string m_CapturePath;
+    uint32_t m_NumLoops = 1;            //How many times all frames are replayed.
+    bool m_Headless = true;
+    uint32_t m_GpuIndex = 0;
+    std::string m_ShadersPath = std::filesystem::current_path().parent_path().string() + "/Build/shaders/";
+    std::string m_CsvPath;              //When set, the statistics of every frame are streamed to this file.
+};
+
+bool ParseArguments(int a_Argc, char** a_Argv, ReplaySettings& a_Settings)
+{
+    for (int i = 1; i < a_Argc; ++i)
+    {
+        const std::string argument = a_Argv[i];
+        if (argument.rfind("--", 0) != 0)
+        {
+            if (!a_Settings.m_CapturePath.empty())
+            {
+                return false;
+            }
+            a_Settings.m_CapturePath = argument;
+            continue;
+        }
+
+        if (argument == "--window")
+        {
+            a_Settings.m_Headless = false;
+            continue;
+        }
+
+        const auto separator = argument.find('=');
+        if (separator == std::string::npos)
+        {
+            return false;
+        }
+
+        const auto key = argument.substr(2, separator - 2);
+        const auto value = argument.substr(separator + 1);
+        if (key == "loops") a_Settings.m_NumLoops = static_cast<uint32_t>(std::stoul(value));
+        else if (key == "gpu") a_Settings.m_GpuIndex = static_cast<uint32_t>(std::stoul(value));
+        else if (key == "shaders") a_Settings.m_ShadersPath = value;
+        else if (key == "csv") a_Settings.m_CsvPath = value;
+        else return false;
+    }
+    return !a_Settings.m_CapturePath.empty();
+}
+
+void PrintPercentiles(const char* a_Name, const egg::StatisticPercentiles& a_Percentiles)
+{
+    printf("%-24s %10.3f %10.3f %10.3f %10.3f %10.3f %10.3f\n", a_Name, a_Percentiles.m_Min, a_Percentiles.m_Average,
+        a_Percentiles.m_P50, a_Percentiles.m_P95, a_Percentiles.m_P99, a_Percentiles.m_Max);
+}
+
+int main(int a_Argc, char** a_Argv)
+{
+    using namespace egg;
+
+    ReplaySettings replaySettings;
+    if (!ParseArguments(a_Argc, a_Argv, replaySettings))
+    {
+        printf("Usage: EggReplay <capture file> [--loops=N] [--window] [--gpu=N] [--shaders=path] [--csv=path]\n");
+        return 1;
+    }
+
+    DrawDataCaptureReader capture;
+    if (!capture.Open(replaySettings.m_CapturePath))
+    {
+        return 1;
+    }
+
+    if (capture.GetFrameCount() == 0)
+    {
+        printf("Capture %s contains no frames.\n", replaySettings.m_CapturePath.c_str());
+        return 1;
+    }
+
+    //Replay at the resolution the capture started at.
+    const auto resolution = capture.GetResolution(0);
+
+    RendererSettings settings;
+    settings.windowName = "Egg Replay";
+    settings.enableDebugMode = false;
+    settings.headless = replaySettings.m_Headless;
+    settings.gpuIndex = replaySettings.m_GpuIndex;
+    settings.resolutionX = resolution.x;
+    settings.resolutionY = resolution.y;
+    settings.vSync = false;
+    settings.m_SwapBufferCount = 3;
+    settings.shadersPath = replaySettings.m_ShadersPath;
+    settings.enableCpuTracing = false;
+    settings.statisticsHistorySize = capture.GetFrameCount() * replaySettings.m_NumLoops;
+
+    auto renderer = EggRenderer::CreateInstance(settings);
+    if (!renderer->Init(settings))
+    {
+        printf("Could not initialize renderer!\n");
+        return 1;
+    }
+
+    //The create infos point into the mapped file, so the geometry is uploaded without copying it first.
+    std::vector<StaticMeshCreateInfo> meshInfos;
+    meshInfos.reserve(capture.GetMeshCount());
+    for (uint32_t i = 0; i < capture.GetMeshCount(); ++i)
+    {
+        meshInfos.push_back(capture.GetMesh(i));
+    }
+    const auto meshes = renderer->CreateMeshes(meshInfos);
+
+    printf("Replaying %s: %u frames, %u meshes, %ux%u, %u loop(s).\n", replaySettings.m_CapturePath.c_str(),
+        capture.GetFrameCount(), capture.GetMeshCount(), resolution.x, resolution.y, replaySettings.m_NumLoops);
+
+    if (!replaySettings.m_CsvPath.empty())
+    {
+        renderer->StartStatisticsStream(replaySettings.m_CsvPath, StatisticsStreamFormat::CSV);
+    }
+
+    bool run = true;
+    for (uint32_t loop = 0; loop < replaySettings.m_NumLoops && run; ++loop)
+    {
+        for (uint32_t frame = 0; frame < capture.GetFrameCount() && run; ++frame)
+        {
+            auto drawData = renderer->CreateDrawData();
+            if (!capture.ReadFrame(frame, static_cast<DrawData&>(*drawData), meshes))
+            {
+                run = false;
+                break;
+            }
+
+            if (!renderer->DrawFrame(drawData))
+            {
+                printf("Drawing frame %u failed!\n", frame);
+                run = false;
+            }
+        }
+    }
+
+    renderer->StopStatisticsStream();
+
+    const auto summary = renderer->GetFrameStatisticsSummary();
+    printf("\n%u frames measured. All times in milliseconds.\n", summary.m_NumFrames);
+    printf("%-24s %10s %10s %10s %10s %10s %10s\n", "", "min", "avg", "p50", "p95", "p99", "max");
+    PrintPercentiles("DrawFrame (CPU)", summary.m_CpuFrameMilliseconds);
+    PrintPercentiles("  Fence wait", summary.m_FenceWaitMilliseconds);
+    PrintPercentiles("  Upload", summary.m_UploadMilliseconds);
+    PrintPercentiles("  Record", summary.m_RecordMilliseconds);
+    PrintPercentiles("  Submit and present", summary.m_SubmitMilliseconds);
+    PrintPercentiles("GPU", summary.m_GpuMilliseconds);
+
+    renderer->CleanUp();
+    return run ? 0 : 1;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm/glm/glm.hpp>
+
+#include "Resources.h"
+
+/*
+ * Test geometry shared by the benchmark and the tests.
+ * Create a flat grid of a_Subdivisions by a_Subdivisions quads on the XZ plane, one unit wide and centered on the origin.
+ */
+inline void CreateGridMesh(uint32_t a_Subdivisions, std::vector<egg::Vertex>& a_Vertices, std::vector<uint32_t>& a_Indices)
+{
+	const uint32_t rowSize = a_Subdivisions + 1;
+	for (uint32_t z = 0; z < rowSize; ++z)
+	{
+		for (uint32_t x = 0; x < rowSize; ++x)
+		{
+			const glm::vec2 uv(static_cast<float>(x) / a_Subdivisions, static_cast<float>(z) / a_Subdivisions);
+			a_Vertices.push_back({ glm::vec3(uv.x - 0.5f, 0.f, uv.y - 0.5f), glm::vec3(0.f, 1.f, 0.f), glm::vec4(1.f, 0.f, 0.f, 1.f), uv });
+		}
+	}
+
+	for (uint32_t z = 0; z < a_Subdivisions; ++z)
+	{
+		for (uint32_t x = 0; x < a_Subdivisions; ++x)
+		{
+			const uint32_t corner = z * rowSize + x;
+			a_Indices.insert(a_Indices.end(), { corner, corner + rowSize, corner + 1, corner + 1, corner + rowSize, corner + rowSize + 1 });
+		}
+	}
+}
@@ -0,0 +1,452 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <glm/glm/glm.hpp>
+
+#include "EggRenderer.h"
+#include "Timer.h"
+#include "Transform.h"
+
+/*
+ * Renders a generated scene for a fixed amount of frames without a window, and reports how long every part of a frame took.
+ * Used to check how the renderer scales with scene size before and after changes.
+ *
+ * Usage: EggStressTest [--key=value ...] [--config=file]
+ * A config file contains one key=value pair per line. Lines starting with # are ignored.
+ * Arguments are applied in order, so arguments after --config override the file.
+ */
+
+/*
+ * Everything that defines a stress scene and how it is rendered.
+ */
+struct StressSettings
+{
+    uint32_t m_NumInstances = 10000;
+    uint32_t m_NumUniqueMeshes = 8;
+    uint32_t m_NumMaterials = 16;
+    uint32_t m_NumLights = 500;
+    uint32_t m_NumShadowedLights = 0;       //The first lights cast shadows from all draw calls.
+    float m_DynamicFraction = 0.1f;         //Fraction of instances that move every frame.
+
+    uint32_t m_NumFrames = 1000;
+    uint32_t m_NumWarmupFrames = 100;       //Drawn before measuring, so that buffers have grown to their final size.
+    uint32_t m_ResolutionX = 1280;
+    uint32_t m_ResolutionY = 720;
+    uint32_t m_GpuIndex = 0;
+    bool m_Headless = true;
+    uint32_t m_Seed = 1;
+
+    std::string m_ShadersPath = std::filesystem::current_path().parent_path().string() + "/Build/shaders/";
+    std::string m_CsvPath;                  //When set, the statistics of every frame are streamed to this file.
+    std::string m_JsonPath;                 //When set, the summary is written to this file.
+};
+
+bool ParseSetting(StressSettings& a_Settings, const std::string& a_Key, const std::string& a_Value);
+
+/*
+ * Read key=value pairs from a config file.
+ */
+bool ParseConfigFile(StressSettings& a_Settings, const std::string& a_FilePath)
+{
+    std::ifstream file(a_FilePath);
+    if (!file.is_open())
+    {
+        printf("Could not open config file: %s\n", a_FilePath.c_str());
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(file, line))
+    {
+        //Strip spaces and line endings.
+        line.erase(std::remove_if(line.begin(), line.end(), [](char a_Char) { return a_Char == ' ' || a_Char == '\t' || a_Char == '\r'; }), line.end());
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+
+        const auto separator = line.find('=');
+        if (separator == std::string::npos || !ParseSetting(a_Settings, line.substr(0, separator), line.substr(separator + 1)))
+        {
+            printf("Invalid line in config file: %s\n", line.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ParseSetting(StressSettings& a_Settings, const std::string& a_Key, const std::string& a_Value)
+{
+    const auto toUint = [&a_Value]() { return static_cast<uint32_t>(std::strtoul(a_Value.c_str(), nullptr, 10)); };
+
+    if (a_Key == "instances") a_Settings.m_NumInstances = toUint();
+    else if (a_Key == "meshes") a_Settings.m_NumUniqueMeshes = std::max(1u, toUint());
+    else if (a_Key == "materials") a_Settings.m_NumMaterials = std::max(1u, toUint());
+    else if (a_Key == "lights") a_Settings.m_NumLights = toUint();
+    else if (a_Key == "shadowed-lights") a_Settings.m_NumShadowedLights = toUint();
+    else if (a_Key == "dynamic-fraction") a_Settings.m_DynamicFraction = std::clamp(std::strtof(a_Value.c_str(), nullptr), 0.f, 1.f);
+    else if (a_Key == "frames") a_Settings.m_NumFrames = std::max(1u, toUint());
+    else if (a_Key == "warmup") a_Settings.m_NumWarmupFrames = toUint();
+    else if (a_Key == "width") a_Settings.m_ResolutionX = std::max(1u, toUint());
+    else if (a_Key == "height") a_Settings.m_ResolutionY = std::max(1u, toUint());
+    else if (a_Key == "gpu") a_Settings.m_GpuIndex = toUint();
+    else if (a_Key == "headless") a_Settings.m_Headless = a_Value != "0" && a_Value != "false";
+    else if (a_Key == "seed") a_Settings.m_Seed = toUint();
+    else if (a_Key == "shaders") a_Settings.m_ShadersPath = a_Value;
+    else if (a_Key == "csv") a_Settings.m_CsvPath = a_Value;
+    else if (a_Key == "json") a_Settings.m_JsonPath = a_Value;
+    else if (a_Key == "config") return ParseConfigFile(a_Settings, a_Value);
+    else return false;
+
+    return true;
+}
+
+/*
+ * A generated scene. Instances are sorted by mesh so that every mesh is drawn with a single draw call.
+ */
+struct StressScene
+{
+    std::vector<std::shared_ptr<egg::EggStaticMesh>> m_Meshes;
+    std::vector<std::shared_ptr<egg::EggMaterial>> m_Materials;
+
+    std::vector<glm::mat4> m_Transforms;
+    std::vector<uint32_t> m_MaterialIndices;
+    std::vector<uint32_t> m_InstanceMeshOffsets;            //Where the instances of each mesh start. One extra entry for the end.
+
+    std::vector<uint32_t> m_DynamicInstances;               //Indices of the instances that move.
+    std::vector<glm::vec3> m_DynamicAxes;
+
+    std::vector<egg::SphereLight> m_Lights;
+    egg::DirectionalLight m_Sun;
+    egg::Camera m_Camera;
+};
+
+bool CreateScene(egg::EggRenderer& a_Renderer, const StressSettings& a_Settings, StressScene& a_Scene)
+{
+    using namespace egg;
+
+    std::mt19937 random(a_Settings.m_Seed);
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+
+    //Alternate spheres of increasing detail with cubes, so that meshes differ in vertex count.
+    std::vector<ShapeCreateInfo> shapes(a_Settings.m_NumUniqueMeshes);
+    for (uint32_t i = 0; i < a_Settings.m_NumUniqueMeshes; ++i)
+    {
+        auto& shape = shapes[i];
+        shape.m_Radius = 0.5f;
+        if (i % 4 == 3)
+        {
+            shape.m_ShapeType = Shape::CUBE;
+        }
+        else
+        {
+            shape.m_ShapeType = Shape::SPHERE;
+            shape.m_Sphere.m_SectorCount = 8 + (i % 32) * 2;
+            shape.m_Sphere.m_StackCount = 8 + (i % 32) * 2;
+        }
+
+        auto mesh = a_Renderer.CreateMesh(shape);
+        if (mesh == nullptr)
+        {
+            printf("Could not create stress test mesh!\n");
+            return false;
+        }
+        a_Scene.m_Meshes.push_back(mesh);
+    }
+
+    for (uint32_t i = 0; i < a_Settings.m_NumMaterials; ++i)
+    {
+        MaterialCreateInfo info;
+        info.m_AlbedoFactor = { unit(random), unit(random), unit(random) };
+        info.m_MetallicFactor = unit(random);
+        info.m_RoughnessFactor = unit(random);
+        a_Scene.m_Materials.push_back(a_Renderer.CreateMaterial(info));
+    }
+
+    //Place the instances on a grid that is roughly a cube.
+    const auto gridSize = std::max(1u, static_cast<uint32_t>(std::ceil(std::cbrt(static_cast<double>(a_Settings.m_NumInstances)))));
+    constexpr float spacing = 1.5f;
+    const float halfExtent = static_cast<float>(gridSize) * spacing * 0.5f;
+
+    a_Scene.m_Transforms.reserve(a_Settings.m_NumInstances);
+    a_Scene.m_MaterialIndices.reserve(a_Settings.m_NumInstances);
+    a_Scene.m_InstanceMeshOffsets.push_back(0);
+    for (uint32_t mesh = 0; mesh < a_Settings.m_NumUniqueMeshes; ++mesh)
+    {
+        //Distribute the instances as evenly as possible over the meshes.
+        const uint32_t numInstances = a_Settings.m_NumInstances / a_Settings.m_NumUniqueMeshes + (mesh < a_Settings.m_NumInstances % a_Settings.m_NumUniqueMeshes ? 1 : 0);
+        for (uint32_t i = 0; i < numInstances; ++i)
+        {
+            const auto index = static_cast<uint32_t>(a_Scene.m_Transforms.size());
+            const glm::vec3 position = glm::vec3(index % gridSize, index / gridSize % gridSize, index / (gridSize * gridSize)) * spacing - glm::vec3(halfExtent);
+            a_Scene.m_Transforms.push_back(glm::translate(glm::identity<glm::mat4>(), position));
+            a_Scene.m_MaterialIndices.push_back(static_cast<uint32_t>(random() % a_Settings.m_NumMaterials));
+        }
+        a_Scene.m_InstanceMeshOffsets.push_back(static_cast<uint32_t>(a_Scene.m_Transforms.size()));
+    }
+
+    //Spread the dynamic instances over the whole scene.
+    const auto numDynamic = static_cast<uint32_t>(static_cast<float>(a_Settings.m_NumInstances) * a_Settings.m_DynamicFraction);
+    for (uint32_t i = 0; i < numDynamic; ++i)
+    {
+        a_Scene.m_DynamicInstances.push_back(static_cast<uint32_t>(static_cast<uint64_t>(i) * a_Settings.m_NumInstances / numDynamic));
+        a_Scene.m_DynamicAxes.push_back(glm::normalize(glm::vec3(unit(random), unit(random), unit(random)) + glm::vec3(0.01f)));
+    }
+
+    for (uint32_t i = 0; i < a_Settings.m_NumLights; ++i)
+    {
+        auto& light = a_Scene.m_Lights.emplace_back();
+        light.SetPosition(unit(random) * 2.f * halfExtent - halfExtent, unit(random) * 2.f * halfExtent - halfExtent, unit(random) * 2.f * halfExtent - halfExtent);
+        light.SetRadiance(unit(random) * 5.f, unit(random) * 5.f, unit(random) * 5.f);
+        light.SetRadius(unit(random) * 0.2f + 0.05f);
+    }
+
+    const auto sunDirection = glm::normalize(glm::vec3(-1.f, -1.f, -1.f));
+    a_Scene.m_Sun.SetDirection(sunDirection.x, sunDirection.y, sunDirection.z);
+    a_Scene.m_Sun.SetRadiance(0.3f, 0.3f, 0.3f);
+
+    //Look at the grid from the front, so that most instances are on screen.
+    a_Scene.m_Camera.UpdateProjection(70.f, 0.1f, halfExtent * 10.f + 100.f, static_cast<float>(a_Settings.m_ResolutionX) / static_cast<float>(a_Settings.m_ResolutionY));
+    a_Scene.m_Camera.GetTransform().SetTranslation({ 0.f, halfExtent * 0.5f, halfExtent * 2.5f + 2.f });
+
+    return true;
+}
+
+/*
+ * Move the dynamic instances and build the draw data for a single frame.
+ */
+std::unique_ptr<egg::EggDrawData> BuildFrame(egg::EggRenderer& a_Renderer, const StressSettings& a_Settings, StressScene& a_Scene)
+{
+    using namespace egg;
+
+    for (size_t i = 0; i < a_Scene.m_DynamicInstances.size(); ++i)
+    {
+        auto& transform = a_Scene.m_Transforms[a_Scene.m_DynamicInstances[i]];
+        transform = glm::rotate(transform, 0.01f, a_Scene.m_DynamicAxes[i]);
+    }
+
+    auto drawData = a_Renderer.CreateDrawData();
+    drawData->SetCamera(a_Scene.m_Camera);
+
+    std::vector<MaterialHandle> materials;
+    materials.reserve(a_Scene.m_Materials.size());
+    for (const auto& material : a_Scene.m_Materials)
+    {
+        materials.push_back(drawData->AddMaterial(material));
+    }
+
+    std::vector<InstanceDataHandle> instances(a_Scene.m_Transforms.size());
+    for (uint32_t i = 0; i < static_cast<uint32_t>(a_Scene.m_Transforms.size()); ++i)
+    {
+        instances[i] = drawData->AddInstance(a_Scene.m_Transforms[i], materials[a_Scene.m_MaterialIndices[i]], i + 1);
+    }
+
+    std::vector<DrawCallHandle> drawCalls;
+    for (size_t mesh = 0; mesh < a_Scene.m_Meshes.size(); ++mesh)
+    {
+        const auto meshHandle = drawData->AddMesh(a_Scene.m_Meshes[mesh]);
+        const auto offset = a_Scene.m_InstanceMeshOffsets[mesh];
+        const auto count = a_Scene.m_InstanceMeshOffsets[mesh + 1] - offset;
+        if (count > 0)
+        {
+            drawCalls.push_back(drawData->AddDrawCall(meshHandle, &instances[offset], count));
+        }
+    }
+
+    if (!drawCalls.empty())
+    {
+        drawData->AddDeferredShadingDrawPass(drawCalls.data(), static_cast<uint32_t>(drawCalls.size()));
+    }
+
+    for (uint32_t i = 0; i < static_cast<uint32_t>(a_Scene.m_Lights.size()); ++i)
+    {
+        if (i < a_Settings.m_NumShadowedLights && !drawCalls.empty())
+        {
+            drawData->AddLightWithShadow(a_Scene.m_Lights[i], drawCalls.data(), static_cast<uint32_t>(drawCalls.size()));
+        }
+        else
+        {
+            drawData->AddLight(a_Scene.m_Lights[i]);
+        }
+    }
+    drawData->AddLight(a_Scene.m_Sun);
+
+    return drawData;
+}
+
+void PrintDistribution(const char* a_Name, const egg::StatisticPercentiles& a_Distribution)
+{
+    printf("%-24s %10.3f %10.3f %10.3f %10.3f %10.3f %10.3f\n", a_Name,
+        a_Distribution.m_Min, a_Distribution.m_Average, a_Distribution.m_P50, a_Distribution.m_P95, a_Distribution.m_P99, a_Distribution.m_Max);
+}
+
+void WriteDistribution(std::ofstream& a_File, const char* a_Name, const egg::StatisticPercentiles& a_Distribution, bool a_Last)
+{
+    a_File << "    \"" << a_Name << "\": {\"samples\": " << a_Distribution.m_NumSamples
+        << ", \"min\": " << a_Distribution.m_Min
+        << ", \"avg\": " << a_Distribution.m_Average
+        << ", \"p50\": " << a_Distribution.m_P50
+        << ", \"p95\": " << a_Distribution.m_P95
+        << ", \"p99\": " << a_Distribution.m_P99
+        << ", \"max\": " << a_Distribution.m_Max << (a_Last ? "}\n" : "},\n");
+}
+
+/*
+ * Program entry point.
+ */
+int main(int a_Argc, char** a_Argv)
+{
+    using namespace egg;
+
+    StressSettings stressSettings;
+    for (int i = 1; i < a_Argc; ++i)
+    {
+        const std::string argument = a_Argv[i];
+        const auto separator = argument.find('=');
+        if (argument.rfind("--", 0) != 0 || separator == std::string::npos || !ParseSetting(stressSettings, argument.substr(2, separator - 2), argument.substr(separator + 1)))
+        {
+            printf("Invalid argument: %s\n", argument.c_str());
+            printf("Keys: instances, meshes, materials, lights, shadowed-lights, dynamic-fraction, frames, warmup, width, height, gpu, headless, seed, shaders, csv, json, config.\n");
+            return 1;
+        }
+    }
+
+    RendererSettings settings;
+    settings.windowName = "Egg Stress Test";
+    settings.enableDebugMode = false;
+    settings.headless = stressSettings.m_Headless;
+    settings.gpuIndex = stressSettings.m_GpuIndex;
+    settings.resolutionX = stressSettings.m_ResolutionX;
+    settings.resolutionY = stressSettings.m_ResolutionY;
+    settings.vSync = false;
+    settings.m_SwapBufferCount = 3;
+    settings.shadersPath = stressSettings.m_ShadersPath;
+    settings.enableCpuTracing = false;
+    settings.statisticsHistorySize = stressSettings.m_NumWarmupFrames + stressSettings.m_NumFrames;
+
+    auto renderer = EggRenderer::CreateInstance(settings);
+    if (!renderer->Init(settings))
+    {
+        printf("Could not initialize renderer!\n");
+        return 1;
+    }
+
+    StressScene scene;
+    if (!CreateScene(*renderer, stressSettings, scene))
+    {
+        renderer->CleanUp();
+        return 1;
+    }
+
+    printf("Stress scene: %u instances, %u meshes, %u materials, %u lights (%u shadowed), %.0f%% dynamic.\n",
+        stressSettings.m_NumInstances, stressSettings.m_NumUniqueMeshes, stressSettings.m_NumMaterials,
+        stressSettings.m_NumLights, std::min(stressSettings.m_NumShadowedLights, stressSettings.m_NumLights), stressSettings.m_DynamicFraction * 100.f);
+
+    if (!stressSettings.m_CsvPath.empty())
+    {
+        renderer->StartStatisticsStream(stressSettings.m_CsvPath, StatisticsStreamFormat::CSV);
+    }
+
+    //Frame building happens outside of the renderer, so it is measured here.
+    std::vector<double> buildMilliseconds;
+    buildMilliseconds.reserve(stressSettings.m_NumFrames);
+
+    const uint32_t totalFrames = stressSettings.m_NumWarmupFrames + stressSettings.m_NumFrames;
+    Timer buildTimer;
+    for (uint32_t frame = 0; frame < totalFrames; ++frame)
+    {
+        buildTimer.Reset();
+        auto drawData = BuildFrame(*renderer, stressSettings, scene);
+        if (frame >= stressSettings.m_NumWarmupFrames)
+        {
+            buildMilliseconds.push_back(buildTimer.Measure(TimeUnit::MILLIS));
+        }
+
+        if (!renderer->DrawFrame(drawData))
+        {
+            printf("Drawing frame %u failed!\n", frame);
+            break;
+        }
+    }
+
+    renderer->StopStatisticsStream();
+
+    //Statistics are published once the GPU has finished a frame, so the last few frames are missing.
+    //The warmup frames are still in the history and are skipped. Every frame draws, so frame indices match the loop.
+    std::vector<double> cpuFrame, upload, record, submit, fenceWait, gpu;
+    for (const auto& statistics : renderer->GetFrameStatisticsHistory())
+    {
+        if (statistics.m_FrameIndex < stressSettings.m_NumWarmupFrames)
+        {
+            continue;
+        }
+
+        cpuFrame.push_back(statistics.m_CpuFrameMilliseconds);
+        upload.push_back(statistics.m_UploadMilliseconds);
+        record.push_back(statistics.m_RecordMilliseconds);
+        submit.push_back(statistics.m_SubmitMilliseconds);
+        fenceWait.push_back(statistics.m_FenceWaitMilliseconds);
+        if (statistics.m_HasGpuTime)
+        {
+            gpu.push_back(statistics.m_GpuMilliseconds);
+        }
+    }
+
+    const auto buildDistribution = egg::CalculatePercentiles(buildMilliseconds);
+    const auto cpuFrameDistribution = egg::CalculatePercentiles(cpuFrame);
+    const auto uploadDistribution = egg::CalculatePercentiles(upload);
+    const auto recordDistribution = egg::CalculatePercentiles(record);
+    const auto submitDistribution = egg::CalculatePercentiles(submit);
+    const auto fenceWaitDistribution = egg::CalculatePercentiles(fenceWait);
+    const auto gpuDistribution = egg::CalculatePercentiles(gpu);
+
+    printf("\n%u frames measured (%zu with GPU time). All times in milliseconds.\n", static_cast<uint32_t>(cpuFrame.size()), gpu.size());
+    printf("%-24s %10s %10s %10s %10s %10s %10s\n", "", "min", "avg", "p50", "p95", "p99", "max");
+    PrintDistribution("Frame build", buildDistribution);
+    PrintDistribution("DrawFrame (CPU)", cpuFrameDistribution);
+    PrintDistribution("  Fence wait", fenceWaitDistribution);
+    PrintDistribution("  Upload", uploadDistribution);
+    PrintDistribution("  Record", recordDistribution);
+    PrintDistribution("  Submit and present", submitDistribution);
+    PrintDistribution("GPU", gpuDistribution);
+
+    if (!stressSettings.m_JsonPath.empty())
+    {
+        std::ofstream file(stressSettings.m_JsonPath, std::ios::out | std::ios::trunc);
+        if (file.is_open())
+        {
+            file << "{\n  \"scene\": {\"instances\": " << stressSettings.m_NumInstances
+                << ", \"meshes\": " << stressSettings.m_NumUniqueMeshes
+                << ", \"materials\": " << stressSettings.m_NumMaterials
+                << ", \"lights\": " << stressSettings.m_NumLights
+                << ", \"shadowed_lights\": " << stressSettings.m_NumShadowedLights
+                << ", \"dynamic_fraction\": " << stressSettings.m_DynamicFraction
+                << ", \"width\": " << stressSettings.m_ResolutionX
+                << ", \"height\": " << stressSettings.m_ResolutionY << "},\n";
+            file << "  \"milliseconds\": {\n";
+            WriteDistribution(file, "frame_build", buildDistribution, false);
+            WriteDistribution(file, "cpu_frame", cpuFrameDistribution, false);
+            WriteDistribution(file, "fence_wait", fenceWaitDistribution, false);
+            WriteDistribution(file, "upload", uploadDistribution, false);
+            WriteDistribution(file, "record", recordDistribution, false);
+            WriteDistribution(file, "submit", submitDistribution, false);
+            WriteDistribution(file, "gpu", gpuDistribution, true);
+            file << "  }\n}\n";
+            printf("Summary written to %s\n", stressSettings.m_JsonPath.c_str());
+        }
+        else
+        {
+            printf("Could not open summary file: %s\n", stressSettings.m_JsonPath.c_str());
+        }
+    }
+
+    renderer->CleanUp();
+    return 0;
+}
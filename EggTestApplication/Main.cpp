@@ -1,4 +1,6 @@
+#include <chrono>
 #include <filesystem>
+#include <future>
 #include <memory>
 #include <glm/glm/glm.hpp>
 
@@ -6,6 +8,7 @@
 #include "InputQueue.h"
 #include "Timer.h"
 #include "Profiler.h"
+#include "TraceProfiler.h"
 
 struct MeshInstance
 {
@@ -27,6 +30,8 @@ int main()
     settings.clearColor = glm::vec4(0.f, 0.5f, 0.9f, 1.f);
     settings.lockCursor = true;
     settings.m_SwapBufferCount = 3;
+    settings.enableGpuProfiling = true;
+    settings.enableCpuTracing = true;
     settings.shadersPath = std::filesystem::current_path().parent_path().string() + "/Build/shaders/";
 
     auto renderer = EggRenderer::CreateInstance(settings);
@@ -79,6 +84,7 @@ int main()
             t.Translate(t.GetUp() * 0.2f);
             t.RotateAround({ 0.f, 0.f, 0.f }, { 0.f, 1.f, 0.f }, 0.1f);
             meshInstances[i].transform = t.GetTransformation();
+            meshInstances[i].customId = i + 1;
         }
 
         //Plane instance (default constructed)
@@ -139,10 +145,17 @@ int main()
         glm::vec3 dir = glm::normalize(glm::vec3(-1.f, -1.f, -1.f));
         dirLight.SetDirection(dir.x, dir.y, dir.z);
 
+        //Picking queries that have not been resolved yet.
+        std::vector<std::future<std::vector<uint32_t>>> pickingQueries;
+
         //Main loop
         Timer timer;
         static int frameIndex = 0;
         bool run = true;
+        bool streamingStatistics = false;
+        bool capturingDrawData = false;
+        bool debugDraw = false;         //Draw light bounds and a grid with the debug draw API.
+        uint64_t inputTimestamp = 0;    //The oldest input that was applied since the last frame, to measure input latency.
         while(run)
         {
             //Start clocking the time and increment the current frame.
@@ -209,6 +222,10 @@ int main()
                 lightSpheres.emplace_back(drawData->AddInstance(lightTransform.GetTransformation(), materials[2], 0));
 
                 drawData->AddLight(light);
+                if (debugDraw)
+                {
+                    drawData->AddDebugSphere(lightPos, radius, glm::vec4(1.f, 1.f, 0.f, 1.f));
+                }
             }
 
             drawData->AddLight(dirLight);
@@ -245,8 +262,27 @@ int main()
             drawData->AddDeferredShadingDrawPass(&lightDrawCall, 1);
             drawData->AddDeferredShadingDrawPass(&cubeDrawCall, 1);
 
-            //Set the camera.
+            //A grid on the ground plane, submitted as a single batch of lines.
+            if (debugDraw)
+            {
+                constexpr int GRID_HALF_SIZE = 20;
+                std::vector<glm::vec3> gridPoints;
+                gridPoints.reserve((GRID_HALF_SIZE * 2 + 1) * 4);
+                for (int i = -GRID_HALF_SIZE; i <= GRID_HALF_SIZE; ++i)
+                {
+                    const float offset = static_cast<float>(i);
+                    const float extent = static_cast<float>(GRID_HALF_SIZE);
+                    gridPoints.emplace_back(offset, 0.01f, -extent);
+                    gridPoints.emplace_back(offset, 0.01f, extent);
+                    gridPoints.emplace_back(-extent, 0.01f, offset);
+                    gridPoints.emplace_back(extent, 0.01f, offset);
+                }
+                drawData->AddDebugLines(gridPoints.data(), static_cast<uint32_t>(gridPoints.size() / 2), glm::vec4(1.f, 1.f, 1.f, 0.25f));
+            }
+
+            //Set the camera, and tag the frame with the input that moved it.
             drawData->SetCamera(camera);
+            drawData->SetInputTimestamp(inputTimestamp);
             PROFILING_END(DrawData_Building, MILLIS, "")
 
             //Randomly change material color once in a while.
@@ -263,6 +299,7 @@ int main()
 
             //Update input
             auto input = renderer->QueryInput();
+            inputTimestamp = input.GetOldestEventTimestamp();
             MouseEvent mEvent;
             KeyboardEvent kEvent;
             while(input.GetNextEvent(mEvent))
@@ -284,7 +321,35 @@ int main()
                 {
                     std::string mbutton = (mEvent.button == MouseButton::MMB ? "MMB" : mEvent.button == MouseButton::RMB ? "RMB" : "LMB");
                     printf("Mouse button clicked: %s.\n", mbutton.c_str());
+
+                    //The cursor is locked, so pick whatever is in the center of the screen.
+                    if(mEvent.button == MouseButton::LMB)
+                    {
+                        const auto resolution = renderer->GetResolution();
+                        pickingQueries.emplace_back(renderer->QueryCustomIds(static_cast<uint32_t>(resolution.x / 2.f), static_cast<uint32_t>(resolution.y / 2.f)));
+                    }
+                }
+            }
+
+            //Print picking results as they become available.
+            for(auto itr = pickingQueries.begin(); itr != pickingQueries.end();)
+            {
+                if(itr->wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+                {
+                    ++itr;
+                    continue;
+                }
+
+                const auto ids = itr->get();
+                if(!ids.empty() && ids[0] != INVALID_CUSTOM_ID)
+                {
+                    printf("Picked custom ID: %u.\n", ids[0]);
                 }
+                else
+                {
+                    printf("Picked nothing.\n");
+                }
+                itr = pickingQueries.erase(itr);
             }
 
             constexpr float movementSpeed = 0.01f;
@@ -319,6 +384,84 @@ int main()
                         const auto resolution = renderer->GetResolution();
                         camera.UpdateProjection(70.f, 0.1f, 1000.f, resolution.x / resolution.y);
                     }
+
+                    //Write the recorded CPU zones to a file that can be opened in chrome://tracing or Perfetto.
+                    if(kEvent.keyCode == EGG_KEY_T)
+                    {
+                        if(TraceProfiler::ExportChromeTrace("cpu_trace.json"))
+                        {
+                            printf("CPU trace written to cpu_trace.json.\n");
+                        }
+                    }
+
+                    //Toggle streaming frame statistics to a CSV file.
+                    if(kEvent.keyCode == EGG_KEY_C)
+                    {
+                        streamingStatistics = !streamingStatistics;
+                        if(streamingStatistics)
+                        {
+                            streamingStatistics = renderer->StartStatisticsStream("frame_statistics.csv", StatisticsStreamFormat::CSV);
+                        }
+                        else
+                        {
+                            renderer->StopStatisticsStream();
+                        }
+                        printf("Streaming frame statistics: %s.\n", streamingStatistics ? "on" : "off");
+                    }
+
+                    //Toggle capturing the draw data of every frame. The capture can be replayed with EggReplay.
+                    if(kEvent.keyCode == EGG_KEY_P)
+                    {
+                        capturingDrawData = !capturingDrawData;
+                        if(capturingDrawData)
+                        {
+                            capturingDrawData = renderer->StartDrawDataCapture("drawdata_capture.eggcap");
+                        }
+                        else
+                        {
+                            renderer->StopDrawDataCapture();
+                        }
+                        printf("Capturing draw data: %s.\n", capturingDrawData ? "on" : "off");
+                    }
+
+                    //Print where GPU memory is going, and dump the allocator state.
+                    if(kEvent.keyCode == EGG_KEY_M)
+                    {
+                        const auto report = renderer->GetMemoryReport();
+                        for(uint32_t category = 0; category < static_cast<uint32_t>(MemoryCategory::MAX_ENUM); ++category)
+                        {
+                            const auto& usage = report.m_Categories[category];
+                            printf("%s: %u allocations, %llu bytes.\n", GetMemoryCategoryName(static_cast<MemoryCategory>(category)), usage.m_NumAllocations, static_cast<unsigned long long>(usage.m_Bytes));
+                        }
+                        for(const auto& heap : report.m_Heaps)
+                        {
+                            printf("Heap %u: %llu / %llu bytes used, fragmentation %f.\n", heap.m_HeapIndex, static_cast<unsigned long long>(heap.m_Usage), static_cast<unsigned long long>(heap.m_Budget), heap.m_Fragmentation);
+                        }
+                        printf("Live resources: %zu.\n", report.m_LiveResources.size());
+                        renderer->WriteMemoryStatistics("memory_statistics.json", false);
+                    }
+
+                    //Toggle debug drawing.
+                    if(kEvent.keyCode == EGG_KEY_B)
+                    {
+                        debugDraw = !debugDraw;
+                        printf("Debug drawing %s.\n", debugDraw ? "enabled" : "disabled");
+                    }
+
+                    //Cycle through the debug views, and print the counters of the last frame that used one.
+                    if(kEvent.keyCode == EGG_KEY_V)
+                    {
+                        auto debugView = renderer->GetDebugView();
+                        debugView.m_Mode = static_cast<DebugViewMode>((static_cast<uint32_t>(debugView.m_Mode) + 1) % static_cast<uint32_t>(DebugViewMode::MAX_ENUM));
+                        if(renderer->SetDebugView(debugView))
+                        {
+                            printf("Debug view: %s.\n", GetDebugViewModeName(debugView.m_Mode));
+                        }
+
+                        const auto counters = renderer->GetDebugCounters();
+                        printf("Debug counters of frame #%u: %u shaded pixels, %f lights per pixel (max %u), overdraw %f (max %u).\n", counters.m_FrameIndex,
+                            counters.m_NumShadedPixels, counters.GetAverageLightsPerPixel(), counters.m_MaxLightsPerPixel, counters.GetAverageOverdraw(), counters.m_MaxOverdraw);
+                    }
                 }
             }
 
@@ -327,6 +470,34 @@ int main()
                 printf("Frame time: %f ms.\n", timer.Measure(TimeUnit::MILLIS));
                 printf("Frame #%i.\n", frameIndex);
             }
+
+            //Print where the GPU time went once in a while.
+            if (frameIndex % 100 == 0)
+            {
+                const auto gpuHistory = renderer->GetGpuTimingHistory();
+                if (!gpuHistory.empty())
+                {
+                    const auto& gpuFrame = gpuHistory.back();
+                    printf("GPU time for frame #%u: %f ms.\n", gpuFrame.m_FrameIndex, gpuFrame.m_TotalMilliseconds);
+                    for (const auto& zone : gpuFrame.m_Zones)
+                    {
+                        printf("%*s%s: %f ms.\n", zone.m_Depth * 2, "", zone.m_Name.c_str(), zone.m_Milliseconds);
+                    }
+                }
+
+                const auto summary = renderer->GetFrameStatisticsSummary();
+                printf("CPU frame p50/p95/p99: %f/%f/%f ms. GPU frame p50/p95/p99: %f/%f/%f ms. Draw calls p50: %f.\n",
+                    summary.m_CpuFrameMilliseconds.m_P50, summary.m_CpuFrameMilliseconds.m_P95, summary.m_CpuFrameMilliseconds.m_P99,
+                    summary.m_GpuMilliseconds.m_P50, summary.m_GpuMilliseconds.m_P95, summary.m_GpuMilliseconds.m_P99,
+                    summary.m_DrawCalls.m_P50);
+
+                if (summary.m_InputToGpuCompleteMilliseconds.m_NumSamples != 0)
+                {
+                    printf("Input to submit/GPU complete/present p50: %f/%f/%f ms. p99: %f/%f/%f ms.\n",
+                        summary.m_InputToSubmitMilliseconds.m_P50, summary.m_InputToGpuCompleteMilliseconds.m_P50, summary.m_InputToPresentMilliseconds.m_P50,
+                        summary.m_InputToSubmitMilliseconds.m_P99, summary.m_InputToGpuCompleteMilliseconds.m_P99, summary.m_InputToPresentMilliseconds.m_P99);
+                }
+            }
         }
     }
     else
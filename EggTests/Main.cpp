@@ -0,0 +1,566 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <vector>
+#include <glm/glm/glm.hpp>
+#include <glm/glm/gtc/quaternion.hpp>
+#include <glm/glm/ext/matrix_transform.hpp>
+
+#include "DrawData.h"
+#include "GridMesh.h"
+#include "LightTree.h"
+#include "MeshCache.h"
+#include "RangeAllocator.h"
+#include "Resources.h"
+#include "api/DrawDataBuilder.h"
+#include "api/StaticBatch.h"
+#include "api/TransformHierarchy.h"
+
+/*
+ * Behavioral tests for the CPU side of the renderer. No window or Vulkan device is created.
+ * Every failed check is printed, and the exit code is the amount of failed checks.
+ *
+ * Usage: EggTests
+ */
+
+uint32_t g_NumFailed = 0;
+
+#define EGG_CHECK(a_Condition) \
+    do \
+    { \
+        if (!(a_Condition)) \
+        { \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #a_Condition); \
+            ++g_NumFailed; \
+        } \
+    } while (false)
+
+glm::mat4 CreateTranslation(const glm::vec3& a_Translation)
+{
+    glm::mat4 transform(1.f);
+    transform[3] = glm::vec4(a_Translation, 1.f);
+    return transform;
+}
+
+/*
+ * Every index has to refer to an existing vertex, and no triangle may use a vertex twice.
+ */
+bool IsValidTriangleList(const std::vector<egg::Vertex>& a_Vertices, const std::vector<uint32_t>& a_Indices)
+{
+    if (a_Indices.size() % 3 != 0)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < a_Indices.size(); i += 3)
+    {
+        const uint32_t a = a_Indices[i];
+        const uint32_t b = a_Indices[i + 1];
+        const uint32_t c = a_Indices[i + 2];
+        if (a >= a_Vertices.size() || b >= a_Vertices.size() || c >= a_Vertices.size() || a == b || b == c || a == c)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Instances are bucketed by the cell that the center of their bounds falls in, and every level above merges the cells that share a parent.
+ * Cells at negative coordinates must not share a parent with the cells at positive coordinates.
+ */
+void TestStaticBatchClusters()
+{
+    std::vector<egg::Vertex> vertices;
+    std::vector<uint32_t> indices;
+    CreateGridMesh(4, vertices, indices);
+
+    egg::StaticMeshCreateInfo meshInfo;
+    meshInfo.m_VertexBuffer = vertices.data();
+    meshInfo.m_IndexBuffer = indices.data();
+    meshInfo.m_NumVertices = static_cast<uint32_t>(vertices.size());
+    meshInfo.m_NumIndices = static_cast<uint32_t>(indices.size());
+
+    const auto materialA = std::make_shared<egg::Material>(egg::MaterialCreateInfo{});
+    const auto materialB = std::make_shared<egg::Material>(egg::MaterialCreateInfo{});
+
+    egg::StaticBatch batch;
+    const uint32_t sourceMesh = batch.AddSourceMesh(meshInfo);
+
+    //Cells along X with a cluster size of 32: -1 contains x = -1, 0 contains x = 1 and x = 31, and 1 contains x = 33.
+    batch.AddInstance(sourceMesh, materialA, CreateTranslation(glm::vec3(1.f, 0.f, 0.f)));
+    batch.AddInstance(sourceMesh, materialB, CreateTranslation(glm::vec3(31.f, 0.f, 0.f)));
+    batch.AddInstance(sourceMesh, materialA, CreateTranslation(glm::vec3(33.f, 0.f, 0.f)));
+    batch.AddInstance(sourceMesh, materialA, CreateTranslation(glm::vec3(-1.f, 0.f, 0.f)));
+
+    egg::StaticBatchSettings settings;
+    settings.m_ClusterSize = 32.f;
+    settings.m_NumLodLevels = 2;
+    batch.Build(settings);
+
+    EGG_CHECK(batch.GetInstanceCount() == 4);
+    EGG_CHECK(batch.GetClusterCount() == 3);
+    EGG_CHECK(batch.GetNodeCount(0) == 3);
+    EGG_CHECK(batch.GetNodeCount(1) == 2);     //Cells 0 and 1 share parent 0, cell -1 has parent -1.
+    EGG_CHECK(batch.GetNodeCount(2) == 2);
+    EGG_CHECK(batch.GetNodeCount() == 7);
+
+    //Clusters keep all geometry. Their meshes are split by material, so cell 0 has two.
+    const uint64_t sourceTriangles = indices.size() / 3;
+    EGG_CHECK(batch.GetTriangleCount(0) == 4 * sourceTriangles);
+    EGG_CHECK(batch.GetTriangleCount(1) < batch.GetTriangleCount(0));
+    EGG_CHECK(batch.GetTriangleCount(2) <= batch.GetTriangleCount(1));
+    EGG_CHECK(batch.GetMeshCount() >= 4);
+
+    //Building again replaces the previous result.
+    settings.m_NumLodLevels = 0;
+    batch.Build(settings);
+    EGG_CHECK(batch.GetClusterCount() == 3);
+    EGG_CHECK(batch.GetNodeCount() == 3);
+    EGG_CHECK(batch.GetMeshCount() == 4);
+}
+
+/*
+ * A grid finer than the vertices keeps the mesh as it is.
+ */
+void TestSimplifyFineGrid()
+{
+    std::vector<egg::Vertex> vertices;
+    std::vector<uint32_t> indices;
+    CreateGridMesh(4, vertices, indices);
+    const auto numVertices = vertices.size();
+    const auto numIndices = indices.size();
+
+    //The origin is offset by half a cell, so that no vertex lies on a cell boundary.
+    egg::StaticBatch::Simplify(vertices, indices, glm::vec3(-0.55f, -0.05f, -0.55f), 0.1f);
+
+    EGG_CHECK(vertices.size() == numVertices);
+    EGG_CHECK(indices.size() == numIndices);
+    EGG_CHECK(IsValidTriangleList(vertices, indices));
+}
+
+/*
+ * Vertices are merged per cell into their average, and triangles with two corners in one cell are removed.
+ */
+void TestSimplifyCoarseGrid()
+{
+    std::vector<egg::Vertex> vertices;
+    std::vector<uint32_t> indices;
+    CreateGridMesh(4, vertices, indices);
+    const auto numIndices = indices.size();
+
+    //Vertices are a quarter apart from -0.5 to 0.5. Relative to the origin they fall in cells 0, 0, 1, 1 and 2 along X and Z.
+    egg::StaticBatch::Simplify(vertices, indices, glm::vec3(-0.625f, -0.25f, -0.625f), 0.5f);
+
+    EGG_CHECK(vertices.size() == 9);
+    EGG_CHECK(!indices.empty());
+    EGG_CHECK(indices.size() < numIndices);
+    EGG_CHECK(IsValidTriangleList(vertices, indices));
+
+    //The first vertex of the mesh is in the first cell, together with the three vertices next to it.
+    EGG_CHECK(glm::length(vertices[0].position - glm::vec3(-0.375f, 0.f, -0.375f)) < 0.0001f);
+    for (const auto& vertex : vertices)
+    {
+        EGG_CHECK(std::abs(glm::length(vertex.normal) - 1.f) < 0.0001f);
+        EGG_CHECK(vertex.position.y == 0.f);
+    }
+}
+
+/*
+ * A cell that contains the whole mesh collapses every triangle.
+ */
+void TestSimplifySingleCell()
+{
+    std::vector<egg::Vertex> vertices;
+    std::vector<uint32_t> indices;
+    CreateGridMesh(4, vertices, indices);
+
+    egg::StaticBatch::Simplify(vertices, indices, glm::vec3(-1.f), 2.f);
+
+    EGG_CHECK(vertices.size() == 1);
+    EGG_CHECK(indices.empty());
+}
+
+/*
+ * Create a sphere light the way the draw data packs it: position and radius first, then radiance.
+ */
+egg::PackedLightData CreateSphereLight(const glm::vec3& a_Position, float a_Radius, const glm::vec3& a_Radiance, int a_ShadowIndex = -1)
+{
+    egg::PackedLightData light{};
+    light.m_Data1 = glm::vec4(a_Position, a_Radius);
+    light.m_Data2 = glm::vec4(a_Radiance, 0.f);
+    light.m_ShadowIndex = a_ShadowIndex;
+    return light;
+}
+
+/*
+ * The radiance of a sphere light times its projected area, which merging has to keep.
+ */
+glm::vec3 GetTotalPower(const std::vector<egg::PackedLightData>& a_Lights)
+{
+    glm::vec3 power(0.f);
+    for (const auto& light : a_Lights)
+    {
+        power += glm::vec3(light.m_Data2) * light.m_Data1.w * light.m_Data1.w;
+    }
+    return power;
+}
+
+/*
+ * Distant groups of lights are merged into one light that emits as much, while lights with a shadow and lights around the camera are kept.
+ */
+void TestLightTreeCut()
+{
+    //Eight equal lights ten units apart along X, from 0 to 70.
+    std::vector<egg::PackedLightData> lights;
+    for (uint32_t i = 0; i < 8; ++i)
+    {
+        lights.push_back(CreateSphereLight(glm::vec3(10.f * i, 0.f, 0.f), 1.f, glm::vec3(1.f, 2.f, 3.f)));
+    }
+
+    egg::LightTree tree;
+    tree.Build(lights);
+    const glm::vec3 farCamera(35.f, 0.f, 1000.f);
+
+    //Without any allowed error every light is shaded on its own.
+    std::vector<egg::PackedLightData> cut;
+    tree.SelectCut(farCamera, 1000.f, 0.f, cut);
+    EGG_CHECK(cut.size() == 8);
+
+    //Any error is allowed, so everything merges into the root. It is centered on the lights, and emits as much as all of them.
+    cut.clear();
+    tree.SelectCut(farCamera, 1000.f, 1e9f, cut);
+    EGG_CHECK(cut.size() == 1);
+    EGG_CHECK(cut[0].m_ShadowIndex == -1);
+    EGG_CHECK(glm::length(glm::vec3(cut[0].m_Data1) - glm::vec3(35.f, 0.f, 0.f)) < 0.001f);
+    EGG_CHECK(std::abs(cut[0].m_Data1.w - std::sqrt(8.f)) < 0.001f);
+    EGG_CHECK(glm::length(GetTotalPower(cut) - GetTotalPower(lights)) < 0.001f);
+
+    //A camera in between the lights is inside the root, so it is split. Both halves are seen from outside and merged.
+    cut.clear();
+    tree.SelectCut(glm::vec3(35.f, 0.f, 0.f), 1000.f, 1e9f, cut);
+    EGG_CHECK(cut.size() == 2);
+    EGG_CHECK(glm::length(GetTotalPower(cut) - GetTotalPower(lights)) < 0.001f);
+
+    //The cut is appended to the output.
+    tree.SelectCut(farCamera, 1000.f, 1e9f, cut);
+    EGG_CHECK(cut.size() == 3);
+
+    //Lights with a shadow are never merged, and are not part of the tree.
+    lights.push_back(CreateSphereLight(glm::vec3(5.f, 0.f, 0.f), 1.f, glm::vec3(1.f), 0));
+    tree.Build(lights);
+    cut.clear();
+    tree.SelectCut(farCamera, 1000.f, 1e9f, cut);
+    EGG_CHECK(cut.size() == 2);
+    EGG_CHECK(std::count_if(cut.begin(), cut.end(), [](const egg::PackedLightData& a_Light) { return a_Light.m_ShadowIndex == 0; }) == 1);
+    EGG_CHECK(glm::length(GetTotalPower(cut) - GetTotalPower(lights)) < 0.001f);
+
+    //Building again replaces the previous tree.
+    tree.Build({});
+    cut.clear();
+    tree.SelectCut(farCamera, 1000.f, 1e9f, cut);
+    EGG_CHECK(cut.empty());
+}
+
+/*
+ * Fill in the create info for a mesh whose geometry is stored in the given vectors.
+ */
+egg::StaticMeshCreateInfo CreateMeshInfo(std::vector<egg::Vertex>& a_Vertices, std::vector<uint32_t>& a_Indices)
+{
+    egg::StaticMeshCreateInfo meshInfo;
+    meshInfo.m_VertexBuffer = a_Vertices.data();
+    meshInfo.m_IndexBuffer = a_Indices.data();
+    meshInfo.m_NumVertices = static_cast<uint32_t>(a_Vertices.size());
+    meshInfo.m_NumIndices = static_cast<uint32_t>(a_Indices.size());
+    return meshInfo;
+}
+
+/*
+ * Meshes are only shared for exactly the same geometry, even when the keys are equal, and never after they were freed.
+ */
+void TestMeshCache()
+{
+    std::vector<egg::Vertex> verticesA, verticesB;
+    std::vector<uint32_t> indicesA, indicesB;
+    CreateGridMesh(2, verticesA, indicesA);
+    CreateGridMesh(3, verticesB, indicesB);
+    const auto geometryA = CreateMeshInfo(verticesA, indicesA);
+    const auto geometryB = CreateMeshInfo(verticesB, indicesB);
+
+    //Keys depend on the contents, not on where the geometry is stored.
+    auto copiedVertices = verticesA;
+    auto copiedIndices = indicesA;
+    const auto copiedGeometry = CreateMeshInfo(copiedVertices, copiedIndices);
+    const auto keyA = egg::MeshCache::CreateKey(geometryA);
+    EGG_CHECK(egg::MeshCache::CreateKey(copiedGeometry) == keyA);
+    EGG_CHECK(egg::MeshCache::CreateKey(geometryB) != keyA);
+
+    const egg::ShapeCreateInfo shape;
+    const auto shapeKey = egg::MeshCache::CreateKey(shape);
+    EGG_CHECK(shapeKey != keyA);
+
+    egg::MeshCache cache;
+    auto mesh = std::make_shared<egg::EggStaticMesh>();
+    auto shapeMesh = std::make_shared<egg::EggStaticMesh>();
+    cache.Insert(keyA, geometryA, mesh);
+    cache.Insert(shapeKey, shapeMesh);
+    EGG_CHECK(cache.Find(keyA, copiedGeometry) == mesh);
+    EGG_CHECK(cache.Find(shapeKey) == shapeMesh);
+    EGG_CHECK(cache.Find(egg::MeshCache::CreateKey(geometryB), geometryB) == nullptr);
+
+    //A hash collision: the key matches, but a single vertex differs.
+    copiedVertices[0].position.y = 1.f;
+    EGG_CHECK(cache.Find(keyA, copiedGeometry) == nullptr);
+    EGG_CHECK(cache.Find(keyA, geometryB) == nullptr);
+
+    //Entries do not keep meshes alive.
+    mesh.reset();
+    shapeMesh.reset();
+    EGG_CHECK(cache.Find(keyA, geometryA) == nullptr);
+    EGG_CHECK(cache.Find(shapeKey) == nullptr);
+
+    //Empty geometry has no buffers to read.
+    const egg::StaticMeshCreateInfo emptyGeometry;
+    const auto emptyKey = egg::MeshCache::CreateKey(emptyGeometry);
+    EGG_CHECK(emptyKey != keyA);
+    const auto emptyMesh = std::make_shared<egg::EggStaticMesh>();
+    cache.Insert(emptyKey, emptyGeometry, emptyMesh);
+    EGG_CHECK(cache.Find(emptyKey, emptyGeometry) == emptyMesh);
+
+    cache.Clear();
+    EGG_CHECK(cache.Find(emptyKey, emptyGeometry) == nullptr);
+}
+
+/*
+ * Ranges are aligned and handed out first fit, and freed ranges merge with their neighbours so that large ranges can be allocated again.
+ */
+void TestRangeAllocator()
+{
+    egg::RangeAllocator allocator;
+    allocator.Reset(64, 16);
+    EGG_CHECK(allocator.GetFreeSize() == 64);
+    EGG_CHECK(allocator.GetFreeRangeCount() == 1);
+
+    //Sizes are rounded up to the alignment, so four ranges fill the space.
+    size_t offsets[4] = {};
+    for (auto& offset : offsets)
+    {
+        EGG_CHECK(allocator.Allocate(10, offset));
+    }
+    EGG_CHECK(offsets[0] == 0 && offsets[1] == 16 && offsets[2] == 32 && offsets[3] == 48);
+    size_t offset = 0;
+    EGG_CHECK(!allocator.Allocate(1, offset));
+    EGG_CHECK(allocator.GetFreeSize() == 0);
+    EGG_CHECK(allocator.GetFreeRangeCount() == 0);
+
+    //Two separate holes have enough space together, but are too small on their own.
+    allocator.Free(offsets[1], 10);
+    allocator.Free(offsets[3], 10);
+    EGG_CHECK(allocator.GetFreeSize() == 32);
+    EGG_CHECK(allocator.GetFreeRangeCount() == 2);
+    EGG_CHECK(allocator.GetLargestFreeRange() == 16);
+    EGG_CHECK(!allocator.Allocate(32, offset));
+
+    //Freeing the range in between merges all three into one.
+    allocator.Free(offsets[2], 10);
+    EGG_CHECK(allocator.GetFreeRangeCount() == 1);
+    EGG_CHECK(allocator.GetLargestFreeRange() == 48);
+    EGG_CHECK(allocator.Allocate(32, offset));
+    EGG_CHECK(offset == 16);
+
+    //First fit takes the lowest free range that is large enough.
+    allocator.Free(offsets[0], 10);
+    EGG_CHECK(allocator.Allocate(16, offset));
+    EGG_CHECK(offset == 0);
+    EGG_CHECK(allocator.Allocate(16, offset));
+    EGG_CHECK(offset == 48);
+
+    //Resetting forgets all ranges.
+    allocator.Reset(64, 16);
+    EGG_CHECK(allocator.GetLargestFreeRange() == 64);
+    allocator.Reset(0, 16);
+    EGG_CHECK(!allocator.Allocate(1, offset));
+}
+
+/*
+ * Objects that share a mesh share a draw call, and a builder that is kept between frames only reflects the changes made since.
+ */
+void TestDrawDataBuilder()
+{
+    const auto meshA = std::make_shared<egg::EggStaticMesh>();
+    const auto meshB = std::make_shared<egg::EggStaticMesh>();
+    const auto material = std::make_shared<egg::Material>(egg::MaterialCreateInfo{});
+    const auto otherMaterial = std::make_shared<egg::Material>(egg::MaterialCreateInfo{});
+
+    egg::DrawDataBuilder builder;
+    const auto first = builder.Add(meshA, material, CreateTranslation(glm::vec3(0.f)), 0);
+    builder.Add(meshA, otherMaterial, CreateTranslation(glm::vec3(1.f)), 1);
+    const auto third = builder.Add(meshA, material, CreateTranslation(glm::vec3(2.f)), 2);
+    const auto last = builder.Add(meshB, material, CreateTranslation(glm::vec3(3.f)), 3);
+    EGG_CHECK(builder.GetObjectCount() == 4);
+    EGG_CHECK(builder.GetMeshCount() == 2);
+    EGG_CHECK(builder.GetMaterialCount() == 2);
+
+    //One draw call per mesh, and every mesh and material is added once.
+    std::vector<egg::DrawCallHandle> drawCalls;
+    auto drawData = std::make_unique<egg::DrawData>();
+    builder.Build(*drawData, drawCalls);
+    EGG_CHECK(drawCalls.size() == 2);
+    EGG_CHECK(drawData->GetDrawCallCount() == 2);
+    EGG_CHECK(drawData->GetInstanceCount() == 4);
+    EGG_CHECK(drawData->GetMeshCount() == 2);
+    EGG_CHECK(drawData->GetMaterialCount() == 2);
+
+    //Changes show up in the next frame's draw data.
+    builder.SetTransform(first, CreateTranslation(glm::vec3(5.f)));
+    EGG_CHECK(builder.GetTransform(first)[3] == glm::vec4(5.f, 5.f, 5.f, 1.f));
+    builder.SetMaterial(first, otherMaterial);
+    EGG_CHECK(builder.GetMaterialCount() == 2);
+
+    //Removing the only object of a mesh removes its draw call.
+    builder.Remove(last);
+    EGG_CHECK(builder.GetObjectCount() == 3);
+    EGG_CHECK(builder.GetMeshCount() == 1);
+    drawData = std::make_unique<egg::DrawData>();
+    builder.Build(*drawData, drawCalls);
+    EGG_CHECK(drawCalls.size() == 1);
+    EGG_CHECK(drawData->GetDrawCallCount() == 1);
+    EGG_CHECK(drawData->GetInstanceCount() == 3);
+    EGG_CHECK(drawData->GetMeshCount() == 1);
+
+    //A material is dropped once no object uses it anymore.
+    builder.SetMaterial(third, otherMaterial);
+    EGG_CHECK(builder.GetMaterialCount() == 1);
+    builder.Add(meshB, material, CreateTranslation(glm::vec3(4.f)), 4);
+    EGG_CHECK(builder.GetMaterialCount() == 2);
+    EGG_CHECK(builder.GetMeshCount() == 2);
+    EGG_CHECK(builder.GetObjectCount() == 4);
+    drawData = std::make_unique<egg::DrawData>();
+    builder.Build(*drawData, drawCalls);
+    EGG_CHECK(drawData->GetDrawCallCount() == 2);
+    EGG_CHECK(drawData->GetInstanceCount() == 4);
+
+    builder.Clear();
+    EGG_CHECK(builder.GetObjectCount() == 0);
+    EGG_CHECK(builder.GetMeshCount() == 0);
+    EGG_CHECK(builder.GetMaterialCount() == 0);
+    drawData = std::make_unique<egg::DrawData>();
+    builder.Build(*drawData, drawCalls);
+    EGG_CHECK(drawCalls.empty());
+    EGG_CHECK(drawData->GetInstanceCount() == 0);
+}
+
+/*
+ * Compose a world matrix with glm, as the reference for the SIMD matrix math of the hierarchy.
+ */
+glm::mat4 ComposeReference(const glm::mat4& a_Parent, const glm::vec3& a_Translation, const glm::quat& a_Rotation, const glm::vec3& a_Scale)
+{
+    return a_Parent * glm::translate(glm::mat4(1.f), a_Translation) * glm::mat4_cast(a_Rotation) * glm::scale(glm::mat4(1.f), a_Scale);
+}
+
+bool IsNearlyEqual(const glm::mat4& a_First, const glm::mat4& a_Second)
+{
+    for (int column = 0; column < 4; ++column)
+    {
+        if (glm::length(a_First[column] - a_Second[column]) > 0.0001f)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Only changed transforms and their descendants are recalculated, reparenting keeps the local transform,
+ * and world matrices match the same math done with glm.
+ */
+void TestTransformHierarchy()
+{
+    egg::TransformHierarchy hierarchy;
+    const auto root = hierarchy.Create();
+    const auto child = hierarchy.Create(root);
+    const auto grandChild = hierarchy.Create(child);
+    const auto other = hierarchy.Create();
+    EGG_CHECK(hierarchy.GetCount() == 4);
+    EGG_CHECK(hierarchy.Update() == 4);
+    EGG_CHECK(hierarchy.GetLevelCount() == 3);
+    EGG_CHECK(hierarchy.Update() == 0);
+
+    const glm::vec3 rootTranslation(1.f, 2.f, 3.f);
+    const glm::quat rootRotation = glm::angleAxis(0.7f, glm::normalize(glm::vec3(1.f, 1.f, 0.f)));
+    const glm::vec3 rootScale(2.f, 0.5f, 1.5f);
+    const glm::vec3 childTranslation(-4.f, 0.5f, 2.f);
+    const glm::quat childRotation = glm::angleAxis(-1.3f, glm::normalize(glm::vec3(0.f, 0.3f, 1.f)));
+    const glm::vec3 childScale(0.25f, 3.f, 1.f);
+    hierarchy.SetLocal(root, rootTranslation, rootRotation, rootScale);
+    hierarchy.SetLocal(child, childTranslation, childRotation, childScale);
+    hierarchy.SetLocalTranslation(grandChild, glm::vec3(0.f, 1.f, 0.f));
+
+    //The changed root is recalculated with everything below it, but not the unrelated transform.
+    EGG_CHECK(hierarchy.Update() == 3);
+    const glm::mat4 rootWorld = ComposeReference(glm::mat4(1.f), rootTranslation, rootRotation, rootScale);
+    const glm::mat4 childWorld = ComposeReference(rootWorld, childTranslation, childRotation, childScale);
+    const glm::mat4 grandChildWorld = ComposeReference(childWorld, glm::vec3(0.f, 1.f, 0.f), glm::quat(1.f, 0.f, 0.f, 0.f), glm::vec3(1.f));
+    EGG_CHECK(IsNearlyEqual(hierarchy.GetWorldTransform(root), rootWorld));
+    EGG_CHECK(IsNearlyEqual(hierarchy.GetWorldTransform(child), childWorld));
+    EGG_CHECK(IsNearlyEqual(hierarchy.GetWorldTransform(grandChild), grandChildWorld));
+    EGG_CHECK(IsNearlyEqual(hierarchy.GetWorldTransform(other), glm::mat4(1.f)));
+
+    //A leaf only recalculates itself.
+    hierarchy.SetLocalScale(grandChild, glm::vec3(2.f));
+    EGG_CHECK(hierarchy.Update() == 1);
+    EGG_CHECK(IsNearlyEqual(hierarchy.GetWorldTransform(grandChild),
+        ComposeReference(childWorld, glm::vec3(0.f, 1.f, 0.f), glm::quat(1.f, 0.f, 0.f, 0.f), glm::vec3(2.f))));
+
+    //A transform can not be attached below itself.
+    EGG_CHECK(!hierarchy.SetParent(root, grandChild));
+    EGG_CHECK(!hierarchy.SetParent(child, child));
+    EGG_CHECK(hierarchy.GetParent(root) == egg::NO_PARENT_TRANSFORM);
+
+    //Reparenting keeps the local transform, and moves the descendants along.
+    const glm::vec3 otherTranslation(10.f, 0.f, 0.f);
+    hierarchy.SetLocalTranslation(other, otherTranslation);
+    EGG_CHECK(hierarchy.SetParent(child, other));
+    EGG_CHECK(hierarchy.GetParent(child) == other);
+    EGG_CHECK(hierarchy.Update() == 3);
+    const glm::mat4 movedChildWorld = ComposeReference(CreateTranslation(otherTranslation), childTranslation, childRotation, childScale);
+    EGG_CHECK(IsNearlyEqual(hierarchy.GetWorldTransform(child), movedChildWorld));
+    EGG_CHECK(IsNearlyEqual(hierarchy.GetWorldTransform(grandChild),
+        ComposeReference(movedChildWorld, glm::vec3(0.f, 1.f, 0.f), glm::quat(1.f, 0.f, 0.f, 0.f), glm::vec3(2.f))));
+    EGG_CHECK(IsNearlyEqual(hierarchy.GetWorldTransform(root), rootWorld));
+
+    //Removing a transform attaches its children to its parent.
+    hierarchy.Remove(child);
+    EGG_CHECK(hierarchy.GetParent(grandChild) == other);
+    EGG_CHECK(hierarchy.GetCount() == 3);
+    hierarchy.Update();
+    EGG_CHECK(IsNearlyEqual(hierarchy.GetWorldTransform(grandChild),
+        ComposeReference(CreateTranslation(otherTranslation), glm::vec3(0.f, 1.f, 0.f), glm::quat(1.f, 0.f, 0.f, 0.f), glm::vec3(2.f))));
+    EGG_CHECK(hierarchy.GetLevelCount() == 2);
+}
+
+/*
+ * Program entry point.
+ */
+int main()
+{
+    TestStaticBatchClusters();
+    TestSimplifyFineGrid();
+    TestSimplifyCoarseGrid();
+    TestSimplifySingleCell();
+    TestLightTreeCut();
+    TestMeshCache();
+    TestRangeAllocator();
+    TestDrawDataBuilder();
+    TestTransformHierarchy();
+
+    if (g_NumFailed > 0)
+    {
+        printf("%u checks failed.\n", g_NumFailed);
+        return static_cast<int>(g_NumFailed);
+    }
+
+    printf("All tests passed.\n");
+    return 0;
+}